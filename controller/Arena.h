@@ -0,0 +1,113 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//----------------------------------------------------------------------------//
+// Fixed-Size Bump Arena
+//----------------------------------------------------------------------------//
+
+/*
+ * Arena: Statically sized scratch memory that is reset after each operation
+ *
+ * Allocation bumps an offset through a fixed buffer; nothing is freed
+ * individually. The owner calls reset() when the operation (one HTTP poll, one
+ * JSON parse) is finished, so the same bytes are reused forever and the heap
+ * is never touched. Exhaustion returns nullptr instead of growing, which the
+ * caller reports as a failed operation.
+ *
+ * Every block carries a small size header so reallocate() can grow the most
+ * recent block in place (the common case for a string being built up) and
+ * copy the right number of bytes otherwise.
+ *
+ * Key C++ concepts:
+ * - template: The capacity is fixed at compile time, so the arena can be a
+ *   static global with no constructor-time allocation
+ * - alignas: Keeps every block suitably aligned for any scalar type
+ */
+template <size_t Capacity>
+class Arena {
+public:
+  Arena() : used(0), lastBlock(nullptr), highWater(0), failures(0) {}
+
+  /**
+   * Allocate a block from the arena
+   * @param size Bytes requested
+   * @return Aligned block, or nullptr if the arena is exhausted
+   */
+  void* allocate(size_t size) {
+    size_t need = HEADER + roundUp(size);
+    if (need > Capacity - used) {
+      failures++;
+      return nullptr;
+    }
+    uint8_t* block = storage + used;
+    *reinterpret_cast<size_t*>(block) = size;
+    used += need;
+    if (used > highWater) highWater = used;
+    lastBlock = block;
+    return block + HEADER;
+  }
+
+  /**
+   * Resize a block (grows in place when it is the most recent one)
+   * @param ptr Block from allocate(), or nullptr
+   * @param size New size in bytes
+   * @return Resized block (contents preserved), or nullptr if exhausted
+   */
+  void* reallocate(void* ptr, size_t size) {
+    if (ptr == nullptr) {
+      return allocate(size);
+    }
+    uint8_t* block = static_cast<uint8_t*>(ptr) - HEADER;
+    size_t oldSize = *reinterpret_cast<size_t*>(block);
+
+    if (block == lastBlock) {
+      size_t start = block - storage;
+      size_t need = HEADER + roundUp(size);
+      if (need > Capacity - start) {
+        failures++;
+        return nullptr;
+      }
+      *reinterpret_cast<size_t*>(block) = size;
+      used = start + need;
+      if (used > highWater) highWater = used;
+      return ptr;
+    }
+
+    void* moved = allocate(size);
+    if (moved != nullptr) {
+      memcpy(moved, ptr, oldSize < size ? oldSize : size);
+    }
+    return moved;
+  }
+
+  /**
+   * Release every block at once (call when the operation is finished)
+   */
+  void reset() {
+    used = 0;
+    lastBlock = nullptr;
+  }
+
+  size_t capacity() const { return Capacity; }
+  size_t bytesUsed() const { return used; }
+  size_t highWaterMark() const { return highWater; }        // Peak bytes used since boot
+  unsigned long exhaustedCount() const { return failures; } // Allocations refused since boot
+
+private:
+  static const size_t ALIGN = 8;
+  static const size_t HEADER = ALIGN;  // Block size, padded to keep alignment
+
+  static size_t roundUp(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+  alignas(8) uint8_t storage[Capacity];
+  size_t used;
+  uint8_t* lastBlock;
+  size_t highWater;
+  unsigned long failures;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,102 @@
+#include "Boot.h"
+#include "ConfigStore.h"
+#include "IrrigationController.h"
+#include "LoopWatchdog.h"
+#include "ZoneSequencer.h"
+#include "Clock.h"
+#include "WiFiConnection.h"
+#include <WiFi.h>
+
+static BootMetrics g_bootMetrics = {0, 0, 0, 0, false};
+static bool g_wifiProbed = false;
+
+//----------------------------------------------------------------------------//
+// Boot Milestones
+//----------------------------------------------------------------------------//
+
+bool bootRestoreZones(IrrigationSchedule* restored) {
+  // One kv_get; everything else at boot reads from the RAM cache
+  loadConfig();
+
+  bool hasSchedule = loadSchedule(restored);
+  if (hasSchedule) {
+    // Same choice the machine makes when the schedule is stepped in, so no
+    // more zones open than the supply can take
+    ZoneQueue queue = advanceZoneQueue(ZoneQueue(), restored->zoneMask(), clockMonotonicMs());
+    updateZoneLEDs(openZoneSchedule(queue, restored->lastUpdate));
+  }
+  g_bootMetrics.valvesRestoredUs = micros();
+  return hasSchedule;
+}
+
+void bootSetupComplete() {
+  g_bootMetrics.setupCompleteMs = millis();
+}
+
+void bootNoteFirstPoll() {
+  if (g_bootMetrics.firstPollMs == 0) {
+    g_bootMetrics.firstPollMs = millis();
+  }
+}
+
+const BootMetrics& bootMetrics() {
+  return g_bootMetrics;
+}
+
+//----------------------------------------------------------------------------//
+// Deferred Boot Work
+//----------------------------------------------------------------------------//
+
+static void probeWiFiModule() {
+  // The first WiFi call brings up the radio driver, which is the slow part of
+  // boot - by now the valves are already in their persisted state
+  Serial.println("Checking WiFi module...");
+  int status = wifiLinkStatus();
+  g_bootMetrics.wifiProbedMs = millis();
+
+  if (status == WL_NO_MODULE) {
+    // Keep running: zones hold their restored state and the machine will
+    // report the module as disconnected
+    Serial.println("ERROR: WiFi module not detected!");
+    return;
+  }
+
+  // Log current WiFi module status for debugging
+  Serial.print("WiFi module status: ");
+  Serial.println(status);
+
+  // Display firmware version for diagnostics
+  Serial.print("WiFi firmware: ");
+  Serial.println(WiFi.firmwareVersion());
+}
+
+static void reportBootMetrics() {
+  Serial.println("=== Boot Metrics ===");
+  Serial.print("Valves restored: ");
+  Serial.print(g_bootMetrics.valvesRestoredUs);
+  Serial.println(" us");
+  Serial.print("Setup complete: ");
+  Serial.print(g_bootMetrics.setupCompleteMs);
+  Serial.println(" ms");
+  Serial.print("WiFi module probed: ");
+  Serial.print(g_bootMetrics.wifiProbedMs);
+  Serial.println(" ms");
+  Serial.print("First poll: ");
+  Serial.print(g_bootMetrics.firstPollMs);
+  Serial.println(" ms");
+  printWatchdogReport();
+}
+
+void serviceBoot() {
+  if (!g_wifiProbed) {
+    g_wifiProbed = true;
+    probeWiFiModule();
+  }
+
+  // Report once a host is listening and the last milestone has happened,
+  // however long either takes
+  if (!g_bootMetrics.reported && g_bootMetrics.firstPollMs != 0 && Serial) {
+    reportBootMetrics();
+    g_bootMetrics.reported = true;
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Fast Boot Sequence
+//----------------------------------------------------------------------------//
+
+/*
+ * Boot is ordered so that nothing slow stands between reset and the valves:
+ *
+ *   setup()   pins -> config record -> zone outputs restored   (milliseconds)
+ *             Serial.begin (no wait for a host), machine setup
+ *   loop()    WiFi module probe on the first pass, connection via the
+ *             network mailbox, serial report whenever a host shows up
+ *
+ * Serial, the WiFi probe and the connection never wait on one another; the
+ * boot metrics below record how long each milestone took.
+ */
+
+struct BootMetrics {
+  unsigned long valvesRestoredUs;  // micros() when persisted zones hit the pins
+  unsigned long setupCompleteMs;   // millis() when setup() returned
+  unsigned long wifiProbedMs;      // millis() when the WiFi module answered (0 = not yet)
+  unsigned long firstPollMs;       // millis() when the first schedule poll was posted (0 = not yet)
+  bool reported;                   // Metrics have been printed to a serial host
+};
+
+/**
+ * Restore persisted zone outputs as the very first thing after pin setup
+ * Reads the configuration record (one flash read) and drives the zone pins.
+ * @param restored Populated with the persisted schedule when one exists
+ * @return true if a persisted schedule was applied
+ */
+bool bootRestoreZones(IrrigationSchedule* restored);
+
+/**
+ * Record that setup() has finished
+ */
+void bootSetupComplete();
+
+/**
+ * Run deferred boot work from loop(): the WiFi module probe on the first
+ * call, and the boot metrics report once a serial host is attached
+ */
+void serviceBoot();
+
+/**
+ * Record the first schedule poll (no-op after the first call)
+ */
+void bootNoteFirstPoll();
+
+/**
+ * Access the boot milestone timings
+ * @return Boot metrics collected so far
+ */
+const BootMetrics& bootMetrics();
+
+#endif // BOOT_H
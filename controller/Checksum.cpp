@@ -0,0 +1,117 @@
+#include "Checksum.h"
+#include <string.h>
+
+// Nibble-wide lookup: 64 bytes of flash instead of 1 KB for a byte table,
+// and still fast enough for the few hundred bytes we checksum at a time
+static const uint32_t CRC32_NIBBLE_TABLE[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= bytes[i];
+    crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ CRC32_NIBBLE_TABLE[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+//----------------------------------------------------------------------------//
+// SHA-256 (FIPS 180-4)
+//----------------------------------------------------------------------------//
+
+static const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(uint32_t state[8], const uint8_t* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+           ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+    uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256Begin(Sha256* hash) {
+  static const uint32_t INITIAL[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  for (int i = 0; i < 8; i++) {
+    hash->state[i] = INITIAL[i];
+  }
+  hash->length = 0;
+}
+
+void sha256Update(Sha256* hash, const void* data, size_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  size_t used = hash->length % 64;
+  hash->length += length;
+
+  // Top up a partial block first, then hash whole blocks straight from input
+  if (used > 0) {
+    size_t take = 64 - used < length ? 64 - used : length;
+    memcpy(hash->block + used, bytes, take);
+    bytes += take;
+    length -= take;
+    if (used + take < 64) {
+      return;
+    }
+    sha256Block(hash->state, hash->block);
+  }
+  while (length >= 64) {
+    sha256Block(hash->state, bytes);
+    bytes += 64;
+    length -= 64;
+  }
+  memcpy(hash->block, bytes, length);
+}
+
+void sha256End(Sha256* hash, uint8_t digest[SHA256_DIGEST_SIZE]) {
+  uint64_t bits = hash->length * 8;
+  uint8_t pad[72] = {0x80};
+  size_t used = hash->length % 64;
+  size_t padLength = (used < 56 ? 56 : 120) - used;
+  for (int i = 0; i < 8; i++) {
+    pad[padLength + i] = (uint8_t)(bits >> (56 - 8 * i));
+  }
+  sha256Update(hash, pad, padLength + 8);
+
+  for (int i = 0; i < 8; i++) {
+    digest[i * 4] = (uint8_t)(hash->state[i] >> 24);
+    digest[i * 4 + 1] = (uint8_t)(hash->state[i] >> 16);
+    digest[i * 4 + 2] = (uint8_t)(hash->state[i] >> 8);
+    digest[i * 4 + 3] = (uint8_t)hash->state[i];
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Checksums
+//----------------------------------------------------------------------------//
+
+/**
+ * CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320)
+ * Matches zlib's crc32(), so host tools can verify records with standard libraries
+ * @param data Bytes to checksum
+ * @param length Number of bytes
+ * @param crc Running CRC from a previous call, or 0 to start
+ * @return Updated CRC
+ */
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+//----------------------------------------------------------------------------//
+// SHA-256
+//----------------------------------------------------------------------------//
+
+// Digests firmware images (FirmwareImage.h), where a CRC can be forged.
+// Plain data, so a running hash can be copied or stored like any struct.
+const size_t SHA256_DIGEST_SIZE = 32;
+
+struct Sha256 {
+  uint32_t state[8];
+  uint64_t length;       // Bytes hashed so far
+  uint8_t block[64];     // Partial block awaiting more input
+};
+
+/**
+ * Start a new hash
+ * @param hash Context to initialize
+ */
+void sha256Begin(Sha256* hash);
+
+/**
+ * Hash more bytes
+ * @param hash Running context
+ * @param data Bytes to add
+ * @param length Number of bytes
+ */
+void sha256Update(Sha256* hash, const void* data, size_t length);
+
+/**
+ * Finish the hash (the context must be restarted before reuse)
+ * @param hash Running context
+ * @param digest Receives SHA256_DIGEST_SIZE bytes
+ */
+void sha256End(Sha256* hash, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#endif // CHECKSUM_H
@@ -0,0 +1,100 @@
+#include "Clock.h"
+
+// Drift is measured over at least this long, so that sample jitter (tens of
+// ms at worst) is a few ppm of the interval
+static const uint64_t CLOCK_DRIFT_BASELINE_MS = 3600000;  // 1 hour
+
+// Crystals are within ~100 ppm; anything beyond this is a step, not drift
+static const int64_t CLOCK_MAX_DRIFT_PPB = 500000;        // 500 ppm
+
+static const uint64_t NTP_UNIX_OFFSET_S = 2208988800ULL;  // 1900 to 1970
+
+static const int64_t PPB = 1000000000;
+static const int64_t MS_PER_MINUTE = 60000;
+static const int64_t MINUTES_PER_DAY = 1440;
+
+//----------------------------------------------------------------------------//
+// Monotonic Clock
+//----------------------------------------------------------------------------//
+
+uint64_t clockMonotonicMs() {
+  static uint32_t lastMillis = 0;
+  static uint64_t wraps = 0;
+  uint32_t now = (uint32_t)millis();
+  if (now < lastMillis) {
+    wraps += 1ULL << 32;
+  }
+  lastMillis = now;
+  return wraps | now;
+}
+
+//----------------------------------------------------------------------------//
+// Wall Clock
+//----------------------------------------------------------------------------//
+
+WallClock wallClockSync(const WallClock& clock, uint64_t now, uint64_t unixMs) {
+  WallClock next = clock;
+  next.syncs++;
+  next.syncedAt = now;
+  next.syncedUnixMs = unixMs;
+  if (!clock.isSet()) {
+    next.referenceAt = now;
+    next.referenceUnixMs = unixMs;
+    return next;
+  }
+
+  uint64_t localElapsed = now - clock.referenceAt;
+  if (localElapsed < CLOCK_DRIFT_BASELINE_MS) {
+    return next;  // Too soon to tell drift from jitter; keep measuring
+  }
+  int64_t trueElapsed = (int64_t)(unixMs - clock.referenceUnixMs);
+  int64_t measuredPpb = trueElapsed > 0
+      ? ((int64_t)localElapsed - trueElapsed) * PPB / trueElapsed
+      : CLOCK_MAX_DRIFT_PPB + 1;
+  if (measuredPpb > CLOCK_MAX_DRIFT_PPB || measuredPpb < -CLOCK_MAX_DRIFT_PPB) {
+    // Stepped, not drifted: measure again from here, keep the estimate
+    next.referenceAt = now;
+    next.referenceUnixMs = unixMs;
+    return next;
+  }
+
+  // Halfway to each new measurement: converges in a few syncs and halves
+  // the noise of any one of them
+  next.driftPpb = clock.driftPpb == 0 ? (int32_t)measuredPpb
+                                      : (int32_t)((clock.driftPpb + measuredPpb) / 2);
+  next.referenceAt = now;
+  next.referenceUnixMs = unixMs;
+  return next;
+}
+
+uint64_t wallClockUnixMs(const WallClock& clock, uint64_t now) {
+  if (!clock.isSet()) {
+    return 0;
+  }
+  // A fast crystal (positive drift) makes local intervals too long
+  int64_t elapsed = (int64_t)(now - clock.syncedAt);
+  return clock.syncedUnixMs + elapsed - elapsed * clock.driftPpb / PPB;
+}
+
+static uint32_t readBigEndian32(const uint8_t* bytes) {
+  return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+         ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+uint64_t ntpToUnixMs(const uint8_t* timestamp) {
+  uint64_t seconds = readBigEndian32(timestamp);
+  uint64_t fraction = readBigEndian32(timestamp + 4);
+  if (seconds < 0x80000000ULL) {
+    seconds += 1ULL << 32;  // Era 1
+  }
+  return (seconds - NTP_UNIX_OFFSET_S) * 1000 + ((fraction * 1000) >> 32);
+}
+
+int wallClockMinuteOfDay(const WallClock& clock, uint64_t now) {
+  if (!clock.isSet()) {
+    return -1;
+  }
+  int64_t localMinutes = (int64_t)(wallClockUnixMs(clock, now) / MS_PER_MINUTE) + utc_offset_minutes;
+  int64_t minute = localMinutes % MINUTES_PER_DAY;
+  return (int)(minute < 0 ? minute + MINUTES_PER_DAY : minute);
+}
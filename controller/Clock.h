@@ -0,0 +1,78 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Monotonic and Wall-Clock Time
+//----------------------------------------------------------------------------//
+
+/*
+ * Two clocks, both in milliseconds:
+ *
+ *   monotonic   clockMonotonicMs() - millis() extended to 64 bits, so
+ *               timestamps in the state never wrap (millis() does after
+ *               49.7 days). Every Input is stamped with it before it is
+ *               stepped, and the transition and output functions take their
+ *               notion of "now" from that stamp rather than reading a clock.
+ *   wall        WallClock in AppState - Unix time from SNTP (TimeSync.h),
+ *               delivered as INPUT_TIME_SYNCED and carried forward on the
+ *               monotonic clock between syncs.
+ *
+ * Between syncs the wall clock runs on the board's crystal, which is off by
+ * some tens of ppm (seconds per day). Each sync compares how far the two
+ * clocks moved since the last drift measurement, at least an hour apart so
+ * the few milliseconds of jitter in each sample don't dominate, and keeps a
+ * smoothed rate correction. Wall time then stays close through network
+ * outages of days, and time-of-day decisions need no round trip.
+ *
+ * Everything except clockMonotonicMs() is pure and linkable into host tools.
+ */
+
+/**
+ * Milliseconds since boot, never wrapping
+ * Extends millis() by counting its wraps, so it must be called at least once
+ * per 49 days - the control loop stamps every input with it.
+ * @return Monotonic time in milliseconds
+ */
+uint64_t clockMonotonicMs();
+
+/**
+ * Take an SNTP sample into the wall clock
+ * Steps the clock to the sample and, once enough time has passed since the
+ * last measurement, refines the drift estimate. Samples implying a rate
+ * error no crystal has (a server step, a bad reply) only step the clock.
+ * @param clock Current wall clock
+ * @param now Monotonic time of the sample
+ * @param unixMs Wall time at `now` (ms since 1970-01-01 UTC)
+ * @return Updated wall clock
+ */
+WallClock wallClockSync(const WallClock& clock, uint64_t now, uint64_t unixMs);
+
+/**
+ * Wall time at a monotonic time, drift corrected
+ * @param clock Wall clock
+ * @param now Monotonic time
+ * @return Unix time in milliseconds, 0 if the clock has never been synced
+ */
+uint64_t wallClockUnixMs(const WallClock& clock, uint64_t now);
+
+/**
+ * Convert an NTP timestamp to Unix time
+ * Seconds below 2^31 are taken as era 1 (from 2036-02-07), the SNTP
+ * convention, so the conversion works until 2104.
+ * @param timestamp 64-bit NTP timestamp as sent (big-endian seconds since
+ *        1900, then a 32-bit fraction)
+ * @return Unix time in milliseconds
+ */
+uint64_t ntpToUnixMs(const uint8_t* timestamp);
+
+/**
+ * Local time of day at a monotonic time (utc_offset_minutes applied)
+ * @param clock Wall clock
+ * @param now Monotonic time
+ * @return Minutes since local midnight (0-1439), -1 if the clock is not set
+ */
+int wallClockMinuteOfDay(const WallClock& clock, uint64_t now);
+
+#endif // CLOCK_H
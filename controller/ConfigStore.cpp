@@ -0,0 +1,260 @@
+#include "ConfigStore.h"
+#include "Checksum.h"
+#include "LoopWatchdog.h"
+#include "kvstore_global_api.h"
+#include <mbed_error.h>
+
+//----------------------------------------------------------------------------//
+// Storage Keys
+//----------------------------------------------------------------------------//
+
+const char* KEY_CONFIG = "config";                        // Current single record
+
+// Keys written by firmware before the single record existed. Read once to
+// migrate, then removed.
+const char* LEGACY_KEY_SSID = "wifi_ssid";
+const char* LEGACY_KEY_PASS = "wifi_pass";
+const char* LEGACY_KEY_SCHEDULE = "irrigation_schedule";
+
+//----------------------------------------------------------------------------//
+// RAM Cache
+//----------------------------------------------------------------------------//
+
+static ConfigPayload g_config;        // What the rest of the firmware sees
+static ConfigPayload g_configStored;  // What's on flash (to skip no-op writes)
+static bool g_configLoaded = false;
+
+//----------------------------------------------------------------------------//
+// Migrations
+//----------------------------------------------------------------------------//
+
+/*
+ * Bring a payload written by an older layout up to CONFIG_VERSION.
+ * Fields appended after `fromVersion` are already zeroed by the caller;
+ * cases only need to set non-zero defaults. Cases fall through so a record
+ * several versions old is upgraded one step at a time.
+ */
+static void migrateConfig(uint16_t fromVersion, ConfigPayload* payload) {
+  (void)payload;
+  switch (fromVersion) {
+    case 1:
+      // Version 2 appended the backup networks; zeroed means none
+    case 2:
+      // Current layout - nothing to do
+      break;
+  }
+}
+
+// Pull the pre-record keys into the payload. Returns true if anything was found.
+static bool migrateLegacyKeys(ConfigPayload* payload) {
+  bool found = false;
+  size_t actual = 0;
+
+  if (kv_get(LEGACY_KEY_SSID, payload->ssid, sizeof(payload->ssid) - 1, &actual) == MBED_SUCCESS &&
+      kv_get(LEGACY_KEY_PASS, payload->pass, sizeof(payload->pass) - 1, &actual) == MBED_SUCCESS) {
+    payload->flags |= CONFIG_HAS_CREDENTIALS;
+    found = true;
+  }
+
+  // Old schedule was the raw IrrigationSchedule struct: three bools first
+  uint8_t legacySchedule[16] = {0};
+  if (kv_get(LEGACY_KEY_SCHEDULE, legacySchedule, sizeof(legacySchedule), &actual) == MBED_SUCCESS &&
+      actual >= 3) {
+    payload->zoneMask = (legacySchedule[0] ? 0x01 : 0) |
+                        (legacySchedule[1] ? 0x02 : 0) |
+                        (legacySchedule[2] ? 0x04 : 0);
+    payload->flags |= CONFIG_HAS_SCHEDULE;
+    found = true;
+  }
+
+  if (found) {
+    Serial.println("Migrating legacy credential/schedule keys to config record");
+  }
+  return found;
+}
+
+static void removeLegacyKeys() {
+  kv_remove(LEGACY_KEY_SSID);
+  kv_remove(LEGACY_KEY_PASS);
+  kv_remove(LEGACY_KEY_SCHEDULE);
+}
+
+//----------------------------------------------------------------------------//
+// Record I/O
+//----------------------------------------------------------------------------//
+
+// Validate a raw record and copy the known prefix of its payload into `out`
+static bool decodeRecord(const uint8_t* raw, size_t size, ConfigPayload* out) {
+  if (size < sizeof(ConfigHeader)) {
+    Serial.println("Config record truncated - ignoring");
+    return false;
+  }
+
+  ConfigHeader header;
+  memcpy(&header, raw, sizeof(header));
+
+  if (header.magic != CONFIG_MAGIC) {
+    Serial.println("Config record has bad magic - ignoring");
+    return false;
+  }
+  if (sizeof(ConfigHeader) + header.payloadLength > size) {
+    Serial.println("Config record shorter than its header claims - ignoring");
+    return false;
+  }
+
+  const uint8_t* payload = raw + sizeof(ConfigHeader);
+  if (crc32(payload, header.payloadLength) != header.crc) {
+    Serial.println("Config record CRC mismatch - ignoring");
+    return false;
+  }
+
+  // Take the prefix both layouts share; anything we don't know stays zero
+  memset(out, 0, sizeof(*out));
+  size_t known = header.payloadLength < sizeof(*out) ? header.payloadLength : sizeof(*out);
+  memcpy(out, payload, known);
+
+  // Never trust stored strings to be terminated
+  out->ssid[sizeof(out->ssid) - 1] = '\0';
+  out->pass[sizeof(out->pass) - 1] = '\0';
+  if (out->backupCount > CONFIG_BACKUP_NETWORKS) {
+    out->backupCount = CONFIG_BACKUP_NETWORKS;
+  }
+  for (int i = 0; i < CONFIG_BACKUP_NETWORKS; i++) {
+    out->backups[i].ssid[sizeof(out->backups[i].ssid) - 1] = '\0';
+    out->backups[i].pass[sizeof(out->backups[i].pass) - 1] = '\0';
+  }
+
+  if (header.version < CONFIG_VERSION) {
+    Serial.print("Migrating config record from version ");
+    Serial.println(header.version);
+    migrateConfig(header.version, out);
+  } else if (header.version > CONFIG_VERSION) {
+    Serial.print("Config record from newer firmware (version ");
+    Serial.print(header.version);
+    Serial.println(") - using known fields");
+  }
+  return true;
+}
+
+static void writeRecord(const ConfigPayload* payload) {
+  uint8_t raw[sizeof(ConfigHeader) + sizeof(ConfigPayload)];
+
+  ConfigHeader header;
+  header.magic = CONFIG_MAGIC;
+  header.version = CONFIG_VERSION;
+  header.payloadLength = sizeof(ConfigPayload);
+  header.crc = crc32(payload, sizeof(ConfigPayload));
+
+  memcpy(raw, &header, sizeof(header));
+  memcpy(raw + sizeof(header), payload, sizeof(ConfigPayload));
+
+  int set_result = kv_set(KEY_CONFIG, raw, sizeof(raw), 0);
+
+  // Check for storage errors - reset on failure (critical error)
+  if (set_result != MBED_SUCCESS) {
+    char detail[32];
+    snprintf(detail, sizeof(detail), "kv_set config: %d", set_result);
+    watchdogFatal(detail);
+  }
+}
+
+bool loadConfig() {
+  if (g_configLoaded) {
+    return (g_config.flags != 0);
+  }
+  g_configLoaded = true;
+  memset(&g_config, 0, sizeof(g_config));
+
+  // The one flash read on the boot path
+  uint8_t raw[CONFIG_MAX_RECORD_SIZE];
+  size_t actual = 0;
+  int get_result = kv_get(KEY_CONFIG, raw, sizeof(raw), &actual);
+
+  bool valid = false;
+  if (get_result == MBED_SUCCESS) {
+    valid = decodeRecord(raw, actual, &g_config);
+    if (!valid) {
+      memset(&g_config, 0, sizeof(g_config));
+    }
+  } else if (get_result == MBED_ERROR_ITEM_NOT_FOUND) {
+    // First boot on this layout - carry over anything older firmware stored
+    if (migrateLegacyKeys(&g_config)) {
+      writeRecord(&g_config);
+      removeLegacyKeys();
+      valid = true;
+    }
+  } else {
+    char detail[32];
+    snprintf(detail, sizeof(detail), "kv_get config: %d", get_result);
+    watchdogFatal(detail);  // Critical error - reset
+  }
+
+  // If the stored record was from another version, the next commit rewrites it
+  g_configStored = g_config;
+  return valid;
+}
+
+ConfigPayload* configPayload() {
+  loadConfig();
+  return &g_config;
+}
+
+void commitConfig() {
+  loadConfig();
+  if (memcmp(&g_config, &g_configStored, sizeof(g_config)) == 0) {
+    return;  // Nothing changed - spare the flash
+  }
+  writeRecord(&g_config);
+  g_configStored = g_config;
+}
+
+//----------------------------------------------------------------------------//
+// Schedule Persistence Functions
+//----------------------------------------------------------------------------//
+
+void saveSchedule(const IrrigationSchedule* schedule) {
+  ConfigPayload* config = configPayload();
+  config->zoneMask = schedule->zoneMask();
+  config->flags |= CONFIG_HAS_SCHEDULE;
+  commitConfig();
+}
+
+bool loadSchedule(IrrigationSchedule* schedule) {
+  const ConfigPayload* config = configPayload();
+  if (!(config->flags & CONFIG_HAS_SCHEDULE)) {
+    Serial.println("No saved schedule found");
+    return false;
+  }
+
+  schedule->zone1 = (config->zoneMask & 0x01) != 0;
+  schedule->zone2 = (config->zoneMask & 0x02) != 0;
+  schedule->zone3 = (config->zoneMask & 0x04) != 0;
+  schedule->lastUpdate = 0;  // Timestamps don't survive a reboot
+
+  Serial.print("Loaded schedule from flash: zones=");
+  Serial.print(schedule->zone1 ? "1" : "0");
+  Serial.print(schedule->zone2 ? "1" : "0");
+  Serial.println(schedule->zone3 ? "1" : "0");
+
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Network Cache Persistence Functions
+//----------------------------------------------------------------------------//
+
+void saveNetworkCache(const NetworkCache* cache) {
+  ConfigPayload* config = configPayload();
+  memcpy(config->serverAddress, cache->serverAddress, sizeof(config->serverAddress));
+  config->flags |= CONFIG_HAS_NETWORK_CACHE;
+  commitConfig();
+}
+
+bool loadNetworkCache(NetworkCache* cache) {
+  const ConfigPayload* config = configPayload();
+  if (!(config->flags & CONFIG_HAS_NETWORK_CACHE)) {
+    return false;
+  }
+  memcpy(cache->serverAddress, config->serverAddress, sizeof(cache->serverAddress));
+  return true;
+}
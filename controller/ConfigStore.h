@@ -0,0 +1,132 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Persistent Configuration Record
+//----------------------------------------------------------------------------//
+
+/*
+ * Everything the controller persists lives in ONE KVStore record:
+ *
+ *   +-----------------------------+----------------------------------+
+ *   | ConfigHeader (12 bytes)     | ConfigPayload (payloadLength)    |
+ *   | magic, version, length, crc | networks, schedule, net cache     |
+ *   +-----------------------------+----------------------------------+
+ *
+ * The record is read with a single kv_get at boot into a RAM cache; every
+ * getter below reads from that cache. Writes replace the whole record and
+ * are skipped when nothing changed.
+ *
+ * Layout rules (so old and new firmware can read each other's records):
+ * - Both structs are packed; there is no compiler padding on flash
+ * - Fields are only ever APPENDED to ConfigPayload, never reordered or resized
+ * - Each append bumps CONFIG_VERSION and adds a case to migrateConfig()
+ * - A record from newer firmware is still accepted: we read the prefix we
+ *   know about and ignore the rest
+ */
+
+const uint32_t CONFIG_MAGIC = 0x46435249;   // "IRCF" little-endian
+const uint16_t CONFIG_VERSION = 2;
+const size_t CONFIG_MAX_RECORD_SIZE = 512;  // Read buffer; future payloads must fit
+
+// ConfigPayload.flags bits
+const uint8_t CONFIG_HAS_CREDENTIALS = 0x01;
+const uint8_t CONFIG_HAS_SCHEDULE = 0x02;
+const uint8_t CONFIG_HAS_NETWORK_CACHE = 0x04;
+
+// Networks kept besides the primary one in ssid/pass (see CredentialStore.h)
+const int CONFIG_BACKUP_NETWORKS = 3;
+
+struct __attribute__((packed)) ConfigHeader {
+  uint32_t magic;          // CONFIG_MAGIC
+  uint16_t version;        // Layout version of the payload that follows
+  uint16_t payloadLength;  // Bytes of payload stored (may differ from sizeof)
+  uint32_t crc;            // CRC-32 of the payload bytes
+};
+
+struct __attribute__((packed)) StoredNetwork {
+  char ssid[33];           // 802.11 SSIDs are at most 32 bytes
+  char pass[64];
+};
+
+struct __attribute__((packed)) ConfigPayload {
+  // Version 1
+  uint8_t flags;           // CONFIG_HAS_* bits
+  char ssid[64];           // WiFi network name (the most recently entered)
+  char pass[64];           // WiFi password
+  uint8_t zoneMask;        // Bit n = zone n+1 active (lastUpdate is never stored)
+  uint8_t unused[6];       // Was the last BSSID, never read; kept for the layout
+  uint8_t serverAddress[4];// Last resolved IPv4 address of the schedule server
+  // Version 2
+  uint8_t backupCount;     // Entries used in backups
+  StoredNetwork backups[CONFIG_BACKUP_NETWORKS]; // Earlier networks, most recent first
+};
+
+static_assert(sizeof(ConfigHeader) + sizeof(ConfigPayload) <= CONFIG_MAX_RECORD_SIZE,
+              "Config record must fit the read buffer");
+
+/*
+ * NetworkCache: The last resolved server address, so the next boot can skip DNS
+ */
+struct NetworkCache {
+  uint8_t serverAddress[4];
+};
+
+/**
+ * Read the configuration record from flash into the RAM cache (one kv_get)
+ * Safe to call more than once; only the first call touches flash.
+ * Migrates records written by older firmware, including the legacy
+ * per-field keys, and logs why a record was rejected.
+ * @return true if a valid record was found, false if starting from defaults
+ */
+bool loadConfig();
+
+/**
+ * Access the cached payload (loads it on first use)
+ * Callers modify fields and then call commitConfig()
+ * @return Pointer to the RAM copy of the payload
+ */
+ConfigPayload* configPayload();
+
+/**
+ * Write the cached payload back to flash if it differs from what's stored
+ */
+void commitConfig();
+
+//----------------------------------------------------------------------------//
+// Schedule Persistence
+//----------------------------------------------------------------------------//
+
+/**
+ * Persist irrigation schedule (zone states only)
+ * @param schedule Pointer to schedule structure to save
+ */
+void saveSchedule(const IrrigationSchedule* schedule);
+
+/**
+ * Load irrigation schedule from the cached configuration record
+ * @param schedule Pointer to schedule structure to populate
+ * @return true if a schedule was stored, false otherwise
+ */
+bool loadSchedule(IrrigationSchedule* schedule);
+
+//----------------------------------------------------------------------------//
+// Network Cache Persistence
+//----------------------------------------------------------------------------//
+
+/**
+ * Persist connection hints
+ * @param cache Pointer to cache structure to save
+ */
+void saveNetworkCache(const NetworkCache* cache);
+
+/**
+ * Load connection hints from the cached configuration record
+ * @param cache Pointer to cache structure to populate
+ * @return true if hints were stored, false otherwise
+ */
+bool loadNetworkCache(NetworkCache* cache);
+
+#endif // CONFIG_STORE_H
@@ -0,0 +1,65 @@
+#include "CredentialStore.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------//
+// Store
+//----------------------------------------------------------------------------//
+
+int credentialStoreFind(const CredentialStore& store, const char* ssid) {
+  for (int i = 0; i < store.count; i++) {
+    if (strcmp(store.networks[i].ssid, ssid) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void credentialStoreRemember(CredentialStore* store, const Credentials& creds) {
+  // Shift everything in front of the old entry (or the whole store, dropping
+  // the least recent if it's full) back by one
+  int from = credentialStoreFind(*store, creds.ssid);
+  if (from < 0) {
+    from = store->count < CREDENTIAL_STORE_SIZE ? store->count++ : CREDENTIAL_STORE_SIZE - 1;
+  }
+  for (int i = from; i > 0; i--) {
+    store->networks[i] = store->networks[i - 1];
+  }
+  store->networks[0] = creds;
+}
+
+//----------------------------------------------------------------------------//
+// Failover Plan
+//----------------------------------------------------------------------------//
+
+void networkPlanBegin(NetworkPlan* plan) {
+  for (int i = 0; i < CREDENTIAL_STORE_SIZE; i++) {
+    plan->rssi[i] = NETWORK_NOT_SEEN;
+  }
+  plan->count = 0;
+  plan->next = 0;
+}
+
+void networkPlanSeen(NetworkPlan* plan, const CredentialStore& store, const char* ssid, int32_t rssi) {
+  int index = credentialStoreFind(store, ssid);
+  if (index >= 0 && rssi > plan->rssi[index]) {
+    plan->rssi[index] = rssi;
+  }
+}
+
+void networkPlanRank(NetworkPlan* plan, const CredentialStore& store) {
+  // Insertion sort of at most CREDENTIAL_STORE_SIZE entries; a stable sort
+  // over store order keeps the more recent network first on a tie
+  plan->count = 0;
+  plan->next = 0;
+  for (int i = 0; i < store.count; i++) {
+    if (plan->rssi[i] == NETWORK_NOT_SEEN) {
+      continue;
+    }
+    int slot = plan->count++;
+    while (slot > 0 && plan->rssi[plan->order[slot - 1]] < plan->rssi[i]) {
+      plan->order[slot] = plan->order[slot - 1];
+      slot--;
+    }
+    plan->order[slot] = (uint8_t)i;
+  }
+}
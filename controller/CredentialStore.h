@@ -0,0 +1,85 @@
+#ifndef CREDENTIAL_STORE_H
+#define CREDENTIAL_STORE_H
+
+#include "Types.h"
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Known WiFi Networks
+//----------------------------------------------------------------------------//
+
+/*
+ * Sites often have more than one access point (a primary and a backup, or
+ * one per building), so the controller remembers the last few networks it
+ * was given, most recently entered first. Entering a network again moves
+ * it back to the front; entering one more than the store holds forgets the
+ * least recent.
+ *
+ * Connecting takes one scan and turns it into a NetworkPlan: the known
+ * networks that are actually on the air, strongest first. If an
+ * association fails the next network in the plan is tried straight away,
+ * without scanning again, so a dead primary AP costs one failed attempt
+ * rather than a full connect timeout and a manual retry.
+ *
+ * Pure code: persisted by WiFiCredentials.h, used by connectWiFi().
+ */
+
+const int CREDENTIAL_STORE_SIZE = 4;
+
+struct CredentialStore {
+  Credentials networks[CREDENTIAL_STORE_SIZE];  // [0] = most recently entered
+  uint8_t count;
+
+  CredentialStore() : count(0) {}
+};
+
+// NetworkPlan.rssi of a known network the scan didn't see
+const int32_t NETWORK_NOT_SEEN = INT32_MIN;
+
+struct NetworkPlan {
+  int32_t rssi[CREDENTIAL_STORE_SIZE];   // Strongest signal per store entry (dBm)
+  uint8_t order[CREDENTIAL_STORE_SIZE];  // Store indices to try, strongest first
+  uint8_t count;                         // Entries in order[]
+  uint8_t next;                          // Next entry of order[] to try
+};
+
+/**
+ * Add a network, or move it to the front if its SSID is already known
+ * @param store Store to update
+ * @param creds Network just entered (its password replaces a stored one)
+ */
+void credentialStoreRemember(CredentialStore* store, const Credentials& creds);
+
+/**
+ * Look up a network by SSID (case-sensitive, as 802.11 compares them)
+ * @param store Known networks
+ * @param ssid SSID to find
+ * @return Index into store.networks, or -1 if unknown
+ */
+int credentialStoreFind(const CredentialStore& store, const char* ssid);
+
+/**
+ * Start a plan for a new scan: nothing seen yet
+ * @param plan Plan to reset
+ */
+void networkPlanBegin(NetworkPlan* plan);
+
+/**
+ * Record one scan result; unknown networks are ignored, and an SSID seen
+ * from several access points keeps its strongest signal
+ * @param plan Plan being built
+ * @param store Known networks
+ * @param ssid SSID of the scan result
+ * @param rssi Its signal strength (dBm)
+ */
+void networkPlanSeen(NetworkPlan* plan, const CredentialStore& store, const char* ssid, int32_t rssi);
+
+/**
+ * Order the networks seen, strongest first (ties go to the most recently
+ * entered), and start at the first
+ * @param plan Plan built from a scan
+ * @param store Known networks
+ */
+void networkPlanRank(NetworkPlan* plan, const CredentialStore& store);
+
+#endif // CREDENTIAL_STORE_H
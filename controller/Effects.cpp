@@ -0,0 +1,200 @@
+#include "StateMachine.h"
+#include "WiFiConnection.h"
+#include "WiFiCredentials.h"
+#include "ConfigStore.h"
+#include "Boot.h"
+#include "IrrigationController.h"
+#include "NetworkMailbox.h"
+#include "FirmwareUpdate.h"
+#include "EventLog.h"
+#include <WiFi.h>
+#include <MooreArduino.h>
+
+using namespace MooreArduino;
+
+//----------------------------------------------------------------------------//
+// External References
+//----------------------------------------------------------------------------//
+
+extern MooreMachine<AppState, Input, Output> g_machine;  // Defined in main file
+
+//----------------------------------------------------------------------------//
+// Effect Ledger
+//----------------------------------------------------------------------------//
+
+// A poll whose result hasn't come back after this long was dropped (the
+// event mailbox was full); stop holding new polls back for it. Well past
+// HTTP_REQUEST_DEADLINE_MS, which bounds the whole request.
+static unsigned long pollInFlightLimitMs() {
+  return 3 * http_response_timeout_ms;
+}
+
+static EffectStats g_effectStats = {0, 0, 0, 0, 0};
+
+static struct {
+  bool anyDone;                   // Something has been carried out since boot
+  OutputType doneType;            // Last effect carried out...
+  uint32_t doneSeq;               // ...and its sequence ID
+  bool pollInFlight;              // A poll request is out and its result isn't back
+  unsigned long pollPostedAt;     // millis() when it was posted
+  uint32_t heldSeq;               // Poll last counted in heldInFlight (count each once)
+} g_effects = {false, EFFECT_NONE, 0, false, 0, 0};
+
+static bool isWork(OutputType type) {
+  return type == EFFECT_SAVE_CREDENTIALS || type == EFFECT_SAVE_SCHEDULE ||
+         type == EFFECT_START_WIFI_CONNECTION || type == EFFECT_POLL_SCHEDULE ||
+         type == EFFECT_ACTIVATE_FIRMWARE;
+}
+
+static bool pollStillInFlight() {
+  if (g_effects.pollInFlight && millis() - g_effects.pollPostedAt >= pollInFlightLimitMs()) {
+    Serial.println("Poll result never arrived - no longer waiting for it");
+    g_effects.pollInFlight = false;
+  }
+  return g_effects.pollInFlight;
+}
+
+void effectsObserveInput(const Input& input) {
+  if (input.type == INPUT_SCHEDULE_PATCH || input.type == INPUT_HTTP_ERROR) {
+    g_effects.pollInFlight = false;
+  }
+}
+
+const EffectStats& effectStats() {
+  return g_effectStats;
+}
+
+//----------------------------------------------------------------------------//
+// Output Execution
+//----------------------------------------------------------------------------//
+
+/**
+ * Carry out one effect
+ * @param effect Output to execute
+ * @param completed Output: false if it couldn't run yet and must be retried
+ * @return Follow-up input if needed, or INPUT_NONE
+ */
+static Input performEffect(const Output& effect, bool* completed) {
+  *completed = true;
+  switch (effect.type) {
+    case EFFECT_UPDATE_LEDS:
+      updateLEDs(effect.currentMode);
+      break;
+      
+    case EFFECT_SAVE_CREDENTIALS: {
+      const AppState& state = g_machine.getState();
+      saveCredentialStore(&knownNetworks(state.credentials));
+      // Return input to clear the credentialsChanged flag
+      return Input::credentialsSaved();
+    }
+    
+    case EFFECT_SAVE_SCHEDULE: {
+      const AppState& state = g_machine.getState();
+      saveSchedule(&state.schedule);
+      // Return input to clear the scheduleChanged flag
+      return Input::scheduleSaved();
+    }
+    
+    case EFFECT_START_WIFI_CONNECTION: {
+      const AppState& state = g_machine.getState();
+      Serial.println("Initiating WiFi connection...");
+      // Hand the scan/connect to the network side; status changes come back
+      // through readEvents() like any other WiFi status change
+      // The whole list travels in the request; the network side never
+      // reads it from flash
+      if (!requestConnect(knownNetworks(state.credentials))) {
+        Serial.println("Network request mailbox full - connect deferred");
+        *completed = false;
+        break;
+      }
+      // Return follow-up input to clear shouldReconnect flag
+      return Input::connectionStarted();
+    }
+    
+    case EFFECT_RENDER_UI:
+      renderUI(effect.currentMode);
+      break;
+      
+    case EFFECT_LOG_CONNECTION_SUCCESS:
+      Serial.println("✓ Successfully connected to WiFi!");
+      Serial.print("IP address: ");
+      Serial.println(WiFi.localIP());
+      break;
+      
+    case EFFECT_LOG_CONNECTION_LOST:
+      Serial.println("✗ WiFi connection lost");
+      break;
+      
+    case EFFECT_POLL_SCHEDULE: {
+      // Hand the HTTP request to the network side; the schedule changes (or
+      // error) come back through readEvents() as a separate Input
+      const AppState& state = g_machine.getState();
+      if (!requestSchedulePoll(state.schedule.seq)) {
+        Serial.println("Network request mailbox full - poll deferred");
+        *completed = false;
+        break;
+      }
+      g_effects.pollInFlight = true;
+      g_effects.pollPostedAt = millis();
+      bootNoteFirstPoll();
+      return Input::pollStarted();
+    }
+      
+    case EFFECT_UPDATE_ZONES: {
+      const AppState& state = g_machine.getState();
+      updateZoneLEDs(state.schedule);
+      break;
+    }
+      
+    case EFFECT_ACTIVATE_FIRMWARE:
+      // Resets into the new build; only returns if the switch failed
+      eventLogFlush();
+      activateFirmwareUpdate();
+      return Input::firmwareFailed();
+      
+    case EFFECT_NONE:
+    default:
+      // No effect to execute
+      break;
+  }
+  
+  return Input::none();
+}
+
+Input executeEffect(const Output& effect) {
+  if (effect.type == EFFECT_NONE) {
+    return Input::none();
+  }
+
+  // Already carried out: the loop asked again before the follow-up input
+  // moved the machine on to its next request
+  if (g_effects.anyDone && effect.seq == g_effects.doneSeq && effect.type == g_effects.doneType) {
+    g_effectStats.repeatsSkipped++;
+    if (isWork(effect.type)) {
+      g_effectStats.workRepeatsSkipped++;
+    }
+    return Input::none();
+  }
+
+  // The poll already out will bring the latest schedule; ask again once it
+  // has (the request keeps its sequence ID until then)
+  if (effect.type == EFFECT_POLL_SCHEDULE && pollStillInFlight()) {
+    if (g_effects.heldSeq != effect.seq) {
+      g_effects.heldSeq = effect.seq;
+      g_effectStats.heldInFlight++;
+    }
+    return Input::none();
+  }
+
+  bool completed;
+  Input followUp = performEffect(effect, &completed);
+  if (!completed) {
+    g_effectStats.deferred++;
+    return followUp;
+  }
+  g_effects.anyDone = true;
+  g_effects.doneType = effect.type;
+  g_effects.doneSeq = effect.seq;
+  g_effectStats.executed++;
+  return followUp;
+}
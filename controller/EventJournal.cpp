@@ -0,0 +1,285 @@
+#include "EventJournal.h"
+#include <string.h>
+
+// Bytes of a record or header covered by its CRC
+static const size_t JOURNAL_CRC_SPAN = JOURNAL_RECORD_SIZE - sizeof(uint32_t);
+
+static uint32_t roundUp(uint32_t value, uint32_t unit) {
+  return (value + unit - 1) / unit * unit;
+}
+
+static bool slotErased(const void* slot) {
+  const uint8_t* bytes = (const uint8_t*)slot;
+  for (size_t i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+    if (bytes[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool recordValid(const JournalRecord& record) {
+  return record.crc == crc32(&record, JOURNAL_CRC_SPAN);
+}
+
+static bool headerValid(const JournalSectorHeader& header) {
+  return header.magic == JOURNAL_MAGIC && header.crc == crc32(&header, JOURNAL_CRC_SPAN);
+}
+
+static uint32_t sectorAddress(const EventJournal& journal, uint32_t sector) {
+  return sector * journal.region->sectorSize();
+}
+
+//----------------------------------------------------------------------------//
+// Recovery
+//----------------------------------------------------------------------------//
+
+// Walks the head sector back from its end, a page at a time, to the last
+// slot that was ever programmed; the next write goes after it. Bounded by
+// one sector however full the journal is.
+static void recoverHead(EventJournal* journal, const JournalSectorHeader& header) {
+  JournalRegion& region = *journal->region;
+  uint32_t base = sectorAddress(*journal, journal->headSector);
+  uint8_t page[JOURNAL_PAGE_SIZE];
+  bool foundEnd = false;
+
+  journal->writeOffset = journal->headerSize;
+  journal->nextSequence = header.firstSequence;
+  for (uint32_t pageOffset = region.sectorSize(); pageOffset > 0; pageOffset -= JOURNAL_PAGE_SIZE) {
+    uint32_t start = pageOffset - JOURNAL_PAGE_SIZE;
+    journal->stats.recoveryReads++;
+    if (!region.read(base + start, page, sizeof(page))) {
+      if (!foundEnd) {
+        foundEnd = true;  // Can't tell what is there, so don't write over it
+        journal->writeOffset = start + JOURNAL_PAGE_SIZE;
+      }
+      continue;
+    }
+    for (uint32_t slot = JOURNAL_PAGE_SIZE; slot > 0; slot -= JOURNAL_RECORD_SIZE) {
+      uint32_t offset = start + slot - JOURNAL_RECORD_SIZE;
+      if (offset < journal->headerSize) {
+        return;  // Reached the header: no valid record in this sector
+      }
+      const uint8_t* bytes = page + slot - JOURNAL_RECORD_SIZE;
+      if (slotErased(bytes)) {
+        continue;
+      }
+      JournalRecord record;
+      memcpy(&record, bytes, sizeof(record));
+      if (!foundEnd) {
+        foundEnd = true;
+        journal->writeOffset = roundUp(offset + JOURNAL_RECORD_SIZE, region.programSize());
+      }
+      if (recordValid(record)) {
+        journal->nextSequence = record.sequence + 1;
+        return;
+      }
+      journal->stats.damaged++;  // Torn by a power cut mid-program
+    }
+  }
+}
+
+bool journalOpen(EventJournal* journal, JournalRegion* region) {
+  memset(journal, 0, sizeof(*journal));
+  journal->region = region;
+  uint32_t sectorSize = region->sectorSize();
+  uint32_t programSize = region->programSize();
+  if (sectorSize == 0 || sectorSize % JOURNAL_PAGE_SIZE != 0 || programSize == 0 ||
+      (programSize & (programSize - 1)) != 0 || JOURNAL_PAGE_SIZE % programSize != 0 ||
+      region->size() / sectorSize < 2) {
+    return false;
+  }
+  journal->sectors = region->size() / sectorSize;
+  journal->headerSize = roundUp(sizeof(JournalSectorHeader), programSize);
+
+  // The newest sector is the one with the highest generation
+  JournalSectorHeader head;
+  memset(&head, 0, sizeof(head));
+  for (uint32_t sector = 0; sector < journal->sectors; sector++) {
+    JournalSectorHeader header;
+    journal->stats.recoveryReads++;
+    if (!region->read(sectorAddress(*journal, sector), &header, sizeof(header))) {
+      continue;
+    }
+    if (!headerValid(header)) {
+      if (!slotErased(&header)) {
+        journal->stats.damaged++;  // Cut off while the sector was being opened
+      }
+      continue;
+    }
+    if (header.generation > journal->headGeneration) {
+      journal->headGeneration = header.generation;
+      journal->headSector = sector;
+      head = header;
+    }
+  }
+
+  if (journal->headGeneration == 0) {
+    // Blank region: the first flush opens sector 0
+    journal->headSector = journal->sectors - 1;
+    journal->writeOffset = sectorSize;
+    journal->nextSequence = 1;
+    return true;
+  }
+  recoverHead(journal, head);
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Appending
+//----------------------------------------------------------------------------//
+
+static bool headFull(const EventJournal& journal) {
+  return journal.headGeneration == 0 ||
+         journal.writeOffset + JOURNAL_RECORD_SIZE > journal.region->sectorSize();
+}
+
+// Records that fit between where the pending batch will be written and the
+// end of that page
+static uint32_t batchRoom(const EventJournal& journal) {
+  uint32_t offset = headFull(journal) ? journal.headerSize : journal.writeOffset;
+  return (roundUp(offset + 1, JOURNAL_PAGE_SIZE) - offset) / JOURNAL_RECORD_SIZE;
+}
+
+// Erase the oldest sector and stamp it as the new head
+static bool openNextSector(EventJournal* journal) {
+  JournalRegion& region = *journal->region;
+  uint32_t sector = (journal->headSector + 1) % journal->sectors;
+  uint32_t address = sectorAddress(*journal, sector);
+  journal->stats.erases++;
+  if (!region.erase(address, region.sectorSize())) {
+    journal->stats.failures++;
+    return false;
+  }
+
+  uint8_t slot[JOURNAL_PAGE_SIZE];
+  memset(slot, 0xFF, journal->headerSize);
+  JournalSectorHeader header;
+  header.magic = JOURNAL_MAGIC;
+  header.generation = journal->headGeneration + 1;
+  header.firstSequence = journal->pending[0].sequence;
+  header.crc = crc32(&header, JOURNAL_CRC_SPAN);
+  memcpy(slot, &header, sizeof(header));
+  if (!region.program(address, slot, journal->headerSize)) {
+    journal->stats.failures++;
+    return false;  // Erased again on the next attempt
+  }
+
+  journal->headSector = sector;
+  journal->headGeneration = header.generation;
+  journal->writeOffset = journal->headerSize;
+  return true;
+}
+
+bool journalFlush(EventJournal* journal) {
+  JournalRegion& region = *journal->region;
+  uint8_t page[JOURNAL_PAGE_SIZE];
+  while (journal->pendingCount > 0) {
+    if (headFull(*journal) && !openNextSector(journal)) {
+      return false;
+    }
+
+    // Up to the end of the page, padded with erased bytes to the program unit
+    uint32_t count = batchRoom(*journal);
+    if (count > journal->pendingCount) {
+      count = journal->pendingCount;
+    }
+    uint32_t length = roundUp(count * JOURNAL_RECORD_SIZE, region.programSize());
+    memset(page, 0xFF, length);
+    memcpy(page, journal->pending, count * JOURNAL_RECORD_SIZE);
+    bool programmed = region.program(sectorAddress(*journal, journal->headSector) + journal->writeOffset,
+                                     page, length);
+    // Never program the same bytes twice: a failed write moves on past them too
+    journal->writeOffset += length;
+    if (!programmed) {
+      journal->stats.failures++;
+      return false;
+    }
+
+    journal->stats.flushes++;
+    journal->pendingCount -= count;
+    memmove(journal->pending, journal->pending + count, journal->pendingCount * JOURNAL_RECORD_SIZE);
+  }
+  return true;
+}
+
+bool journalAppend(EventJournal* journal, uint8_t type, uint32_t time, uint8_t subject,
+                   int16_t value, uint64_t now) {
+  if (journal->pendingCount == JOURNAL_PAGE_RECORDS && !journalFlush(journal)) {
+    journal->stats.dropped++;
+    return false;
+  }
+
+  JournalRecord& record = journal->pending[journal->pendingCount];
+  record.sequence = journal->nextSequence++;
+  record.time = time;
+  record.type = type;
+  record.subject = subject;
+  record.value = value;
+  record.crc = crc32(&record, JOURNAL_CRC_SPAN);
+  if (journal->pendingCount++ == 0) {
+    journal->pendingSince = now;
+  }
+  journal->stats.appended++;
+  return true;
+}
+
+bool journalFlushDue(const EventJournal& journal, uint64_t now, uint64_t maxAgeMs) {
+  return journal.pendingCount > 0 &&
+         (journal.pendingCount >= batchRoom(journal) || now - journal.pendingSince >= maxAgeMs);
+}
+
+//----------------------------------------------------------------------------//
+// Reading
+//----------------------------------------------------------------------------//
+
+void journalBeginRead(const EventJournal& journal, JournalCursor* cursor) {
+  cursor->sector = (journal.headSector + 1) % journal.sectors;
+  cursor->offset = 0;
+  cursor->sectorsLeft = journal.headGeneration == 0 ? 0 : journal.sectors;
+  cursor->pendingIndex = 0;
+  cursor->lastSequence = 0;
+}
+
+static void nextSector(const EventJournal& journal, JournalCursor* cursor) {
+  cursor->sector = (cursor->sector + 1) % journal.sectors;
+  cursor->offset = 0;
+  cursor->sectorsLeft--;
+}
+
+bool journalNext(EventJournal* journal, JournalCursor* cursor, JournalRecord* record) {
+  JournalRegion& region = *journal->region;
+  while (cursor->sectorsLeft > 0) {
+    uint32_t address = sectorAddress(*journal, cursor->sector);
+    if (cursor->offset == 0) {
+      // Only sectors from the current lap; anything else is a half-erased leftover
+      JournalSectorHeader header;
+      if (!region.read(address, &header, sizeof(header)) || !headerValid(header) ||
+          header.generation > journal->headGeneration ||
+          journal->headGeneration - header.generation >= journal->sectors) {
+        nextSector(*journal, cursor);
+        continue;
+      }
+      cursor->offset = journal->headerSize;
+    }
+
+    uint32_t end = cursor->sector == journal->headSector ? journal->writeOffset : region.sectorSize();
+    if (cursor->offset + JOURNAL_RECORD_SIZE > end) {
+      nextSector(*journal, cursor);
+      continue;
+    }
+    bool readOk = region.read(address + cursor->offset, record, sizeof(*record));
+    cursor->offset += JOURNAL_RECORD_SIZE;
+    if (readOk && !slotErased(record) && recordValid(*record) && record->sequence > cursor->lastSequence) {
+      cursor->lastSequence = record->sequence;
+      return true;
+    }
+  }
+
+  // Then whatever hasn't reached flash yet
+  if (cursor->pendingIndex < journal->pendingCount) {
+    *record = journal->pending[cursor->pendingIndex++];
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,186 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include "Checksum.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Append-Only Event Journal
+//----------------------------------------------------------------------------//
+
+/*
+ * A history of zone, link and HTTP events kept in a dedicated flash region,
+ * used as a ring of erase sectors:
+ *
+ *   sector    +--------------+--------+--------+-----+--------+
+ *             | SectorHeader | record | record | ... | record |
+ *             | generation   | 16 B   | 16 B   |     | 16 B   |
+ *             +--------------+--------+--------+-----+--------+
+ *
+ * Records are only ever appended. They collect in RAM and are programmed a
+ * page at a time (JOURNAL_PAGE_SIZE, the flash's page program unit), or
+ * once the oldest has waited long enough - the caller flushes when
+ * journalFlushDue() says so, outside any time-critical path. When the head sector is full the next
+ * sector round the ring is erased and stamped with the next generation,
+ * dropping the oldest records. Every sector is erased once per lap, so wear
+ * is spread evenly however the events arrive, and the ring carries on from
+ * where it was after a reset instead of starting again at sector 0.
+ *
+ * Nothing is ever rewritten, so a power cut can only damage the page being
+ * programmed or the sector being opened. Each record and sector header
+ * carries its own CRC; damaged ones are skipped on reading and never
+ * programmed over. Opening the journal reads every sector header and then
+ * the head sector alone, so recovery time is fixed by the region's layout,
+ * not by how much history it holds.
+ *
+ * Pure code over the JournalRegion interface: the firmware backs it with the
+ * QSPI flash (EventLog.h), host tools with RAM.
+ */
+
+const uint32_t JOURNAL_MAGIC = 0x4C4A5249;   // "IRJL"
+const size_t JOURNAL_RECORD_SIZE = 16;
+const size_t JOURNAL_PAGE_SIZE = 256;        // Appends reach flash in batches of up to a page
+const size_t JOURNAL_PAGE_RECORDS = JOURNAL_PAGE_SIZE / JOURNAL_RECORD_SIZE;
+
+enum JournalEventType {
+  JOURNAL_BOOT = 1,            // value = firmware_version (low 16 bits)
+  JOURNAL_ZONE_OPENED,         // subject = zone index
+  JOURNAL_ZONE_CLOSED,         // subject = zone index
+  JOURNAL_FAIL_SAFE,           // Stale schedule closed every zone
+  JOURNAL_LINK_UP,             // value = WiFi status
+  JOURNAL_LINK_DOWN,           // value = WiFi status
+  JOURNAL_HTTP_FAILED,         // value = HTTP status, or the client's negative error, 0 = bad body
+  JOURNAL_ZONE_OVERRIDE        // subject = zone index, value = minutes held open (+) or closed (-), 0 = released
+};
+
+// Set in JournalRecord.type when `time` counts seconds since boot because
+// the wall clock wasn't synced yet
+const uint8_t JOURNAL_UPTIME = 0x80;
+
+// Little-endian on flash, as laid out here
+struct JournalRecord {
+  uint32_t sequence;           // Position in the history, from 1; never reused
+  uint32_t time;               // Unix seconds (or uptime seconds, see JOURNAL_UPTIME)
+  uint8_t type;                // JournalEventType, maybe | JOURNAL_UPTIME
+  uint8_t subject;             // Type-specific
+  int16_t value;               // Type-specific
+  uint32_t crc;                // CRC-32 of the bytes above
+};
+
+struct JournalSectorHeader {
+  uint32_t magic;              // JOURNAL_MAGIC
+  uint32_t generation;         // Sectors opened before this one, plus one
+  uint32_t firstSequence;      // Sequence of the first record appended here
+  uint32_t crc;                // CRC-32 of the bytes above
+};
+
+static_assert(sizeof(JournalRecord) == JOURNAL_RECORD_SIZE, "Record layout is the flash format");
+static_assert(sizeof(JournalSectorHeader) == JOURNAL_RECORD_SIZE, "Header fills one record slot");
+
+/*
+ * Flash region holding the journal, as FirmwareSlot. Offsets are relative to
+ * the start of the region; the sector size must be a multiple of
+ * JOURNAL_PAGE_SIZE, which must be a multiple of the program size.
+ */
+class JournalRegion {
+public:
+  virtual ~JournalRegion() {}
+  virtual uint32_t size() const = 0;
+  virtual uint32_t sectorSize() const = 0;   // Erase unit
+  virtual uint32_t programSize() const = 0;  // Program unit; flushes are padded to it
+  virtual bool erase(uint32_t offset, uint32_t length) = 0;
+  virtual bool program(uint32_t offset, const void* data, uint32_t length) = 0;
+  virtual bool read(uint32_t offset, void* data, uint32_t length) = 0;
+};
+
+struct JournalStats {
+  unsigned long appended;      // Records accepted
+  unsigned long dropped;       // Records lost because flash writes were failing
+  unsigned long flushes;       // Batches programmed
+  unsigned long erases;        // Sectors erased (one per sector per lap)
+  unsigned long failures;      // Failed erases and programs
+  unsigned long damaged;       // Torn records and headers found while opening
+  unsigned long recoveryReads; // Flash reads taken by the last open
+};
+
+struct EventJournal {
+  JournalRegion* region;
+  uint32_t sectors;            // Sectors in the ring
+  uint32_t headerSize;         // Header slot, rounded up to the program size
+  uint32_t headSector;         // Sector being appended to
+  uint32_t headGeneration;     // Its generation, 0 = no sector opened yet
+  uint32_t writeOffset;        // Next unprogrammed byte in the head sector
+  uint32_t nextSequence;       // Sequence of the next record appended
+  JournalRecord pending[JOURNAL_PAGE_RECORDS];  // Appended, not yet in flash
+  uint32_t pendingCount;
+  uint64_t pendingSince;       // When the oldest pending record was appended
+  JournalStats stats;
+};
+
+// Read position for journalNext(); start one with journalBeginRead()
+struct JournalCursor {
+  uint32_t sector;             // Sector being read
+  uint32_t offset;             // Next slot in it, 0 = header not read yet
+  uint32_t sectorsLeft;        // Sectors still to read, this one included
+  uint32_t pendingIndex;       // Next RAM record once flash is exhausted
+  uint32_t lastSequence;       // Last record returned; older ones are leftovers
+};
+
+/**
+ * Find the end of the journal after a reset or power loss
+ * Reads each sector header and the head sector's slots; never writes.
+ * @param journal Journal state to initialize
+ * @param region Flash holding the journal (kept for later calls)
+ * @return false if the region's geometry can't hold a journal
+ */
+bool journalOpen(EventJournal* journal, JournalRegion* region);
+
+/**
+ * Append one record to the pending batch (RAM only, unless the batch is
+ * already a full page and has to make room)
+ * @param journal Open journal
+ * @param type JournalEventType, maybe | JOURNAL_UPTIME
+ * @param time Unix seconds, or seconds since boot with JOURNAL_UPTIME
+ * @param subject Type-specific
+ * @param value Type-specific
+ * @param now Monotonic time, to age the pending batch
+ * @return false if the record was dropped (the batch is full and won't flush)
+ */
+bool journalAppend(EventJournal* journal, uint8_t type, uint32_t time, uint8_t subject,
+                   int16_t value, uint64_t now);
+
+/**
+ * Check whether the pending batch should go to flash
+ * @param journal Open journal
+ * @param now Monotonic time
+ * @param maxAgeMs Longest the oldest pending record may wait
+ * @return true if the batch fills its page or has waited maxAgeMs
+ */
+bool journalFlushDue(const EventJournal& journal, uint64_t now, uint64_t maxAgeMs);
+
+/**
+ * Program the pending records, opening the next sector first if needed
+ * @param journal Open journal
+ * @return true if nothing is left pending
+ */
+bool journalFlush(EventJournal* journal);
+
+/**
+ * Start reading the journal from its oldest record
+ * @param journal Open journal
+ * @param cursor Read position to initialize
+ */
+void journalBeginRead(const EventJournal& journal, JournalCursor* cursor);
+
+/**
+ * Read the next record, oldest first, ending with the ones still pending
+ * Don't append or flush between journalBeginRead() and the last call.
+ * @param journal Open journal
+ * @param cursor Read position, advanced past the record
+ * @param record Populated with the record
+ * @return false at the end of the journal
+ */
+bool journalNext(EventJournal* journal, JournalCursor* cursor, JournalRecord* record);
+
+#endif // EVENT_JOURNAL_H
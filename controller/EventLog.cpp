@@ -0,0 +1,287 @@
+#include "EventLog.h"
+#include "Clock.h"
+#include <BlockDevice.h>
+#include <MBRBlockDevice.h>
+#include <SlicingBlockDevice.h>
+
+//----------------------------------------------------------------------------//
+// Flash Region
+//----------------------------------------------------------------------------//
+
+// User data partition of the QSPI flash's standard layout (WiFi firmware,
+// OTA, key-value store, user data); the journal takes its first 256 KB,
+// 64 sectors of 4 KB. The standard layout also lets sketches format that
+// partition as a filesystem, so eventLogBegin() looks for one first and
+// leaves the partition alone if it finds it.
+static const int JOURNAL_PARTITION = 4;
+static const uint32_t JOURNAL_REGION_SIZE = 0x40000;
+
+// LittleFS keeps its superblock in both of the first two blocks ("littlefs"
+// at offset 8); mbed's default block size on the QSPI flash is 4 KB
+static const uint32_t LITTLEFS_BLOCK_SIZE = 4096;
+static const uint32_t LITTLEFS_MAGIC_OFFSET = 8;
+
+static mbed::MBRBlockDevice g_journalPartition(mbed::BlockDevice::get_default_instance(), JOURNAL_PARTITION);
+static mbed::SlicingBlockDevice g_journalDevice(&g_journalPartition, 0, JOURNAL_REGION_SIZE);
+
+class QspiJournalRegion : public JournalRegion {
+public:
+  uint32_t size() const override { return (uint32_t)g_journalDevice.size(); }
+  uint32_t sectorSize() const override { return (uint32_t)g_journalDevice.get_erase_size(); }
+  uint32_t programSize() const override { return (uint32_t)g_journalDevice.get_program_size(); }
+
+  bool erase(uint32_t offset, uint32_t length) override {
+    return g_journalDevice.erase(offset, length) == 0;
+  }
+  bool program(uint32_t offset, const void* data, uint32_t length) override {
+    return g_journalDevice.program(data, offset, length) == 0;
+  }
+  bool read(uint32_t offset, void* data, uint32_t length) override {
+    return g_journalDevice.read(data, offset, length) == 0;
+  }
+};
+
+static QspiJournalRegion g_journalRegion;
+static EventJournal g_journal;
+static bool g_journalOpen = false;
+
+//----------------------------------------------------------------------------//
+// Filesystem Check
+//----------------------------------------------------------------------------//
+
+// Name of the filesystem the partition starts with, or nullptr if none. A
+// FAT volume boot record has a jump instruction, the 0x55AA signature and a
+// "FAT" type string; LittleFS has its magic in block 0 or 1. Journal sectors
+// (and erased flash) match neither.
+static const char* partitionFilesystem() {
+  uint8_t boot[512];
+  if (g_journalPartition.read(boot, 0, sizeof(boot)) == 0) {
+    bool jump = boot[0] == 0xEB || boot[0] == 0xE9;
+    bool signature = boot[510] == 0x55 && boot[511] == 0xAA;
+    bool fatType = memcmp(boot + 54, "FAT", 3) == 0 || memcmp(boot + 82, "FAT", 3) == 0;
+    if (jump && signature && fatType) {
+      return "FAT";
+    }
+  }
+  for (uint32_t block = 0; block < 2; block++) {
+    char magic[8];
+    if (g_journalPartition.read(magic, block * LITTLEFS_BLOCK_SIZE + LITTLEFS_MAGIC_OFFSET, sizeof(magic)) == 0 &&
+        memcmp(magic, "littlefs", sizeof(magic)) == 0) {
+      return "LittleFS";
+    }
+  }
+  return nullptr;
+}
+
+//----------------------------------------------------------------------------//
+// Recording
+//----------------------------------------------------------------------------//
+
+// Wall-clock seconds when synced, else seconds since boot
+static void record(const WallClock& clock, uint64_t at, JournalEventType type, uint8_t subject,
+                   int16_t value) {
+  if (!g_journalOpen) {
+    return;
+  }
+  uint8_t flags = 0;
+  uint32_t time;
+  if (clock.isSet()) {
+    time = (uint32_t)(wallClockUnixMs(clock, at) / 1000);
+  } else {
+    time = (uint32_t)(at / 1000);
+    flags = JOURNAL_UPTIME;
+  }
+  journalAppend(&g_journal, (uint8_t)type | flags, time, subject, value, clockMonotonicMs());
+}
+
+bool eventLogBegin() {
+  if (g_journalDevice.init() != 0) {
+    Serial.println("Event journal: QSPI partition unavailable - history not kept");
+    return false;
+  }
+  // Never write over a filesystem someone formatted in the user partition
+  const char* filesystem = partitionFilesystem();
+  if (filesystem != nullptr) {
+    Serial.print("Event journal: QSPI partition ");
+    Serial.print(JOURNAL_PARTITION);
+    Serial.print(" holds a ");
+    Serial.print(filesystem);
+    Serial.println(" filesystem - history not kept");
+    return false;
+  }
+  g_journalOpen = journalOpen(&g_journal, &g_journalRegion);
+  if (!g_journalOpen) {
+    Serial.println("Event journal: unusable flash geometry - history not kept");
+    return false;
+  }
+  record(WallClock(), clockMonotonicMs(), JOURNAL_BOOT, 0, (int16_t)firmware_version);
+  return true;
+}
+
+void observeEventLog(const AppState& oldState, const AppState& newState) {
+  uint8_t opened = newState.zones.openMask & ~oldState.zones.openMask;
+  uint8_t closed = oldState.zones.openMask & ~newState.zones.openMask;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (opened & (1 << i)) {
+      record(newState.clock, newState.lastUpdate, JOURNAL_ZONE_OPENED, (uint8_t)i, 0);
+    }
+    if (closed & (1 << i)) {
+      record(newState.clock, newState.lastUpdate, JOURNAL_ZONE_CLOSED, (uint8_t)i, 0);
+    }
+  }
+  if (!oldState.failSafeActive && newState.failSafeActive) {
+    record(newState.clock, newState.lastUpdate, JOURNAL_FAIL_SAFE, 0, 0);
+  }
+  if (oldState.mode != MODE_CONNECTED && newState.mode == MODE_CONNECTED) {
+    record(newState.clock, newState.lastUpdate, JOURNAL_LINK_UP, 0, (int16_t)newState.wifiStatus);
+  } else if (oldState.mode == MODE_CONNECTED && newState.mode != MODE_CONNECTED) {
+    record(newState.clock, newState.lastUpdate, JOURNAL_LINK_DOWN, 0, (int16_t)newState.wifiStatus);
+  }
+}
+
+void eventLogInput(const Input& input, const AppState& state) {
+  if (input.type == INPUT_HTTP_ERROR) {
+    record(state.clock, input.nowMs, JOURNAL_HTTP_FAILED, 0, (int16_t)input.httpStatus);
+  } else if (input.type == INPUT_ZONE_OVERRIDE && input.overrideZone < ZONE_COUNT) {
+    // Who took a zone over matters when a technician and the schedule disagree
+    unsigned long ms = input.overrideMs < lan_override_max_ms ? input.overrideMs : lan_override_max_ms;
+    int16_t minutes = (int16_t)((ms + 59999) / 60000);
+    int16_t value = input.overrideAction == OVERRIDE_OPEN ? minutes
+                  : input.overrideAction == OVERRIDE_CLOSE ? (int16_t)-minutes : 0;
+    record(state.clock, input.nowMs, JOURNAL_ZONE_OVERRIDE, input.overrideZone, value);
+  }
+}
+
+void serviceEventLog() {
+  if (g_journalOpen && journalFlushDue(g_journal, clockMonotonicMs(), journal_flush_ms)) {
+    // A failure leaves the batch pending; it is retried at the next pass
+    journalFlush(&g_journal);
+  }
+}
+
+void eventLogFlush() {
+  if (g_journalOpen) {
+    journalFlush(&g_journal);
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Reading
+//----------------------------------------------------------------------------//
+
+// Newest records printed by the 'j' command
+static const unsigned long EVENT_LOG_PRINT_LIMIT = 200;
+
+static const char* journalEventName(uint8_t type) {
+  switch (type & ~JOURNAL_UPTIME) {
+    case JOURNAL_BOOT: return "boot";
+    case JOURNAL_ZONE_OPENED: return "zone opened";
+    case JOURNAL_ZONE_CLOSED: return "zone closed";
+    case JOURNAL_FAIL_SAFE: return "fail-safe";
+    case JOURNAL_LINK_UP: return "link up";
+    case JOURNAL_LINK_DOWN: return "link down";
+    case JOURNAL_HTTP_FAILED: return "poll failed";
+    case JOURNAL_ZONE_OVERRIDE: return "zone override";
+    default: return "unknown";
+  }
+}
+
+void printEventLog() {
+  if (!g_journalOpen) {
+    Serial.println("Event journal not available");
+    return;
+  }
+  // The whole ring would take the serial port longer than the watchdog
+  // allows; count first, then print the newest
+  JournalCursor cursor;
+  JournalRecord record;
+  unsigned long count = 0;
+  journalBeginRead(g_journal, &cursor);
+  while (journalNext(&g_journal, &cursor, &record)) {
+    count++;
+  }
+  unsigned long skip = count > EVENT_LOG_PRINT_LIMIT ? count - EVENT_LOG_PRINT_LIMIT : 0;
+
+  Serial.println("=== Event Journal (oldest first) ===");
+  journalBeginRead(g_journal, &cursor);
+  for (unsigned long i = 0; journalNext(&g_journal, &cursor, &record); i++) {
+    if (i < skip) {
+      continue;
+    }
+    Serial.print("#");
+    Serial.print(record.sequence);
+    Serial.print(record.type & JOURNAL_UPTIME ? " boot+" : " unix ");
+    Serial.print(record.time);
+    Serial.print(" ");
+    Serial.print(journalEventName(record.type));
+    uint8_t type = record.type & ~JOURNAL_UPTIME;
+    if (type == JOURNAL_ZONE_OPENED || type == JOURNAL_ZONE_CLOSED) {
+      Serial.print(" ");
+      Serial.print(record.subject + 1);
+    } else if (type == JOURNAL_ZONE_OVERRIDE) {
+      Serial.print(" ");
+      Serial.print(record.subject + 1);
+      Serial.print(record.value > 0 ? " open " : record.value < 0 ? " closed " : " released");
+      if (record.value != 0) {
+        Serial.print(record.value > 0 ? record.value : -record.value);
+        Serial.print(" min");
+      }
+    } else if (type != JOURNAL_FAIL_SAFE) {
+      Serial.print(" (");
+      Serial.print(record.value);
+      Serial.print(")");
+    }
+    Serial.println("");
+  }
+  Serial.print(count);
+  Serial.print(" events (");
+  Serial.print(count - skip);
+  Serial.print(" shown), ");
+  Serial.print(g_journal.stats.damaged);
+  Serial.println(" damaged slots skipped at boot");
+}
+
+static unsigned long journalWrites() {
+  return g_journal.stats.flushes + g_journal.stats.erases;
+}
+
+// Resume after reader->lastSequence; the cursor filters flash records by it
+static void placeReader(EventLogReader* reader) {
+  journalBeginRead(g_journal, &reader->cursor);
+  reader->cursor.lastSequence = reader->lastSequence;
+  reader->writes = journalWrites();
+}
+
+bool eventLogReadBegin(EventLogReader* reader, uint32_t fromSequence) {
+  if (!g_journalOpen) {
+    return false;
+  }
+  reader->lastSequence = fromSequence > 0 ? fromSequence - 1 : 0;
+  reader->endSequence = g_journal.nextSequence;
+  placeReader(reader);
+  return true;
+}
+
+bool eventLogRead(EventLogReader* reader, JournalRecord* record) {
+  if (!g_journalOpen) {
+    return false;
+  }
+  if (journalWrites() != reader->writes) {
+    placeReader(reader);  // Pending records moved to flash, or a sector was reused
+  }
+  while (journalNext(&g_journal, &reader->cursor, record)) {
+    if (record->sequence <= reader->lastSequence) {
+      continue;  // Pending records aren't filtered by the cursor
+    }
+    if (record->sequence >= reader->endSequence) {
+      return false;
+    }
+    reader->lastSequence = record->sequence;
+    return true;
+  }
+  return false;
+}
+
+const JournalStats& eventLogStats() {
+  return g_journal.stats;
+}
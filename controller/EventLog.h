@@ -0,0 +1,107 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "Types.h"
+#include "EventJournal.h"
+
+//----------------------------------------------------------------------------//
+// Event History
+//----------------------------------------------------------------------------//
+
+/*
+ * Keeps a durable history of what the controller did in the event journal
+ * (EventJournal.h), on a dedicated 256 KB region of the QSPI flash - the
+ * start of its user data partition (4), away from the key-value store. If
+ * that partition holds a FAT or LittleFS filesystem the journal stays off
+ * rather than overwrite it:
+ *
+ *   setup()        eventLogBegin() - open the journal (a bounded scan) and
+ *                  record the boot
+ *   machine step   observeEventLog() - zone open/close edges, the stale
+ *                  schedule fail-safe, WiFi link up/down
+ *                  eventLogInput() - failed schedule polls, LAN zone overrides
+ *   loop()         serviceEventLog() - flush the pending batch once it
+ *                  fills a page or its oldest record is journal_flush_ms old
+ *   serial 'j'     printEventLog() - print the newest events, oldest first
+ *   serial link    eventLogReadBegin()/eventLogRead() - stream every record
+ *                  to a bench tool over several passes (SerialLink.h)
+ *
+ * Recording an event costs a RAM copy; flash is programmed from loop(), a
+ * page (16 events) at a time or at the flush deadline, never once per event
+ * and never from inside a machine step. A power cut loses at most
+ * the last journal_flush_ms of events. Times are wall-clock seconds once
+ * SNTP has synced, seconds since boot until then.
+ *
+ * Runs on the control side only; does nothing if the flash isn't usable.
+ */
+
+/**
+ * Open the journal and record a boot (call once from setup())
+ * @return true if the journal is available
+ */
+bool eventLogBegin();
+
+/**
+ * Observer: Record zone, fail-safe and link transitions
+ * @param oldState Previous state
+ * @param newState Current state
+ */
+void observeEventLog(const AppState& oldState, const AppState& newState);
+
+/**
+ * Record events carried by an input rather than a state change
+ * @param input Input just applied
+ * @param state State after applying it
+ */
+void eventLogInput(const Input& input, const AppState& state);
+
+/**
+ * Flush the pending batch if it is due (call every loop() pass)
+ */
+void serviceEventLog();
+
+/**
+ * Flush the pending batch now (before a deliberate reset)
+ */
+void eventLogFlush();
+
+/**
+ * Print every record in the journal to serial, oldest first
+ */
+void printEventLog();
+
+// A read that may span loop() passes, flushes and all
+struct EventLogReader {
+  JournalCursor cursor;
+  uint32_t lastSequence;       // Last record returned
+  uint32_t endSequence;        // First record appended after the read began
+  unsigned long writes;        // Journal flushes and erases when the cursor was placed
+};
+
+/**
+ * Start reading the journal from a given record on
+ * Records appended after this call aren't returned, so a read always ends.
+ * @param reader Reader to initialize
+ * @param fromSequence First sequence wanted (0 for everything)
+ * @return false if the journal isn't available
+ */
+bool eventLogReadBegin(EventLogReader* reader, uint32_t fromSequence);
+
+/**
+ * Read the next record, oldest first
+ * If the journal was flushed since the last call the cursor is placed again
+ * from the oldest sector (one rescan) and records already returned are
+ * skipped, so nothing is repeated or missed except what the ring overwrote.
+ * @param reader Reader from eventLogReadBegin()
+ * @param record Populated with the record
+ * @return false at the end of the read
+ */
+bool eventLogRead(EventLogReader* reader, JournalRecord* record);
+
+/**
+ * Access journal counters
+ * @return Journal statistics since boot
+ */
+const JournalStats& eventLogStats();
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,154 @@
+#include "FirmwareImage.h"
+#include <string.h>
+
+// Read-back and hashing go through this much stack at a time
+static const uint32_t FIRMWARE_VERIFY_BLOCK = 256;
+
+//----------------------------------------------------------------------------//
+// Header
+//----------------------------------------------------------------------------//
+
+bool firmwareHeaderUsable(const FirmwareImageHeader& header, uint32_t slotSize) {
+  return header.magic == FIRMWARE_MAGIC &&
+         header.headerSize == FIRMWARE_HEADER_SIZE &&
+         header.payloadSize > 0 && header.payloadSize <= slotSize;
+}
+
+void firmwareProgressBegin(FirmwareProgress* progress, const FirmwareImageHeader& header) {
+  FirmwareImageHeader copy = header;  // May be progress->header itself
+  memset(progress, 0, sizeof(*progress));
+  progress->header = copy;
+}
+
+//----------------------------------------------------------------------------//
+// Chunk Writer
+//----------------------------------------------------------------------------//
+
+static bool regionBlank(FirmwareSlot& slot, uint32_t offset, uint32_t length) {
+  uint8_t block[FIRMWARE_VERIFY_BLOCK];
+  while (length > 0) {
+    uint32_t n = length < sizeof(block) ? length : sizeof(block);
+    if (!slot.read(offset, block, n)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      if (block[i] != 0xFF) return false;
+    }
+    offset += n;
+    length -= n;
+  }
+  return true;
+}
+
+static bool regionMatches(FirmwareSlot& slot, uint32_t offset, const uint8_t* data, uint32_t length) {
+  uint8_t block[FIRMWARE_VERIFY_BLOCK];
+  while (length > 0) {
+    uint32_t n = length < sizeof(block) ? length : sizeof(block);
+    if (!slot.read(offset, block, n) || memcmp(block, data, n) != 0) {
+      return false;
+    }
+    offset += n;
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+// Finish a chunk whose program was cut short by a reset: words that already
+// hold their data are kept and blank ones programmed. A word cut off
+// mid-program holds neither, and only an erase can clear it.
+static bool completeChunk(FirmwareSlot& slot, uint32_t offset, const uint8_t* chunk, uint32_t length) {
+  uint32_t unit = slot.programSize();
+  uint8_t word[FIRMWARE_VERIFY_BLOCK];
+  if (unit > sizeof(word)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < length; i += unit) {
+    if (!slot.read(offset + i, word, unit)) {
+      return false;
+    }
+    if (memcmp(word, chunk + i, unit) == 0) {
+      continue;
+    }
+    for (uint32_t b = 0; b < unit; b++) {
+      if (word[b] != 0xFF) return false;
+    }
+    if (!slot.program(offset + i, chunk + i, unit)) {
+      return false;
+    }
+  }
+  return regionMatches(slot, offset, chunk, length);
+}
+
+FirmwareWriteResult firmwareWriteChunk(FirmwareProgress* progress, FirmwareSlot& slot,
+                                       uint8_t* chunk, size_t length, size_t capacity) {
+  uint32_t offset = progress->written;
+  uint32_t unit = slot.programSize();
+  uint32_t padded = (uint32_t)((length + unit - 1) / unit * unit);
+  if (length == 0 || offset % unit != 0 || padded > capacity ||
+      offset + length > progress->header.payloadSize || offset + padded > slot.size()) {
+    return FIRMWARE_WRITE_FAILED;
+  }
+  memset(chunk + length, 0xFF, padded - length);
+
+  // Sectors starting inside the chunk are new: erase them. The sector the
+  // chunk starts in was erased when an earlier chunk reached it, so the rest
+  // of it must still be blank - unless the last run was reset while
+  // programming this chunk, or before saving its progress. Then finish the
+  // chunk in place if possible, else rewrite the sector from its start.
+  uint32_t sector = slot.sectorSize();
+  uint32_t sectorStart = offset / sector * sector;
+  if (offset != sectorStart) {
+    uint32_t blankLength = sectorStart + sector - offset < padded ? sectorStart + sector - offset : padded;
+    if (!regionBlank(slot, offset, blankLength)) {
+      if (completeChunk(slot, offset, chunk, padded)) {
+        progress->written = offset + (uint32_t)length;
+        return FIRMWARE_WRITE_OK;
+      }
+      if (!slot.erase(sectorStart, sector)) {
+        return FIRMWARE_WRITE_FAILED;
+      }
+      progress->written = sectorStart;
+      return FIRMWARE_WRITE_REWOUND;
+    }
+    sectorStart += sector;
+  }
+  for (; sectorStart < offset + padded; sectorStart += sector) {
+    if (!slot.erase(sectorStart, sector)) {
+      return FIRMWARE_WRITE_FAILED;
+    }
+  }
+
+  if (!slot.program(offset, chunk, padded) || !regionMatches(slot, offset, chunk, padded)) {
+    return FIRMWARE_WRITE_FAILED;
+  }
+  progress->written = offset + (uint32_t)length;
+  return FIRMWARE_WRITE_OK;
+}
+
+//----------------------------------------------------------------------------//
+// Verification
+//----------------------------------------------------------------------------//
+
+bool firmwareVerifySlot(FirmwareProgress* progress, FirmwareSlot& slot) {
+  const FirmwareImageHeader& header = progress->header;
+  if (progress->written != header.payloadSize) {
+    return false;
+  }
+
+  Sha256 hash;
+  sha256Begin(&hash);
+  uint8_t block[FIRMWARE_VERIFY_BLOCK];
+  for (uint32_t offset = 0; offset < header.payloadSize; offset += sizeof(block)) {
+    uint32_t n = header.payloadSize - offset < sizeof(block) ? header.payloadSize - offset : sizeof(block);
+    if (!slot.read(offset, block, n)) {
+      return false;
+    }
+    sha256Update(&hash, block, n);
+  }
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256End(&hash, digest);
+
+  progress->complete = memcmp(digest, header.digest, sizeof(digest)) == 0;
+  return progress->complete;
+}
@@ -0,0 +1,127 @@
+#ifndef FIRMWARE_IMAGE_H
+#define FIRMWARE_IMAGE_H
+
+#include "Checksum.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Signed Firmware Images
+//----------------------------------------------------------------------------//
+
+/*
+ * An update image is a 128-byte header followed by the sketch binary
+ * (the payload). The header carries the payload's size and SHA-256 digest
+ * and an ECDSA P-256 signature over everything before the signature, so
+ * one signature check on the header vouches for every payload byte.
+ *
+ * The image is fetched in chunks and each chunk is programmed straight into
+ * the inactive flash slot, then read back and compared - nothing bigger
+ * than one chunk is ever held in RAM. FirmwareProgress records how much of
+ * the payload is safely in flash; persisted after each chunk, it lets an
+ * interrupted download carry on from there. Once the payload is complete
+ * its digest is computed from the slot contents, so what gets verified is
+ * what will boot.
+ *
+ * Pure code over the FirmwareSlot interface: the firmware backs it with the
+ * internal flash (FirmwareUpdate.h), host tools with a file.
+ */
+
+const uint32_t FIRMWARE_MAGIC = 0x57465249;  // "IRFW"
+const size_t FIRMWARE_HEADER_SIZE = 128;
+const size_t FIRMWARE_SIGNATURE_SIZE = 64;   // r || s, big-endian
+const size_t FIRMWARE_PUBLIC_KEY_SIZE = 65;  // Uncompressed P-256 point (0x04 || x || y)
+
+// Little-endian on the wire, as laid out here
+struct FirmwareImageHeader {
+  uint32_t magic;             // FIRMWARE_MAGIC
+  uint32_t headerSize;        // FIRMWARE_HEADER_SIZE
+  uint32_t version;           // Build number; only newer builds are installed
+  uint32_t payloadSize;       // Bytes of sketch binary after the header
+  uint8_t digest[SHA256_DIGEST_SIZE];  // SHA-256 of the payload
+  uint8_t reserved[16];       // Zero
+  uint8_t signature[FIRMWARE_SIGNATURE_SIZE];  // Over the bytes above
+};
+
+static_assert(sizeof(FirmwareImageHeader) == FIRMWARE_HEADER_SIZE, "Header layout is the wire format");
+
+/*
+ * Flash region that receives the payload. Erase and program granularity are
+ * the hardware's; offsets are relative to the start of the slot.
+ */
+class FirmwareSlot {
+public:
+  virtual ~FirmwareSlot() {}
+  virtual uint32_t size() const = 0;
+  virtual uint32_t sectorSize() const = 0;   // Erase unit
+  virtual uint32_t programSize() const = 0;  // Program unit; chunks are padded to it
+  virtual bool erase(uint32_t offset, uint32_t length) = 0;
+  virtual bool program(uint32_t offset, const void* data, uint32_t length) = 0;
+  virtual bool read(uint32_t offset, void* data, uint32_t length) = 0;
+};
+
+// Resume point of an update, persisted after every chunk
+struct FirmwareProgress {
+  FirmwareImageHeader header;  // Verified header of the image being written
+  uint32_t written;            // Payload bytes programmed and read back
+  bool complete;               // Whole payload in the slot and its digest matched
+};
+
+enum FirmwareWriteResult {
+  FIRMWARE_WRITE_OK,           // Chunk programmed and verified
+  FIRMWARE_WRITE_REWOUND,      // Found a damaged flash word; `written` moved back
+  FIRMWARE_WRITE_FAILED        // Erase/program/read-back failed
+};
+
+/**
+ * Check an image header's signature (platform-specific: mbedTLS on the
+ * board, OpenSSL in host tools)
+ * @param header Header as received
+ * @param publicKey Signing key, uncompressed P-256 point
+ * @return true if the signature is valid for this key
+ */
+bool firmwareHeaderSigned(const FirmwareImageHeader& header,
+                          const uint8_t publicKey[FIRMWARE_PUBLIC_KEY_SIZE]);
+
+/**
+ * Check an image header's fields (not its signature)
+ * @param header Header as received
+ * @param slotSize Capacity of the slot the payload must fit in
+ * @return true if the header is well formed and the payload fits
+ */
+bool firmwareHeaderUsable(const FirmwareImageHeader& header, uint32_t slotSize);
+
+/**
+ * Start writing a new image from its first byte
+ * @param progress Resume point to reset
+ * @param header Verified header of the image
+ */
+void firmwareProgressBegin(FirmwareProgress* progress, const FirmwareImageHeader& header);
+
+/**
+ * Program the next payload chunk at progress->written, then read it back
+ * Sectors are erased as the write reaches them. If the target bytes are no
+ * longer blank (a reset while programming or before saving progress), the
+ * chunk is finished in place when every word is either intact or blank;
+ * otherwise its sector is erased and `written` rewinds to the sector start.
+ * @param progress Resume point, advanced past the chunk on success
+ * @param slot Flash to write
+ * @param chunk Payload bytes; padded in place with 0xFF up to programSize()
+ * @param length Payload bytes in the chunk (a multiple of programSize()
+ *               except for the last chunk)
+ * @param capacity Size of the chunk buffer, at least length rounded up
+ * @return Outcome; on FIRMWARE_WRITE_REWOUND fetch again from progress->written
+ */
+FirmwareWriteResult firmwareWriteChunk(FirmwareProgress* progress, FirmwareSlot& slot,
+                                       uint8_t* chunk, size_t length, size_t capacity);
+
+/**
+ * Hash the payload as it sits in the slot and compare with the header
+ * Marks the progress complete on a match.
+ * @param progress Resume point with the whole payload written
+ * @param slot Flash holding the payload
+ * @return true if the slot holds exactly the signed payload
+ */
+bool firmwareVerifySlot(FirmwareProgress* progress, FirmwareSlot& slot);
+
+#endif // FIRMWARE_IMAGE_H
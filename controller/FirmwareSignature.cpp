@@ -0,0 +1,40 @@
+#include "FirmwareImage.h"
+#include <mbedtls/ecdsa.h>
+#include <mbedtls/ecp.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------//
+// Header Signature (mbedTLS)
+//----------------------------------------------------------------------------//
+
+// The big-number arithmetic allocates from the heap; this runs once per new
+// image, not on the steady-state poll path
+bool firmwareHeaderSigned(const FirmwareImageHeader& header,
+                          const uint8_t publicKey[FIRMWARE_PUBLIC_KEY_SIZE]) {
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  Sha256 hash;
+  sha256Begin(&hash);
+  sha256Update(&hash, &header, offsetof(FirmwareImageHeader, signature));
+  sha256End(&hash, digest);
+
+  mbedtls_ecp_group group;
+  mbedtls_ecp_point key;
+  mbedtls_mpi r, s;
+  mbedtls_ecp_group_init(&group);
+  mbedtls_ecp_point_init(&key);
+  mbedtls_mpi_init(&r);
+  mbedtls_mpi_init(&s);
+
+  const size_t half = FIRMWARE_SIGNATURE_SIZE / 2;
+  bool valid = mbedtls_ecp_group_load(&group, MBEDTLS_ECP_DP_SECP256R1) == 0 &&
+               mbedtls_ecp_point_read_binary(&group, &key, publicKey, FIRMWARE_PUBLIC_KEY_SIZE) == 0 &&
+               mbedtls_mpi_read_binary(&r, header.signature, half) == 0 &&
+               mbedtls_mpi_read_binary(&s, header.signature + half, half) == 0 &&
+               mbedtls_ecdsa_verify(&group, digest, sizeof(digest), &key, &r, &s) == 0;
+
+  mbedtls_mpi_free(&s);
+  mbedtls_mpi_free(&r);
+  mbedtls_ecp_point_free(&key);
+  mbedtls_ecp_group_free(&group);
+  return valid;
+}
@@ -0,0 +1,329 @@
+#include "FirmwareUpdate.h"
+#include "IrrigationController.h"
+#include "HttpSession.h"
+#include "WiFiConnection.h"
+#include <WiFi.h>
+#include <ArduinoHttpClient.h>
+#include <FlashIAP.h>
+#include "kvstore_global_api.h"
+#include <mbed_error.h>
+
+// External HTTP client from main file
+extern HttpClient g_httpClient;
+
+//----------------------------------------------------------------------------//
+// Flash Layout
+//----------------------------------------------------------------------------//
+
+static const uint32_t ACTIVE_BANK_ADDRESS = 0x08000000;
+static const uint32_t INACTIVE_BANK_ADDRESS = 0x08100000;
+static const uint32_t BOOTLOADER_SIZE = 0x40000;       // Sketches start 256 KB into the bank
+static const uint32_t BANK_SIZE = 0x100000;
+static const uint32_t FLASH_SECTOR_SIZE = 0x20000;     // 128 KB
+static const uint32_t FLASH_PROGRAM_SIZE = 32;         // One 256-bit flash word
+
+// Payload bytes per request. One chunk is the only piece of the image ever
+// in RAM; a multiple of the flash word so only the last chunk is padded.
+static const size_t FIRMWARE_CHUNK_CAPACITY = 4096;
+static const unsigned long FIRMWARE_RETRY_MS = 30000;  // After a failed request
+
+static_assert(FIRMWARE_CHUNK_CAPACITY % FLASH_PROGRAM_SIZE == 0, "Chunks are whole flash words");
+
+static mbed::FlashIAP g_flash;
+static bool g_flashReady = false;
+
+static bool flashBegin() {
+  if (!g_flashReady) {
+    g_flashReady = g_flash.init() == 0;
+  }
+  return g_flashReady;
+}
+
+// The inactive bank past its bootloader: where the new sketch goes
+class InactiveBankSlot : public FirmwareSlot {
+public:
+  uint32_t size() const override { return BANK_SIZE - BOOTLOADER_SIZE; }
+  uint32_t sectorSize() const override { return FLASH_SECTOR_SIZE; }
+  uint32_t programSize() const override { return FLASH_PROGRAM_SIZE; }
+
+  bool erase(uint32_t offset, uint32_t length) override {
+    return g_flash.erase(address(offset), length) == 0;
+  }
+  bool program(uint32_t offset, const void* data, uint32_t length) override {
+    return g_flash.program(data, address(offset), length) == 0;
+  }
+  bool read(uint32_t offset, void* data, uint32_t length) override {
+    // Flash is cacheable on the M7; drop lines from before an erase/program
+    SCB_InvalidateDCache_by_Addr((void*)address(offset), (int32_t)length);
+    return g_flash.read(data, address(offset), length) == 0;
+  }
+
+private:
+  static uint32_t address(uint32_t offset) {
+    return INACTIVE_BANK_ADDRESS + BOOTLOADER_SIZE + offset;
+  }
+};
+
+static InactiveBankSlot g_slot;
+
+//----------------------------------------------------------------------------//
+// Persisted Resume Point
+//----------------------------------------------------------------------------//
+
+const char* KEY_FIRMWARE = "ota";
+static const uint32_t FIRMWARE_RECORD_MAGIC = 0x4154504F;  // "OPTA"
+
+struct StoredProgress {
+  uint32_t magic;
+  FirmwareProgress progress;
+  uint32_t crc;                // CRC-32 of `progress`
+};
+
+static bool loadProgress(FirmwareProgress* progress) {
+  StoredProgress stored;
+  size_t actual = 0;
+  if (kv_get(KEY_FIRMWARE, &stored, sizeof(stored), &actual) != MBED_SUCCESS ||
+      actual != sizeof(stored) || stored.magic != FIRMWARE_RECORD_MAGIC ||
+      stored.crc != crc32(&stored.progress, sizeof(stored.progress))) {
+    return false;
+  }
+  *progress = stored.progress;
+  return true;
+}
+
+static void saveProgress(const FirmwareProgress& progress) {
+  StoredProgress stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.magic = FIRMWARE_RECORD_MAGIC;
+  stored.progress = progress;
+  stored.crc = crc32(&stored.progress, sizeof(stored.progress));
+  // A lost checkpoint costs a re-download of the chunks since the last one
+  kv_set(KEY_FIRMWARE, &stored, sizeof(stored), 0);
+}
+
+//----------------------------------------------------------------------------//
+// Download
+//----------------------------------------------------------------------------//
+
+enum FirmwarePhase {
+  FIRMWARE_IDLE,               // Waiting for the next check
+  FIRMWARE_DOWNLOADING,        // Fetching payload chunks
+  FIRMWARE_READY               // Verified image waiting for activation
+};
+
+static uint8_t g_chunk[FIRMWARE_CHUNK_CAPACITY + 1];  // +1 for readResponseBody's terminator
+static char g_firmwarePath[48];
+static FirmwareProgress g_progress;
+static FirmwarePhase g_phase = FIRMWARE_IDLE;
+static bool g_progressLoaded = false;
+static unsigned long g_nextCheckMs = 0;
+static FirmwareUpdateStats g_updateStats = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+// GET one byte range of the image into g_chunk
+static bool fetchRange(uint32_t offset, uint32_t length) {
+  snprintf(g_firmwarePath, sizeof(g_firmwarePath), "/firmware?offset=%lu&length=%lu",
+           (unsigned long)offset, (unsigned long)length);
+  int statusCode = httpSessionGet(g_firmwarePath);
+  if (statusCode < 0) {
+    return false;
+  }
+
+  bool keepOpen = true;
+  static char headerLine[128];
+  while (readHeaderLine(headerLine, sizeof(headerLine))) {
+    if (strcasecmp(headerLine, "Connection: close") == 0) {
+      keepOpen = false;
+    }
+  }
+  int received = readResponseBody((char*)g_chunk, sizeof(g_chunk));
+  httpSessionEnd(keepOpen && received >= 0 && g_httpClient.endOfBodyReached());
+  return statusCode == 200 && received == (int)length;
+}
+
+static void retryLater() {
+  g_updateStats.failures++;
+  g_nextCheckMs = millis() + FIRMWARE_RETRY_MS;
+}
+
+static void checkForUpdate() {
+  g_updateStats.checks++;
+  if (!fetchRange(0, FIRMWARE_HEADER_SIZE)) {
+    retryLater();  // Includes a 404 from a server with nothing published
+    return;
+  }
+  FirmwareImageHeader header;
+  memcpy(&header, g_chunk, sizeof(header));
+  if (header.magic != FIRMWARE_MAGIC || header.version <= firmware_version) {
+    return;  // Nothing newer; no signature check on this path
+  }
+
+  // Same image as the saved resume point: its signature was checked then
+  if (g_progress.header.version != 0 && memcmp(&header, &g_progress.header, sizeof(header)) == 0) {
+    g_updateStats.resumes++;
+    Serial.print("Firmware update: resuming build ");
+    Serial.print(header.version);
+    Serial.print(" at ");
+    Serial.println(g_progress.written);
+  } else {
+    if (!firmwareHeaderUsable(header, g_slot.size()) || !firmwareHeaderSigned(header, ota_public_key)) {
+      Serial.println("Firmware update: image rejected (bad header or signature)");
+      retryLater();
+      return;
+    }
+    firmwareProgressBegin(&g_progress, header);
+    saveProgress(g_progress);
+    Serial.print("Firmware update: downloading build ");
+    Serial.println(header.version);
+  }
+  g_phase = FIRMWARE_DOWNLOADING;
+}
+
+static void downloadChunk() {
+  const FirmwareImageHeader& header = g_progress.header;
+  uint32_t remaining = header.payloadSize - g_progress.written;
+  uint32_t length = remaining < FIRMWARE_CHUNK_CAPACITY ? remaining : FIRMWARE_CHUNK_CAPACITY;
+  if (!fetchRange(FIRMWARE_HEADER_SIZE + g_progress.written, length)) {
+    g_phase = FIRMWARE_IDLE;  // The next check re-reads the header and resumes
+    retryLater();
+    return;
+  }
+
+  switch (firmwareWriteChunk(&g_progress, g_slot, g_chunk, length, FIRMWARE_CHUNK_CAPACITY)) {
+    case FIRMWARE_WRITE_OK:
+      g_updateStats.chunks++;
+      g_updateStats.bytes += length;
+      break;
+    case FIRMWARE_WRITE_REWOUND:
+      g_updateStats.rewinds++;
+      break;
+    case FIRMWARE_WRITE_FAILED:
+      Serial.println("Firmware update: flash write failed - starting over");
+      firmwareProgressBegin(&g_progress, header);
+      saveProgress(g_progress);
+      g_phase = FIRMWARE_IDLE;
+      retryLater();
+      return;
+  }
+
+  if (g_progress.written == header.payloadSize) {
+    if (!firmwareVerifySlot(&g_progress, g_slot)) {
+      Serial.println("Firmware update: digest mismatch - starting over");
+      firmwareProgressBegin(&g_progress, header);
+      saveProgress(g_progress);
+      g_phase = FIRMWARE_IDLE;
+      retryLater();
+      return;
+    }
+    Serial.print("Firmware update: build ");
+    Serial.print(header.version);
+    Serial.println(" verified, will install when all zones are closed");
+    g_phase = FIRMWARE_READY;
+  }
+  saveProgress(g_progress);
+}
+
+bool serviceFirmwareUpdate(bool* ready) {
+  *ready = false;
+  if (!ota_enabled || wifiLinkStatus() != WL_CONNECTED) {
+    return false;
+  }
+
+  if (!g_progressLoaded) {
+    g_progressLoaded = true;
+    if (!loadProgress(&g_progress) || g_progress.header.version <= firmware_version) {
+      // None saved, or it is the build now running - nothing to resume
+      kv_remove(KEY_FIRMWARE);
+      memset(&g_progress, 0, sizeof(g_progress));
+    } else if (g_progress.complete) {
+      g_phase = FIRMWARE_READY;  // Verified before a reset; still in the slot
+    }
+  }
+
+  bool wasReady = g_phase == FIRMWARE_READY;
+  bool remind = false;
+  bool requested = false;
+  if (g_phase == FIRMWARE_DOWNLOADING) {
+    if (flashBegin()) {
+      downloadChunk();
+      requested = true;
+    } else {
+      g_phase = FIRMWARE_IDLE;
+      retryLater();
+    }
+  } else if ((long)(millis() - g_nextCheckMs) >= 0) {
+    g_nextCheckMs = millis() + ota_check_interval_ms;
+    if (g_phase == FIRMWARE_READY) {
+      remind = true;  // The control side may have missed the first event
+    } else {
+      checkForUpdate();
+      requested = true;
+    }
+  }
+
+  g_updateStats.pendingVersion = g_progress.header.version;
+  g_updateStats.pendingWritten = g_progress.written;
+  g_updateStats.pendingSize = g_progress.header.payloadSize;
+  *ready = remind || (!wasReady && g_phase == FIRMWARE_READY);
+  return requested;
+}
+
+//----------------------------------------------------------------------------//
+// Activation
+//----------------------------------------------------------------------------//
+
+// The inactive bank boots from its own first 256 KB; give it ours unless it
+// already matches
+static bool copyBootloader() {
+  if (memcmp((const void*)ACTIVE_BANK_ADDRESS, (const void*)INACTIVE_BANK_ADDRESS, BOOTLOADER_SIZE) == 0) {
+    return true;
+  }
+  if (g_flash.erase(INACTIVE_BANK_ADDRESS, BOOTLOADER_SIZE) != 0) {
+    return false;
+  }
+  for (uint32_t offset = 0; offset < BOOTLOADER_SIZE; offset += FIRMWARE_CHUNK_CAPACITY) {
+    memcpy(g_chunk, (const void*)(ACTIVE_BANK_ADDRESS + offset), FIRMWARE_CHUNK_CAPACITY);
+    if (g_flash.program(g_chunk, INACTIVE_BANK_ADDRESS + offset, FIRMWARE_CHUNK_CAPACITY) != 0) {
+      return false;
+    }
+  }
+  SCB_InvalidateDCache_by_Addr((void*)INACTIVE_BANK_ADDRESS, (int32_t)BOOTLOADER_SIZE);
+  return memcmp((const void*)ACTIVE_BANK_ADDRESS, (const void*)INACTIVE_BANK_ADDRESS, BOOTLOADER_SIZE) == 0;
+}
+
+bool activateFirmwareUpdate() {
+  FirmwareProgress progress;
+  if (!loadProgress(&progress) || !progress.complete || progress.header.version <= firmware_version) {
+    return false;
+  }
+  if (!flashBegin() || !firmwareVerifySlot(&progress, g_slot) || !copyBootloader()) {
+    Serial.println("Firmware update: inactive bank no longer verifies - not switching");
+    return false;
+  }
+
+  Serial.print("Firmware update: switching to build ");
+  Serial.println(progress.header.version);
+  Serial.flush();
+
+  // One option-byte program flips which bank boots; the reset that follows
+  // (OB_Launch) brings up the new build
+  FLASH_OBProgramInitTypeDef options;
+  memset(&options, 0, sizeof(options));
+  options.OptionType = OPTIONBYTE_USER;
+  options.USERType = OB_USER_SWAP_BANK;
+  options.USERConfig = (FLASH->OPTSR_CUR & FLASH_OPTSR_SWAP_BANK_OPT) ? OB_SWAP_BANK_DISABLE : OB_SWAP_BANK_ENABLE;
+
+  HAL_FLASH_Unlock();
+  HAL_FLASH_OB_Unlock();
+  bool programmed = HAL_FLASHEx_OBProgram(&options) == HAL_OK && HAL_FLASH_OB_Launch() == HAL_OK;
+  HAL_FLASH_OB_Lock();
+  HAL_FLASH_Lock();
+  if (programmed) {
+    NVIC_SystemReset();  // OB_Launch normally resets first
+  }
+  Serial.println("Firmware update: bank swap failed");
+  return false;
+}
+
+const FirmwareUpdateStats& firmwareUpdateStats() {
+  return g_updateStats;
+}
@@ -0,0 +1,79 @@
+#ifndef FIRMWARE_UPDATE_H
+#define FIRMWARE_UPDATE_H
+
+#include "Types.h"
+#include "FirmwareImage.h"
+
+//----------------------------------------------------------------------------//
+// Over-the-Air Firmware Update
+//----------------------------------------------------------------------------//
+
+/*
+ * Fetches signed images (FirmwareImage.h) from the schedule server and
+ * installs them in the inactive flash bank.
+ *
+ *   network idle   serviceFirmwareUpdate() - every ota_check_interval_ms,
+ *                  GET /firmware?offset=0&length=128 for the header; if it
+ *                  is a newer, validly signed build, fetch the payload one
+ *                  chunk per call with /firmware?offset=N&length=M on the
+ *                  schedule poll's keep-alive connection, programming each
+ *                  chunk into the slot and saving the resume point
+ *   control side   activateFirmwareUpdate() - once the machine has seen
+ *                  INPUT_FIRMWARE_READY and every zone is closed, flip the
+ *                  bank swap option bit and reset into the new build
+ *
+ * The STM32H747's two 1 MB flash banks are the slots: the running build is
+ * always mapped at 0x08000000 and the other bank at 0x08100000, and the
+ * SWAP_BANK option bit chooses which physical bank sits where. Flipping it
+ * is a single option-byte program, so a reset at any moment boots either
+ * the old build or the new one, never a mix. The sketch must therefore fit
+ * in one bank (flash split "1MB M7 + 1MB M4", with no M4 sketch), and the
+ * bootloader is copied into the inactive bank before the swap. The
+ * key-value store is on the QSPI flash, so the resume record and the
+ * configuration don't move with the banks.
+ *
+ * A download interrupted by a dropped connection, a failed request or a
+ * reset carries on from the last chunk that was read back from flash.
+ * Only a build newer than firmware_version and signed by ota_public_key
+ * is written; the signature check is the one heap user here (mbedTLS) and
+ * runs once per new image, never on the steady-state checks.
+ *
+ * Does nothing unless ota_enabled is set.
+ */
+
+struct FirmwareUpdateStats {
+  unsigned long checks;         // Header requests
+  unsigned long chunks;         // Chunks programmed and verified
+  unsigned long bytes;          // Payload bytes programmed
+  unsigned long resumes;        // Downloads continued from a saved resume point
+  unsigned long rewinds;        // Sectors erased and refetched after a damaged write
+  unsigned long failures;       // Failed requests, writes and verifications
+  uint32_t pendingVersion;      // Build being fetched or ready, 0 = none
+  uint32_t pendingWritten;      // Its payload bytes in flash
+  uint32_t pendingSize;         // Its payload size
+};
+
+/**
+ * Check for, download or verify an update - at most one HTTP request
+ * Call when the network side is idle; does nothing while WiFi is down.
+ * @param ready Set to true if a verified image is waiting to be activated
+ *        (repeated at every check until it is)
+ * @return true if an HTTP request was made (this pass's blocking job)
+ */
+bool serviceFirmwareUpdate(bool* ready);
+
+/**
+ * Switch to the verified image in the inactive bank and reset
+ * Call with the zones closed; returns only if there is nothing to activate
+ * or the switch failed, in which case the running build carries on.
+ * @return false (on success it doesn't return)
+ */
+bool activateFirmwareUpdate();
+
+/**
+ * Access update counters
+ * @return Update statistics since boot
+ */
+const FirmwareUpdateStats& firmwareUpdateStats();
+
+#endif // FIRMWARE_UPDATE_H
@@ -0,0 +1,60 @@
+#include "HeapAudit.h"
+#include <malloc.h>
+
+static HeapAuditStats g_heapAudit = {false, 0, 0, false, 0, 0};
+static unsigned long g_steadyBaseline = 0;
+
+//----------------------------------------------------------------------------//
+// Allocation Counters (HEAP_AUDIT builds only)
+//----------------------------------------------------------------------------//
+
+#if defined(HEAP_AUDIT)
+// The linker sends every malloc/calloc/realloc call here (-Wl,--wrap=...),
+// and __real_* reaches the C library's implementation
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_calloc(size_t count, size_t size);
+  void* __real_realloc(void* ptr, size_t size);
+
+  void* __wrap_malloc(size_t size) {
+    g_heapAudit.allocations++;
+    return __real_malloc(size);
+  }
+
+  void* __wrap_calloc(size_t count, size_t size) {
+    g_heapAudit.allocations++;
+    return __real_calloc(count, size);
+  }
+
+  void* __wrap_realloc(void* ptr, size_t size) {
+    g_heapAudit.allocations++;
+    return __real_realloc(ptr, size);
+  }
+}
+#endif
+
+//----------------------------------------------------------------------------//
+// Audit API
+//----------------------------------------------------------------------------//
+
+void heapAuditSteadyState() {
+  if (!g_heapAudit.steady) {
+    g_heapAudit.steady = true;
+    g_steadyBaseline = g_heapAudit.allocations;
+  }
+}
+
+const HeapAuditStats& heapAudit() {
+#if defined(HEAP_AUDIT)
+  g_heapAudit.counting = true;
+#endif
+  struct mallinfo info = mallinfo();
+  g_heapAudit.inUseBytes = info.uordblks;
+  if (g_heapAudit.inUseBytes > g_heapAudit.peakInUseBytes) {
+    g_heapAudit.peakInUseBytes = g_heapAudit.inUseBytes;
+  }
+  if (g_heapAudit.steady) {
+    g_heapAudit.steadyAllocations = g_heapAudit.allocations - g_steadyBaseline;
+  }
+  return g_heapAudit;
+}
@@ -0,0 +1,43 @@
+#ifndef HEAP_AUDIT_H
+#define HEAP_AUDIT_H
+
+#include <stddef.h>
+
+//----------------------------------------------------------------------------//
+// Heap Audit
+//----------------------------------------------------------------------------//
+
+/*
+ * The poll, parse and serial paths run out of static arenas (see Arena.h),
+ * so once the controller has completed its first poll it should not call
+ * malloc at all. Building with `just arduino-build-heap-audit` defines
+ * HEAP_AUDIT and links malloc/calloc/realloc through counting wrappers
+ * (-Wl,--wrap), so the status line can prove it. Heap occupancy (from
+ * mallinfo) is reported in every build so a long run shows it stays flat.
+ *
+ * Note that allocations made by the WiFi driver and socket layer are counted
+ * too; a new TCP connection allocates inside mbed, which is one more reason
+ * schedule polls keep their connection alive.
+ */
+
+struct HeapAuditStats {
+  bool counting;                      // Built with HEAP_AUDIT (allocation counters valid)
+  unsigned long allocations;          // malloc/calloc/realloc calls since boot
+  unsigned long steadyAllocations;    // ...since heapAuditSteadyState()
+  bool steady;                        // Steady state has been entered
+  size_t inUseBytes;                  // Heap bytes currently allocated
+  size_t peakInUseBytes;              // Highest inUseBytes seen by heapAudit()
+};
+
+/**
+ * Mark the start of steady state (first successful poll); later calls no-op
+ */
+void heapAuditSteadyState();
+
+/**
+ * Sample heap occupancy and return the audit counters
+ * @return Current heap audit statistics
+ */
+const HeapAuditStats& heapAudit();
+
+#endif // HEAP_AUDIT_H
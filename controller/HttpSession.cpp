@@ -0,0 +1,167 @@
+#include "HttpSession.h"
+#include "ServerResolver.h"
+#include <WiFi.h>
+#include <ArduinoHttpClient.h>
+
+// External HTTP client from main file
+extern WiFiClient g_wifiClient;
+extern HttpClient g_httpClient;
+
+static HttpSessionStats g_sessionStats = {0, 0, 0, 0, 0};
+static bool g_sessionOpen = false;            // A connection is held for reuse
+static unsigned long g_sessionLastUsed = 0;   // millis() when the last response finished
+static unsigned long g_requestStartMs = 0;    // millis() when the current request began
+
+//----------------------------------------------------------------------------//
+// Connection Liveness
+//----------------------------------------------------------------------------//
+
+static bool sessionUsable() {
+  if (!g_sessionOpen || !g_wifiClient.connected()) {
+    return false;  // Never opened, or the peer closed it
+  }
+  if (millis() - g_sessionLastUsed >= http_keepalive_idle_ms) {
+    return false;  // Server's idle timeout has probably reaped it
+  }
+  if (g_wifiClient.available() > 0) {
+    return false;  // Unsolicited bytes - the server is closing or confused
+  }
+  return true;
+}
+
+// Open the TCP connection ourselves, to the cached server address. HttpClient
+// sees it already connected and skips its own connect, which would resolve
+// server_hostname on every call; it still sends the hostname as Host.
+static bool openConnection() {
+  IPAddress address;
+  if (!serverAddress(&address)) {
+    return false;
+  }
+  if (!g_wifiClient.connect(address, server_port)) {
+    invalidateServerAddress();  // Maybe the server moved - re-resolve soon
+    return false;
+  }
+  return true;
+}
+
+// HttpClient only clears the last response's parse state (body length read,
+// Content-Length, chunking) in startRequest() when it is still reading that
+// body - and beginRequest() has already moved it past that state. On a
+// reused connection the second response would inherit the first's counts,
+// and endOfBodyReached() could be true before a byte of it is read. The
+// reset is protected; a derived class may name it for any HttpClient.
+struct HttpClientReset : HttpClient {
+  static void reset(HttpClient& client) {
+    (client.*&HttpClientReset::resetState)();
+  }
+};
+
+//----------------------------------------------------------------------------//
+// Deadlines
+//----------------------------------------------------------------------------//
+
+// Time a wait begun at `waitStartMs` has left, 0 when it should give up
+static unsigned long waitRemainingMs(unsigned long waitStartMs) {
+  unsigned long now = millis();
+  unsigned long waited = now - waitStartMs;
+  unsigned long spent = now - g_requestStartMs;
+  if (waited >= http_response_timeout_ms || spent >= HTTP_REQUEST_DEADLINE_MS) {
+    return 0;
+  }
+  unsigned long left = http_response_timeout_ms - waited;
+  return (HTTP_REQUEST_DEADLINE_MS - spent < left) ? HTTP_REQUEST_DEADLINE_MS - spent : left;
+}
+
+bool httpSessionWaitOver(unsigned long waitStartMs) {
+  return waitRemainingMs(waitStartMs) == 0;
+}
+
+// responseStatusCode() only watches the clock, so wait for the first byte
+// here, watching the socket too: a connection the server closed shows up
+// at once instead of after the whole timeout, and only then is it retried
+static int awaitStatus() {
+  unsigned long start = millis();
+  while (g_wifiClient.available() == 0) {
+    if (!g_wifiClient.connected()) {
+      return HTTP_ERROR_CONNECTION_FAILED;
+    }
+    if (httpSessionWaitOver(start)) {
+      return HTTP_ERROR_TIMED_OUT;
+    }
+    delay(1);
+  }
+  g_httpClient.setHttpResponseTimeout(waitRemainingMs(start));
+  return g_httpClient.responseStatusCode();
+}
+
+//----------------------------------------------------------------------------//
+// Session API
+//----------------------------------------------------------------------------//
+
+static int sendGet(const char* path, bool reused) {
+  if (!reused && !openConnection()) {
+    return HTTP_ERROR_CONNECTION_FAILED;
+  }
+  HttpClientReset::reset(g_httpClient);  // Nothing carried over from the last response
+  g_httpClient.connectionKeepAlive();  // Must be set before every request
+  g_httpClient.beginRequest();         // Hold the headers open for ours
+  int err = g_httpClient.get(path);
+  if (err != HTTP_SUCCESS) {
+    return err;
+  }
+  g_httpClient.sendHeader("Accept-Encoding", "gzip, deflate");  // Decoded by Inflate.h
+  g_httpClient.endRequest();
+  return awaitStatus();
+}
+
+int httpSessionGet(const char* path) {
+  g_sessionStats.requests++;
+  g_requestStartMs = millis();
+
+  bool reused = sessionUsable();
+  if (!reused && g_sessionOpen) {
+    g_httpClient.stop();  // Discard the stale connection before reconnecting
+  }
+
+  int status = sendGet(path, reused);
+  if (reused && status == HTTP_ERROR_CONNECTION_FAILED && !httpSessionWaitOver(millis())) {
+    // The server dropped the connection between liveness check and request.
+    // Never on a timeout: a hung server would only hang the retry too.
+    g_sessionStats.staleRetries++;
+    g_httpClient.stop();
+    reused = false;
+    status = sendGet(path, false);
+  }
+
+  if (reused) {
+    g_sessionStats.keepAliveHits++;
+  } else {
+    g_sessionStats.keepAliveMisses++;
+  }
+
+  g_sessionOpen = (status >= 0);
+  if (!g_sessionOpen) {
+    g_httpClient.stop();
+  }
+  return status;
+}
+
+void httpSessionEnd(bool keepOpen) {
+  if (!keepOpen) {
+    g_sessionStats.closedAfterUse++;
+    httpSessionClose();
+    return;
+  }
+  g_sessionLastUsed = millis();
+}
+
+void httpSessionClose() {
+  if (g_sessionOpen) {
+    g_httpClient.stop();
+    g_sessionOpen = false;
+  }
+}
+
+const HttpSessionStats& httpSessionStats() {
+  return g_sessionStats;
+}
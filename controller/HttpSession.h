@@ -0,0 +1,83 @@
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Persistent HTTP Session
+//----------------------------------------------------------------------------//
+
+/*
+ * Schedule polls share one HTTP/1.1 keep-alive connection to
+ * server_hostname:server_port instead of paying a TCP handshake per poll.
+ * Before each request the session checks that the connection is still
+ * usable: the socket is open, nothing unsolicited is waiting in the receive
+ * buffer (a server close or error page), and it hasn't sat idle past
+ * http_keepalive_idle_ms, after which the server has likely dropped it.
+ * A reused connection that still turns out dead - closed by the server
+ * before it answered - is retried once on a fresh connection, so the caller
+ * never sees the difference. A server that is merely slow is not retried:
+ * that would only wait out the timeout a second time. New
+ * connections go to the address cached by ServerResolver, never through DNS.
+ * Every request offers "Accept-Encoding: gzip, deflate"; the caller decodes
+ * compressed bodies with Inflate.h.
+ *
+ * Every wait in a request (status line, headers, body) gives up after
+ * http_response_timeout_ms, and the request as a whole after
+ * HTTP_REQUEST_DEADLINE_MS, however the time was spread between them.
+ *
+ * Runs on the network side only (see NetworkMailbox.h).
+ */
+
+// Everything one request may spend: connect, send, status line, headers and
+// body together. Inside the network stage's 20 s soft deadline
+// (LoopWatchdog.cpp) and well inside watchdog_timeout_ms (30 s), so a server
+// that stalls part way through a response can't stretch a loop pass into a
+// watchdog reset. A connect that blocks in the WiFi driver counts against
+// it but can't be cut short.
+const unsigned long HTTP_REQUEST_DEADLINE_MS = 15000;
+
+struct HttpSessionStats {
+  unsigned long requests;         // Requests issued through the session
+  unsigned long keepAliveHits;    // Requests served on an already-open connection
+  unsigned long keepAliveMisses;  // Requests that had to open a new connection
+  unsigned long staleRetries;     // Reused connections found dead mid-request and retried
+  unsigned long closedAfterUse;   // Responses after which the connection couldn't be kept
+};
+
+/**
+ * GET a path on the persistent connection, reconnecting if needed
+ * On success the response headers and body are ready to read from
+ * g_httpClient; finish with httpSessionEnd().
+ * @param path Request path
+ * @return HTTP status code, or a negative ArduinoHttpClient error
+ */
+int httpSessionGet(const char* path);
+
+/**
+ * Whether a wait for response bytes should give up
+ * @param waitStartMs millis() when the wait began
+ * @return true once it has lasted http_response_timeout_ms, or the request
+ *         has reached HTTP_REQUEST_DEADLINE_MS
+ */
+bool httpSessionWaitOver(unsigned long waitStartMs);
+
+/**
+ * Finish the current response
+ * @param keepOpen false if the server asked to close or the body wasn't
+ *                 fully read, so the connection can't be reused
+ */
+void httpSessionEnd(bool keepOpen);
+
+/**
+ * Drop the connection (e.g. after the WiFi link went away)
+ */
+void httpSessionClose();
+
+/**
+ * Access keep-alive counters
+ * @return Session statistics since boot
+ */
+const HttpSessionStats& httpSessionStats();
+
+#endif // HTTP_SESSION_H
@@ -0,0 +1,469 @@
+#include "Inflate.h"
+#include "Checksum.h"
+
+//----------------------------------------------------------------------------//
+// Tables (RFC 1951 section 3.2.5)
+//----------------------------------------------------------------------------//
+
+// Where inflateRead() picks up again
+enum InflatePhase : uint8_t {
+  PHASE_HEADER,                // gzip/zlib header not read yet
+  PHASE_BLOCK,                 // At a block header (or past the final block)
+  PHASE_STORED,                // Copying a stored block
+  PHASE_CODES,                 // Decoding a compressed block
+  PHASE_COPY,                  // Copying a match out of the window
+  PHASE_DONE,                  // Trailer checked; the stream is over
+  PHASE_FAILED                 // See Inflater.error
+};
+
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order in which a dynamic block lists its code length code
+static const uint8_t CODE_LENGTH_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static const uint32_t ADLER_MODULUS = 65521;
+
+//----------------------------------------------------------------------------//
+// Bits and Bytes
+//----------------------------------------------------------------------------//
+
+static int fail(Inflater* inflater, InflateError error) {
+  if (inflater->phase != PHASE_FAILED) {
+    inflater->error = error;
+    inflater->phase = PHASE_FAILED;
+  }
+  return -1;
+}
+
+static bool failed(const Inflater* inflater) {
+  return inflater->phase == PHASE_FAILED;
+}
+
+// Next `count` (0-16) input bits, LSB first; 0 once the input runs out,
+// which fails the stream
+static uint32_t getBits(Inflater* inflater, uint8_t count) {
+  while (inflater->bitCount < count) {
+    int byte = inflater->source->read();
+    if (byte < 0) {
+      fail(inflater, INFLATE_TRUNCATED);
+      return 0;
+    }
+    inflater->bits |= (uint32_t)byte << inflater->bitCount;
+    inflater->bitCount += 8;
+    inflater->consumed++;
+  }
+  uint32_t value = inflater->bits & ((1UL << count) - 1);
+  inflater->bits >>= count;
+  inflater->bitCount -= count;
+  return value;
+}
+
+// Skip to the next byte boundary of the input
+static void alignToByte(Inflater* inflater) {
+  getBits(inflater, inflater->bitCount & 7);
+}
+
+// Append a byte to the output: the window, the running check, the limit
+static int emit(Inflater* inflater, uint8_t byte) {
+  if (inflater->maxOutput != 0 && inflater->produced >= inflater->maxOutput) {
+    return fail(inflater, INFLATE_TOO_LONG);
+  }
+  inflater->window[inflater->produced & (INFLATE_WINDOW_SIZE - 1)] = byte;
+  inflater->produced++;
+
+  if (inflater->format == INFLATE_GZIP) {
+    inflater->check = crc32(&byte, 1, inflater->check);
+  } else if (inflater->format == INFLATE_ZLIB) {
+    uint32_t a = ((inflater->check & 0xFFFF) + byte) % ADLER_MODULUS;
+    uint32_t b = ((inflater->check >> 16) + a) % ADLER_MODULUS;
+    inflater->check = (b << 16) | a;
+  }
+  return byte;
+}
+
+//----------------------------------------------------------------------------//
+// Huffman Codes
+//----------------------------------------------------------------------------//
+
+// Build a canonical code from code lengths (0 = symbol unused); fails only
+// for an over-subscribed code. An incomplete one is allowed, and a code it
+// lacks fails when decoded.
+static bool buildHuffman(InflateHuffman* code, const uint8_t* lengths, int symbolCount) {
+  for (int length = 0; length < 16; length++) {
+    code->counts[length] = 0;
+  }
+  for (int symbol = 0; symbol < symbolCount; symbol++) {
+    code->counts[lengths[symbol]]++;
+  }
+  code->counts[0] = 0;
+
+  int left = 1;
+  for (int length = 1; length < 16; length++) {
+    left = (left << 1) - code->counts[length];
+    if (left < 0) {
+      return false;
+    }
+  }
+
+  uint16_t offsets[16];
+  offsets[1] = 0;
+  for (int length = 1; length < 15; length++) {
+    offsets[length + 1] = offsets[length] + code->counts[length];
+  }
+  for (int symbol = 0; symbol < symbolCount; symbol++) {
+    if (lengths[symbol] != 0) {
+      code->symbols[offsets[lengths[symbol]]++] = symbol;
+    }
+  }
+  return true;
+}
+
+// Decode one symbol a bit at a time: codes of each length are consecutive
+// integers, so a code is found once it falls inside its length's range
+static int decodeSymbol(Inflater* inflater, const InflateHuffman* code) {
+  int value = 0;
+  int first = 0;
+  int index = 0;
+  for (int length = 1; length < 16; length++) {
+    value |= getBits(inflater, 1);
+    int count = code->counts[length];
+    if (value - first < count) {
+      return failed(inflater) ? -1 : code->symbols[index + value - first];
+    }
+    index += count;
+    first = (first + count) << 1;
+    value <<= 1;
+  }
+  return fail(inflater, INFLATE_BAD_DATA);
+}
+
+static void buildFixedCodes(Inflater* inflater) {
+  uint8_t lengths[288];
+  for (int symbol = 0; symbol < 288; symbol++) {
+    lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+  }
+  buildHuffman(&inflater->literals, lengths, 288);
+  for (int symbol = 0; symbol < 30; symbol++) {
+    lengths[symbol] = 5;
+  }
+  buildHuffman(&inflater->distances, lengths, 30);
+}
+
+static bool readDynamicCodes(Inflater* inflater) {
+  int literalCount = getBits(inflater, 5) + 257;
+  int distanceCount = getBits(inflater, 5) + 1;
+  int codeLengthCount = getBits(inflater, 4) + 4;
+  if (failed(inflater)) {
+    return false;
+  }
+  if (literalCount > 286 || distanceCount > 30) {
+    fail(inflater, INFLATE_BAD_DATA);
+    return false;
+  }
+
+  // The code length code is only needed until both real codes are read, so
+  // it borrows the distance code's table
+  uint8_t lengths[286 + 30];
+  for (int i = 0; i < 19; i++) {
+    lengths[CODE_LENGTH_ORDER[i]] = i < codeLengthCount ? getBits(inflater, 3) : 0;
+  }
+  if (!buildHuffman(&inflater->distances, lengths, 19)) {
+    fail(inflater, INFLATE_BAD_DATA);
+    return false;
+  }
+
+  int total = literalCount + distanceCount;
+  for (int i = 0; i < total && !failed(inflater);) {
+    int symbol = decodeSymbol(inflater, &inflater->distances);
+    if (symbol < 16) {
+      if (symbol >= 0) {
+        lengths[i++] = symbol;
+      }
+      continue;
+    }
+
+    // 16 repeats the previous length 3-6 times, 17 and 18 repeat zero 3-10
+    // and 11-138 times
+    uint8_t value = 0;
+    int repeat;
+    if (symbol == 16) {
+      if (i == 0) {
+        fail(inflater, INFLATE_BAD_DATA);
+        break;
+      }
+      value = lengths[i - 1];
+      repeat = 3 + getBits(inflater, 2);
+    } else if (symbol == 17) {
+      repeat = 3 + getBits(inflater, 3);
+    } else {
+      repeat = 11 + getBits(inflater, 7);
+    }
+    if (i + repeat > total) {
+      fail(inflater, INFLATE_BAD_DATA);
+      break;
+    }
+    while (repeat-- > 0) {
+      lengths[i++] = value;
+    }
+  }
+  if (failed(inflater)) {
+    return false;
+  }
+
+  // A block that can't end (no code for symbol 256) is corrupt
+  if (lengths[256] == 0 ||
+      !buildHuffman(&inflater->literals, lengths, literalCount) ||
+      !buildHuffman(&inflater->distances, lengths + literalCount, distanceCount)) {
+    fail(inflater, INFLATE_BAD_DATA);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Wrappers
+//----------------------------------------------------------------------------//
+
+static bool readHeader(Inflater* inflater) {
+  if (inflater->format == INFLATE_GZIP) {
+    // ID1 ID2 CM FLG MTIME(4) XFL OS, then the optional fields FLG names
+    if (getBits(inflater, 8) != 0x1F || getBits(inflater, 8) != 0x8B || getBits(inflater, 8) != 8) {
+      fail(inflater, INFLATE_BAD_HEADER);
+      return false;
+    }
+    uint32_t flags = getBits(inflater, 8);
+    if (flags & 0xE0) {
+      fail(inflater, INFLATE_BAD_HEADER);
+      return false;
+    }
+    for (int i = 0; i < 6; i++) {
+      getBits(inflater, 8);
+    }
+    if (flags & 0x04) {  // FEXTRA
+      for (uint32_t extra = getBits(inflater, 16); extra > 0 && !failed(inflater); extra--) {
+        getBits(inflater, 8);
+      }
+    }
+    if (flags & 0x08) {  // FNAME
+      while (getBits(inflater, 8) != 0 && !failed(inflater)) {}
+    }
+    if (flags & 0x10) {  // FCOMMENT
+      while (getBits(inflater, 8) != 0 && !failed(inflater)) {}
+    }
+    if (flags & 0x02) {  // FHCRC
+      getBits(inflater, 16);
+    }
+  } else if (inflater->format == INFLATE_ZLIB) {
+    uint32_t cmf = getBits(inflater, 8);
+    uint32_t flg = getBits(inflater, 8);
+    if (failed(inflater)) {
+      return false;
+    }
+    // No falling back to bare DEFLATE (as some browsers do for servers that
+    // mislabel it): a damaged header would then skip the Adler-32 check
+    if ((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) {  // 0x20: preset dictionary
+      fail(inflater, INFLATE_BAD_HEADER);
+      return false;
+    }
+    if ((1UL << ((cmf >> 4) + 8)) > INFLATE_WINDOW_SIZE) {
+      fail(inflater, INFLATE_FAR_DISTANCE);
+      return false;
+    }
+  }
+  return !failed(inflater);
+}
+
+static bool checkTrailer(Inflater* inflater) {
+  alignToByte(inflater);
+  if (inflater->format == INFLATE_GZIP) {
+    // CRC-32 then the length mod 2^32, both little-endian
+    uint32_t crc = getBits(inflater, 16);
+    crc |= getBits(inflater, 16) << 16;
+    uint32_t size = getBits(inflater, 16);
+    size |= getBits(inflater, 16) << 16;
+    if (!failed(inflater) && (crc != inflater->check || size != inflater->produced)) {
+      fail(inflater, INFLATE_BAD_CHECKSUM);
+    }
+  } else if (inflater->format == INFLATE_ZLIB) {
+    // Adler-32, big-endian
+    uint32_t adler = 0;
+    for (int i = 0; i < 4; i++) {
+      adler = (adler << 8) | getBits(inflater, 8);
+    }
+    if (!failed(inflater) && adler != inflater->check) {
+      fail(inflater, INFLATE_BAD_CHECKSUM);
+    }
+  }
+  return !failed(inflater);
+}
+
+//----------------------------------------------------------------------------//
+// Decoding
+//----------------------------------------------------------------------------//
+
+void inflateBegin(Inflater* inflater, InflateSource* source, InflateFormat format, uint32_t maxOutput) {
+  inflater->source = source;
+  inflater->format = format;
+  inflater->phase = PHASE_HEADER;
+  inflater->error = INFLATE_OK;
+  inflater->lastBlock = false;
+  inflater->bits = 0;
+  inflater->bitCount = 0;
+  inflater->remaining = 0;
+  inflater->distance = 0;
+  inflater->produced = 0;
+  inflater->consumed = 0;
+  inflater->maxOutput = maxOutput;
+  inflater->check = format == INFLATE_ZLIB ? 1 : 0;  // Adler-32 starts at 1
+}
+
+int inflateRead(Inflater* inflater) {
+  for (;;) {
+    switch (inflater->phase) {
+      case PHASE_HEADER:
+        if (!readHeader(inflater)) {
+          return -1;
+        }
+        inflater->phase = PHASE_BLOCK;
+        break;
+
+      case PHASE_BLOCK: {
+        if (inflater->lastBlock) {
+          if (checkTrailer(inflater)) {
+            inflater->phase = PHASE_DONE;
+          }
+          return -1;
+        }
+        inflater->lastBlock = getBits(inflater, 1);
+        uint32_t type = getBits(inflater, 2);
+        if (failed(inflater)) {
+          return -1;
+        }
+        if (type == 0) {
+          // Stored: byte-aligned LEN and its complement, then LEN raw bytes
+          alignToByte(inflater);
+          uint32_t length = getBits(inflater, 16);
+          uint32_t complement = getBits(inflater, 16);
+          if (failed(inflater)) {
+            return -1;
+          }
+          if (length != (~complement & 0xFFFF)) {
+            return fail(inflater, INFLATE_BAD_DATA);
+          }
+          inflater->remaining = length;
+          inflater->phase = PHASE_STORED;
+        } else if (type == 1) {
+          buildFixedCodes(inflater);
+          inflater->phase = PHASE_CODES;
+        } else if (type == 2) {
+          if (!readDynamicCodes(inflater)) {
+            return -1;
+          }
+          inflater->phase = PHASE_CODES;
+        } else {
+          return fail(inflater, INFLATE_BAD_DATA);
+        }
+        break;
+      }
+
+      case PHASE_STORED: {
+        if (inflater->remaining == 0) {
+          inflater->phase = PHASE_BLOCK;
+          break;
+        }
+        uint32_t byte = getBits(inflater, 8);
+        if (failed(inflater)) {
+          return -1;
+        }
+        inflater->remaining--;
+        return emit(inflater, byte);
+      }
+
+      case PHASE_CODES: {
+        int symbol = decodeSymbol(inflater, &inflater->literals);
+        if (symbol < 256) {
+          return symbol < 0 ? -1 : emit(inflater, symbol);
+        }
+        if (symbol == 256) {
+          inflater->phase = PHASE_BLOCK;
+          break;
+        }
+
+        // A match: length symbol and extra bits, then distance symbol and
+        // extra bits
+        symbol -= 257;
+        if (symbol >= 29) {
+          return fail(inflater, INFLATE_BAD_DATA);
+        }
+        uint32_t length = LENGTH_BASE[symbol] + getBits(inflater, LENGTH_EXTRA[symbol]);
+        symbol = decodeSymbol(inflater, &inflater->distances);
+        if (symbol < 0) {
+          return -1;
+        }
+        if (symbol >= 30) {
+          return fail(inflater, INFLATE_BAD_DATA);
+        }
+        uint32_t distance = DISTANCE_BASE[symbol] + getBits(inflater, DISTANCE_EXTRA[symbol]);
+        if (failed(inflater)) {
+          return -1;
+        }
+        if (distance > inflater->produced) {
+          return fail(inflater, INFLATE_BAD_DATA);  // Before the start of the stream
+        }
+        if (distance > INFLATE_WINDOW_SIZE) {
+          return fail(inflater, INFLATE_FAR_DISTANCE);
+        }
+        inflater->remaining = length;
+        inflater->distance = distance;
+        inflater->phase = PHASE_COPY;
+        break;
+      }
+
+      case PHASE_COPY:
+        if (inflater->remaining == 0) {
+          inflater->phase = PHASE_CODES;
+          break;
+        }
+        inflater->remaining--;
+        return emit(inflater, inflater->window[(inflater->produced - inflater->distance) & (INFLATE_WINDOW_SIZE - 1)]);
+
+      default:
+        return -1;  // PHASE_DONE or PHASE_FAILED
+    }
+  }
+}
+
+bool inflateFinish(Inflater* inflater) {
+  while (inflateRead(inflater) >= 0) {}
+  return inflater->phase == PHASE_DONE;
+}
+
+const char* inflateErrorName(InflateError error) {
+  switch (error) {
+    case INFLATE_OK:           return "ok";
+    case INFLATE_TRUNCATED:    return "truncated";
+    case INFLATE_BAD_HEADER:   return "bad header";
+    case INFLATE_BAD_DATA:     return "bad data";
+    case INFLATE_FAR_DISTANCE: return "window too small";
+    case INFLATE_TOO_LONG:     return "too long";
+    case INFLATE_BAD_CHECKSUM: return "bad checksum";
+  }
+  return "unknown";
+}
@@ -0,0 +1,118 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Streaming Inflate
+//----------------------------------------------------------------------------//
+
+/*
+ * Decodes gzip (RFC 1952), zlib (RFC 1950, HTTP's "deflate") and raw
+ * DEFLATE (RFC 1951) one output byte at a time, pulling compressed bytes
+ * from an InflateSource as it needs them:
+ *
+ *   socket --> InflateSource --> Inflater --> JSON parser
+ *                                  |
+ *                           1 KB history window
+ *
+ * Nothing is buffered whole: the only memory is the Inflater itself (the
+ * window and two Huffman tables, under 2 KB), so a compressed body can be
+ * parsed as it arrives and needn't fit any buffer, compressed or not.
+ *
+ * The price of the small window is that back-references can only reach
+ * INFLATE_WINDOW_SIZE bytes back, so the sender must compress with a window
+ * no larger (zlib windowBits 10; the web server does). A stream that
+ * reaches further is rejected as INFLATE_FAR_DISTANCE rather than decoded
+ * wrongly. The gzip CRC-32 or zlib Adler-32 is checked at the end, so a
+ * body damaged in transit is never accepted.
+ *
+ * Pure code over the InflateSource interface: the firmware reads the HTTP
+ * body, host tools read memory.
+ */
+
+const size_t INFLATE_WINDOW_SIZE = 1024;   // Power of two; zlib windowBits 10
+
+enum InflateFormat {
+  INFLATE_RAW,                 // Bare DEFLATE blocks
+  INFLATE_ZLIB,                // Content-Encoding: deflate
+  INFLATE_GZIP                 // Content-Encoding: gzip
+};
+
+enum InflateError {
+  INFLATE_OK,
+  INFLATE_TRUNCATED,           // Input ended (or timed out) mid-stream
+  INFLATE_BAD_HEADER,          // Not a gzip/zlib stream we can decode
+  INFLATE_BAD_DATA,            // Invalid block type, code or length
+  INFLATE_FAR_DISTANCE,        // Stream needs a window larger than ours
+  INFLATE_TOO_LONG,            // Output passed the limit given to inflateBegin()
+  INFLATE_BAD_CHECKSUM         // Trailer CRC/Adler/length mismatch
+};
+
+/*
+ * Where compressed bytes come from, as JournalRegion for the journal
+ */
+class InflateSource {
+public:
+  virtual ~InflateSource() {}
+  virtual int read() = 0;      // Next byte, or -1 at the end of input or on error
+};
+
+// Canonical Huffman code: how many codes of each length, then the symbols
+// in code order (enough to decode without a lookup table)
+struct InflateHuffman {
+  uint16_t counts[16];
+  uint16_t symbols[288];
+};
+
+struct Inflater {
+  InflateSource* source;
+  InflateFormat format;
+  uint8_t phase;               // Where decoding resumes (Inflate.cpp)
+  InflateError error;
+  bool lastBlock;              // The current block is the final one
+  uint32_t bits;               // Input bits not yet used, LSB first
+  uint8_t bitCount;
+  uint32_t remaining;          // Bytes left in a stored block or a match
+  uint32_t distance;           // Distance of the match being copied
+  uint32_t produced;           // Output bytes so far
+  uint32_t consumed;           // Input bytes so far
+  uint32_t maxOutput;          // Output limit, 0 = none
+  uint32_t check;              // Running CRC-32 (gzip) or Adler-32 (zlib)
+  uint8_t window[INFLATE_WINDOW_SIZE];
+  InflateHuffman literals;     // Literal/length code of the current block
+  InflateHuffman distances;    // Distance code of the current block
+};
+
+/**
+ * Start decoding a stream
+ * @param inflater Decoder state to initialize
+ * @param source Compressed input (kept for later calls)
+ * @param format Stream wrapper
+ * @param maxOutput Fail with INFLATE_TOO_LONG past this many output bytes (0 = no limit)
+ */
+void inflateBegin(Inflater* inflater, InflateSource* source, InflateFormat format, uint32_t maxOutput);
+
+/**
+ * Decode the next output byte
+ * @param inflater Decoder
+ * @return Byte value, or -1 at the end of the stream or on an error (see inflater->error)
+ */
+int inflateRead(Inflater* inflater);
+
+/**
+ * Decode whatever output is left, unread, and check the trailer
+ * @param inflater Decoder
+ * @return true if the stream ended cleanly and its checksum matched
+ */
+bool inflateFinish(Inflater* inflater);
+
+/**
+ * Human-readable error
+ * @param error Decoder error
+ * @return Error name
+ */
+const char* inflateErrorName(InflateError error);
+
+#endif // INFLATE_H
@@ -1,13 +1,45 @@
 #include "IrrigationController.h"
 #include "WiFiCredentials.h"
+#include "WiFiConnection.h"
+#include "SerialInput.h"
+#include "SerialLink.h"
+#include "HttpSession.h"
+#include "HeapAudit.h"
+#include "OutputEngine.h"
+#include "Inflate.h"
 #include <WiFi.h>
 #include <ArduinoHttpClient.h>
-#include <ArduinoJson.h>
 
-// External HTTP client and server config from main file
+// External HTTP client from main file
 extern HttpClient g_httpClient;
-extern const char* server_hostname;
-extern const int server_port;
+
+//----------------------------------------------------------------------------//
+// Static I/O Buffers
+//----------------------------------------------------------------------------//
+
+// Polls run entirely out of these, and parses out of ScheduleJson's arena;
+// nothing on the poll path touches the heap (see HeapAudit.h). Sizes leave
+// generous headroom over today's ~45-byte schedule body. A response that
+// doesn't fit is rejected.
+static const size_t HTTP_REQUEST_PATH_CAPACITY = 32;  // "/?since=" + a 32-bit number
+static const size_t HTTP_HEADER_LINE_CAPACITY = 128;  // Longer header lines are truncated
+static const size_t HTTP_BODY_CAPACITY = 1024;
+
+static char g_requestPath[HTTP_REQUEST_PATH_CAPACITY];
+static char g_headerLine[HTTP_HEADER_LINE_CAPACITY];
+static char g_responseBody[HTTP_BODY_CAPACITY];
+
+// A compressed body never lands in g_responseBody: it's parsed as it
+// decodes, so only the decoder's window bounds it. The output limit stops a
+// decompression bomb long before the parse arena would.
+static const uint32_t HTTP_INFLATE_LIMIT = 8192;
+
+static Inflater g_inflater;
+
+// Compressed bodies decoded since boot, for the running ratio
+static unsigned long g_inflatedBodies = 0;
+static uint64_t g_inflatedWireBytes = 0;
+static uint64_t g_inflatedBytes = 0;
 
 
 //----------------------------------------------------------------------------//
@@ -18,24 +50,23 @@ void updateLEDs(AppMode mode) {
   switch (mode) {
     case MODE_CONNECTED:
       // Solid on when connected
-      digitalWrite(wifi_led_pin, HIGH);
+      outputSetWifiLed(LED_ON);
       break;
     case MODE_CONNECTING:
-      // Blink at 2Hz during connection attempt
-      digitalWrite(wifi_led_pin, (millis() / 250) % 2);  // Toggle every 250ms
+      // Blink at 2Hz during connection attempt (timed by the PWM channel)
+      outputSetWifiLed(LED_BLINK_2HZ);
       break;
     default:
       // Off for all other modes (disconnected, initializing, entering credentials)
-      digitalWrite(wifi_led_pin, LOW);
+      outputSetWifiLed(LED_OFF);
       break;
   }
 }
 
-void updateZoneLEDs(const IrrigationSchedule& schedule) {
-  // Update each zone LED based on the schedule
-  digitalWrite(zone1_led_pin, schedule.zone1 ? HIGH : LOW);
-  digitalWrite(zone2_led_pin, schedule.zone2 ? HIGH : LOW);
-  digitalWrite(zone3_led_pin, schedule.zone3 ? HIGH : LOW);
+void updateZoneLEDs(const IrrigationSchedule& schedule, const uint64_t* closeBy) {
+  // Drive each zone from the schedule; the engine closes any zone whose
+  // deadline passes before the next call
+  outputSetZones(schedule.zoneMask(), closeBy);
 }
 
 //----------------------------------------------------------------------------//
@@ -70,7 +101,7 @@ void renderUI(AppMode mode) {
 void printCurrentNet() {
   // Display network name
   Serial.print("SSID: ");
-  Serial.println(WiFi.SSID());
+  Serial.println(wifiNetworkName());
 
   // Display router's MAC address (BSSID = Basic Service Set Identifier)
   byte bssid[6];
@@ -84,7 +115,7 @@ void printCurrentNet() {
   Serial.println(rssi);
 
   // Display security protocol (WEP, WPA, WPA2, etc.)
-  byte encryption = WiFi.encryptionType();
+  byte encryption = wifiNetworkSecurity();  // nsapi_security_t
   Serial.print("Encryption Type:");
   Serial.println(encryption, HEX);  // Print as hexadecimal
   
@@ -110,10 +141,10 @@ void printMacAddress(byte mac[]) {
 }
 
 char readSingleChar() {
-  if (!Serial.available()) return '\0';  // No input available
-  char input = Serial.read();            // Read first byte
-  flushSerialInput();                    // Discard remaining input
-  return input;                          // Return the character
+  int input = serialConsoleRead();       // Console text only; frames go to the serial link
+  if (input < 0) return '\0';            // No input available
+  flushSerialInput();                    // Discard the rest of the line
+  return (char)input;                    // Return the character
 }
 
 //----------------------------------------------------------------------------//
@@ -136,6 +167,35 @@ void observeDisconnectedState(const AppState& oldState, const AppState& newState
   }
 }
 
+void observeCredentialEntry(const AppState& oldState, const AppState& newState) {
+  // Start a fresh line-editor session whenever we enter credential entry mode
+  if (oldState.mode != MODE_ENTERING_CREDENTIALS && newState.mode == MODE_ENTERING_CREDENTIALS) {
+    beginCredentialEntry();
+  }
+}
+
+void observeScheduleFailSafe(const AppState& oldState, const AppState& newState) {
+  // Trigger when the stale-schedule fail-safe closes the zones
+  if (!oldState.failSafeActive && newState.failSafeActive) {
+    Serial.println("⚠ Schedule stale - all zones closed until the server responds");
+  }
+}
+
+void observeMoistureSkips(const AppState& oldState, const AppState& newState) {
+  // Trigger when a zone the schedule wants turns wet (skipped or cut short)
+  uint8_t requested = newState.schedule.zoneMask();
+  uint8_t newlyWet = newState.moisture.wetMask & ~oldState.moisture.wetMask & requested;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (newlyWet & (1 << i)) {
+      Serial.print("💧 Zone ");
+      Serial.print(i + 1);
+      Serial.print(" soil is wet (");
+      Serial.print(newState.moisture.permille[i]);
+      Serial.println("‰) - skipping until it dries");
+    }
+  }
+}
+
 void observeCredentialChanges(const AppState& oldState, const AppState& newState) {
   // Trigger when credentialsChanged flag is set (before persistence)
   if (!oldState.credentialsChanged && newState.credentialsChanged) {
@@ -164,10 +224,108 @@ const char* getModeString(AppMode mode) {
 // HTTP Communication Functions
 //----------------------------------------------------------------------------//
 
-Input pollIrrigationSchedule() {
+// Content-Encoding of a response body
+enum BodyEncoding {
+  BODY_IDENTITY,
+  BODY_GZIP,
+  BODY_DEFLATE,
+  BODY_UNSUPPORTED           // Never offered; the body can't be read
+};
+
+static BodyEncoding parseBodyEncoding(const char* value) {
+  if (strcasecmp(value, "identity") == 0) return BODY_IDENTITY;
+  if (strcasecmp(value, "gzip") == 0 || strcasecmp(value, "x-gzip") == 0) return BODY_GZIP;
+  if (strcasecmp(value, "deflate") == 0) return BODY_DEFLATE;
+  return BODY_UNSUPPORTED;
+}
+
+// The compressed body straight off the socket, same timeout as
+// readResponseBody(). Time spent waiting for bytes is tallied so decode
+// cost can be told apart from a slow link.
+class HttpBodySource : public InflateSource {
+public:
+  HttpBodySource() : waitMicros(0), start(millis()) {}
+
+  int read() override {
+    while (!g_httpClient.endOfBodyReached()) {
+      if (g_httpClient.available()) {
+        return g_httpClient.read();
+      }
+      if (!g_httpClient.connected() || httpSessionWaitOver(start)) {
+        return -1;
+      }
+      unsigned long waited = micros();
+      delay(1);
+      waitMicros += micros() - waited;
+    }
+    return -1;
+  }
+
+  unsigned long waitMicros;
+
+private:
+  unsigned long start;
+};
+
+static void printSessionStats() {
+  const HttpSessionStats& session = httpSessionStats();
+  Serial.print("Keep-alive: ");
+  Serial.print(session.keepAliveHits);
+  Serial.print(" hits, ");
+  Serial.print(session.keepAliveMisses);
+  Serial.print(" misses, ");
+  Serial.print(session.staleRetries);
+  Serial.println(" stale retries");
+}
+
+// Parse a compressed 200 body as it arrives, then report what the
+// compression saved and what decoding it cost
+static Input readCompressedSchedule(BodyEncoding encoding, unsigned long pollHintMs, bool keepOpen) {
+  HttpBodySource body;
+  inflateBegin(&g_inflater, &body, encoding == BODY_GZIP ? INFLATE_GZIP : INFLATE_ZLIB, HTTP_INFLATE_LIMIT);
+  unsigned long started = micros();
+  SchedulePatch patch;
+  bool parsed = parseScheduleJson(&g_inflater, &patch);
+  bool intact = parsed && inflateFinish(&g_inflater);  // Checks the CRC/Adler trailer
+  unsigned long decodeMicros = micros() - started - body.waitMicros;
+  httpSessionEnd(keepOpen && intact && g_httpClient.endOfBodyReached());
+  printSessionStats();
+
+  Serial.print("HTTP Status: 200, ");
+  Serial.print(encoding == BODY_GZIP ? "gzip " : "deflate ");
+  Serial.print(g_inflater.consumed);
+  Serial.print(" -> ");
+  Serial.print(g_inflater.produced);
+  Serial.print(" bytes");
+  if (!intact) {
+    Serial.print(", failed: ");
+    Serial.println(g_inflater.error == INFLATE_OK ? "bad JSON" : inflateErrorName(g_inflater.error));
+    return Input::httpError(0, 200);
+  }
+
+  g_inflatedBodies++;
+  g_inflatedWireBytes += g_inflater.consumed;
+  g_inflatedBytes += g_inflater.produced;
+  Serial.print(" (");
+  Serial.print((float)g_inflater.produced / g_inflater.consumed, 2);
+  Serial.print("x), decoded in ");
+  Serial.print(decodeMicros);
+  Serial.print(" us; ");
+  Serial.print(g_inflatedBodies);
+  Serial.print(" bodies at ");
+  Serial.print((float)g_inflatedBytes / g_inflatedWireBytes, 2);
+  Serial.println("x");
+
+  Serial.println("Schedule received successfully");
+  heapAuditSteadyState();
+  return Input::schedulePatch(patch, pollHintMs);
+}
+
+Input pollIrrigationSchedule(uint32_t scheduleSeq) {
   // Only poll if WiFi is connected
-  if (WiFi.status() != WL_CONNECTED) {
+  if (wifiLinkStatus() != WL_CONNECTED) {
     Serial.println("Cannot poll: WiFi not connected");
+    httpSessionClose();  // The socket didn't survive the link
     return Input::httpError();
   }
 
@@ -176,56 +334,175 @@ Input pollIrrigationSchedule() {
   Serial.print(":");
   Serial.println(server_port);
   
-  // Make HTTP GET request
-  g_httpClient.get("/");
+  // Ask for changes since the version we hold (0 asks for a snapshot)
+  snprintf(g_requestPath, sizeof(g_requestPath), "/?since=%lu", (unsigned long)scheduleSeq);
   
-  // Wait for response
-  int statusCode = g_httpClient.responseStatusCode();
-  String response = g_httpClient.responseBody();
+  // Make HTTP GET request on the persistent connection and wait for response
+  int statusCode = httpSessionGet(g_requestPath);
+  if (statusCode < 0) {
+    Serial.print("HTTP request failed: ");
+    Serial.println(statusCode);
+    return Input::httpError(0, statusCode);
+  }
+  
+  // Scan headers for a poll interval hint before reading the body
+  unsigned long pollHintMs = 0;
+  bool keepOpen = true;
+  BodyEncoding encoding = BODY_IDENTITY;
+  while (readHeaderLine(g_headerLine, sizeof(g_headerLine))) {
+    char* value = strchr(g_headerLine, ':');
+    if (value == nullptr) {
+      continue;  // Not a header (or truncated past the colon)
+    }
+    *value++ = '\0';
+    while (*value == ' ') value++;
+    unsigned long hint = parsePollHint(g_headerLine, value);
+    if (hint > 0) {
+      pollHintMs = hint;
+    }
+    if (strcasecmp(g_headerLine, "Connection") == 0 && strcasecmp(value, "close") == 0) {
+      keepOpen = false;  // Server won't take another request on this socket
+    }
+    if (strcasecmp(g_headerLine, "Content-Encoding") == 0) {
+      encoding = parseBodyEncoding(value);
+    }
+  }
+  
+  // A 304 has no body, with or without a Content-Length header
+  bool noBody = statusCode == 304;
+  if (encoding != BODY_IDENTITY && !noBody) {
+    if (statusCode == 200 && encoding != BODY_UNSUPPORTED) {
+      return readCompressedSchedule(encoding, pollHintMs, keepOpen);
+    }
+    // An error page we'd only print: not worth decoding, so leave it unread
+    httpSessionEnd(false);
+    Serial.print("HTTP Status: ");
+    Serial.print(statusCode);
+    Serial.println(", compressed body skipped");
+    return Input::httpError(pollHintMs, statusCode);
+  }
+  int length = 0;
+  g_responseBody[0] = '\0';
+  if (!noBody) {
+    length = readResponseBody(g_responseBody, sizeof(g_responseBody));
+  }
+  httpSessionEnd(keepOpen && length >= 0 && (noBody || g_httpClient.endOfBodyReached()));
+  if (length < 0) {
+    Serial.println("HTTP response body too large or timed out");
+    return Input::httpError(pollHintMs, statusCode);
+  }
+  
+  printSessionStats();
   
   Serial.print("HTTP Status: ");
   Serial.print(statusCode);
   Serial.print(", Response: ");
-  Serial.println(response);
+  Serial.println(g_responseBody);
+  
+  if (statusCode == 304) {
+    // Not Modified: our version is current - confirm it with an empty delta
+    SchedulePatch unchanged;
+    unchanged.seq = scheduleSeq;
+    unchanged.baseSeq = scheduleSeq;
+    heapAuditSteadyState();
+    return Input::schedulePatch(unchanged, pollHintMs);
+  }
   
   if (statusCode != 200) {
     Serial.println("HTTP request failed");
-    return Input::httpError();
+    return Input::httpError(pollHintMs, statusCode);  // 503 + Retry-After lands here
   }
   
   // Parse JSON response
-  IrrigationSchedule schedule;
-  if (!parseScheduleJson(response, &schedule)) {
+  SchedulePatch patch;
+  if (!parseScheduleJson(g_responseBody, length, &patch)) {
     Serial.println("Failed to parse JSON response");
-    return Input::httpError();
+    return Input::httpError(0, statusCode);
   }
   
   Serial.println("Schedule received successfully");
-  return Input::scheduleReceived(schedule);
+  heapAuditSteadyState();  // Everything lazily set up has been set up by now
+  return Input::schedulePatch(patch, pollHintMs);
 }
 
-bool parseScheduleJson(const String& json, IrrigationSchedule* schedule) {
-  // Create JSON document for parsing
-  JsonDocument doc;
-  
-  // Parse JSON
-  DeserializationError error = deserializeJson(doc, json);
-  if (error) {
-    Serial.print("JSON parsing failed: ");
-    Serial.println(error.c_str());
-    return false;
+bool readHeaderLine(char* line, size_t capacity) {
+  size_t length = 0;
+  unsigned long start = millis();
+  while (!g_httpClient.endOfHeadersReached()) {
+    if (!g_httpClient.available()) {
+      if (!g_httpClient.connected() || httpSessionWaitOver(start)) {
+        return false;  // Headers cut short; the body read will fail too
+      }
+      delay(1);
+      continue;
+    }
+    int c = g_httpClient.readHeader();
+    if (c == '\n') {
+      if (length == 0) continue;  // The blank line that ends the headers
+      line[length] = '\0';
+      return true;
+    }
+    if (c != '\r' && length < capacity - 1) {
+      line[length++] = (char)c;
+    }
+  }
+  return false;
+}
+
+int readResponseBody(char* buffer, size_t capacity) {
+  size_t length = 0;
+  unsigned long start = millis();
+  while (!g_httpClient.endOfBodyReached()) {
+    if (!g_httpClient.available()) {
+      if (!g_httpClient.connected()) {
+        break;  // No Content-Length: the body ends when the server closes
+      }
+      if (httpSessionWaitOver(start)) {
+        return -1;
+      }
+      delay(1);
+      continue;
+    }
+    if (length == capacity - 1) {
+      return -1;  // Doesn't fit - the connection is dropped with the rest
+    }
+    int n = g_httpClient.read((uint8_t*)buffer + length, capacity - 1 - length);
+    if (n > 0) {
+      length += n;
+    }
+  }
+  buffer[length] = '\0';
+  return (int)length;
+}
+
+// Seconds as ms, capped at the longest poll interval before multiplying:
+// unsigned long is 32 bits here, so 4294968 s would otherwise come out as 704 ms
+static unsigned long hintSecondsToMs(const char* digits) {
+  unsigned long seconds = strtoul(digits, nullptr, 10);
+  const unsigned long maxSeconds = poll_interval_max_ms / 1000UL;
+  return (seconds < maxSeconds ? seconds : maxSeconds) * 1000UL;
+}
+
+unsigned long parsePollHint(const char* name, const char* value) {
+  if (strcasecmp(name, "Retry-After") == 0) {
+    // Only the delay-seconds form; an HTTP-date needs a wall clock
+    if (isdigit((unsigned char)value[0])) {
+      return hintSecondsToMs(value);
+    }
+    return 0;
   }
   
-  // Extract zone states
-  schedule->zone1 = doc["zone1"] | false;  // Default to false if key missing
-  schedule->zone2 = doc["zone2"] | false;
-  schedule->zone3 = doc["zone3"] | false;
-  schedule->lastUpdate = millis();
-  
-  Serial.print("Zone schedule: ");
-  Serial.print(schedule->zone1 ? "1" : "0");
-  Serial.print(schedule->zone2 ? "1" : "0");
-  Serial.println(schedule->zone3 ? "1" : "0");
+  if (strcasecmp(name, "Cache-Control") == 0) {
+    // Find max-age=N among comma-separated directives
+    const char* p = value;
+    while ((p = strstr(p, "max-age")) != nullptr) {
+      p += 7;
+      while (*p == ' ') p++;
+      if (*p == '=') {
+        return hintSecondsToMs(p + 1);
+      }
+    }
+  }
   
-  return true;
-}
\ No newline at end of file
+  return 0;
+}
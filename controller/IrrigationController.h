@@ -2,6 +2,7 @@
 #define IRRIGATION_CONTROLLER_H
 
 #include "Types.h"
+#include "ScheduleJson.h"
 
 //----------------------------------------------------------------------------//
 // User Interface and Display
@@ -9,6 +10,7 @@
 
 /**
  * Update LED indicators based on current application mode
+ * Hands a pattern to the output engine; cheap to call when nothing changed.
  * @param mode Current application mode
  */
 void updateLEDs(AppMode mode);
@@ -16,8 +18,10 @@ void updateLEDs(AppMode mode);
 /**
  * Update zone LEDs based on irrigation schedule
  * @param schedule Current irrigation schedule
+ * @param closeBy Per zone, monotonic time by which the output engine closes
+ *                the zone on its own (0 = none); nullptr for no deadlines
  */
-void updateZoneLEDs(const IrrigationSchedule& schedule);
+void updateZoneLEDs(const IrrigationSchedule& schedule, const uint64_t* closeBy = nullptr);
 
 /**
  * Display appropriate UI messages based on current mode
@@ -49,18 +53,41 @@ char readSingleChar();
 //----------------------------------------------------------------------------//
 
 /**
- * Poll the HTTP endpoint for irrigation schedule
- * @return Input with new schedule or error
+ * Poll the HTTP endpoint for changes to the irrigation schedule
+ * Sends `GET /?since=<scheduleSeq>`; the server answers with a snapshot, a
+ * delta, or 304 Not Modified (see SchedulePatch in Types.h).
+ * @param scheduleSeq Sequence number of the schedule we hold (0 = none)
+ * @return INPUT_SCHEDULE_PATCH, or INPUT_HTTP_ERROR
  */
-Input pollIrrigationSchedule();
+Input pollIrrigationSchedule(uint32_t scheduleSeq);
 
 /**
- * Parse JSON response into IrrigationSchedule
- * @param json JSON string to parse
- * @param schedule Output schedule structure
- * @return true if parsing successful, false otherwise
+ * Extract a poll interval hint from a response header
+ * Understands Cache-Control: max-age=N and Retry-After: N (seconds)
+ * @param name Header name (case-insensitive)
+ * @param value Header value
+ * @return Hint in milliseconds (at most poll_interval_max_ms), or 0 if the
+ *         header carries none
  */
-bool parseScheduleJson(const String& json, IrrigationSchedule* schedule);
+unsigned long parsePollHint(const char* name, const char* value);
+
+/**
+ * Read one response header line into a fixed buffer (no String involved)
+ * Call after the status code has been read; lines longer than the buffer
+ * are truncated.
+ * @param line Output buffer, NUL-terminated
+ * @param capacity Size of `line`
+ * @return true if a header line was read, false at the end of the headers
+ */
+bool readHeaderLine(char* line, size_t capacity);
+
+/**
+ * Read the response body into a fixed buffer (no String involved)
+ * @param buffer Output buffer, NUL-terminated
+ * @param capacity Size of `buffer`
+ * @return Body length, or -1 if it didn't fit or timed out
+ */
+int readResponseBody(char* buffer, size_t capacity);
 
 //----------------------------------------------------------------------------//
 // State Observers (Reactive UI Updates)
@@ -80,6 +107,27 @@ void observeConnectedState(const AppState& oldState, const AppState& newState);
  */
 void observeDisconnectedState(const AppState& oldState, const AppState& newState);
 
+/**
+ * Observer: Start the serial credential prompt on entering credential mode
+ * @param oldState Previous state
+ * @param newState Current state
+ */
+void observeCredentialEntry(const AppState& oldState, const AppState& newState);
+
+/**
+ * Observer: Report when the stale-schedule fail-safe closes the zones
+ * @param oldState Previous state
+ * @param newState Current state
+ */
+void observeScheduleFailSafe(const AppState& oldState, const AppState& newState);
+
+/**
+ * Observer: Report requested zones skipped because their soil is wet
+ * @param oldState Previous state
+ * @param newState Current state
+ */
+void observeMoistureSkips(const AppState& oldState, const AppState& newState);
+
 /**
  * Observer: React to credential changes
  * @param oldState Previous state
@@ -0,0 +1,423 @@
+#include "LanHttp.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Room kept ahead of the body for the status line and headers, which can't be
+// formatted until the body length is known
+static const size_t LAN_HEADER_RESERVE = 192;
+
+// Longest `minutes` value accepted (about 69 days, far past any sane max)
+static const unsigned long LAN_MAX_MINUTES = 99999;
+
+//----------------------------------------------------------------------------//
+// Request Framing
+//----------------------------------------------------------------------------//
+
+static bool headersEnded(const LanRequest* request) {
+  size_t n = request->length;
+  if (n < 2 || request->text[n - 1] != '\n') {
+    return false;
+  }
+  // "\r\n\r\n" from well-behaved clients, bare "\n\n" from hand-typed ones
+  return request->text[n - 2] == '\n' ||
+         (n >= 3 && request->text[n - 2] == '\r' && request->text[n - 3] == '\n');
+}
+
+void lanRequestReset(LanRequest* request) {
+  request->length = 0;
+  request->text[0] = '\0';
+}
+
+LanFraming lanRequestAppend(LanRequest* request, const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (headersEnded(request)) {
+      return LAN_FRAMING_COMPLETE;  // The rest is body, which we don't read
+    }
+    if (request->length >= LAN_REQUEST_CAPACITY - 1) {
+      return LAN_FRAMING_TOO_LARGE;
+    }
+    request->text[request->length++] = (char)data[i];
+  }
+  request->text[request->length] = '\0';
+  return headersEnded(request) ? LAN_FRAMING_COMPLETE : LAN_FRAMING_INCOMPLETE;
+}
+
+//----------------------------------------------------------------------------//
+// Response Formatting
+//----------------------------------------------------------------------------//
+
+struct BodyWriter {
+  char* at;
+  size_t left;
+  bool overflowed;
+};
+
+static void put(BodyWriter* out, const char* format, ...) {
+  if (out->overflowed) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(out->at, out->left, format, args);
+  va_end(args);
+  if (n < 0 || (size_t)n >= out->left) {
+    out->overflowed = true;
+    return;
+  }
+  out->at += n;
+  out->left -= n;
+}
+
+static const char* reasonPhrase(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Internal Server Error";
+  }
+}
+
+static void respondError(LanResponse* response, int status, const char* extraHeader);
+
+static BodyWriter beginBody(LanResponse* response) {
+  BodyWriter out;
+  out.at = response->text + LAN_HEADER_RESERVE;
+  out.left = LAN_RESPONSE_CAPACITY - LAN_HEADER_RESERVE;
+  out.overflowed = false;
+  return out;
+}
+
+/**
+ * Put the status line and headers in front of a body written by beginBody()
+ * @param extraHeader Additional header line(s) ending in "\r\n", or ""
+ */
+static void finishResponse(LanResponse* response, int status, const char* extraHeader,
+                           const BodyWriter& body) {
+  if (body.overflowed) {
+    respondError(response, 500, "");
+    return;
+  }
+  const char* bodyStart = response->text + LAN_HEADER_RESERVE;
+  size_t bodyLength = body.at - bodyStart;
+
+  char header[LAN_HEADER_RESERVE];
+  int n = snprintf(header, sizeof(header),
+                   "HTTP/1.1 %d %s\r\n"
+                   "Content-Type: application/json\r\n"
+                   "Content-Length: %u\r\n"
+                   "Cache-Control: no-store\r\n"
+                   "Connection: close\r\n"
+                   "%s\r\n",
+                   status, reasonPhrase(status), (unsigned)bodyLength, extraHeader);
+  if (n < 0 || (size_t)n >= sizeof(header)) {
+    n = 0;  // Can't happen with our own headers; send the body rather than garbage
+  }
+  memcpy(response->text, header, n);
+  memmove(response->text + n, bodyStart, bodyLength);
+  response->length = n + bodyLength;
+  response->status = status;
+}
+
+static void respondError(LanResponse* response, int status, const char* extraHeader) {
+  // A fixed one-liner: can't overflow, so finishResponse() never recurses here twice
+  BodyWriter body = beginBody(response);
+  put(&body, "{\"error\":\"%s\"}\n", reasonPhrase(status));
+  finishResponse(response, status, extraHeader, body);
+}
+
+void lanErrorResponse(int status, LanResponse* response) {
+  respondError(response, status, "");
+}
+
+//----------------------------------------------------------------------------//
+// Request Parsing
+//----------------------------------------------------------------------------//
+
+struct RequestLine {
+  const char* method;
+  size_t methodLength;
+  const char* path;
+  size_t pathLength;
+  const char* query;              // After '?', or NULL
+  size_t queryLength;
+  const char* headers;            // First header line
+};
+
+static bool parseRequestLine(const char* text, RequestLine* line) {
+  const char* space = strchr(text, ' ');
+  if (space == NULL || space == text) {
+    return false;
+  }
+  line->method = text;
+  line->methodLength = space - text;
+
+  const char* target = space + 1;
+  const char* targetEnd = strchr(target, ' ');
+  if (targetEnd == NULL || *target != '/' || strncmp(targetEnd + 1, "HTTP/1.", 7) != 0 ||
+      memchr(text, '\n', targetEnd - text) != NULL) {
+    return false;  // Not "METHOD /target HTTP/1.x" on the first line
+  }
+  const char* question = (const char*)memchr(target, '?', targetEnd - target);
+  line->path = target;
+  line->pathLength = (question ? question : targetEnd) - target;
+  line->query = question ? question + 1 : NULL;
+  line->queryLength = question ? targetEnd - (question + 1) : 0;
+
+  const char* eol = strchr(targetEnd, '\n');
+  if (eol == NULL) {
+    return false;
+  }
+  line->headers = eol + 1;
+  return true;
+}
+
+static bool spanIs(const char* span, size_t length, const char* literal) {
+  return strlen(literal) == length && memcmp(span, literal, length) == 0;
+}
+
+static bool startsWithNoCase(const char* text, const char* prefix) {
+  for (; *prefix; text++, prefix++) {
+    char c = *text;
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    if (c != *prefix) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Check "Authorization: Bearer <lan_http_token>" among the headers
+ * The comparison takes the same time wherever the first wrong byte is.
+ */
+static bool authorized(const char* headers) {
+  for (const char* line = headers; *line && *line != '\r' && *line != '\n';) {
+    const char* eol = strchr(line, '\n');
+    if (eol == NULL) {
+      break;
+    }
+    if (startsWithNoCase(line, "authorization:")) {
+      const char* value = line + strlen("authorization:");
+      while (*value == ' ' || *value == '\t') {
+        value++;
+      }
+      if (!startsWithNoCase(value, "bearer ")) {
+        return false;
+      }
+      value += strlen("bearer ");
+      const char* end = eol;
+      while (end > value && (end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+      }
+      size_t tokenLength = strlen(lan_http_token);
+      if ((size_t)(end - value) != tokenLength) {
+        return false;
+      }
+      uint8_t diff = 0;
+      for (size_t i = 0; i < tokenLength; i++) {
+        diff |= (uint8_t)(value[i] ^ lan_http_token[i]);
+      }
+      return diff == 0;
+    }
+    line = eol + 1;
+  }
+  return false;
+}
+
+/**
+ * Parse a decimal number filling exactly [text, text + length)
+ * @return false if empty, not all digits, or over `max`
+ */
+static bool parseNumber(const char* text, size_t length, unsigned long max, unsigned long* value) {
+  if (length == 0 || length > 5) {
+    return false;
+  }
+  unsigned long n = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] < '0' || text[i] > '9') {
+      return false;
+    }
+    n = n * 10 + (text[i] - '0');
+  }
+  if (n > max) {
+    return false;
+  }
+  *value = n;
+  return true;
+}
+
+/**
+ * Find `minutes=M` in a query string
+ * @return false if present but malformed (absent leaves durationMs alone)
+ */
+static bool parseMinutes(const char* query, size_t length, unsigned long* durationMs) {
+  const char* end = query + length;
+  for (const char* param = query; param < end;) {
+    const char* amp = (const char*)memchr(param, '&', end - param);
+    const char* paramEnd = amp ? amp : end;
+    if ((size_t)(paramEnd - param) >= 8 && memcmp(param, "minutes=", 8) == 0) {
+      unsigned long minutes;
+      if (!parseNumber(param + 8, paramEnd - param - 8, LAN_MAX_MINUTES, &minutes) || minutes == 0) {
+        return false;
+      }
+      *durationMs = minutes * 60000UL;
+    }
+    param = paramEnd + 1;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Routes
+//----------------------------------------------------------------------------//
+
+static const char* modeName(AppMode mode) {
+  switch (mode) {
+    case MODE_INITIALIZING: return "initializing";
+    case MODE_CONNECTING: return "connecting";
+    case MODE_CONNECTED: return "connected";
+    case MODE_DISCONNECTED: return "disconnected";
+    case MODE_ENTERING_CREDENTIALS: return "entering_credentials";
+    default: return "unknown";
+  }
+}
+
+static void respondStatus(LanControl* control, LanResponse* response) {
+  ControllerStatus status;
+  if (!control->readStatus(&status)) {
+    respondError(response, 503, "");  // Control side still booting
+    return;
+  }
+
+  BodyWriter body = beginBody(response);
+  put(&body, "{\"mode\":\"%s\",\"uptime_s\":%lu,", modeName(status.mode), (unsigned long)status.uptimeS);
+  if (status.hasSchedule) {
+    put(&body, "\"schedule\":{\"seq\":%lu,\"age_s\":%lu,",
+        (unsigned long)status.scheduleSeq, (unsigned long)status.scheduleAgeS);
+  } else {
+    put(&body, "\"schedule\":{\"seq\":null,\"age_s\":null,");
+  }
+  put(&body, "\"fail_safe\":%s,\"poll_failing\":%s},\"zones\":[",
+      status.failSafeActive ? "true" : "false", status.pollFailing ? "true" : "false");
+
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    uint8_t bit = 1 << i;
+    const char* held = !(status.overrideMask & bit) ? "null"
+                     : (status.overrideOpenMask & bit) ? "\"open\"" : "\"closed\"";
+    put(&body, "%s{\"zone\":%d,\"scheduled\":%s,\"wet\":%s,\"open\":%s,\"waiting\":%s,"
+               "\"override\":%s,\"override_left_s\":%lu,",
+        i ? "," : "", i + 1,
+        (status.scheduledMask & bit) ? "true" : "false",
+        (status.wetMask & bit) ? "true" : "false",
+        (status.openMask & bit) ? "true" : "false",
+        (status.waitingMask & bit) ? "true" : "false",
+        held, (unsigned long)status.overrideLeftS[i]);
+    if (status.moisturePermille[i] == MOISTURE_UNKNOWN) {
+      put(&body, "\"moisture_permille\":null}");
+    } else {
+      put(&body, "\"moisture_permille\":%u}", (unsigned)status.moisturePermille[i]);
+    }
+  }
+  put(&body, "]}\n");
+  finishResponse(response, 200, "", body);
+}
+
+/**
+ * POST /zones/{n}/{open|close|auto}
+ * @param rest Path after "/zones/"
+ */
+static void respondZone(const RequestLine& line, const char* rest, size_t restLength,
+                        LanControl* control, LanResponse* response) {
+  const char* slash = (const char*)memchr(rest, '/', restLength);
+  unsigned long zoneNumber;
+  if (slash == NULL || !parseNumber(rest, slash - rest, ZONE_COUNT, &zoneNumber) || zoneNumber == 0) {
+    respondError(response, 404, "");
+    return;
+  }
+  const char* verb = slash + 1;
+  size_t verbLength = rest + restLength - verb;
+  ZoneOverrideAction action;
+  if (spanIs(verb, verbLength, "open")) {
+    action = OVERRIDE_OPEN;
+  } else if (spanIs(verb, verbLength, "close")) {
+    action = OVERRIDE_CLOSE;
+  } else if (spanIs(verb, verbLength, "auto")) {
+    action = OVERRIDE_RELEASE;
+  } else {
+    respondError(response, 404, "");
+    return;
+  }
+
+  if (!spanIs(line.method, line.methodLength, "POST")) {
+    respondError(response, 405, "Allow: POST\r\n");
+    return;
+  }
+  if (lan_http_token[0] == '\0') {
+    respondError(response, 403, "");  // Overrides are off until a token is set
+    return;
+  }
+  if (!authorized(line.headers)) {
+    respondError(response, 401, "WWW-Authenticate: Bearer\r\n");
+    return;
+  }
+
+  unsigned long durationMs = lan_override_default_ms;
+  if (action != OVERRIDE_RELEASE && line.query && !parseMinutes(line.query, line.queryLength, &durationMs)) {
+    respondError(response, 400, "");
+    return;
+  }
+  if (durationMs > lan_override_max_ms) {
+    durationMs = lan_override_max_ms;  // The state machine caps it too; report what will happen
+  }
+
+  uint8_t zone = (uint8_t)(zoneNumber - 1);
+  if (!control->postOverride(zone, action, durationMs)) {
+    respondError(response, 503, "Retry-After: 1\r\n");  // Event mailbox full, control side behind
+    return;
+  }
+
+  BodyWriter body = beginBody(response);
+  if (action == OVERRIDE_RELEASE) {
+    put(&body, "{\"zone\":%lu,\"override\":null}\n", zoneNumber);
+  } else {
+    put(&body, "{\"zone\":%lu,\"override\":\"%s\",\"override_s\":%lu}\n", zoneNumber,
+        action == OVERRIDE_OPEN ? "open" : "closed", durationMs / 1000);
+  }
+  finishResponse(response, 202, "", body);
+}
+
+void lanHandleRequest(const LanRequest& request, LanControl* control, LanResponse* response) {
+  RequestLine line;
+  if (!parseRequestLine(request.text, &line)) {
+    respondError(response, 400, "");
+    return;
+  }
+
+  if (spanIs(line.path, line.pathLength, "/status")) {
+    if (!spanIs(line.method, line.methodLength, "GET")) {
+      respondError(response, 405, "Allow: GET\r\n");
+      return;
+    }
+    respondStatus(control, response);
+    return;
+  }
+
+  static const char ZONES_PREFIX[] = "/zones/";
+  const size_t prefixLength = sizeof(ZONES_PREFIX) - 1;
+  if (line.pathLength > prefixLength && memcmp(line.path, ZONES_PREFIX, prefixLength) == 0) {
+    respondZone(line, line.path + prefixLength, line.pathLength - prefixLength, control, response);
+    return;
+  }
+
+  respondError(response, 404, "");
+}
@@ -0,0 +1,105 @@
+#ifndef LAN_HTTP_H
+#define LAN_HTTP_H
+
+#include "NetworkMailbox.h"
+
+//----------------------------------------------------------------------------//
+// LAN Status and Override Protocol
+//----------------------------------------------------------------------------//
+
+/*
+ * A deliberately small HTTP/1.1 subset for technicians on the site network:
+ *
+ *   GET  /status                        Controller and zone status (JSON)
+ *   POST /zones/{n}/open[?minutes=M]    Hold zone n (1-based) open
+ *   POST /zones/{n}/close[?minutes=M]   Hold zone n closed
+ *   POST /zones/{n}/auto                Hand zone n back to the schedule
+ *
+ * Overrides last lan_override_default_ms unless `minutes` says otherwise, and
+ * never longer than lan_override_max_ms. POSTs need "Authorization: Bearer
+ * <lan_http_token>"; with no token set they're refused with 403, so a
+ * controller fresh out of the box only shows status. Request bodies are never read, every
+ * response closes the connection, and a request whose headers don't fit in
+ * LAN_REQUEST_CAPACITY is refused with 431 - so one connection never needs
+ * more than its fixed buffer.
+ *
+ * Pure code: the socket side is in LanServer.cpp, and the controller is
+ * reached only through LanControl.
+ */
+
+const size_t LAN_REQUEST_CAPACITY = 512;   // Request line and headers
+const size_t LAN_RESPONSE_CAPACITY = 1024; // Status line, headers and body
+
+struct LanRequest {
+  char text[LAN_REQUEST_CAPACITY];
+  size_t length;                  // Bytes buffered so far
+};
+
+enum LanFraming {
+  LAN_FRAMING_INCOMPLETE,         // Headers not finished yet, keep reading
+  LAN_FRAMING_COMPLETE,           // Blank line seen, ready to respond
+  LAN_FRAMING_TOO_LARGE           // Headers overflowed the buffer
+};
+
+struct LanResponse {
+  char text[LAN_RESPONSE_CAPACITY];
+  size_t length;                  // Bytes to send
+  int status;                     // HTTP status code, for logging
+};
+
+/*
+ * What a request may touch: the last published status, and the event
+ * mailbox for overrides (LanServer.cpp binds these to NetworkMailbox.h)
+ */
+class LanControl {
+public:
+  virtual ~LanControl() {}
+
+  /**
+   * @param status Output status
+   * @return false if the control side hasn't published one yet
+   */
+  virtual bool readStatus(ControllerStatus* status) = 0;
+
+  /**
+   * @param zone Zone index, 0-based
+   * @param action Hold open, hold closed or hand back
+   * @param durationMs How long to hold it (ignored for OVERRIDE_RELEASE)
+   * @return false if the override couldn't be queued
+   */
+  virtual bool postOverride(uint8_t zone, ZoneOverrideAction action, unsigned long durationMs) = 0;
+};
+
+/**
+ * Start a connection's request buffer afresh
+ * @param request Request buffer
+ */
+void lanRequestReset(LanRequest* request);
+
+/**
+ * Add received bytes to a request
+ * Bytes past the end of the headers are dropped (bodies aren't read).
+ * @param request Request buffer
+ * @param data Received bytes
+ * @param length Number of bytes
+ * @return Whether the headers are complete
+ */
+LanFraming lanRequestAppend(LanRequest* request, const uint8_t* data, size_t length);
+
+/**
+ * Route a complete request and format the response
+ * @param request Request whose framing is LAN_FRAMING_COMPLETE
+ * @param control Status source and override sink
+ * @param response Output response
+ */
+void lanHandleRequest(const LanRequest& request, LanControl* control, LanResponse* response);
+
+/**
+ * Format an error response with a one-line JSON body (e.g. 431 for an
+ * oversized request, or 503 when every connection slot is busy)
+ * @param status HTTP status code
+ * @param response Output response
+ */
+void lanErrorResponse(int status, LanResponse* response);
+
+#endif // LAN_HTTP_H
@@ -0,0 +1,143 @@
+#include "LanServer.h"
+#include "LanHttp.h"
+#include "NetworkMailbox.h"
+#include "WiFiConnection.h"
+#include <WiFi.h>
+
+// Largest single read from a socket; a request fits in a few of these
+static const size_t LAN_READ_CHUNK = 128;
+
+struct LanConnection {
+  bool active;
+  WiFiClient client;
+  LanRequest request;
+  unsigned long openedAt;         // millis() when accepted
+};
+
+static LanServerStats g_lanStats = {0, 0, 0, 0, 0};
+static WiFiServer* g_lanServer = NULL;
+static LanConnection g_lanConnections[LAN_HTTP_CONNECTIONS];
+static LanResponse g_lanResponse;  // Shared: each reply is sent before the next is built
+
+//----------------------------------------------------------------------------//
+// Controller Access
+//----------------------------------------------------------------------------//
+
+class MailboxLanControl : public LanControl {
+public:
+  bool readStatus(ControllerStatus* status) override {
+    return readControllerStatus(status);
+  }
+
+  bool postOverride(uint8_t zone, ZoneOverrideAction action, unsigned long durationMs) override {
+    if (!postZoneOverride(zone, action, durationMs)) {
+      return false;
+    }
+    g_lanStats.overrides++;
+    return true;
+  }
+};
+
+static MailboxLanControl g_lanControl;
+
+//----------------------------------------------------------------------------//
+// Connections
+//----------------------------------------------------------------------------//
+
+static void sendAndClose(WiFiClient& client, const LanResponse& response) {
+  client.write(reinterpret_cast<const uint8_t*>(response.text), response.length);
+  client.stop();
+  g_lanStats.served++;
+}
+
+static void acceptConnection() {
+  WiFiClient client = g_lanServer->available();
+  if (!client) {
+    return;
+  }
+  for (int i = 0; i < LAN_HTTP_CONNECTIONS; i++) {
+    LanConnection& connection = g_lanConnections[i];
+    if (!connection.active) {
+      connection.active = true;
+      connection.client = client;
+      connection.openedAt = millis();
+      lanRequestReset(&connection.request);
+      g_lanStats.accepted++;
+      return;
+    }
+  }
+  g_lanStats.refused++;
+  lanErrorResponse(503, &g_lanResponse);
+  sendAndClose(client, g_lanResponse);
+}
+
+static void serviceConnection(LanConnection& connection) {
+  if (!connection.client.connected() && connection.client.available() == 0) {
+    connection.client.stop();  // Client gave up before finishing its request
+    connection.active = false;
+    return;
+  }
+
+  LanFraming framing = LAN_FRAMING_INCOMPLETE;
+  int pending = connection.client.available();
+  while (pending > 0 && framing == LAN_FRAMING_INCOMPLETE) {
+    uint8_t chunk[LAN_READ_CHUNK];
+    int n = connection.client.read(chunk, pending < (int)sizeof(chunk) ? pending : sizeof(chunk));
+    if (n <= 0) {
+      break;
+    }
+    framing = lanRequestAppend(&connection.request, chunk, n);
+    pending -= n;
+  }
+
+  if (framing == LAN_FRAMING_COMPLETE) {
+    lanHandleRequest(connection.request, &g_lanControl, &g_lanResponse);
+  } else if (framing == LAN_FRAMING_TOO_LARGE) {
+    lanErrorResponse(431, &g_lanResponse);
+  } else if (millis() - connection.openedAt >= lan_http_idle_ms) {
+    g_lanStats.timedOut++;
+    lanErrorResponse(408, &g_lanResponse);
+  } else {
+    return;  // Keep waiting for the rest of the headers
+  }
+
+  Serial.print("LAN HTTP ");
+  Serial.print(g_lanResponse.status);
+  Serial.print(" for ");
+  Serial.println(connection.client.remoteIP());
+  sendAndClose(connection.client, g_lanResponse);
+  connection.active = false;
+}
+
+//----------------------------------------------------------------------------//
+// Public API
+//----------------------------------------------------------------------------//
+
+void serviceLanServer() {
+  if (lan_http_port == 0) {
+    return;
+  }
+  if (g_lanServer == NULL) {
+    if (wifiLinkStatus() != WL_CONNECTED) {
+      return;  // The stack can't listen before the interface is up
+    }
+    static WiFiServer server(lan_http_port);
+    server.begin();
+    g_lanServer = &server;
+    Serial.print("LAN status server on ");
+    Serial.print(WiFi.localIP());
+    Serial.print(":");
+    Serial.println(lan_http_port);
+  }
+
+  acceptConnection();
+  for (int i = 0; i < LAN_HTTP_CONNECTIONS; i++) {
+    if (g_lanConnections[i].active) {
+      serviceConnection(g_lanConnections[i]);
+    }
+  }
+}
+
+const LanServerStats& lanServerStats() {
+  return g_lanStats;
+}
@@ -0,0 +1,49 @@
+#ifndef LAN_SERVER_H
+#define LAN_SERVER_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// LAN Status and Override Server
+//----------------------------------------------------------------------------//
+
+/*
+ * Listens on lan_http_port (once WiFi first connects) and serves LanHttp.h
+ * to up to LAN_HTTP_CONNECTIONS clients at a time. Each pass accepts at most
+ * one new connection and reads only what each socket already has buffered,
+ * so a slow or silent client costs a few microseconds a pass, never a stall;
+ * one that hasn't finished its headers within lan_http_idle_ms gets a 408.
+ * With every slot busy, a new connection gets an immediate 503. The reply
+ * (at most LAN_RESPONSE_CAPACITY bytes) is written in one go and the
+ * connection closed.
+ *
+ * Overrides reach the Moore machine as INPUT_ZONE_OVERRIDE through the
+ * event mailbox; status comes from the snapshot the control side publishes.
+ *
+ * Runs on the network side only (see NetworkMailbox.h).
+ */
+
+const int LAN_HTTP_CONNECTIONS = 4;
+
+struct LanServerStats {
+  unsigned long accepted;         // Connections given a slot
+  unsigned long refused;          // Connections turned away with 503 (no free slot)
+  unsigned long served;           // Requests answered (any status)
+  unsigned long timedOut;         // Connections dropped for idling (408)
+  unsigned long overrides;        // Overrides posted to the control side
+};
+
+/**
+ * Accept, read and answer LAN clients without blocking
+ * Called on every serviceNetworkMailbox() pass; does nothing when
+ * lan_http_port is 0
+ */
+void serviceLanServer();
+
+/**
+ * Access server counters
+ * @return Statistics since boot
+ */
+const LanServerStats& lanServerStats();
+
+#endif // LAN_SERVER_H
@@ -0,0 +1,295 @@
+#include "LoopWatchdog.h"
+#include "Checksum.h"
+#include "OutputEngine.h"
+#include "kvstore_global_api.h"
+#include <mbed.h>
+
+//----------------------------------------------------------------------------//
+// Stage Deadlines
+//----------------------------------------------------------------------------//
+
+// Soft deadlines, checked when a stage ends. The hardware watchdog
+// (watchdog_timeout_ms) must be longer than the longest of these.
+static const unsigned long STAGE_DEADLINE_MS[LOOP_STAGE_COUNT] = {
+  0,      // IDLE - not checked
+  5000,   // BOOT - config read, zone restore, WiFi module probe
+  100,    // READ_EVENTS
+  50,     // STEP
+  500,    // EFFECT - a config commit is one flash write
+  500,    // OUTPUT
+  20000   // NETWORK - one job: a scan takes 10-15 s, an HTTP request gives up after 15 s
+};
+
+// Fatal errors retried this many times (by resetting) before parking
+static const uint8_t FATAL_RESET_LIMIT = 3;
+
+//----------------------------------------------------------------------------//
+// Reset-Surviving Breadcrumb
+//----------------------------------------------------------------------------//
+
+// Placed outside .bss/.data so the C runtime doesn't clear it at startup.
+// After a power cycle it holds garbage, which the magic words reject.
+#ifndef WATCHDOG_RETAINED
+  #define WATCHDOG_RETAINED __attribute__((section(".noinit")))
+#endif
+
+static const uint32_t BREADCRUMB_MAGIC = 0x57444F47;  // "WDOG"
+
+struct Breadcrumb {
+  uint32_t magic;
+  uint32_t magicInverse;       // ~magic: two words make a false match unlikely
+  uint8_t stage;               // LoopStage being executed
+  uint8_t cause;               // CRASH_FATAL if watchdogFatal() ran
+  uint8_t consecutiveFatal;    // Fatal resets without a loop() pass in between
+  uint32_t stageStartMs;
+  uint32_t lastKickMs;
+  char detail[32];
+};
+
+static Breadcrumb g_breadcrumb WATCHDOG_RETAINED;
+
+static bool breadcrumbValid() {
+  return g_breadcrumb.magic == BREADCRUMB_MAGIC &&
+         g_breadcrumb.magicInverse == ~BREADCRUMB_MAGIC &&
+         g_breadcrumb.stage < LOOP_STAGE_COUNT &&
+         g_breadcrumb.cause <= CRASH_FATAL;
+}
+
+//----------------------------------------------------------------------------//
+// Persisted Crash Record
+//----------------------------------------------------------------------------//
+
+const char* KEY_CRASH = "crash";
+static const uint32_t CRASH_MAGIC = 0x48535243;  // "CRSH"
+
+struct StoredCrash {
+  uint32_t magic;
+  CrashRecord record;
+  uint32_t crc;                // CRC-32 of `record`
+};
+
+static WatchdogStats g_watchdogStats;
+static bool g_crashThisBoot = false;
+static bool g_watchdogArmed = false;
+static unsigned long g_passStartUs = 0;  // micros() when the current pass left IDLE
+
+bool lastCrash(CrashRecord* record) {
+  StoredCrash stored;
+  size_t actual = 0;
+  if (kv_get(KEY_CRASH, &stored, sizeof(stored), &actual) != MBED_SUCCESS ||
+      actual != sizeof(stored) || stored.magic != CRASH_MAGIC ||
+      stored.crc != crc32(&stored.record, sizeof(stored.record))) {
+    return false;
+  }
+  *record = stored.record;
+  return true;
+}
+
+static void saveCrash(CrashCause cause) {
+  CrashRecord previous;
+  uint32_t count = lastCrash(&previous) ? previous.crashCount : 0;
+
+  StoredCrash stored;
+  memset(&stored, 0, sizeof(stored));
+  stored.magic = CRASH_MAGIC;
+  stored.record.cause = cause;
+  stored.record.stage = g_breadcrumb.stage;
+  stored.record.stageStartMs = g_breadcrumb.stageStartMs;
+  stored.record.lastKickMs = g_breadcrumb.lastKickMs;
+  stored.record.crashCount = count + 1;
+  memcpy(stored.record.detail, g_breadcrumb.detail, sizeof(stored.record.detail));
+  stored.record.detail[sizeof(stored.record.detail) - 1] = '\0';
+  stored.crc = crc32(&stored.record, sizeof(stored.record));
+
+  // Best effort: a failing flash is one of the things being diagnosed
+  kv_set(KEY_CRASH, &stored, sizeof(stored), 0);
+}
+
+//----------------------------------------------------------------------------//
+// Watchdog API
+//----------------------------------------------------------------------------//
+
+void watchdogBegin() {
+  uint8_t consecutiveFatal = 0;
+  if (breadcrumbValid()) {
+    CrashCause cause = CRASH_NONE;
+    if (g_breadcrumb.cause == CRASH_FATAL) {
+      cause = CRASH_FATAL;
+      consecutiveFatal = g_breadcrumb.consecutiveFatal;
+    } else if (mbed::ResetReason::get() == RESET_REASON_WATCHDOG) {
+      cause = CRASH_WATCHDOG;
+    }
+    if (cause != CRASH_NONE) {
+      saveCrash(cause);
+      g_crashThisBoot = true;
+    }
+  }
+
+  // Fresh breadcrumb for this boot
+  memset(&g_breadcrumb, 0, sizeof(g_breadcrumb));
+  g_breadcrumb.magic = BREADCRUMB_MAGIC;
+  g_breadcrumb.magicInverse = ~BREADCRUMB_MAGIC;
+  g_breadcrumb.stage = LOOP_STAGE_BOOT;
+  g_breadcrumb.cause = CRASH_NONE;
+  g_breadcrumb.consecutiveFatal = consecutiveFatal;
+  g_breadcrumb.stageStartMs = millis();
+  g_breadcrumb.lastKickMs = millis();
+
+  mbed::Watchdog& watchdog = mbed::Watchdog::get_instance();
+  uint32_t timeout = watchdog_timeout_ms;
+  if (timeout > watchdog.get_max_timeout()) {
+    timeout = watchdog.get_max_timeout();  // IWDG tops out around 32 s
+  }
+  g_watchdogArmed = watchdog.start(timeout);
+}
+
+void watchdogStage(LoopStage stage) {
+  unsigned long now = millis();
+  LoopStage previous = (LoopStage)g_breadcrumb.stage;
+  unsigned long elapsed = now - g_breadcrumb.stageStartMs;
+
+  if (previous != LOOP_STAGE_IDLE) {
+    if (elapsed > g_watchdogStats.worstMs[previous]) {
+      g_watchdogStats.worstMs[previous] = elapsed;
+    }
+    if (elapsed > STAGE_DEADLINE_MS[previous]) {
+      g_watchdogStats.overruns[previous]++;
+      Serial.print("⚠ Loop stage ");
+      Serial.print(loopStageName(previous));
+      Serial.print(" overran: ");
+      Serial.print(elapsed);
+      Serial.print(" ms (deadline ");
+      Serial.print(STAGE_DEADLINE_MS[previous]);
+      Serial.println(" ms)");
+    }
+  }
+
+  if ((previous == LOOP_STAGE_IDLE || previous == LOOP_STAGE_BOOT) && stage > LOOP_STAGE_BOOT) {
+    g_passStartUs = micros();
+  }
+  g_breadcrumb.stage = stage;
+  g_breadcrumb.stageStartMs = now;
+}
+
+// Bucket one pass's duration (see LOOP_PASS_BUCKETS)
+static void countPass(unsigned long elapsedUs) {
+  int bucket = 0;
+  for (unsigned long bound = LOOP_PASS_FIRST_BUCKET_US;
+       elapsedUs >= bound && bucket < LOOP_PASS_BUCKETS - 1; bound <<= 1) {
+    bucket++;
+  }
+  g_watchdogStats.passHistogram[bucket]++;
+  if (elapsedUs > g_watchdogStats.worstPassUs) {
+    g_watchdogStats.worstPassUs = elapsedUs;
+  }
+}
+
+void watchdogKick() {
+  if (g_breadcrumb.stage > LOOP_STAGE_BOOT) {  // setup() isn't a pass
+    countPass(micros() - g_passStartUs);
+  }
+  watchdogStage(LOOP_STAGE_IDLE);
+  g_breadcrumb.lastKickMs = g_breadcrumb.stageStartMs;
+  g_breadcrumb.consecutiveFatal = 0;  // The loop ran, so the last fatal didn't recur at boot
+  if (g_watchdogArmed) {
+    mbed::Watchdog::get_instance().kick();
+  }
+}
+
+void watchdogFatal(const char* detail) {
+  // Fail safe first: nothing downstream may leave a valve open, whether the
+  // valves are on GPIO pins or the shift register chain
+  outputForceAllClosed();
+
+  Serial.print("FATAL: ");
+  Serial.println(detail);
+
+  if (!breadcrumbValid()) {
+    // Fatal before watchdogBegin() on a cold boot
+    memset(&g_breadcrumb, 0, sizeof(g_breadcrumb));
+    g_breadcrumb.magic = BREADCRUMB_MAGIC;
+    g_breadcrumb.magicInverse = ~BREADCRUMB_MAGIC;
+    g_breadcrumb.stage = LOOP_STAGE_BOOT;
+  }
+  g_breadcrumb.cause = CRASH_FATAL;
+  strncpy(g_breadcrumb.detail, detail, sizeof(g_breadcrumb.detail) - 1);
+  g_breadcrumb.detail[sizeof(g_breadcrumb.detail) - 1] = '\0';
+
+  if (g_breadcrumb.consecutiveFatal >= FATAL_RESET_LIMIT) {
+    // Resetting hasn't helped; stay up with the zones closed so the
+    // error can be read on the serial console
+    Serial.println("Repeated fatal error - halted with all zones closed");
+    while (true) {
+      if (g_watchdogArmed) {
+        mbed::Watchdog::get_instance().kick();
+      }
+      delay(1000);
+    }
+  }
+  g_breadcrumb.consecutiveFatal++;
+
+  Serial.flush();
+  NVIC_SystemReset();
+}
+
+//----------------------------------------------------------------------------//
+// Reporting
+//----------------------------------------------------------------------------//
+
+const char* loopStageName(LoopStage stage) {
+  switch (stage) {
+    case LOOP_STAGE_IDLE: return "IDLE";
+    case LOOP_STAGE_BOOT: return "BOOT";
+    case LOOP_STAGE_READ_EVENTS: return "READ_EVENTS";
+    case LOOP_STAGE_STEP: return "STEP";
+    case LOOP_STAGE_EFFECT: return "EFFECT";
+    case LOOP_STAGE_OUTPUT: return "OUTPUT";
+    case LOOP_STAGE_NETWORK: return "NETWORK";
+    default: return "UNKNOWN";
+  }
+}
+
+void printWatchdogReport() {
+  CrashRecord crash;
+  if (g_crashThisBoot && lastCrash(&crash)) {
+    Serial.print("Last reset: ");
+    Serial.print(crash.cause == CRASH_WATCHDOG ? "watchdog" : "fatal error");
+    Serial.print(" in stage ");
+    Serial.print(loopStageName((LoopStage)crash.stage));
+    Serial.print(" (entered at ");
+    Serial.print(crash.stageStartMs);
+    Serial.print(" ms, last kick at ");
+    Serial.print(crash.lastKickMs);
+    Serial.print(" ms)");
+    if (crash.detail[0] != '\0') {
+      Serial.print(": ");
+      Serial.print(crash.detail);
+    }
+    Serial.print(" [crash #");
+    Serial.print(crash.crashCount);
+    Serial.println("]");
+  }
+
+  Serial.print("Watchdog: ");
+  Serial.println(g_watchdogArmed ? "armed" : "NOT ARMED");
+  for (int i = LOOP_STAGE_BOOT; i < LOOP_STAGE_COUNT; i++) {
+    if (g_watchdogStats.overruns[i] > 0) {
+      Serial.print("  ");
+      Serial.print(loopStageName((LoopStage)i));
+      Serial.print(": ");
+      Serial.print(g_watchdogStats.overruns[i]);
+      Serial.print(" overruns, worst ");
+      Serial.print(g_watchdogStats.worstMs[i]);
+      Serial.println(" ms");
+    }
+  }
+}
+
+const WatchdogStats& watchdogStats() {
+  return g_watchdogStats;
+}
+
+void watchdogClearPassHistogram() {
+  memset(g_watchdogStats.passHistogram, 0, sizeof(g_watchdogStats.passHistogram));
+  g_watchdogStats.worstPassUs = 0;
+}
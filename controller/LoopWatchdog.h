@@ -0,0 +1,123 @@
+#ifndef LOOP_WATCHDOG_H
+#define LOOP_WATCHDOG_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Loop Watchdog
+//----------------------------------------------------------------------------//
+
+/*
+ * Arms the hardware watchdog and accounts for where each loop() pass spends
+ * its time. loop() announces each stage as it enters it; every stage has a
+ * deadline, and finishing late counts as an overrun. A stage that never
+ * finishes (a hung HTTP read, a scan that doesn't return) stops the loop from
+ * kicking the hardware watchdog, which resets the board after
+ * watchdog_timeout_ms.
+ *
+ * The current stage and when it began are kept in a small record in RAM that
+ * survives a reset (not a power cycle). At the next boot that record tells us
+ * which stage was running when the watchdog fired. It is saved to flash as
+ * the crash record and printed with the boot metrics.
+ *
+ * Unrecoverable errors (flash failures) go through watchdogFatal(), which
+ * closes the zones, records the reason the same way and resets right away
+ * instead of spinning forever. If the same error keeps happening before the
+ * loop ever runs, it stops retrying after a few resets and parks with the
+ * zones closed, rather than boot-looping.
+ */
+
+enum LoopStage {
+  LOOP_STAGE_IDLE,           // Between loop() passes (delay, Arduino core)
+  LOOP_STAGE_BOOT,           // setup() and deferred boot work (WiFi probe)
+  LOOP_STAGE_READ_EVENTS,    // readEvents(): serial, network mailbox, WiFi status
+  LOOP_STAGE_STEP,           // g_machine.step() and its observers
+  LOOP_STAGE_EFFECT,         // executeEffect() for the step's output
+  LOOP_STAGE_OUTPUT,         // outputFunction() effects and LED updates
+  LOOP_STAGE_NETWORK,        // serviceNetworkMailbox(): one scan, connect, HTTP or DNS job
+  LOOP_STAGE_COUNT
+};
+
+enum CrashCause {
+  CRASH_NONE,                // Clean power-on or requested reset
+  CRASH_WATCHDOG,            // Hardware watchdog fired - a stage hung
+  CRASH_FATAL                // watchdogFatal() - an unrecoverable error
+};
+
+struct CrashRecord {
+  uint8_t cause;             // CrashCause
+  uint8_t stage;             // LoopStage running at the time
+  uint32_t stageStartMs;     // millis() when that stage was entered
+  uint32_t lastKickMs;       // millis() of the last watchdog kick
+  uint32_t crashCount;       // Crashes recorded since the record was created
+  char detail[32];           // watchdogFatal() message, empty for watchdog resets
+};
+
+// Whole loop() passes (idle time excluded) are counted in power-of-two
+// buckets: bucket 0 is under LOOP_PASS_FIRST_BUCKET_US, bucket b covers
+// [LOOP_PASS_FIRST_BUCKET_US << (b - 1), LOOP_PASS_FIRST_BUCKET_US << b), and
+// the last bucket takes everything longer
+const int LOOP_PASS_BUCKETS = 16;
+const unsigned long LOOP_PASS_FIRST_BUCKET_US = 128;
+
+struct WatchdogStats {
+  unsigned long overruns[LOOP_STAGE_COUNT];  // Stage passes that missed their deadline
+  unsigned long worstMs[LOOP_STAGE_COUNT];   // Longest pass through each stage
+  unsigned long passHistogram[LOOP_PASS_BUCKETS];  // loop() passes by duration
+  unsigned long worstPassUs;                 // Longest loop() pass since the histogram was cleared
+};
+
+/**
+ * Collect the previous reset's crash record (saving it to flash) and arm
+ * the hardware watchdog. Call early in setup(), after the config is loaded.
+ */
+void watchdogBegin();
+
+/**
+ * Leave the current stage (checking its deadline) and enter another
+ * @param stage Stage being entered
+ */
+void watchdogStage(LoopStage stage);
+
+/**
+ * End of a loop() pass: kick the hardware watchdog and go idle
+ */
+void watchdogKick();
+
+/**
+ * Unrecoverable error: close the zones, record the reason and reset
+ * @param detail Short description saved in the crash record
+ */
+void watchdogFatal(const char* detail);
+
+/**
+ * Read the crash record saved by the last crash
+ * @param record Populated with the most recent crash
+ * @return true if a crash has been recorded
+ */
+bool lastCrash(CrashRecord* record);
+
+/**
+ * Print the crash record (if any) and per-stage overrun counts
+ */
+void printWatchdogReport();
+
+/**
+ * Access per-stage timing counters
+ * @return Watchdog statistics since boot
+ */
+const WatchdogStats& watchdogStats();
+
+/**
+ * Clear the pass histogram and worst pass (per-stage counters are kept)
+ */
+void watchdogClearPassHistogram();
+
+/**
+ * Human-readable stage name
+ * @param stage Loop stage
+ * @return Stage name
+ */
+const char* loopStageName(LoopStage stage);
+
+#endif // LOOP_WATCHDOG_H
@@ -0,0 +1,133 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Lock-Free Single-Producer/Single-Consumer Mailbox
+//----------------------------------------------------------------------------//
+
+/*
+ * Mailbox: Fixed-capacity ring buffer for passing messages between two threads
+ *
+ * Exactly one side pushes and exactly one side pops. Each index is written by
+ * only one side, so no locks are needed: the producer publishes a slot with a
+ * release store of `head`, and the consumer frees it with a release store of
+ * `tail`. On the board both ends run in loop(), so it is simply a queue;
+ * on the host the two ends run as threads (host/mailbox-bench).
+ *
+ * Key C++ concepts:
+ * - template: The message type and capacity are fixed at compile time
+ * - std::atomic: Loads/stores that are never torn and carry ordering guarantees
+ * - static_assert: Compile-time check that Capacity is a power of two
+ */
+template <typename T, size_t Capacity>
+class Mailbox {
+  static_assert((Capacity & (Capacity - 1)) == 0, "Mailbox capacity must be a power of two");
+
+public:
+  Mailbox() : head(0), tail(0) {}
+
+  /**
+   * Copy a message into the mailbox (producer side only)
+   * @param msg Message to enqueue
+   * @return true if enqueued, false if the mailbox is full
+   */
+  bool push(const T& msg) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    if (h - t == Capacity) {
+      return false;  // Full - consumer hasn't caught up
+    }
+    slots[h & (Capacity - 1)] = msg;
+    head.store(h + 1, std::memory_order_release);  // Publish the slot
+    return true;
+  }
+
+  /**
+   * Copy the oldest message out of the mailbox (consumer side only)
+   * @param msg Output message
+   * @return true if a message was dequeued, false if the mailbox is empty
+   */
+  bool pop(T* msg) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    if (h == t) {
+      return false;  // Empty
+    }
+    *msg = slots[t & (Capacity - 1)];
+    tail.store(t + 1, std::memory_order_release);  // Hand the slot back
+    return true;
+  }
+
+  // Approximate when called from the side that doesn't own the check
+  bool isEmpty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+private:
+  std::atomic<uint32_t> head;  // Next slot to write (owned by producer)
+  std::atomic<uint32_t> tail;  // Next slot to read (owned by consumer)
+  T slots[Capacity];
+};
+
+//----------------------------------------------------------------------------//
+// Latest-Value Snapshot
+//----------------------------------------------------------------------------//
+
+/*
+ * Snapshot: The newest copy of a value one core owns, for the other to read
+ *
+ * Where a Mailbox queues every message, a Snapshot keeps only the last one:
+ * right for state that is republished constantly (status for display),
+ * where a full queue would only hold stale copies. It's a seqlock - the
+ * writer makes `version` odd while it copies the value in and even again
+ * after, and a reader whose copy overlapped a write (odd, or changed by the
+ * time it finished) copies again. The writer never waits for readers.
+ *
+ * Exactly one side writes; any number may read.
+ */
+template <typename T>
+class Snapshot {
+public:
+  Snapshot() : version(0), value() {}
+
+  /**
+   * Replace the value (writer side only)
+   * @param next New value
+   */
+  void write(const T& next) {
+    uint32_t v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);      // Odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    value = next;
+    version.store(v + 2, std::memory_order_release);      // Even: value complete
+  }
+
+  /**
+   * Copy the latest value out
+   * @param out Output value
+   * @return false if nothing has been written yet
+   */
+  bool read(T* out) const {
+    for (;;) {
+      uint32_t before = version.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;  // Mid-write; a copy takes microseconds
+      }
+      *out = value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (version.load(std::memory_order_relaxed) == before) {
+        return before != 0;
+      }
+    }
+  }
+
+private:
+  std::atomic<uint32_t> version;  // Writes started and finished, x2 (owned by writer)
+  T value;
+};
+
+#endif // MAILBOX_H
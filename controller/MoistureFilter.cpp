@@ -0,0 +1,82 @@
+#include "MoistureFilter.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------//
+// Median Network
+//----------------------------------------------------------------------------//
+
+static inline uint16_t min16(uint16_t a, uint16_t b) { return a < b ? a : b; }
+static inline uint16_t max16(uint16_t a, uint16_t b) { return a < b ? b : a; }
+
+static inline uint16_t median3(uint16_t a, uint16_t b, uint16_t c) {
+  return max16(min16(a, b), min16(max16(a, b), c));
+}
+
+// Dropping the smallest and the largest of a..d can't remove the median of
+// all five, and leaves it as the median of the remaining three. Compiles to
+// conditional selects on the M7, so the cost doesn't depend on the data.
+static inline uint16_t median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e) {
+  uint16_t secondLowest = max16(min16(a, b), min16(c, d));
+  uint16_t secondHighest = min16(max16(a, b), max16(c, d));
+  return median3(e, secondLowest, secondHighest);
+}
+
+//----------------------------------------------------------------------------//
+// Filter Stages
+//----------------------------------------------------------------------------//
+
+static inline void filterSample(MoistureChannelFilter* ch, uint16_t sample) {
+  ch->medianWindow[ch->medianPos] = sample;
+  ch->medianPos = (ch->medianPos + 1) % MOISTURE_MEDIAN_TAPS;
+  const uint16_t* w = ch->medianWindow;
+  uint16_t median = median5(w[0], w[1], w[2], w[3], w[4]);
+
+  ch->averageSum += median;
+  ch->averageSum -= ch->averageWindow[ch->averagePos];
+  ch->averageWindow[ch->averagePos] = median;
+  ch->averagePos = (ch->averagePos + 1) & (MOISTURE_AVERAGE_TAPS - 1);
+  ch->samples++;
+}
+
+void moistureFilterReset(MoistureFilterBank* bank) {
+  memset(bank, 0, sizeof(*bank));
+}
+
+void moistureFilterBlock(MoistureFilterBank* bank, const uint16_t* samples, size_t frames) {
+  for (size_t f = 0; f < frames; f++) {
+    for (int c = 0; c < ZONE_COUNT; c++) {
+      filterSample(&bank->channels[c], samples[f * ZONE_COUNT + c]);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Calibration
+//----------------------------------------------------------------------------//
+
+uint16_t moisturePermilleFromRaw(uint16_t raw) {
+  // Capacitive sensors read lower when wet, resistive ones higher; signed
+  // arithmetic handles either orientation of the calibration points
+  int32_t span = (int32_t)moisture_raw_wet - (int32_t)moisture_raw_dry;
+  if (span == 0) {
+    return MOISTURE_UNKNOWN;
+  }
+  int32_t permille = ((int32_t)raw - (int32_t)moisture_raw_dry) * 1000 / span;
+
+  // Within an eighth of the span past either end is calibration drift;
+  // further out the sensor is disconnected or shorted
+  if (permille < -125 || permille > 1125) {
+    return MOISTURE_UNKNOWN;
+  }
+  if (permille < 0) return 0;
+  if (permille > 1000) return 1000;
+  return (uint16_t)permille;
+}
+
+uint16_t moistureFilterPermille(const MoistureFilterBank& bank, int channel) {
+  const MoistureChannelFilter& ch = bank.channels[channel];
+  if (ch.samples < MOISTURE_MEDIAN_TAPS + MOISTURE_AVERAGE_TAPS) {
+    return MOISTURE_UNKNOWN;  // Windows still hold the zeros from reset
+  }
+  return moisturePermilleFromRaw((uint16_t)(ch.averageSum / MOISTURE_AVERAGE_TAPS));
+}
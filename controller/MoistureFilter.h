@@ -0,0 +1,78 @@
+#ifndef MOISTURE_FILTER_H
+#define MOISTURE_FILTER_H
+
+#include "Types.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Soil Moisture Filter Kernels
+//----------------------------------------------------------------------------//
+
+/*
+ * Raw ADC samples from the moisture sensors are noisy: pump and valve
+ * switching put spikes on the lines, and capacitive sensors ripple at their
+ * oscillator frequency. Each channel runs two integer-only stages:
+ *
+ * 1. Median of the last 5 samples (min/max network, no branches or sort)
+ *    throws away single- and double-sample spikes.
+ * 2. Moving average of the last 32 medians, kept as a running sum so each
+ *    sample costs one add and one subtract regardless of window length.
+ *
+ * The filtered value is then mapped to 0-1000 permille of the calibrated
+ * dry-to-wet span. Readings well outside that span (open or shorted sensor)
+ * map to MOISTURE_UNKNOWN.
+ *
+ * Pure functions over caller-owned state: the firmware runs them on DMA
+ * buffers (MoistureSensor.h) and host tools on recorded sample files.
+ */
+
+const int MOISTURE_MEDIAN_TAPS = 5;
+const int MOISTURE_AVERAGE_TAPS = 32;   // Power of two - the mean is a shift
+
+struct MoistureChannelFilter {
+  uint16_t medianWindow[MOISTURE_MEDIAN_TAPS];   // Last raw samples (ring)
+  uint16_t averageWindow[MOISTURE_AVERAGE_TAPS]; // Last medians (ring)
+  uint32_t averageSum;                           // Sum of averageWindow
+  uint8_t medianPos;
+  uint8_t averagePos;
+  uint32_t samples;                              // Samples seen since reset
+};
+
+// One filter per zone; samples arrive interleaved by channel, as the ADC's
+// DMA writes them (zone 1, zone 2, zone 3, zone 1, ...)
+struct MoistureFilterBank {
+  MoistureChannelFilter channels[ZONE_COUNT];
+};
+
+/**
+ * Clear every channel (readings are not ready until the windows refill)
+ * @param bank Filters to reset
+ */
+void moistureFilterReset(MoistureFilterBank* bank);
+
+/**
+ * Run a block of interleaved samples through the filters
+ * @param bank Filters to update
+ * @param samples ZONE_COUNT samples per frame, interleaved by channel
+ * @param frames Number of frames (samples per channel)
+ */
+void moistureFilterBlock(MoistureFilterBank* bank, const uint16_t* samples, size_t frames);
+
+/**
+ * Current filtered reading for one channel
+ * @param bank Filters
+ * @param channel Zone number - 1
+ * @return Reading in permille of the calibrated span, or MOISTURE_UNKNOWN if
+ *         the windows haven't filled or the sensor reads out of range
+ */
+uint16_t moistureFilterPermille(const MoistureFilterBank& bank, int channel);
+
+/**
+ * Map a filtered ADC value onto the calibrated dry-to-wet span
+ * @param raw Filtered ADC value
+ * @return 0 (moisture_raw_dry) to 1000 (moisture_raw_wet), or MOISTURE_UNKNOWN
+ */
+uint16_t moisturePermilleFromRaw(uint16_t raw);
+
+#endif // MOISTURE_FILTER_H
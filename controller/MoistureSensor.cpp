@@ -0,0 +1,80 @@
+#include "MoistureSensor.h"
+#include "MoistureFilter.h"
+#include <Arduino_AdvancedAnalog.h>
+
+//----------------------------------------------------------------------------//
+// DMA ADC
+//----------------------------------------------------------------------------//
+
+// Frames (one sample per channel) per DMA buffer, and buffers in the pool.
+// At 100 Hz that is 0.64 s per buffer and ~5 s of slack before samples drop.
+static const size_t MOISTURE_DMA_FRAMES = 64;
+static const size_t MOISTURE_DMA_BUFFERS = 8;
+
+static_assert(ZONE_COUNT == 3, "One ADC channel per zone");
+
+// The channels are scanned in this order, so each DMA buffer holds frames
+// interleaved by zone - the layout moistureFilterBlock() expects
+static AdvancedADC g_moistureAdc(zone_moisture_pins[0], zone_moisture_pins[1],
+                                 zone_moisture_pins[2]);
+
+static MoistureFilterBank g_moistureFilters;
+static MoistureSensorStats g_moistureStats = {false, 0, 0, 0, 0};
+static unsigned long g_lastReportMs = 0;
+
+bool moistureBegin() {
+  if (!moisture_sensing_enabled) {
+    return false;
+  }
+  moistureFilterReset(&g_moistureFilters);
+  if (!g_moistureAdc.begin(AN_RESOLUTION_12, moisture_sample_rate_hz,
+                           MOISTURE_DMA_FRAMES, MOISTURE_DMA_BUFFERS)) {
+    Serial.println("Moisture ADC failed to start - watering by schedule only");
+    return false;
+  }
+  g_moistureStats.running = true;
+  g_lastReportMs = millis();
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Filtering and Reporting
+//----------------------------------------------------------------------------//
+
+bool readMoistureInput(Input* input) {
+  if (!g_moistureStats.running) {
+    return false;
+  }
+
+  while (g_moistureAdc.available()) {
+    SampleBuffer buffer = g_moistureAdc.read();
+    unsigned long started = micros();
+    size_t frames = buffer.size() / ZONE_COUNT;
+    moistureFilterBlock(&g_moistureFilters, buffer.data(), frames);
+    buffer.release();  // Back to the DMA pool
+
+    unsigned long elapsed = micros() - started;
+    if (elapsed > g_moistureStats.maxBlockMicros) {
+      g_moistureStats.maxBlockMicros = elapsed;
+    }
+    g_moistureStats.buffers++;
+    g_moistureStats.samples += frames * ZONE_COUNT;
+  }
+
+  if (millis() - g_lastReportMs < moisture_report_ms) {
+    return false;
+  }
+  g_lastReportMs = millis();
+
+  uint16_t permille[ZONE_COUNT];
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    permille[i] = moistureFilterPermille(g_moistureFilters, i);
+  }
+  *input = Input::moistureReading(permille);
+  g_moistureStats.reports++;
+  return true;
+}
+
+const MoistureSensorStats& moistureSensorStats() {
+  return g_moistureStats;
+}
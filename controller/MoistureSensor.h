@@ -0,0 +1,51 @@
+#ifndef MOISTURE_SENSOR_H
+#define MOISTURE_SENSOR_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Soil Moisture Sampling
+//----------------------------------------------------------------------------//
+
+/*
+ * Samples one moisture sensor per zone (zone_moisture_pins) at
+ * moisture_sample_rate_hz per channel. The ADC is timer-triggered and
+ * scans the channels into a pool of DMA buffers, so sampling keeps its rate
+ * and costs the CPU nothing while loop() is busy elsewhere (a WiFi scan
+ * blocks for seconds; the pool covers about five).
+ *
+ * readMoistureInput() drains the filled buffers through the filters in
+ * MoistureFilter.h and, every moisture_report_ms, turns the filtered values
+ * into one INPUT_MOISTURE_READING for the Moore machine.
+ *
+ * Does nothing unless moisture_sensing_enabled is set.
+ */
+
+struct MoistureSensorStats {
+  bool running;                 // ADC started
+  unsigned long buffers;        // DMA buffers filtered
+  unsigned long samples;        // Samples filtered (all channels)
+  unsigned long reports;        // Readings posted to the machine
+  unsigned long maxBlockMicros; // Slowest buffer through the filters
+};
+
+/**
+ * Start DMA sampling (call once from setup())
+ * @return true if sampling started, false if disabled or the ADC failed
+ */
+bool moistureBegin();
+
+/**
+ * Filter any completed DMA buffers and post a reading when one is due
+ * @param input Populated with INPUT_MOISTURE_READING when returning true
+ * @return true if a reading is due
+ */
+bool readMoistureInput(Input* input);
+
+/**
+ * Sampling and filter counters
+ * @return Current statistics
+ */
+const MoistureSensorStats& moistureSensorStats();
+
+#endif // MOISTURE_SENSOR_H
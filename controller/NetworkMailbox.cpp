@@ -0,0 +1,183 @@
+#include "NetworkMailbox.h"
+#include "ConfigStore.h"
+#include "WiFiConnection.h"
+#include "IrrigationController.h"
+#include "ServerResolver.h"
+#include "FirmwareUpdate.h"
+#include "TimeSync.h"
+#include "LanServer.h"
+
+//----------------------------------------------------------------------------//
+// Mailbox Placement
+//----------------------------------------------------------------------------//
+
+// Both sides run in loop() on the M7, so the mailbox is an ordinary global
+static NetworkMailbox g_networkMailbox;
+
+static NetworkMailbox& mailbox() {
+  return g_networkMailbox;
+}
+
+//----------------------------------------------------------------------------//
+// Control Side
+//----------------------------------------------------------------------------//
+
+bool requestConnect(const CredentialStore& networks) {
+  NetworkRequest request;
+  request.type = NET_REQUEST_CONNECT;
+  request.networks = networks;
+  request.scheduleSeq = 0;  // Unused for connects
+  return mailbox().requests.push(request);
+}
+
+bool requestSchedulePoll(uint32_t scheduleSeq) {
+  NetworkRequest request;
+  request.type = NET_REQUEST_POLL_SCHEDULE;
+  request.networks.count = 0;  // Unused for polls
+  request.scheduleSeq = scheduleSeq;
+  return mailbox().requests.push(request);
+}
+
+bool requestServerAddressSeed(const uint8_t address[4]) {
+  NetworkRequest request;
+  request.type = NET_REQUEST_SEED_SERVER_ADDRESS;
+  request.networks.count = 0;  // Unused for seeds
+  request.scheduleSeq = 0;
+  memcpy(request.serverAddress, address, sizeof(request.serverAddress));
+  return mailbox().requests.push(request);
+}
+
+// The configuration record belongs to the control side, so the resolver's
+// findings are written here (no flash write if the address is unchanged)
+static void persistServerAddress(const uint8_t address[4]) {
+  NetworkCache cache;
+  if (!loadNetworkCache(&cache)) {
+    memset(&cache, 0, sizeof(cache));
+  }
+  memcpy(cache.serverAddress, address, sizeof(cache.serverAddress));
+  saveNetworkCache(&cache);
+}
+
+bool receiveNetworkInput(Input* input) {
+  NetworkEvent event;
+  do {
+    if (!mailbox().events.pop(&event)) {
+      return false;  // Nothing from the network side
+    }
+    if (event.type == NET_EVENT_SERVER_RESOLVED) {
+      persistServerAddress(event.serverAddress);
+    }
+  } while (event.type == NET_EVENT_SERVER_RESOLVED);
+  *input = networkEventToInput(event);
+  return true;
+}
+
+void publishControllerStatus(const AppState& state, uint64_t now) {
+  mailbox().status.write(controllerStatusOf(state, now));
+}
+
+//----------------------------------------------------------------------------//
+// Network Side
+//----------------------------------------------------------------------------//
+
+bool postZoneOverride(uint8_t zone, ZoneOverrideAction action, unsigned long durationMs) {
+  NetworkEvent event;
+  event.type = NET_EVENT_ZONE_OVERRIDE;
+  event.pollHintMs = 0;
+  event.httpStatus = 0;
+  event.unixMs = 0;
+  event.overrideZone = zone;
+  event.overrideAction = action;
+  event.overrideMs = durationMs;
+  return mailbox().events.push(event);
+}
+
+bool postServerAddress(const uint8_t address[4]) {
+  NetworkEvent event;
+  event.type = NET_EVENT_SERVER_RESOLVED;
+  event.pollHintMs = 0;
+  event.httpStatus = 0;
+  event.unixMs = 0;
+  memcpy(event.serverAddress, address, sizeof(event.serverAddress));
+  return mailbox().events.push(event);
+}
+
+bool readControllerStatus(ControllerStatus* status) {
+  return mailbox().status.read(status);
+}
+
+void serviceNetworkMailbox() {
+  // LAN clients are served on every pass, busy or idle; it never blocks
+  serviceLanServer();
+
+  NetworkRequest request;
+  if (!mailbox().requests.pop(&request)) {
+    // Idle - each of these may block, so run only the first with work to do;
+    // the rest wait for a later pass and the watchdog sees one job per pass
+    if (serviceWiFiConnect()) {
+      return;  // Joined (or tried) the next network from the last scan
+    }
+    if (serviceServerResolver()) {
+      return;  // Refreshed the server address off the poll path
+    }
+    uint64_t unixMs;
+    bool sampled;
+    bool synced = serviceTimeSync(&unixMs, &sampled);
+    if (sampled) {
+      NetworkEvent event;
+      event.type = NET_EVENT_TIME_SYNCED;
+      event.pollHintMs = 0;
+      event.httpStatus = 0;
+      event.unixMs = unixMs;
+      // A dropped sample is made up by the next sync
+      mailbox().events.push(event);
+    }
+    if (synced) {
+      return;
+    }
+    bool ready;
+    serviceFirmwareUpdate(&ready);
+    if (ready) {
+      NetworkEvent event;
+      event.type = NET_EVENT_FIRMWARE_READY;
+      event.pollHintMs = 0;
+      event.httpStatus = 0;
+      event.unixMs = 0;
+      // Repeated at every update check, so a dropped event only delays it
+      mailbox().events.push(event);
+    }
+    return;
+  }
+
+  switch (request.type) {
+    case NET_REQUEST_CONNECT:
+      // Scans only; serviceWiFiConnect() joins on a later pass. WiFi status
+      // changes are observed by readEvents(), no event needed
+      connectWiFi(&request.networks);
+      break;
+
+    case NET_REQUEST_SEED_SERVER_ADDRESS:
+      seedServerAddress(request.serverAddress);
+      break;
+
+    case NET_REQUEST_POLL_SCHEDULE: {
+      Input result = pollIrrigationSchedule(request.scheduleSeq);
+      NetworkEvent event;
+      event.pollHintMs = result.pollHintMs;
+      event.httpStatus = result.httpStatus;
+      event.unixMs = 0;
+      if (result.type == INPUT_SCHEDULE_PATCH) {
+        event.type = NET_EVENT_SCHEDULE_RECEIVED;
+        event.patch = result.patch;
+      } else {
+        event.type = NET_EVENT_HTTP_ERROR;
+      }
+      // Control side drains every loop, so a full mailbox means it is wedged;
+      // dropping the event is safe because the next poll will retry
+      if (!mailbox().events.push(event)) {
+        Serial.println("Network event mailbox full - dropping poll result");
+      }
+      break;
+    }
+  }
+}
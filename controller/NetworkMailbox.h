@@ -0,0 +1,232 @@
+#ifndef NETWORK_MAILBOX_H
+#define NETWORK_MAILBOX_H
+
+#include "Types.h"
+#include "CredentialStore.h"
+#include "Mailbox.h"
+
+//----------------------------------------------------------------------------//
+// Network Mailbox Protocol
+//----------------------------------------------------------------------------//
+
+/*
+ * The network stack (scan, connect, HTTP poll, JSON parse) sits behind a pair
+ * of mailboxes. The control side posts NetworkRequests and drains
+ * NetworkEvents; the network side does the reverse. Neither side calls into
+ * the other's state directly, which keeps the Moore machine's inputs in one
+ * place and lets host tools drive either side alone.
+ *
+ * On the board both sides run in loop() on the M7: the control side first,
+ * then one serviceNetworkMailbox() call at the end of each pass. The mailboxes
+ * are lock-free single-producer/single-consumer queues all the same, so
+ * host/mailbox-bench can run the two sides as two threads and check the
+ * protocol under real concurrency.
+ *
+ *   control side                          network side
+ *   ------------   requests (SPSC)  -->   ------------
+ *   executeEffect                         serviceNetworkMailbox
+ *   readEvents     <--  events (SPSC)     LAN server overrides
+ *   loop()         status (snapshot) -->  LAN server
+ */
+
+enum NetworkRequestType {
+  NET_REQUEST_CONNECT,            // Scan for and join the strongest network in `networks`
+  NET_REQUEST_POLL_SCHEDULE,      // GET the irrigation schedule from the server
+  NET_REQUEST_SEED_SERVER_ADDRESS // Server address remembered from the last boot
+};
+
+struct NetworkRequest {
+  NetworkRequestType type;        // Which operation to perform
+  CredentialStore networks;       // Known networks, [0] = the current one (if NET_REQUEST_CONNECT)
+  uint32_t scheduleSeq;           // Version we hold, 0 = send a snapshot (if NET_REQUEST_POLL_SCHEDULE)
+  uint8_t serverAddress[4];       // IPv4 address (if NET_REQUEST_SEED_SERVER_ADDRESS)
+};
+
+enum NetworkEventType {
+  NET_EVENT_SCHEDULE_RECEIVED,    // Poll succeeded, `patch` is valid
+  NET_EVENT_HTTP_ERROR,           // Poll failed (no link, bad status, bad JSON)
+  NET_EVENT_FIRMWARE_READY,       // A verified update is in the inactive flash bank
+  NET_EVENT_TIME_SYNCED,          // SNTP reply, `unixMs` is valid
+  NET_EVENT_ZONE_OVERRIDE,        // LAN server request, `override*` are valid
+  NET_EVENT_SERVER_RESOLVED       // The server's address changed, `serverAddress` is valid
+};
+
+struct NetworkEvent {
+  NetworkEventType type;          // What happened
+  SchedulePatch patch;            // Parsed response (if NET_EVENT_SCHEDULE_RECEIVED)
+  unsigned long pollHintMs;       // Server-requested poll delay, 0 = none
+  int httpStatus;                 // Why the poll failed (if NET_EVENT_HTTP_ERROR), as Input::httpStatus
+  uint64_t unixMs;                // Wall-clock time when posted (if NET_EVENT_TIME_SYNCED)
+  uint8_t overrideZone;           // Zone index, 0-based (if NET_EVENT_ZONE_OVERRIDE)
+  ZoneOverrideAction overrideAction; // Hold open, hold closed or hand back (if NET_EVENT_ZONE_OVERRIDE)
+  unsigned long overrideMs;       // How long to hold it (if NET_EVENT_ZONE_OVERRIDE)
+  uint8_t serverAddress[4];       // New IPv4 address (if NET_EVENT_SERVER_RESOLVED)
+};
+
+/*
+ * What the LAN server shows, as of the control side's last loop pass. Plain
+ * numbers rather than an AppState so the two sides share only this.
+ */
+struct ControllerStatus {
+  AppMode mode;
+  uint32_t uptimeS;               // Seconds since boot
+  bool hasSchedule;               // A schedule was ever received (or restored)
+  uint32_t scheduleSeq;           // Server version held, 0 = none
+  uint32_t scheduleAgeS;          // Since the server last confirmed the schedule (if hasSchedule)
+  bool failSafeActive;            // Zones closed because the schedule went stale
+  bool pollFailing;               // The last poll failed
+  uint8_t scheduledMask;          // Zones the schedule wants (bit 0 = zone 1)
+  uint8_t wetMask;                // Zones skipped for wet soil
+  uint8_t overrideMask;           // Zones held from the LAN server
+  uint8_t overrideOpenMask;       // Which of those are held open
+  uint8_t openMask;               // Valves open now
+  uint8_t waitingMask;            // Requested zones waiting for supply
+  uint32_t overrideLeftS[ZONE_COUNT];     // Time left on each override
+  uint16_t moisturePermille[ZONE_COUNT];  // MOISTURE_UNKNOWN if none
+};
+
+// Capacities are small: the control side never has more than one connect
+// and one poll outstanding at a time (plus the address seed, once at boot).
+const size_t NETWORK_REQUEST_SLOTS = 4;
+const size_t NETWORK_EVENT_SLOTS = 4;
+
+struct NetworkMailbox {
+  Mailbox<NetworkRequest, NETWORK_REQUEST_SLOTS> requests;  // control -> network
+  Mailbox<NetworkEvent, NETWORK_EVENT_SLOTS> events;        // network -> control
+  Snapshot<ControllerStatus> status;                        // control -> network
+};
+
+/**
+ * Translate a network event into an Input symbol for the Moore machine
+ * Kept inline so host tools can share the exact protocol mapping
+ * @param event Event drained from the events mailbox
+ * @return Input symbol representing the event
+ */
+inline Input networkEventToInput(const NetworkEvent& event) {
+  switch (event.type) {
+    case NET_EVENT_SCHEDULE_RECEIVED:
+      return Input::schedulePatch(event.patch, event.pollHintMs);
+    case NET_EVENT_FIRMWARE_READY:
+      return Input::firmwareReady();
+    case NET_EVENT_TIME_SYNCED:
+      return Input::timeSynced(event.unixMs);
+    case NET_EVENT_ZONE_OVERRIDE:
+      return Input::zoneOverride(event.overrideZone, event.overrideAction, event.overrideMs);
+    case NET_EVENT_SERVER_RESOLVED:
+      return Input::none();  // Persisted by receiveNetworkInput(), nothing for the machine
+    case NET_EVENT_HTTP_ERROR:
+    default:
+      return Input::httpError(event.pollHintMs, event.httpStatus);
+  }
+}
+
+/**
+ * Summarize the machine's state for the LAN server
+ * Kept inline so host tools can share the exact mapping
+ * @param state Current state
+ * @param now Current monotonic time in milliseconds (clockMonotonicMs())
+ * @return Status to publish
+ */
+inline ControllerStatus controllerStatusOf(const AppState& state, uint64_t now) {
+  ControllerStatus status;
+  status.mode = state.mode;
+  status.uptimeS = (uint32_t)(now / 1000);
+  status.hasSchedule = state.schedule.lastUpdate != 0;
+  status.scheduleSeq = state.schedule.seq;
+  status.scheduleAgeS = status.hasSchedule ? (uint32_t)((now - state.schedule.lastUpdate) / 1000) : 0;
+  status.failSafeActive = state.failSafeActive;
+  status.pollFailing = state.httpError;
+  status.scheduledMask = state.schedule.zoneMask();
+  status.wetMask = state.moisture.wetMask;
+  status.overrideMask = state.overrides.mask;
+  status.overrideOpenMask = state.overrides.openMask;
+  status.openMask = state.zones.openMask;
+  status.waitingMask = state.zones.waitingMask();
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    bool held = (state.overrides.mask & (1 << i)) && state.overrides.until[i] > now;
+    status.overrideLeftS[i] = held ? (uint32_t)((state.overrides.until[i] - now + 999) / 1000) : 0;
+    status.moisturePermille[i] = state.moisture.permille[i];
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------//
+// Control Side
+//----------------------------------------------------------------------------//
+
+/**
+ * Post a connect request to the network side
+ * The network side never reads the stored networks itself; everything it
+ * may join travels in the request.
+ * @param networks Known networks, [0] = the current one
+ * @return true if posted, false if the request mailbox is full
+ */
+bool requestConnect(const CredentialStore& networks);
+
+/**
+ * Post a schedule poll request to the network side
+ * @param scheduleSeq Sequence number of the schedule we hold (0 = none)
+ * @return true if posted, false if the request mailbox is full
+ */
+bool requestSchedulePoll(uint32_t scheduleSeq);
+
+/**
+ * Seed the network side's server address cache (once, from setup())
+ * @param address Address persisted by an earlier boot
+ * @return true if posted, false if the request mailbox is full
+ */
+bool requestServerAddressSeed(const uint8_t address[4]);
+
+/**
+ * Drain one event from the network side
+ * A new server address is persisted here, on the control side, rather than
+ * handed to the machine.
+ * @param input Output Input symbol for the event
+ * @return true if an event was available, false otherwise
+ */
+bool receiveNetworkInput(Input* input);
+
+/**
+ * Publish the machine's state for the LAN server (every loop pass)
+ * @param state Current state
+ * @param now Current monotonic time in milliseconds
+ */
+void publishControllerStatus(const AppState& state, uint64_t now);
+
+//----------------------------------------------------------------------------//
+// Network Side
+//----------------------------------------------------------------------------//
+
+/**
+ * Perform at most one pending network request and post its result; when
+ * none is pending, run the first idle job that has work (WiFi association,
+ * server lookup, SNTP, firmware update). Either way at most one blocking
+ * network job per call, so each loop() pass fits the watchdog.
+ * Called at the end of every loop() pass
+ */
+void serviceNetworkMailbox();
+
+/**
+ * Hand a zone override from the LAN server to the control side
+ * @param zone Zone index, 0-based
+ * @param action Hold open, hold closed or hand back
+ * @param durationMs How long to hold it (ignored for OVERRIDE_RELEASE)
+ * @return true if posted, false if the event mailbox is full
+ */
+bool postZoneOverride(uint8_t zone, ZoneOverrideAction action, unsigned long durationMs);
+
+/**
+ * Hand a newly resolved server address to the control side to persist
+ * @param address Address the resolver just found
+ * @return true if posted, false if the event mailbox is full
+ */
+bool postServerAddress(const uint8_t address[4]);
+
+/**
+ * The control side's last published status
+ * @param status Output status
+ * @return false if nothing has been published yet
+ */
+bool readControllerStatus(ControllerStatus* status);
+
+#endif // NETWORK_MAILBOX_H
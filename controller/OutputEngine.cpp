@@ -0,0 +1,255 @@
+#include "OutputEngine.h"
+#include "Clock.h"
+#include "ShiftRegisterValves.h"
+#include <mbed.h>
+#include <new>
+
+// Blink period; LED patterns are duty cycles of it
+static const int LED_PWM_PERIOD_MS = 500;
+
+// Valve chain clock: a 74HC595 takes far more, but the cable to the valve
+// board may be long. Four registers still shift out in 32 us.
+static const int VALVE_SPI_HZ = 1000000;
+
+static const int ZONE_PINS[ZONE_COUNT] = {zone1_led_pin, zone2_led_pin, zone3_led_pin};
+
+struct ZoneOutput {
+  int index;
+  mbed::DigitalOut* pin;        // nullptr when the zone is a shift register output
+  mbed::Timeout deadline;
+  bool open;                    // As last set by the loop
+  uint64_t closeBy;             // Armed deadline, 0 = none
+};
+
+static OutputEngineStats g_outputStats = {0, 0, 0, 0, 0};
+static volatile unsigned long g_timerCloses = 0;  // Written from the timer interrupt
+
+//----------------------------------------------------------------------------//
+// Pin Objects
+//----------------------------------------------------------------------------//
+
+// Constructed in outputEngineBegin() rather than at static init, so the
+// pins are claimed at a known point in setup() and never from the heap
+alignas(mbed::PwmOut) static uint8_t g_wifiLedStorage[sizeof(mbed::PwmOut)];
+alignas(mbed::DigitalOut) static uint8_t g_zonePinStorage[ZONE_COUNT][sizeof(mbed::DigitalOut)];
+
+static mbed::PwmOut* g_wifiLed = nullptr;
+static LedPattern g_wifiPattern = LED_OFF;
+static ZoneOutput g_zones[ZONE_COUNT];
+static bool g_zonesReady = false;
+
+//----------------------------------------------------------------------------//
+// Shift Register Chain
+//----------------------------------------------------------------------------//
+
+static ShiftRegisterChain g_valveChain;
+static uint32_t g_chainOutputs = 0;  // Written from the loop and the deadline timer
+
+// The chain on the SPI header. Frames go out by DMA where the core's SPI
+// driver supports it (by interrupt otherwise); the completion interrupt
+// latches them.
+class SpiShiftChainBus : public ShiftChainBus {
+public:
+  SpiShiftChainBus()
+    : spi(digitalPinToPinName(PIN_SPI_MOSI), digitalPinToPinName(PIN_SPI_MISO),
+          digitalPinToPinName(PIN_SPI_SCK)),
+      latchPin(digitalPinToPinName(valve_latch_pin), 0),
+      enablePin(nullptr) {
+    spi.format(8, 0);
+    spi.frequency(VALVE_SPI_HZ);
+    spi.set_dma_usage(DMA_USAGE_ALWAYS);
+    if (valve_enable_pin >= 0) {
+      enablePin = new (enableStorage) mbed::DigitalOut(digitalPinToPinName(valve_enable_pin), 1);
+    }
+  }
+
+  bool startTransfer(const uint8_t* frame, size_t length) override {
+    return spi.transfer(frame, (int)length, (uint8_t*)nullptr, 0,
+                        mbed::callback(this, &SpiShiftChainBus::onTransferDone),
+                        SPI_EVENT_COMPLETE) == 0;
+  }
+
+  void latch() override {
+    latchPin = 1;
+    latchPin = 0;
+    if (enablePin != nullptr && !disabled) {
+      *enablePin = 0;  // /OE low: outputs follow the latch from now on
+    }
+  }
+
+  // /OE high until reset: every output off whatever is latched, and no
+  // later latch turns them back on
+  void disableOutputs() {
+    disabled = true;
+    if (enablePin != nullptr) {
+      *enablePin = 1;
+    }
+  }
+
+private:
+  // SPI interrupt
+  void onTransferDone(int) {
+    core_util_critical_section_enter();
+    shiftChainTransferDone(&g_valveChain);
+    core_util_critical_section_exit();
+  }
+
+  mbed::SPI spi;
+  mbed::DigitalOut latchPin;
+  mbed::DigitalOut* enablePin;
+  volatile bool disabled = false;
+  alignas(mbed::DigitalOut) uint8_t enableStorage[sizeof(mbed::DigitalOut)];
+};
+
+alignas(SpiShiftChainBus) static uint8_t g_valveBusStorage[sizeof(SpiShiftChainBus)];
+static SpiShiftChainBus* g_valveBus = nullptr;
+
+static void setChainOutput(int index, bool open) {
+  core_util_critical_section_enter();
+  if (open) {
+    g_chainOutputs |= 1u << index;
+  } else {
+    g_chainOutputs &= ~(1u << index);
+  }
+  core_util_critical_section_exit();
+}
+
+// One frame for every change made since the last
+static void sendChainOutputs() {
+  core_util_critical_section_enter();
+  shiftChainWrite(&g_valveChain, g_chainOutputs);
+  core_util_critical_section_exit();
+}
+
+//----------------------------------------------------------------------------//
+// Engine
+//----------------------------------------------------------------------------//
+
+void outputEngineBegin() {
+  g_wifiLed = new (g_wifiLedStorage) mbed::PwmOut(digitalPinToPinName(wifi_led_pin));
+  g_wifiLed->period_ms(LED_PWM_PERIOD_MS);
+  g_wifiLed->write(0.0f);
+  g_wifiPattern = LED_OFF;
+
+  if (valve_shift_registers > 0) {
+    g_valveBus = new (g_valveBusStorage) SpiShiftChainBus();
+    core_util_critical_section_enter();
+    shiftChainBegin(&g_valveChain, g_valveBus, valve_shift_registers);
+    core_util_critical_section_exit();
+  }
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    g_zones[i].index = i;
+    g_zones[i].pin = nullptr;
+    if (valve_shift_registers == 0) {
+      g_zones[i].pin = new (g_zonePinStorage[i]) mbed::DigitalOut(digitalPinToPinName(ZONE_PINS[i]), 0);
+    }
+    g_zones[i].open = false;
+    g_zones[i].closeBy = 0;
+  }
+  g_zonesReady = true;
+}
+
+void outputSetWifiLed(LedPattern pattern) {
+  if (g_wifiLed == nullptr || pattern == g_wifiPattern) {
+    return;
+  }
+  switch (pattern) {
+    case LED_ON:
+      g_wifiLed->write(1.0f);
+      break;
+    case LED_BLINK_2HZ:
+      g_wifiLed->write(0.5f);
+      break;
+    case LED_OFF:
+    default:
+      g_wifiLed->write(0.0f);
+      break;
+  }
+  g_wifiPattern = pattern;
+  g_outputStats.patternChanges++;
+}
+
+// Timer interrupt: the zone's window is over
+static void closeZoneOnDeadline(ZoneOutput* zone) {
+  if (zone->pin != nullptr) {
+    zone->pin->write(0);
+  } else {
+    setChainOutput(zone->index, false);
+    sendChainOutputs();
+  }
+  g_timerCloses++;
+}
+
+void outputSetZones(uint8_t openMask, const uint64_t* closeBy) {
+  if (!g_zonesReady) {
+    return;
+  }
+  bool chainChanged = false;
+  uint64_t now = clockMonotonicMs();
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    ZoneOutput& zone = g_zones[i];
+    bool open = openMask & (1 << i);
+    uint64_t deadline = (open && closeBy != nullptr) ? closeBy[i] : 0;
+    if (deadline != 0 && deadline <= now) {
+      open = false;  // Window already over (the timer may have closed it)
+      deadline = 0;
+    }
+    if (open == zone.open && deadline == zone.closeBy) {
+      continue;
+    }
+
+    // Disarm first so the interrupt can't land between the two writes
+    zone.deadline.detach();
+    if (zone.pin != nullptr) {
+      zone.pin->write(open ? 1 : 0);
+    } else {
+      setChainOutput(i, open);  // Sent below, with the other zones' changes
+      chainChanged = true;
+    }
+    if (deadline != 0) {
+      zone.deadline.attach(mbed::callback(closeZoneOnDeadline, &zone),
+                           std::chrono::milliseconds(deadline - now));
+    }
+    zone.open = open;
+    zone.closeBy = deadline;
+    g_outputStats.zoneChanges++;
+  }
+  if (chainChanged) {
+    sendChainOutputs();
+  }
+}
+
+void outputForceAllClosed() {
+  if (!g_zonesReady) {
+    return;  // Before outputEngineBegin(), or already forced closed
+  }
+  core_util_critical_section_enter();
+  g_zonesReady = false;  // The loop can't reopen anything from here on
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    g_zones[i].deadline.detach();
+    if (g_zones[i].pin != nullptr) {
+      g_zones[i].pin->write(0);
+    }
+    g_zones[i].open = false;
+    g_zones[i].closeBy = 0;
+  }
+  if (g_valveBus != nullptr) {
+    g_valveBus->disableOutputs();
+    // Goes out after any transfer under way; a few tens of microseconds,
+    // so it is latched long before the fatal path's serial output is done
+    g_chainOutputs = 0;
+    shiftChainWrite(&g_valveChain, 0);
+  }
+  core_util_critical_section_exit();
+}
+
+const OutputEngineStats& outputEngineStats() {
+  g_outputStats.timerCloses = g_timerCloses;
+  if (valve_shift_registers > 0) {
+    core_util_critical_section_enter();
+    g_outputStats.valveFrames = g_valveChain.stats.latches;
+    g_outputStats.valveFramesMerged = g_valveChain.stats.merged;
+    core_util_critical_section_exit();
+  }
+  return g_outputStats;
+}
@@ -0,0 +1,83 @@
+#ifndef OUTPUT_ENGINE_H
+#define OUTPUT_ENGINE_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Timer-Driven Outputs
+//----------------------------------------------------------------------------//
+
+/*
+ * Owns the WiFi LED and the zone valve pins and times their edges in
+ * hardware, so they are exact however long loop() spends in a scan or an
+ * HTTP request:
+ *
+ *   WiFi LED   a PWM channel (500 ms period); a pattern is a duty cycle,
+ *              and the timer makes every blink edge with no CPU involvement
+ *   valves     GPIO outputs, or outputs of a shift register chain on SPI
+ *              (ShiftRegisterValves.h, when valve_shift_registers is set),
+ *              each with a one-shot hardware timeout; a zone opened with a
+ *              deadline closes at that moment from the timer interrupt,
+ *              whether or not the loop is running
+ *
+ * The loop hands over the current patterns every pass; unchanged ones are
+ * ignored, so the hardware is only touched when the state changes. On the
+ * chain, every zone changed in one call goes out in a single latched frame. A valve
+ * deadline is the latest moment the zone may stay open without the loop
+ * confirming it (see openZoneDeadlines() in ZoneSequencer.h).
+ *
+ * The WiFi LED pin must be PWM-capable, on a timer no other PWM output
+ * uses (the period is set once, for the blink).
+ */
+
+enum LedPattern {
+  LED_OFF,
+  LED_ON,
+  LED_BLINK_2HZ                 // 250 ms on, 250 ms off
+};
+
+struct OutputEngineStats {
+  unsigned long patternChanges; // WiFi LED pattern changes
+  unsigned long zoneChanges;    // Valve open/close/deadline changes from the loop
+  unsigned long timerCloses;    // Valves closed by their deadline timer
+  unsigned long valveFrames;    // Frames latched into the shift register chain
+  unsigned long valveFramesMerged; // Changes that rode along in a later frame
+};
+
+/**
+ * Take over the WiFi LED and zone pins, all off (call first in setup())
+ */
+void outputEngineBegin();
+
+/**
+ * Set the WiFi LED pattern
+ * @param pattern New pattern; the current one is left running
+ */
+void outputSetWifiLed(LedPattern pattern);
+
+/**
+ * Set which valves are open and until when
+ * A zone whose deadline has already passed stays closed.
+ * @param openMask Zones to open (bit 0 = zone 1), the rest close
+ * @param closeBy Per zone, monotonic time to close at regardless of the
+ *                loop (0 = no deadline); nullptr for none at all
+ */
+void outputSetZones(uint8_t openMask, const uint64_t* closeBy);
+
+/**
+ * Close every valve now and keep them closed, for the fail-safe path
+ * (watchdogFatal()): deadline timers are disarmed and later outputSetZones()
+ * calls are ignored until reset. On the shift register chain the outputs
+ * are disabled (/OE high) at once and an all-off frame follows, for chains
+ * without /OE wired. Safe with interrupts enabled or not, and before
+ * outputEngineBegin() (nothing has been driven since reset then).
+ */
+void outputForceAllClosed();
+
+/**
+ * Output counters
+ * @return Statistics since boot
+ */
+const OutputEngineStats& outputEngineStats();
+
+#endif // OUTPUT_ENGINE_H
@@ -0,0 +1,127 @@
+#include "ScheduleJson.h"
+#include "Arena.h"
+#include "Inflate.h"
+#include <ArduinoJson.h>
+
+//----------------------------------------------------------------------------//
+// JSON Arena
+//----------------------------------------------------------------------------//
+
+// Generous headroom over the document for today's ~45-byte body; a body that
+// outgrows it fails to parse with NoMemory
+static const size_t JSON_ARENA_CAPACITY = 4096;
+
+static Arena<JSON_ARENA_CAPACITY> g_jsonArena;
+
+// Routes ArduinoJson's allocations into g_jsonArena instead of the heap
+class JsonArenaAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override { return g_jsonArena.allocate(size); }
+  void deallocate(void*) override {}  // Whole arena is reset after each parse
+  void* reallocate(void* ptr, size_t size) override { return g_jsonArena.reallocate(ptr, size); }
+};
+
+static JsonArenaAllocator g_jsonAllocator;
+
+//----------------------------------------------------------------------------//
+// Parsing
+//----------------------------------------------------------------------------//
+
+// Feeds ArduinoJson straight from the decoder, so a compressed body is
+// never held whole, compressed or not
+class InflateReader {
+public:
+  explicit InflateReader(Inflater* inflater) : inflater(inflater) {}
+
+  int read() { return inflateRead(inflater); }
+
+  size_t readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    for (int c; count < length && (c = inflateRead(inflater)) >= 0;) {
+      buffer[count++] = (char)c;
+    }
+    return count;
+  }
+
+private:
+  Inflater* inflater;
+};
+
+// Turn a parsed (or failed) document into a patch
+static bool patchFromDocument(JsonDocument& doc, DeserializationError error, SchedulePatch* patch) {
+  if (error) {
+    Serial.print("JSON parsing failed: ");
+    Serial.println(error.c_str());
+    return false;  // NoMemory here means the body outgrew JSON_ARENA_CAPACITY
+  }
+  
+  if (!doc.is<JsonObject>()) {
+    Serial.println("JSON parsing failed: not an object");
+    return false;
+  }
+  
+  // "seq" numbers the version; with "base" the body is a delta against that
+  // version. A body with neither is a snapshot from a server that doesn't
+  // version its schedules.
+  JsonVariant seq = doc["seq"];
+  JsonVariant base = doc["base"];
+  if ((!seq.isNull() && !seq.is<uint32_t>()) || (!base.isNull() && (!base.is<uint32_t>() || seq.isNull()))) {
+    Serial.println("JSON parsing failed: bad seq/base");
+    return false;
+  }
+  patch->seq = seq | 0UL;
+  patch->full = base.isNull();
+  patch->baseSeq = base | 0UL;
+  
+  // A snapshot sets every zone (missing means off); a delta only the zones
+  // it names
+  static const char* const ZONE_KEYS[ZONE_COUNT] = {"zone1", "zone2", "zone3"};
+  patch->changedMask = patch->full ? (1 << ZONE_COUNT) - 1 : 0;
+  patch->valueMask = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    JsonVariant zone = doc[ZONE_KEYS[i]];
+    if (zone.isNull()) {
+      continue;
+    }
+    if (!zone.is<bool>()) {
+      Serial.println("JSON parsing failed: zone is not a boolean");
+      return false;
+    }
+    patch->changedMask |= 1 << i;
+    if (zone.as<bool>()) {
+      patch->valueMask |= 1 << i;
+    }
+  }
+  
+  Serial.print(patch->full ? "Zone schedule: " : "Zone changes: ");
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (patch->changedMask & (1 << i)) {
+      Serial.print(patch->valueMask & (1 << i) ? "1" : "0");
+    } else {
+      Serial.print("-");
+    }
+  }
+  Serial.print(" seq=");
+  Serial.println(patch->seq);
+  
+  return true;
+}
+
+bool parseScheduleJson(const char* json, size_t length, SchedulePatch* patch) {
+  // Create JSON document for parsing; its memory comes from the static arena,
+  // which starts empty for every parse
+  g_jsonArena.reset();
+  JsonDocument doc(&g_jsonAllocator);
+  return patchFromDocument(doc, deserializeJson(doc, json, length), patch);
+}
+
+bool parseScheduleJson(Inflater* body, SchedulePatch* patch) {
+  g_jsonArena.reset();
+  JsonDocument doc(&g_jsonAllocator);
+  InflateReader reader(body);
+  return patchFromDocument(doc, deserializeJson(doc, reader), patch);
+}
+
+size_t scheduleJsonArenaUsed() {
+  return g_jsonArena.bytesUsed();
+}
@@ -0,0 +1,54 @@
+#ifndef SCHEDULE_JSON_H
+#define SCHEDULE_JSON_H
+
+#include "Types.h"
+#include <stddef.h>
+
+struct Inflater;
+
+//----------------------------------------------------------------------------//
+// Schedule Response Parsing
+//----------------------------------------------------------------------------//
+
+/*
+ * Turns a schedule response body into a SchedulePatch. ArduinoJson's document
+ * lives in a static arena that is reset at the start of every parse, so
+ * parsing never touches the heap; a body whose document doesn't fit the
+ * arena is rejected like any other bad body.
+ *
+ * A compressed body is parsed straight out of the Inflater (Inflate.h) as
+ * it decodes, without a buffer for the decoded text.
+ *
+ * Pure code (ArduinoJson and Serial only): the firmware calls it from
+ * pollIrrigationSchedule(), host tools link it directly.
+ */
+
+/**
+ * Parse a schedule response into a patch
+ * Snapshot: {"seq":7,"zone1":true,"zone2":false,"zone3":true}
+ * Delta:    {"seq":9,"base":7,"zone2":true} (only the changed zones)
+ * A body without "seq" is an unversioned snapshot. Uses a static arena for
+ * the JSON document, never the heap.
+ * @param json JSON text to parse
+ * @param length Length of `json` in bytes
+ * @param patch Output patch
+ * @return true if parsing successful, false otherwise
+ */
+bool parseScheduleJson(const char* json, size_t length, SchedulePatch* patch);
+
+/**
+ * Parse a schedule response as it decompresses; reads up to the end of the
+ * JSON value, so the caller checks the stream's trailer with inflateFinish()
+ * @param body Decoder positioned at the start of the body
+ * @param patch Output patch
+ * @return true if parsing successful, false otherwise
+ */
+bool parseScheduleJson(Inflater* body, SchedulePatch* patch);
+
+/**
+ * Arena bytes taken by the last parse's document
+ * @return Bytes in use, 0 before the first parse
+ */
+size_t scheduleJsonArenaUsed();
+
+#endif // SCHEDULE_JSON_H
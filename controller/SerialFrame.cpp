@@ -0,0 +1,315 @@
+#include "SerialFrame.h"
+#include "Checksum.h"
+#include <string.h>
+
+//----------------------------------------------------------------------------//
+// Consistent Overhead Byte Stuffing
+//----------------------------------------------------------------------------//
+
+// Each block is a code byte (one more than the non-zero bytes that follow)
+// standing in for the zero after them; 0xFF is a full block with no zero
+static const uint8_t COBS_FULL_BLOCK = 0xFF;
+
+// Decoded output never gets ahead of the input, so this works in place
+static bool cobsDecode(uint8_t* data, size_t length, size_t* decoded) {
+  size_t in = 0;
+  size_t out = 0;
+  while (in < length) {
+    uint8_t code = data[in++];
+    if (code == 0) {
+      return false;
+    }
+    for (uint8_t i = 1; i < code; i++) {
+      if (in >= length) {
+        return false;
+      }
+      data[out++] = data[in++];
+    }
+    if (code != COBS_FULL_BLOCK && in < length) {
+      data[out++] = 0;
+    }
+  }
+  *decoded = out;
+  return true;
+}
+
+// Body byte i of a frame: type, tag, payload, then the CRC little-endian
+static uint8_t bodyByte(const SerialFrame& frame, uint32_t crc, size_t i) {
+  if (i == 0) {
+    return frame.type;
+  }
+  if (i == 1) {
+    return frame.tag;
+  }
+  if (i < frame.length + 2) {
+    return frame.payload[i - 2];
+  }
+  return (uint8_t)(crc >> (8 * (i - 2 - frame.length)));
+}
+
+//----------------------------------------------------------------------------//
+// Framing
+//----------------------------------------------------------------------------//
+
+void serialFrameReaderReset(SerialFrameReader* reader) {
+  reader->length = 0;
+  reader->inFrame = false;
+  reader->overflow = false;
+  reader->lastByteAt = 0;
+}
+
+static bool decodeFrame(SerialFrameReader* reader) {
+  size_t length;
+  if (!cobsDecode(reader->wire, reader->length, &length) || length < 6) {
+    return false;
+  }
+  const uint8_t* body = reader->wire;
+  size_t payloadLength = length - 6;
+  uint32_t crc = (uint32_t)body[length - 4] | (uint32_t)body[length - 3] << 8 |
+                 (uint32_t)body[length - 2] << 16 | (uint32_t)body[length - 1] << 24;
+  if (crc32(body, length - 4) != crc) {
+    return false;
+  }
+  reader->frame.type = body[0];
+  reader->frame.tag = body[1];
+  memcpy(reader->frame.payload, body + 2, payloadLength);
+  reader->frame.length = payloadLength;
+  return true;
+}
+
+SerialByte serialFrameFeed(SerialFrameReader* reader, uint8_t byte, unsigned long now) {
+  if (reader->inFrame && now - reader->lastByteAt > SERIAL_FRAME_TIMEOUT_MS) {
+    reader->inFrame = false;  // The sender gave up; this byte starts afresh
+  }
+  reader->lastByteAt = now;
+
+  if (!reader->inFrame) {
+    if (byte != SERIAL_FRAME_START) {
+      return SERIAL_BYTE_CONSOLE;
+    }
+    reader->inFrame = true;
+    reader->overflow = false;
+    reader->length = 0;
+    return SERIAL_BYTE_FRAMED;
+  }
+
+  if (byte == SERIAL_FRAME_END) {
+    reader->inFrame = false;
+    if (reader->overflow || !decodeFrame(reader)) {
+      return SERIAL_BYTE_FRAME_BAD;
+    }
+    return SERIAL_BYTE_FRAME_READY;
+  }
+
+  if (reader->length < sizeof(reader->wire)) {
+    reader->wire[reader->length++] = byte;
+  } else {
+    reader->overflow = true;
+  }
+  return SERIAL_BYTE_FRAMED;
+}
+
+void serialFrameBegin(SerialFrame* frame, uint8_t type, uint8_t tag) {
+  frame->type = type;
+  frame->tag = tag;
+  frame->length = 0;
+}
+
+size_t serialFrameEncode(const SerialFrame& frame, uint8_t* wire) {
+  uint8_t head[2] = {frame.type, frame.tag};
+  uint32_t crc = crc32(frame.payload, frame.length, crc32(head, sizeof(head)));
+  size_t bodyLength = frame.length + 6;
+
+  size_t out = 0;
+  wire[out++] = SERIAL_FRAME_START;
+  size_t codeAt = out++;
+  uint8_t code = 1;
+  for (size_t i = 0; i < bodyLength; i++) {
+    uint8_t byte = bodyByte(frame, crc, i);
+    if (byte == 0) {
+      wire[codeAt] = code;
+      codeAt = out++;
+      code = 1;
+      continue;
+    }
+    wire[out++] = byte;
+    if (++code == COBS_FULL_BLOCK) {
+      wire[codeAt] = code;
+      codeAt = out++;
+      code = 1;
+    }
+  }
+  wire[codeAt] = code;
+  wire[out++] = SERIAL_FRAME_END;
+  return out;
+}
+
+//----------------------------------------------------------------------------//
+// Payload Fields
+//----------------------------------------------------------------------------//
+
+bool serialPutBytes(SerialFrame* frame, const void* data, size_t length) {
+  if (length > SERIAL_PAYLOAD_CAPACITY - frame->length) {
+    return false;
+  }
+  memcpy(frame->payload + frame->length, data, length);
+  frame->length += length;
+  return true;
+}
+
+static bool putLittleEndian(SerialFrame* frame, uint64_t value, size_t size) {
+  uint8_t bytes[8];
+  for (size_t i = 0; i < size; i++) {
+    bytes[i] = (uint8_t)(value >> (8 * i));
+  }
+  return serialPutBytes(frame, bytes, size);
+}
+
+bool serialPut8(SerialFrame* frame, uint8_t value) { return putLittleEndian(frame, value, 1); }
+bool serialPut16(SerialFrame* frame, uint16_t value) { return putLittleEndian(frame, value, 2); }
+bool serialPut32(SerialFrame* frame, uint32_t value) { return putLittleEndian(frame, value, 4); }
+bool serialPut64(SerialFrame* frame, uint64_t value) { return putLittleEndian(frame, value, 8); }
+
+bool serialTakeBytes(SerialCursor* cursor, void* data, size_t length) {
+  if (cursor->offset > cursor->frame->length || length > cursor->frame->length - cursor->offset) {
+    memset(data, 0, length);
+    cursor->offset = cursor->frame->length;
+    cursor->overrun = true;
+    return false;
+  }
+  memcpy(data, cursor->frame->payload + cursor->offset, length);
+  cursor->offset += length;
+  return true;
+}
+
+static uint64_t takeLittleEndian(SerialCursor* cursor, size_t size) {
+  uint8_t bytes[8];
+  serialTakeBytes(cursor, bytes, size);
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= (uint64_t)bytes[i] << (8 * i);
+  }
+  return value;
+}
+
+uint8_t serialTake8(SerialCursor* cursor) { return (uint8_t)takeLittleEndian(cursor, 1); }
+uint16_t serialTake16(SerialCursor* cursor) { return (uint16_t)takeLittleEndian(cursor, 2); }
+uint32_t serialTake32(SerialCursor* cursor) { return (uint32_t)takeLittleEndian(cursor, 4); }
+uint64_t serialTake64(SerialCursor* cursor) { return takeLittleEndian(cursor, 8); }
+
+// ControllerStatus flag bits
+static const uint8_t STATUS_HAS_SCHEDULE = 0x01;
+static const uint8_t STATUS_FAIL_SAFE = 0x02;
+static const uint8_t STATUS_POLL_FAILING = 0x04;
+
+bool serialPutStatus(SerialFrame* frame, const ControllerStatus& status) {
+  uint8_t flags = (status.hasSchedule ? STATUS_HAS_SCHEDULE : 0) |
+                  (status.failSafeActive ? STATUS_FAIL_SAFE : 0) |
+                  (status.pollFailing ? STATUS_POLL_FAILING : 0);
+  bool ok = serialPut8(frame, (uint8_t)status.mode) && serialPut8(frame, flags) &&
+            serialPut32(frame, status.uptimeS) && serialPut32(frame, status.scheduleSeq) &&
+            serialPut32(frame, status.scheduleAgeS) && serialPut8(frame, status.scheduledMask) &&
+            serialPut8(frame, status.wetMask) && serialPut8(frame, status.overrideMask) &&
+            serialPut8(frame, status.overrideOpenMask) && serialPut8(frame, status.openMask) &&
+            serialPut8(frame, status.waitingMask) && serialPut8(frame, (uint8_t)ZONE_COUNT);
+  for (int i = 0; ok && i < ZONE_COUNT; i++) {
+    ok = serialPut32(frame, status.overrideLeftS[i]) && serialPut16(frame, status.moisturePermille[i]);
+  }
+  return ok;
+}
+
+bool serialTakeStatus(SerialCursor* cursor, ControllerStatus* status) {
+  status->mode = (AppMode)serialTake8(cursor);
+  uint8_t flags = serialTake8(cursor);
+  status->hasSchedule = (flags & STATUS_HAS_SCHEDULE) != 0;
+  status->failSafeActive = (flags & STATUS_FAIL_SAFE) != 0;
+  status->pollFailing = (flags & STATUS_POLL_FAILING) != 0;
+  status->uptimeS = serialTake32(cursor);
+  status->scheduleSeq = serialTake32(cursor);
+  status->scheduleAgeS = serialTake32(cursor);
+  status->scheduledMask = serialTake8(cursor);
+  status->wetMask = serialTake8(cursor);
+  status->overrideMask = serialTake8(cursor);
+  status->overrideOpenMask = serialTake8(cursor);
+  status->openMask = serialTake8(cursor);
+  status->waitingMask = serialTake8(cursor);
+  if (serialTake8(cursor) != ZONE_COUNT) {
+    return false;  // Built for a different board
+  }
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    status->overrideLeftS[i] = serialTake32(cursor);
+    status->moisturePermille[i] = serialTake16(cursor);
+  }
+  return !cursor->overrun;
+}
+
+bool serialPutNetwork(SerialFrame* frame, const Credentials& creds) {
+  size_t ssidLength = strnlen(creds.ssid, sizeof(creds.ssid) - 1);
+  size_t passLength = strnlen(creds.pass, sizeof(creds.pass) - 1);
+  if (frame->length + ssidLength + passLength + 2 > SERIAL_PAYLOAD_CAPACITY) {
+    return false;
+  }
+  return serialPut8(frame, (uint8_t)ssidLength) && serialPutBytes(frame, creds.ssid, ssidLength) &&
+         serialPut8(frame, (uint8_t)passLength) && serialPutBytes(frame, creds.pass, passLength);
+}
+
+bool serialTakeNetwork(SerialCursor* cursor, Credentials* creds) {
+  uint8_t ssidLength = serialTake8(cursor);
+  if (ssidLength == 0 || ssidLength >= sizeof(creds->ssid) ||
+      !serialTakeBytes(cursor, creds->ssid, ssidLength)) {
+    return false;
+  }
+  creds->ssid[ssidLength] = '\0';
+  uint8_t passLength = serialTake8(cursor);
+  if (passLength >= sizeof(creds->pass) || !serialTakeBytes(cursor, creds->pass, passLength)) {
+    return false;
+  }
+  creds->pass[passLength] = '\0';
+  return !cursor->overrun;
+}
+
+bool serialPutTrace(SerialFrame* frame, const SerialTraceRecord& record) {
+  if (frame->length + SERIAL_TRACE_RECORD_SIZE > SERIAL_PAYLOAD_CAPACITY) {
+    return false;
+  }
+  serialPut32(frame, record.atMs);
+  serialPut8(frame, record.input);
+  serialPut8(frame, record.mode);
+  serialPut8(frame, record.openMask);
+  serialPut8(frame, record.effectSeq);
+  return true;
+}
+
+bool serialTakeTrace(SerialCursor* cursor, SerialTraceRecord* record) {
+  record->atMs = serialTake32(cursor);
+  record->input = serialTake8(cursor);
+  record->mode = serialTake8(cursor);
+  record->openMask = serialTake8(cursor);
+  record->effectSeq = serialTake8(cursor);
+  return !cursor->overrun;
+}
+
+const char* serialCounterName(uint8_t id) {
+  switch (id) {
+    case SERIAL_COUNTER_EFFECTS_EXECUTED: return "effects.executed";
+    case SERIAL_COUNTER_EFFECTS_DEFERRED: return "effects.deferred";
+    case SERIAL_COUNTER_EFFECT_REPEATS_SKIPPED: return "effects.repeats_skipped";
+    case SERIAL_COUNTER_EFFECT_IO_REPEATS_SKIPPED: return "effects.io_repeats_skipped";
+    case SERIAL_COUNTER_POLLS_HELD_IN_FLIGHT: return "effects.polls_held_in_flight";
+    case SERIAL_COUNTER_JOURNAL_APPENDED: return "journal.appended";
+    case SERIAL_COUNTER_JOURNAL_DROPPED: return "journal.dropped";
+    case SERIAL_COUNTER_JOURNAL_FLUSHES: return "journal.flushes";
+    case SERIAL_COUNTER_JOURNAL_ERASES: return "journal.erases";
+    case SERIAL_COUNTER_JOURNAL_FAILURES: return "journal.failures";
+    case SERIAL_COUNTER_HEAP_IN_USE: return "heap.in_use_bytes";
+    case SERIAL_COUNTER_HEAP_PEAK: return "heap.peak_bytes";
+    case SERIAL_COUNTER_HEAP_ALLOCATIONS: return "heap.allocations";
+    case SERIAL_COUNTER_VALVE_TIMER_CLOSES: return "valves.timer_closes";
+    case SERIAL_COUNTER_LINK_FRAMES: return "link.frames";
+    case SERIAL_COUNTER_LINK_BAD_FRAMES: return "link.bad_frames";
+    case SERIAL_COUNTER_LINK_TRACE_DROPPED: return "link.trace_dropped";
+    case SERIAL_COUNTER_VALVE_FRAMES: return "valves.frames";
+    case SERIAL_COUNTER_VALVE_FRAMES_MERGED: return "valves.frames_merged";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,238 @@
+#ifndef SERIAL_FRAME_H
+#define SERIAL_FRAME_H
+
+#include "NetworkMailbox.h"
+
+//----------------------------------------------------------------------------//
+// Binary Serial Frames
+//----------------------------------------------------------------------------//
+
+/*
+ * A framed, CRC-checked binary protocol that shares the USB serial port with
+ * the human console, for bench tools (host/serial-tool) that provision units
+ * and pull diagnostics faster and more reliably than the console can:
+ *
+ *   0x01  COBS( type | tag | payload... | CRC-32 LE )  0x00
+ *   SOH                                                 end
+ *
+ * COBS removes every 0x00 from the body, so 0x00 only ever ends a frame, and
+ * console text never contains 0x00 or 0x01 - one byte stream carries both
+ * without escaping the console. A damaged frame fails its CRC and is
+ * dropped; one that lost its end byte takes the frame after it along, and
+ * the reader is back in step at the next 0x00. A frame left unfinished for
+ * SERIAL_FRAME_TIMEOUT_MS is abandoned, so a tool that dies mid-write can't
+ * capture the console.
+ *
+ * Requests carry a tag the device echoes in its reply, so a tool can pipeline
+ * requests and match the answers. Replies are the request type | 0x80;
+ * journal and trace data stream back as several frames of their own types.
+ * Multi-byte fields are little-endian.
+ *
+ * Pure code: the device side is in SerialLink.cpp, and the host tool links
+ * this file as is.
+ */
+
+const uint8_t SERIAL_PROTOCOL_VERSION = 1;
+
+const uint8_t SERIAL_FRAME_START = 0x01;
+const uint8_t SERIAL_FRAME_END = 0x00;
+
+const size_t SERIAL_PAYLOAD_CAPACITY = 1024;
+// Type, tag, payload and CRC
+const size_t SERIAL_BODY_CAPACITY = SERIAL_PAYLOAD_CAPACITY + 6;
+// Start byte, COBS overhead (one byte per 254, plus one) and end byte
+const size_t SERIAL_WIRE_CAPACITY = SERIAL_BODY_CAPACITY + SERIAL_BODY_CAPACITY / 254 + 3;
+
+const unsigned long SERIAL_FRAME_TIMEOUT_MS = 500;
+
+enum SerialMessageType {
+  // Requests (host to device); each is answered by type | SERIAL_REPLY
+  SERIAL_PING = 0x01,             // -> version, firmware_version, uptime
+  SERIAL_GET_STATE = 0x02,        // -> ControllerStatus
+  SERIAL_GET_COUNTERS = 0x03,     // -> (SerialCounter id, value) pairs
+  SERIAL_GET_HISTOGRAM = 0x04,    // -> loop pass times and per-stage worsts
+  SERIAL_WRITE_NETWORKS = 0x10,   // Replace the known networks -> count stored
+  SERIAL_READ_JOURNAL = 0x11,     // -> JOURNAL_RECORDS frames, then JOURNAL_END
+  SERIAL_TRACE = 0x12,            // Start/stop input tracing -> TRACE_RECORDS frames
+
+  // Streamed data (device to host), tagged like the request that started it
+  SERIAL_JOURNAL_RECORDS = 0xA0,  // Raw JournalRecords, oldest first
+  SERIAL_JOURNAL_END = 0xA1,      // Records sent, damaged slots skipped at boot
+  SERIAL_TRACE_RECORDS = 0xA2,    // Records lost so far, then SerialTraceRecords
+
+  SERIAL_ERROR = 0xFF             // The request failed: one SerialError byte
+};
+
+const uint8_t SERIAL_REPLY = 0x80;
+
+enum SerialError {
+  SERIAL_ERROR_UNKNOWN_TYPE = 1,  // Not a request this firmware knows
+  SERIAL_ERROR_BAD_PAYLOAD = 2,   // Too short, too long or out of range
+  SERIAL_ERROR_BUSY = 3,          // A journal dump is already streaming
+  SERIAL_ERROR_UNAVAILABLE = 4    // The journal isn't usable
+};
+
+// SERIAL_WRITE_NETWORKS flags
+const uint8_t SERIAL_NETWORKS_CONNECT = 0x01;  // Join the first network now
+
+// SERIAL_GET_HISTOGRAM flags
+const uint8_t SERIAL_HISTOGRAM_RESET = 0x01;   // Clear the pass histogram after reading
+
+// Counter IDs in a SERIAL_GET_COUNTERS reply; new ones are only ever added
+enum SerialCounter {
+  SERIAL_COUNTER_EFFECTS_EXECUTED = 1,
+  SERIAL_COUNTER_EFFECTS_DEFERRED,
+  SERIAL_COUNTER_EFFECT_REPEATS_SKIPPED,
+  SERIAL_COUNTER_EFFECT_IO_REPEATS_SKIPPED,
+  SERIAL_COUNTER_POLLS_HELD_IN_FLIGHT,
+  SERIAL_COUNTER_JOURNAL_APPENDED,
+  SERIAL_COUNTER_JOURNAL_DROPPED,
+  SERIAL_COUNTER_JOURNAL_FLUSHES,
+  SERIAL_COUNTER_JOURNAL_ERASES,
+  SERIAL_COUNTER_JOURNAL_FAILURES,
+  SERIAL_COUNTER_HEAP_IN_USE,
+  SERIAL_COUNTER_HEAP_PEAK,
+  SERIAL_COUNTER_HEAP_ALLOCATIONS,
+  SERIAL_COUNTER_VALVE_TIMER_CLOSES,
+  SERIAL_COUNTER_LINK_FRAMES,
+  SERIAL_COUNTER_LINK_BAD_FRAMES,
+  SERIAL_COUNTER_LINK_TRACE_DROPPED,
+  SERIAL_COUNTER_VALVE_FRAMES,
+  SERIAL_COUNTER_VALVE_FRAMES_MERGED,
+  SERIAL_COUNTER_COUNT
+};
+
+// One machine step, as captured by SERIAL_TRACE (8 bytes on the wire)
+struct SerialTraceRecord {
+  uint32_t atMs;                  // Input.nowMs, low 32 bits
+  uint8_t input;                  // InputType
+  uint8_t mode;                   // AppMode after the step
+  uint8_t openMask;               // Valves open after the step
+  uint8_t effectSeq;              // AppState.effectSeq after the step, low 8 bits
+};
+
+const size_t SERIAL_TRACE_RECORD_SIZE = 8;
+
+struct SerialFrame {
+  uint8_t type;                   // SerialMessageType
+  uint8_t tag;                    // Chosen by the host, echoed in replies
+  uint8_t payload[SERIAL_PAYLOAD_CAPACITY];
+  size_t length;                  // Payload bytes
+};
+
+struct SerialFrameReader {
+  uint8_t wire[SERIAL_WIRE_CAPACITY];  // COBS bytes of the frame so far
+  size_t length;
+  bool inFrame;                   // Between a start byte and its end byte
+  bool overflow;                  // Frame outgrew `wire`; discard until its end
+  unsigned long lastByteAt;       // To abandon a frame that stops arriving
+  SerialFrame frame;              // The last frame decoded
+};
+
+enum SerialByte {
+  SERIAL_BYTE_CONSOLE,            // Console text: not part of any frame
+  SERIAL_BYTE_FRAMED,             // Consumed by the frame in progress
+  SERIAL_BYTE_FRAME_READY,        // Completed a valid frame (reader.frame)
+  SERIAL_BYTE_FRAME_BAD           // Completed a frame that failed to decode
+};
+
+// Read position in a received frame's payload; reads past the end return 0
+struct SerialCursor {
+  const SerialFrame* frame;
+  size_t offset;
+  bool overrun;                   // Some read ran past the payload
+
+  explicit SerialCursor(const SerialFrame& f) : frame(&f), offset(0), overrun(false) {}
+  bool atEnd() const { return offset >= frame->length; }
+};
+
+/**
+ * Start a reader outside any frame
+ * @param reader Reader to reset
+ */
+void serialFrameReaderReset(SerialFrameReader* reader);
+
+/**
+ * Sort one received byte into console text or frame
+ * @param reader Reader state
+ * @param byte Byte received
+ * @param now millis(), to abandon stalled frames
+ * @return What the byte was; on SERIAL_BYTE_FRAME_READY reader->frame holds the frame
+ */
+SerialByte serialFrameFeed(SerialFrameReader* reader, uint8_t byte, unsigned long now);
+
+/**
+ * Start an outgoing frame with an empty payload
+ * @param frame Frame to reset
+ * @param type SerialMessageType
+ * @param tag Tag of the request being answered
+ */
+void serialFrameBegin(SerialFrame* frame, uint8_t type, uint8_t tag);
+
+/**
+ * Encode a frame for the wire
+ * @param frame Frame to send
+ * @param wire Output, at least SERIAL_WIRE_CAPACITY bytes
+ * @return Bytes to send
+ */
+size_t serialFrameEncode(const SerialFrame& frame, uint8_t* wire);
+
+//----------------------------------------------------------------------------//
+// Payload Fields
+//----------------------------------------------------------------------------//
+
+// Appends return false (and append nothing) if the payload is full
+
+bool serialPut8(SerialFrame* frame, uint8_t value);
+bool serialPut16(SerialFrame* frame, uint16_t value);
+bool serialPut32(SerialFrame* frame, uint32_t value);
+bool serialPut64(SerialFrame* frame, uint64_t value);
+bool serialPutBytes(SerialFrame* frame, const void* data, size_t length);
+
+uint8_t serialTake8(SerialCursor* cursor);
+uint16_t serialTake16(SerialCursor* cursor);
+uint32_t serialTake32(SerialCursor* cursor);
+uint64_t serialTake64(SerialCursor* cursor);
+bool serialTakeBytes(SerialCursor* cursor, void* data, size_t length);
+
+/**
+ * Append a status snapshot (the SERIAL_GET_STATE reply)
+ * @param frame Reply being built
+ * @param status Snapshot to encode
+ * @return false if it didn't fit
+ */
+bool serialPutStatus(SerialFrame* frame, const ControllerStatus& status);
+
+/**
+ * @param cursor Position in a SERIAL_GET_STATE reply
+ * @param status Output snapshot
+ * @return false if the payload was too short
+ */
+bool serialTakeStatus(SerialCursor* cursor, ControllerStatus* status);
+
+/**
+ * Append one network of a SERIAL_WRITE_NETWORKS request (length-prefixed
+ * SSID, then password)
+ * @param frame Request being built
+ * @param creds Network to add
+ * @return false if it didn't fit
+ */
+bool serialPutNetwork(SerialFrame* frame, const Credentials& creds);
+
+/**
+ * @param cursor Position in a SERIAL_WRITE_NETWORKS request
+ * @param creds Output network
+ * @return false if the payload was short or the SSID is empty or too long
+ */
+bool serialTakeNetwork(SerialCursor* cursor, Credentials* creds);
+
+bool serialPutTrace(SerialFrame* frame, const SerialTraceRecord& record);
+bool serialTakeTrace(SerialCursor* cursor, SerialTraceRecord* record);
+
+/**
+ * @param id SerialCounter
+ * @return Counter name for tools, or "unknown"
+ */
+const char* serialCounterName(uint8_t id);
+
+#endif // SERIAL_FRAME_H
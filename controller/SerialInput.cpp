@@ -0,0 +1,116 @@
+#include "SerialInput.h"
+#include "SerialLink.h"
+
+//----------------------------------------------------------------------------//
+// Line Editor State
+//----------------------------------------------------------------------------//
+
+enum CredentialEntryStage {
+  STAGE_SSID,                     // Collecting the SSID line
+  STAGE_PASSWORD                  // Collecting the password line
+};
+
+struct CredentialEntry {
+  CredentialEntryStage stage;
+  char line[64];                  // Current line (same size as Credentials fields)
+  size_t length;                  // Characters in `line`
+  bool overflow;                  // Line grew past 63 characters
+  unsigned long lastActivity;     // millis() of the last byte received
+  Credentials creds;              // Accepted lines so far
+};
+
+static CredentialEntry g_entry;
+
+static void resetLine() {
+  g_entry.length = 0;
+  g_entry.overflow = false;
+  g_entry.line[0] = '\0';
+}
+
+//----------------------------------------------------------------------------//
+// Serial Input Functions
+//----------------------------------------------------------------------------//
+
+void flushSerialInput() {
+  while (serialConsoleRead() >= 0) {}  // Discard queued console text (frames never queue here)
+}
+
+void beginCredentialEntry() {
+  flushSerialInput();  // Clear any stale input
+  g_entry.stage = STAGE_SSID;
+  g_entry.lastActivity = millis();
+  g_entry.creds.ssid[0] = '\0';
+  g_entry.creds.pass[0] = '\0';
+  resetLine();
+  Serial.println("Enter SSID:");
+}
+
+// Accept the current line into the active field
+// Returns false if the line has an invalid length (1-63 characters required)
+static bool commitLine() {
+  // Trim trailing whitespace (leading whitespace is never stored)
+  while (g_entry.length > 0 && isspace((unsigned char)g_entry.line[g_entry.length - 1])) {
+    g_entry.length--;
+  }
+  g_entry.line[g_entry.length] = '\0';
+
+  if (g_entry.overflow || g_entry.length == 0) {
+    return false;
+  }
+
+  char* field = (g_entry.stage == STAGE_SSID) ? g_entry.creds.ssid : g_entry.creds.pass;
+  memcpy(field, g_entry.line, g_entry.length + 1);
+  return true;
+}
+
+CredentialEntryResult pollCredentialEntry(Credentials* creds) {
+  if (millis() - g_entry.lastActivity > CREDENTIAL_ENTRY_TIMEOUT_MS) {
+    Serial.println("Credential entry timed out. Aborting.");
+    return CREDENTIAL_ENTRY_FAILED;
+  }
+
+  int byte;
+  for (int n = 0; n < CREDENTIAL_ENTRY_MAX_BYTES_PER_POLL && (byte = serialConsoleRead()) >= 0; n++) {
+    char c = (char)byte;
+    g_entry.lastActivity = millis();
+
+    if (c == '\r' || c == '\n') {
+      // Ignore blank lines so CRLF line endings don't submit an empty field
+      if (g_entry.length == 0 && !g_entry.overflow) continue;
+
+      if (!commitLine()) {
+        Serial.println(g_entry.stage == STAGE_SSID ? "Invalid SSID length. Aborting."
+                                                   : "Invalid password length. Aborting.");
+        return CREDENTIAL_ENTRY_FAILED;
+      }
+
+      if (g_entry.stage == STAGE_SSID) {
+        g_entry.stage = STAGE_PASSWORD;
+        resetLine();
+        Serial.println("Enter Password:");
+        continue;
+      }
+
+      *creds = g_entry.creds;
+      return CREDENTIAL_ENTRY_COMPLETE;
+    }
+
+    if (c == '\b' || c == 0x7f) {
+      // Backspace/delete edits the line in place
+      if (g_entry.length > 0) g_entry.length--;
+      continue;
+    }
+
+    if (g_entry.length == 0 && isspace((unsigned char)c)) {
+      continue;  // Skip leading whitespace
+    }
+
+    if (g_entry.length < sizeof(g_entry.line) - 1) {
+      g_entry.line[g_entry.length++] = c;
+    } else {
+      g_entry.overflow = true;  // Keep consuming until newline, then reject
+    }
+  }
+
+  return CREDENTIAL_ENTRY_PENDING;
+}
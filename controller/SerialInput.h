@@ -0,0 +1,50 @@
+#ifndef SERIAL_INPUT_H
+#define SERIAL_INPUT_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Non-Blocking Credential Entry
+//----------------------------------------------------------------------------//
+
+/*
+ * Credential entry is an incremental line editor. Each call to
+ * pollCredentialEntry() consumes whatever console text is already waiting
+ * (SerialLink.h; never waits for more) and returns immediately, so the main
+ * loop keeps stepping the machine, driving zones and polling while a user
+ * types. Lines are accumulated in a fixed buffer; no String is involved.
+ */
+
+// Give up on an abandoned prompt after this long without a keystroke
+const unsigned long CREDENTIAL_ENTRY_TIMEOUT_MS = 120000;  // 2 minutes
+
+// Upper bound on bytes consumed per call so a paste can't stall one loop
+const int CREDENTIAL_ENTRY_MAX_BYTES_PER_POLL = 64;
+
+enum CredentialEntryResult {
+  CREDENTIAL_ENTRY_PENDING,       // Still waiting for more input
+  CREDENTIAL_ENTRY_COMPLETE,      // SSID and password accepted
+  CREDENTIAL_ENTRY_FAILED         // Invalid length or timed out
+};
+
+/**
+ * Start a new credential entry session and print the SSID prompt
+ * Discards any stale serial input
+ */
+void beginCredentialEntry();
+
+/**
+ * Feed pending serial bytes into the credential line editor
+ * @param creds Populated with the entered credentials on completion
+ * @return CREDENTIAL_ENTRY_COMPLETE when both lines are accepted,
+ *         CREDENTIAL_ENTRY_FAILED on validation failure or timeout,
+ *         CREDENTIAL_ENTRY_PENDING otherwise
+ */
+CredentialEntryResult pollCredentialEntry(Credentials* creds);
+
+/**
+ * Clear any pending console text to prevent stale data
+ */
+void flushSerialInput();
+
+#endif // SERIAL_INPUT_H
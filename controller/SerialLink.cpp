@@ -0,0 +1,342 @@
+#include "SerialLink.h"
+#include "StateMachine.h"
+#include "WiFiCredentials.h"
+#include "EventLog.h"
+#include "LoopWatchdog.h"
+#include "HeapAudit.h"
+#include "OutputEngine.h"
+#include "Clock.h"
+
+static SerialLinkStats g_linkStats = {0, 0, 0, 0};
+static SerialFrameReader g_reader;
+static SerialFrame g_reply;               // Shared: each frame is sent before the next is built
+static uint8_t g_wire[SERIAL_WIRE_CAPACITY];
+
+// Console text, oldest at head
+static uint8_t g_console[SERIAL_CONSOLE_CAPACITY];
+static size_t g_consoleHead = 0;
+static size_t g_consoleCount = 0;
+
+struct JournalDump {
+  bool active;
+  uint8_t tag;                    // Of the READ_JOURNAL request
+  uint32_t sent;                  // Records sent so far
+  EventLogReader reader;
+};
+
+struct Trace {
+  bool active;
+  uint8_t tag;                    // Of the TRACE request
+  unsigned long startedAt;        // millis()
+  unsigned long durationMs;
+  SerialTraceRecord records[SERIAL_TRACE_CAPACITY];
+  int count;                      // Captured, not yet sent
+};
+
+static JournalDump g_dump;
+static Trace g_trace;
+
+// Journal records per JOURNAL_RECORDS frame
+static const size_t JOURNAL_RECORDS_PER_FRAME = SERIAL_PAYLOAD_CAPACITY / JOURNAL_RECORD_SIZE;
+
+static void sendReply() {
+  size_t length = serialFrameEncode(g_reply, g_wire);
+  Serial.write(g_wire, length);
+}
+
+static void sendError(uint8_t tag, SerialError error) {
+  serialFrameBegin(&g_reply, SERIAL_ERROR, tag);
+  serialPut8(&g_reply, (uint8_t)error);
+  sendReply();
+}
+
+//----------------------------------------------------------------------------//
+// Requests
+//----------------------------------------------------------------------------//
+
+static void replyPing(const SerialFrame& request) {
+  serialFrameBegin(&g_reply, SERIAL_PING | SERIAL_REPLY, request.tag);
+  serialPut8(&g_reply, SERIAL_PROTOCOL_VERSION);
+  serialPut32(&g_reply, firmware_version);
+  serialPut64(&g_reply, clockMonotonicMs());
+  serialPut16(&g_reply, (uint16_t)SERIAL_PAYLOAD_CAPACITY);
+  sendReply();
+}
+
+static void replyState(const SerialFrame& request, const AppState& state) {
+  serialFrameBegin(&g_reply, SERIAL_GET_STATE | SERIAL_REPLY, request.tag);
+  serialPutStatus(&g_reply, controllerStatusOf(state, clockMonotonicMs()));
+  sendReply();
+}
+
+static void putCounter(SerialCounter id, unsigned long value) {
+  serialPut8(&g_reply, (uint8_t)id);
+  serialPut32(&g_reply, (uint32_t)value);
+}
+
+static void replyCounters(const SerialFrame& request) {
+  const EffectStats& effects = effectStats();
+  const JournalStats& journal = eventLogStats();
+  const HeapAuditStats& heap = heapAudit();
+
+  serialFrameBegin(&g_reply, SERIAL_GET_COUNTERS | SERIAL_REPLY, request.tag);
+  putCounter(SERIAL_COUNTER_EFFECTS_EXECUTED, effects.executed);
+  putCounter(SERIAL_COUNTER_EFFECTS_DEFERRED, effects.deferred);
+  putCounter(SERIAL_COUNTER_EFFECT_REPEATS_SKIPPED, effects.repeatsSkipped);
+  putCounter(SERIAL_COUNTER_EFFECT_IO_REPEATS_SKIPPED, effects.workRepeatsSkipped);
+  putCounter(SERIAL_COUNTER_POLLS_HELD_IN_FLIGHT, effects.heldInFlight);
+  putCounter(SERIAL_COUNTER_JOURNAL_APPENDED, journal.appended);
+  putCounter(SERIAL_COUNTER_JOURNAL_DROPPED, journal.dropped);
+  putCounter(SERIAL_COUNTER_JOURNAL_FLUSHES, journal.flushes);
+  putCounter(SERIAL_COUNTER_JOURNAL_ERASES, journal.erases);
+  putCounter(SERIAL_COUNTER_JOURNAL_FAILURES, journal.failures);
+  putCounter(SERIAL_COUNTER_HEAP_IN_USE, heap.inUseBytes);
+  putCounter(SERIAL_COUNTER_HEAP_PEAK, heap.peakInUseBytes);
+  if (heap.counting) {
+    putCounter(SERIAL_COUNTER_HEAP_ALLOCATIONS, heap.allocations);
+  }
+  const OutputEngineStats& outputs = outputEngineStats();
+  putCounter(SERIAL_COUNTER_VALVE_TIMER_CLOSES, outputs.timerCloses);
+  if (valve_shift_registers > 0) {
+    putCounter(SERIAL_COUNTER_VALVE_FRAMES, outputs.valveFrames);
+    putCounter(SERIAL_COUNTER_VALVE_FRAMES_MERGED, outputs.valveFramesMerged);
+  }
+  putCounter(SERIAL_COUNTER_LINK_FRAMES, g_linkStats.frames);
+  putCounter(SERIAL_COUNTER_LINK_BAD_FRAMES, g_linkStats.badFrames);
+  putCounter(SERIAL_COUNTER_LINK_TRACE_DROPPED, g_linkStats.traceDropped);
+  sendReply();
+}
+
+// Bucket count and first bound, the buckets, the worst pass, then each
+// stage's worst time and overrun count
+static void replyHistogram(const SerialFrame& request) {
+  SerialCursor cursor(request);
+  uint8_t flags = cursor.atEnd() ? 0 : serialTake8(&cursor);
+  const WatchdogStats& watchdog = watchdogStats();
+
+  serialFrameBegin(&g_reply, SERIAL_GET_HISTOGRAM | SERIAL_REPLY, request.tag);
+  serialPut8(&g_reply, (uint8_t)LOOP_PASS_BUCKETS);
+  serialPut32(&g_reply, LOOP_PASS_FIRST_BUCKET_US);
+  for (int i = 0; i < LOOP_PASS_BUCKETS; i++) {
+    serialPut32(&g_reply, watchdog.passHistogram[i]);
+  }
+  serialPut32(&g_reply, watchdog.worstPassUs);
+  serialPut8(&g_reply, (uint8_t)LOOP_STAGE_COUNT);
+  for (int i = 0; i < LOOP_STAGE_COUNT; i++) {
+    serialPut32(&g_reply, watchdog.worstMs[i]);
+    serialPut32(&g_reply, watchdog.overruns[i]);
+  }
+  sendReply();
+
+  if (flags & SERIAL_HISTOGRAM_RESET) {
+    watchdogClearPassHistogram();
+  }
+}
+
+// Flags, a count, then that many networks, the primary first
+static bool writeNetworks(const SerialFrame& request, Input* input) {
+  SerialCursor cursor(request);
+  uint8_t flags = serialTake8(&cursor);
+  uint8_t count = serialTake8(&cursor);
+  Credentials networks[CREDENTIAL_STORE_SIZE];
+  bool valid = count >= 1 && count <= CREDENTIAL_STORE_SIZE;
+  for (int i = 0; valid && i < count; i++) {
+    valid = serialTakeNetwork(&cursor, &networks[i]);
+  }
+  if (!valid || !cursor.atEnd()) {
+    sendError(request.tag, SERIAL_ERROR_BAD_PAYLOAD);
+    return false;
+  }
+
+  // Remembering the last first leaves the first at the front, and drops a
+  // repeated SSID rather than storing it twice
+  CredentialStore store;
+  for (int i = count - 1; i >= 0; i--) {
+    credentialStoreRemember(&store, networks[i]);
+  }
+  Serial.print("Serial link: received ");
+  Serial.print(store.count);
+  Serial.println(" networks");
+
+  serialFrameBegin(&g_reply, SERIAL_WRITE_NETWORKS | SERIAL_REPLY, request.tag);
+  serialPut8(&g_reply, store.count);
+  sendReply();
+
+  // The list waits beside the machine, which gets its primary; then
+  // EFFECT_SAVE_CREDENTIALS writes it
+  stageKnownNetworks(&store);
+  *input = Input::networksReplaced(store.networks[0], (flags & SERIAL_NETWORKS_CONNECT) != 0);
+  return true;
+}
+
+// An optional first sequence number; the records themselves are the reply
+static void startJournalDump(const SerialFrame& request) {
+  SerialCursor cursor(request);
+  uint32_t fromSequence = cursor.atEnd() ? 0 : serialTake32(&cursor);
+  if (g_dump.active) {
+    sendError(request.tag, SERIAL_ERROR_BUSY);
+    return;
+  }
+  if (!eventLogReadBegin(&g_dump.reader, fromSequence)) {
+    sendError(request.tag, SERIAL_ERROR_UNAVAILABLE);
+    return;
+  }
+  g_dump.active = true;
+  g_dump.tag = request.tag;
+  g_dump.sent = 0;
+}
+
+// Seconds to trace for; 0 stops a running trace
+static void startTrace(const SerialFrame& request) {
+  SerialCursor cursor(request);
+  uint16_t seconds = serialTake16(&cursor);
+  if (cursor.overrun) {
+    sendError(request.tag, SERIAL_ERROR_BAD_PAYLOAD);
+    return;
+  }
+  g_trace.active = seconds > 0;
+  g_trace.tag = request.tag;
+  g_trace.startedAt = millis();
+  g_trace.durationMs = seconds * 1000UL;
+
+  serialFrameBegin(&g_reply, SERIAL_TRACE | SERIAL_REPLY, request.tag);
+  sendReply();
+}
+
+static bool handleFrame(const SerialFrame& request, const AppState& state, Input* input) {
+  switch (request.type) {
+    case SERIAL_PING:
+      replyPing(request);
+      return false;
+    case SERIAL_GET_STATE:
+      replyState(request, state);
+      return false;
+    case SERIAL_GET_COUNTERS:
+      replyCounters(request);
+      return false;
+    case SERIAL_GET_HISTOGRAM:
+      replyHistogram(request);
+      return false;
+    case SERIAL_WRITE_NETWORKS:
+      return writeNetworks(request, input);
+    case SERIAL_READ_JOURNAL:
+      startJournalDump(request);
+      return false;
+    case SERIAL_TRACE:
+      startTrace(request);
+      return false;
+    default:
+      sendError(request.tag, SERIAL_ERROR_UNKNOWN_TYPE);
+      return false;
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Streams
+//----------------------------------------------------------------------------//
+
+// One JOURNAL_RECORDS frame, or JOURNAL_END once the read is over
+static void continueJournalDump() {
+  serialFrameBegin(&g_reply, SERIAL_JOURNAL_RECORDS, g_dump.tag);
+  JournalRecord record;
+  size_t count = 0;
+  bool more = true;
+  while (count < JOURNAL_RECORDS_PER_FRAME && (more = eventLogRead(&g_dump.reader, &record))) {
+    serialPutBytes(&g_reply, &record, sizeof(record));  // Already little-endian
+    count++;
+  }
+  if (count > 0) {
+    g_dump.sent += count;
+    g_linkStats.journalRecords += count;
+    sendReply();
+  }
+  if (!more) {
+    serialFrameBegin(&g_reply, SERIAL_JOURNAL_END, g_dump.tag);
+    serialPut32(&g_reply, g_dump.sent);
+    serialPut32(&g_reply, eventLogStats().damaged);
+    sendReply();
+    g_dump.active = false;
+  }
+}
+
+// Records lost so far, then the captured steps
+static void sendTrace() {
+  serialFrameBegin(&g_reply, SERIAL_TRACE_RECORDS, g_trace.tag);
+  serialPut32(&g_reply, g_linkStats.traceDropped);
+  for (int i = 0; i < g_trace.count; i++) {
+    serialPutTrace(&g_reply, g_trace.records[i]);
+  }
+  g_trace.count = 0;
+  sendReply();
+}
+
+//----------------------------------------------------------------------------//
+// Public API
+//----------------------------------------------------------------------------//
+
+bool serviceSerialLink(const AppState& state, Input* input) {
+  bool produced = false;
+  for (int n = 0; n < SERIAL_LINK_MAX_BYTES_PER_POLL && !produced && Serial.available() > 0; n++) {
+    if (!g_reader.inFrame && g_consoleCount == sizeof(g_console)) {
+      break;  // Leave console text in the driver until the console catches up
+    }
+    uint8_t byte = Serial.read();
+    switch (serialFrameFeed(&g_reader, byte, millis())) {
+      case SERIAL_BYTE_CONSOLE:
+        g_console[(g_consoleHead + g_consoleCount++) % sizeof(g_console)] = byte;
+        break;
+      case SERIAL_BYTE_FRAMED:
+        break;
+      case SERIAL_BYTE_FRAME_BAD:
+        g_linkStats.badFrames++;  // The tool times out and asks again
+        break;
+      case SERIAL_BYTE_FRAME_READY:
+        g_linkStats.frames++;
+        produced = handleFrame(g_reader.frame, state, input);
+        break;
+    }
+  }
+
+  int frames = 0;
+  if (g_trace.active && millis() - g_trace.startedAt >= g_trace.durationMs) {
+    g_trace.active = false;
+  }
+  if (g_trace.count > 0) {
+    sendTrace();
+    frames++;
+  }
+  for (; g_dump.active && frames < SERIAL_LINK_FRAMES_PER_PASS; frames++) {
+    continueJournalDump();
+  }
+  return produced;
+}
+
+int serialConsoleRead() {
+  if (g_consoleCount == 0) {
+    return -1;
+  }
+  uint8_t byte = g_console[g_consoleHead];
+  g_consoleHead = (g_consoleHead + 1) % sizeof(g_console);
+  g_consoleCount--;
+  return byte;
+}
+
+void serialLinkTrace(const Input& input, const AppState& state) {
+  if (!g_trace.active) {
+    return;
+  }
+  if (g_trace.count == SERIAL_TRACE_CAPACITY) {
+    g_linkStats.traceDropped++;
+    return;
+  }
+  SerialTraceRecord& record = g_trace.records[g_trace.count++];
+  record.atMs = (uint32_t)input.nowMs;
+  record.input = (uint8_t)input.type;
+  record.mode = (uint8_t)state.mode;
+  record.openMask = state.zones.openMask;
+  record.effectSeq = (uint8_t)state.effectSeq;
+}
+
+const SerialLinkStats& serialLinkStats() {
+  return g_linkStats;
+}
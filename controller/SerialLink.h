@@ -0,0 +1,81 @@
+#ifndef SERIAL_LINK_H
+#define SERIAL_LINK_H
+
+#include "Types.h"
+#include "SerialFrame.h"
+
+//----------------------------------------------------------------------------//
+// Serial Link (Binary Frames Beside the Console)
+//----------------------------------------------------------------------------//
+
+/*
+ * Owns the USB serial port's input. Every byte received goes through the
+ * frame reader (SerialFrame.h): console text is queued for the single-key
+ * commands and the credential line editor (serialConsoleRead()), and frames
+ * from a bench tool (host/serial-tool) are answered here:
+ *
+ *   PING            protocol and firmware version, uptime
+ *   GET_STATE       the status the LAN server shows (ControllerStatus)
+ *   GET_COUNTERS    effect, journal, heap, valve and link counters
+ *   GET_HISTOGRAM   loop() pass times and per-stage worsts (LoopWatchdog.h)
+ *   WRITE_NETWORKS  replace the known networks (INPUT_NETWORKS_REPLACED,
+ *                   saved in one config write) and optionally join the first
+ *   READ_JOURNAL    every journal record from a sequence number on
+ *   TRACE           every machine step for the next N seconds
+ *
+ * Short replies are written at once. Journal dumps and traces stream at most
+ * SERIAL_LINK_FRAMES_PER_PASS frames per pass, so a full journal (some 16000
+ * records, 64 to a frame) crosses USB in about 60 passes without any one
+ * pass spending more than a few milliseconds on it.
+ *
+ * Runs on the control side only; called first thing in readEvents().
+ */
+
+const int SERIAL_LINK_FRAMES_PER_PASS = 4;
+
+// Upper bound on bytes taken from the port per pass (two full frames)
+const int SERIAL_LINK_MAX_BYTES_PER_POLL = 2 * SERIAL_WIRE_CAPACITY;
+
+// Console text waiting for readSingleChar() or the line editor. When full,
+// bytes stay in the USB driver's buffer instead of being dropped.
+const size_t SERIAL_CONSOLE_CAPACITY = 128;
+
+// Steps captured between passes while tracing; more are counted as lost
+const int SERIAL_TRACE_CAPACITY = 64;
+
+struct SerialLinkStats {
+  unsigned long frames;           // Valid frames received
+  unsigned long badFrames;        // Frames dropped for a bad CRC, encoding or size
+  unsigned long journalRecords;   // Records sent by journal dumps
+  unsigned long traceDropped;     // Trace records lost to a full buffer
+};
+
+/**
+ * Sort pending serial bytes, answer any frames and continue a journal dump
+ * or trace (call every pass, before anything reads the console)
+ * @param state Current state, for GET_STATE
+ * @param input Populated when a frame carries an input for the machine
+ * @return true if input was populated
+ */
+bool serviceSerialLink(const AppState& state, Input* input);
+
+/**
+ * Take one byte of console text
+ * @return The byte, or -1 if none is queued
+ */
+int serialConsoleRead();
+
+/**
+ * Capture one machine step if a trace is running (call after each step)
+ * @param input Input just applied
+ * @param state State after applying it
+ */
+void serialLinkTrace(const Input& input, const AppState& state);
+
+/**
+ * Access link counters
+ * @return Statistics since boot
+ */
+const SerialLinkStats& serialLinkStats();
+
+#endif // SERIAL_LINK_H
@@ -0,0 +1,142 @@
+#include "ServerResolver.h"
+#include "NetworkMailbox.h"
+#include "WiFiConnection.h"
+#include <WiFi.h>
+
+// A failed refresh is retried after this long, keeping the old address
+static const unsigned long RESOLVER_RETRY_MS = 60000;
+
+static ServerResolverStats g_resolverStats = {0, 0, 0, 0, 0};
+
+static struct {
+  bool initialized;          // server_hostname checked for an IP literal
+  bool literal;              // server_hostname is an IP address, never expires
+  bool valid;                // `address` holds a usable address
+  IPAddress address;
+  unsigned long resolvedAt;  // millis() of the last successful lookup
+  bool expired;              // Forced refresh (seeded from flash or invalidated)
+  unsigned long nextAttempt; // millis() before which no refresh is attempted
+  bool unposted;             // A new address the control side hasn't been given
+} g_server;
+
+//----------------------------------------------------------------------------//
+// Cache Maintenance
+//----------------------------------------------------------------------------//
+
+static void initServerAddress() {
+  g_server.initialized = true;
+  if (g_server.address.fromString(server_hostname)) {
+    g_server.literal = true;
+    g_server.valid = true;
+  }
+}
+
+// Tell the control side about a new address; retried from
+// serviceServerResolver() while the event mailbox is full
+static void postResolvedAddress() {
+  uint8_t address[4];
+  for (int i = 0; i < 4; i++) {
+    address[i] = g_server.address[i];
+  }
+  g_server.unposted = !postServerAddress(address);
+}
+
+static bool refreshServerAddress() {
+  g_resolverStats.lookups++;
+  IPAddress resolved;
+  if (WiFi.hostByName(server_hostname, resolved) != 1) {
+    g_resolverStats.failures++;
+    g_server.nextAttempt = millis() + RESOLVER_RETRY_MS;
+    Serial.print("DNS lookup failed for ");
+    Serial.print(server_hostname);
+    Serial.println(g_server.valid ? " - keeping last known address" : "");
+    return false;
+  }
+
+  bool changed = !g_server.valid || !(resolved == g_server.address);
+  g_server.address = resolved;
+  g_server.valid = true;
+  g_server.expired = false;
+  g_server.resolvedAt = millis();
+  g_server.nextAttempt = g_server.resolvedAt;
+
+  if (changed) {
+    g_resolverStats.changes++;
+    Serial.print("Resolved ");
+    Serial.print(server_hostname);
+    Serial.print(" to ");
+    Serial.println(resolved);
+    postResolvedAddress();  // The control side persists it for the next boot
+  }
+  return true;
+}
+
+// True once `quarters` quarters of the cache lifetime have elapsed
+static bool isPastLifetime(unsigned long quarters) {
+  return g_server.expired ||
+         millis() - g_server.resolvedAt >= (server_address_ttl_ms / 4) * quarters;
+}
+
+//----------------------------------------------------------------------------//
+// Resolver API
+//----------------------------------------------------------------------------//
+
+void seedServerAddress(const uint8_t address[4]) {
+  if (!g_server.initialized) {
+    initServerAddress();
+  }
+  if (g_server.valid || (address[0] | address[1] | address[2] | address[3]) == 0) {
+    return;  // A literal, or already resolved this boot
+  }
+  // Usable immediately, refreshed soon
+  g_server.address = IPAddress(address[0], address[1], address[2], address[3]);
+  g_server.valid = true;
+  g_server.expired = true;
+}
+
+bool serverAddress(IPAddress* address) {
+  if (!g_server.initialized) {
+    initServerAddress();
+  }
+  if (!g_server.valid) {
+    return false;  // serviceServerResolver() looks it up on an idle pass
+  }
+
+  g_resolverStats.cacheHits++;
+  if (!g_server.literal && isPastLifetime(4)) {
+    g_resolverStats.staleServed++;
+  }
+  *address = g_server.address;
+  return true;
+}
+
+void invalidateServerAddress() {
+  if (!g_server.literal) {
+    g_server.expired = true;
+    g_server.nextAttempt = millis();
+  }
+}
+
+bool serviceServerResolver() {
+  if (!g_server.initialized) {
+    initServerAddress();
+  }
+  if (g_server.unposted) {
+    postResolvedAddress();
+  }
+  if (g_server.literal || wifiLinkStatus() != WL_CONNECTED) {
+    return false;
+  }
+  if ((long)(millis() - g_server.nextAttempt) < 0) {
+    return false;  // Backing off after a failed refresh
+  }
+  if (!g_server.valid || isPastLifetime(3)) {
+    refreshServerAddress();
+    return true;
+  }
+  return false;
+}
+
+const ServerResolverStats& serverResolverStats() {
+  return g_resolverStats;
+}
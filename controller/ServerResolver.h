@@ -0,0 +1,74 @@
+#ifndef SERVER_RESOLVER_H
+#define SERVER_RESOLVER_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Server Address Cache
+//----------------------------------------------------------------------------//
+
+/*
+ * Resolves server_hostname once and keeps the address off the poll path.
+ *
+ *   poll path      serverAddress() - cache only, never a DNS round trip; a
+ *                  poll before the first lookup fails and is retried
+ *   network idle   serviceServerResolver() - looks the address up when
+ *                  nothing is cached, and refreshes it in the background
+ *                  once three quarters of its lifetime is gone
+ *
+ * Each new address is posted to the control side (NET_EVENT_SERVER_RESOLVED),
+ * which keeps it in the configuration record; at boot it hands the address
+ * back through NET_REQUEST_SEED_SERVER_ADDRESS, so a fresh boot can connect
+ * before the resolver is reachable. When a refresh fails, the old address
+ * stays in use and the refresh is retried later.
+ * An IP-literal server_hostname never touches the resolver.
+ *
+ * The WiFi library's hostByName() doesn't report the record's TTL, so the
+ * cache lifetime is server_address_ttl_ms.
+ *
+ * Runs on the network side only (see NetworkMailbox.h).
+ */
+
+struct ServerResolverStats {
+  unsigned long lookups;        // DNS queries sent
+  unsigned long failures;       // Queries that failed (resolver unreachable, NXDOMAIN)
+  unsigned long cacheHits;      // Poll-path requests answered from the cache
+  unsigned long staleServed;    // ...of those, past their lifetime because refresh failed
+  unsigned long changes;        // Refreshes that returned a different address
+};
+
+/**
+ * Start from an address remembered by an earlier boot, until the first refresh
+ * Ignored for an IP-literal server_hostname, an all-zero address, or once a
+ * lookup has already succeeded.
+ * @param address IPv4 address from the control side's configuration record
+ */
+void seedServerAddress(const uint8_t address[4]);
+
+/**
+ * Get the schedule server's address for a new connection
+ * @param address Populated with the cached address
+ * @return true if an address is available, false if not resolved yet
+ */
+bool serverAddress(IPAddress* address);
+
+/**
+ * Mark the cached address as suspect (e.g. connecting to it failed) so the
+ * next serviceServerResolver() call refreshes it right away
+ */
+void invalidateServerAddress();
+
+/**
+ * Resolve the address if nothing is cached, or refresh it if it is close to
+ * expiry. Call when the network side is idle; does nothing while WiFi is down.
+ * @return true if a DNS lookup was made (this pass's blocking job)
+ */
+bool serviceServerResolver();
+
+/**
+ * Access resolver counters
+ * @return Resolver statistics since boot
+ */
+const ServerResolverStats& serverResolverStats();
+
+#endif // SERVER_RESOLVER_H
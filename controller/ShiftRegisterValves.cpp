@@ -0,0 +1,71 @@
+#include "ShiftRegisterValves.h"
+
+static uint32_t chainMask(int registers) {
+  int outputs = registers * SHIFT_CHAIN_OUTPUTS_PER_REGISTER;
+  return outputs >= 32 ? 0xFFFFFFFFu : ((1u << outputs) - 1);
+}
+
+size_t shiftChainFrame(uint32_t outputs, int registers, uint8_t* frame) {
+  // The first byte sent is pushed furthest down the chain, so the last
+  // register's byte leads and register 0's goes out last
+  for (int r = 0; r < registers; r++) {
+    frame[registers - 1 - r] = (uint8_t)(outputs >> (r * SHIFT_CHAIN_OUTPUTS_PER_REGISTER));
+  }
+  return (size_t)registers;
+}
+
+// Send the wanted outputs if they differ from what is showing and the bus is free
+static void sendIfChanged(ShiftRegisterChain* chain) {
+  if (chain->busy || (chain->started && chain->wanted == chain->latched)) {
+    return;
+  }
+  uint32_t outputs = chain->started ? chain->wanted : 0;
+  size_t length = shiftChainFrame(outputs, chain->registers, chain->frame);
+  chain->shifting = outputs;
+  chain->busy = true;  // Before starting: the bus may report completion at once
+  if (!chain->bus->startTransfer(chain->frame, length)) {
+    chain->busy = false;
+    chain->stats.refused++;
+    return;
+  }
+  chain->stats.frames++;
+}
+
+void shiftChainBegin(ShiftRegisterChain* chain, ShiftChainBus* bus, int registers) {
+  if (registers < 1) registers = 1;
+  if (registers > SHIFT_CHAIN_MAX_REGISTERS) registers = SHIFT_CHAIN_MAX_REGISTERS;
+  chain->bus = bus;
+  chain->registers = registers;
+  chain->wanted = 0;
+  chain->shifting = 0;
+  chain->latched = 0;
+  chain->busy = false;
+  chain->started = false;
+  chain->stats = ShiftChainStats{0, 0, 0, 0, 0};
+  sendIfChanged(chain);  // All off, whatever the registers powered up with
+}
+
+void shiftChainWrite(ShiftRegisterChain* chain, uint32_t outputs) {
+  outputs &= chainMask(chain->registers);
+  chain->stats.writes++;
+  if (outputs == chain->wanted && (chain->busy || outputs == chain->latched)) {
+    return;
+  }
+  if (chain->busy) {
+    chain->stats.merged++;  // Goes out with the next frame instead
+  }
+  chain->wanted = outputs;
+  sendIfChanged(chain);
+}
+
+void shiftChainTransferDone(ShiftRegisterChain* chain) {
+  if (!chain->busy) {
+    return;
+  }
+  chain->bus->latch();
+  chain->latched = chain->shifting;
+  chain->started = true;
+  chain->busy = false;
+  chain->stats.latches++;
+  sendIfChanged(chain);
+}
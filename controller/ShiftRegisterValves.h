@@ -0,0 +1,103 @@
+#ifndef SHIFT_REGISTER_VALVES_H
+#define SHIFT_REGISTER_VALVES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------//
+// Shift Register Valve Chain
+//----------------------------------------------------------------------------//
+
+/*
+ * Valve outputs on daisy-chained 74HC595-style shift registers, so the zone
+ * count isn't capped by the board's free GPIO pins:
+ *
+ *   MOSI --> [595 #0] --Q7'--> [595 #1] --Q7'--> ... [595 #n-1]
+ *   SCK, RCLK (latch) and /OE go to every register
+ *
+ * Output k of the chain is Qk%8 of register k/8, register 0 being the one
+ * wired to MOSI. Every update clocks the whole chain out in one transfer,
+ * one byte per register, and then pulses the latch: all outputs change
+ * together, never one at a time, and nothing shows while bits are still
+ * moving through the chain. The first frame after shiftChainBegin() is all
+ * off, and the bus enables the outputs (/OE) only once that is latched, so
+ * whatever the registers powered up holding never reaches a valve.
+ *
+ * Writes made while a transfer is under way are merged: when it completes,
+ * the latest mask goes out in a single further transfer. Callers on the
+ * device serialize shiftChainWrite() and shiftChainTransferDone() (a timer
+ * interrupt closing a zone can land mid-transfer), see OutputEngine.cpp.
+ *
+ * Pure code over the ShiftChainBus interface: the firmware backs it with
+ * SPI and a latch pin (OutputEngine.cpp), host tools with a recorder.
+ */
+
+const int SHIFT_CHAIN_MAX_REGISTERS = 4;   // Up to 32 outputs
+const int SHIFT_CHAIN_OUTPUTS_PER_REGISTER = 8;
+
+/*
+ * The SPI port and control lines, as the chain sees them. A transfer may
+ * complete later (DMA) or before startTransfer() returns; either way the
+ * bus reports it with shiftChainTransferDone().
+ */
+class ShiftChainBus {
+public:
+  virtual ~ShiftChainBus() {}
+  // Clock `length` bytes out, first byte first, MSB first; false if refused
+  virtual bool startTransfer(const uint8_t* frame, size_t length) = 0;
+  // Pulse the storage clock (RCLK) and enable the outputs if they aren't yet
+  virtual void latch() = 0;
+};
+
+struct ShiftChainStats {
+  unsigned long writes;         // Masks handed to shiftChainWrite()
+  unsigned long frames;         // Transfers started
+  unsigned long latches;        // Transfers completed and latched
+  unsigned long merged;         // Writes folded into a later frame while busy
+  unsigned long refused;        // Transfers the bus wouldn't start (retried on the next write)
+};
+
+struct ShiftRegisterChain {
+  ShiftChainBus* bus;
+  int registers;                // In the chain, 1 to SHIFT_CHAIN_MAX_REGISTERS
+  volatile uint32_t wanted;     // Outputs the caller last asked for
+  volatile uint32_t shifting;   // Outputs in the transfer under way
+  volatile uint32_t latched;    // Outputs showing now
+  volatile bool busy;           // A transfer is under way
+  volatile bool started;        // The all-off frame has gone out
+  uint8_t frame[SHIFT_CHAIN_MAX_REGISTERS];  // Stays put while the bus reads it
+  ShiftChainStats stats;
+};
+
+/**
+ * Lay out a frame for the chain
+ * @param outputs Output bits (bit k = output k)
+ * @param registers Registers in the chain
+ * @param frame Output, `registers` bytes in the order they are sent
+ * @return Bytes in the frame
+ */
+size_t shiftChainFrame(uint32_t outputs, int registers, uint8_t* frame);
+
+/**
+ * Start a chain with every output off, and send that frame
+ * @param chain Chain to set up
+ * @param bus Port it is wired to
+ * @param registers Registers in the chain (clamped to 1..SHIFT_CHAIN_MAX_REGISTERS)
+ */
+void shiftChainBegin(ShiftRegisterChain* chain, ShiftChainBus* bus, int registers);
+
+/**
+ * Set the outputs; unchanged outputs send nothing
+ * @param chain Chain to drive
+ * @param outputs Output bits (bit k = output k); bits past the chain are ignored
+ */
+void shiftChainWrite(ShiftRegisterChain* chain, uint32_t outputs);
+
+/**
+ * The bus finished clocking out the current frame: latch it and send the
+ * next one if the outputs were changed meanwhile
+ * @param chain Chain whose transfer completed
+ */
+void shiftChainTransferDone(ShiftRegisterChain* chain);
+
+#endif // SHIFT_REGISTER_VALVES_H
@@ -1,11 +1,11 @@
 #include "StateMachine.h"
-#include "WiFiConnection.h"
-#include "WiFiCredentials.h"
-#include "IrrigationController.h"
-#include <WiFi.h>
-#include <MooreArduino.h>
+#include "ZoneSequencer.h"
+#include "Clock.h"
 
-using namespace MooreArduino;
+// This file holds only the pure δ and λ functions: no hardware, no globals.
+// Effect interpretation lives in Effects.cpp. Keeping them apart lets host
+// tools (host/) link the real machine without the Arduino libraries.
+// Time comes in with the input (Input::nowMs), never from a clock read here.
 
 //----------------------------------------------------------------------------//
 // Debug Configuration
@@ -27,18 +27,81 @@ using namespace MooreArduino;
 #endif
 
 //----------------------------------------------------------------------------//
-// External References
+// Poll Interval Policy
 //----------------------------------------------------------------------------//
 
-extern MooreMachine<AppState, Input, Output> g_machine;  // Defined in main file
+static unsigned long clampPollInterval(unsigned long intervalMs) {
+  if (intervalMs < poll_interval_min_ms) return poll_interval_min_ms;
+  if (intervalMs > poll_interval_max_ms) return poll_interval_max_ms;
+  return intervalMs;
+}
+
+/*
+ * Next poll interval after a successful poll:
+ * - A server hint (Cache-Control: max-age / Retry-After) wins, within bounds
+ * - A changed schedule snaps to the fastest interval, since more changes
+ *   tend to follow (e.g. a zone run that will end soon)
+ * - An unchanged schedule backs off by 1.5x up to the maximum
+ */
+static unsigned long nextPollInterval(unsigned long currentMs, bool scheduleChanged,
+                                      unsigned long hintMs) {
+  if (hintMs > 0) return clampPollInterval(hintMs);
+  if (scheduleChanged) return poll_interval_min_ms;
+  return clampPollInterval(currentMs + currentMs / 2);
+}
+
+// Take a confirmed schedule (snapshot or patched) into the new state. A 304
+// or a repeat of the version we hold only refreshes lastUpdate, so it asks
+// for no save; the first schedule since boot always does.
+static void acceptSchedule(const AppState& state, const IrrigationSchedule& schedule,
+                           unsigned long pollHintMs, AppState* newState) {
+  bool zonesChanged = !state.schedule.sameZones(schedule) || state.failSafeActive;
+  bool differsFromSaved = !state.schedule.sameZones(schedule) || state.schedule.seq != schedule.seq ||
+                          state.schedule.lastUpdate == 0;
+  newState->schedule = schedule;
+  newState->lastPollTime = newState->lastUpdate;
+  newState->pollIntervalMs = nextPollInterval(state.pollIntervalMs, zonesChanged, pollHintMs);
+  newState->httpError = false;
+  newState->failSafeActive = false;  // Fresh schedule takes control again
+  if (differsFromSaved) {
+    newState->scheduleChanged = true;  // Flag for persistence (a pending save stays pending)
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Moisture Policy
+//----------------------------------------------------------------------------//
+
+/*
+ * Wet zones after a reading, with hysteresis: a zone turns wet at
+ * moisture_wet_permille and only turns dry again below
+ * moisture_dry_permille. A missing or faulty sensor never blocks watering.
+ */
+static uint8_t nextWetMask(uint8_t wetMask, const uint16_t permille[ZONE_COUNT]) {
+  uint8_t next = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    uint16_t level = permille[i];
+    if (level == MOISTURE_UNKNOWN) {
+      continue;
+    }
+    bool wasWet = wetMask & (1 << i);
+    if (level >= moisture_wet_permille || (wasWet && level >= moisture_dry_permille)) {
+      next |= 1 << i;
+    }
+  }
+  return next;
+}
 
 //----------------------------------------------------------------------------//
 // Pure State Transition Function δ: Q × Σ → Q
 //----------------------------------------------------------------------------//
 
-AppState transitionFunction(const AppState& state, const Input& input) {
+// Mode, flag and schedule changes for one input; the zone queue is advanced
+// afterwards by transitionFunction()
+static AppState applyInput(const AppState& state, const Input& input) {
+  uint64_t now = input.nowMs;
   AppState newState = state;          // Copy current state
-  newState.lastUpdate = millis();     // Update timestamp on every input
+  newState.lastUpdate = now;          // Update timestamp on every input
   
   switch (input.type) {
     case INPUT_NONE:
@@ -51,16 +114,29 @@ AppState transitionFunction(const AppState& state, const Input& input) {
       return newState;
       
     case INPUT_CREDENTIALS_ENTERED:
-      // User finished entering credentials - prepare for connection
+      // User finished entering credentials - prepare for connection. The
+      // save and connect effects put it at the front of the known networks.
       newState.credentials = input.newCredentials;  // Store new credentials
       newState.credentialsChanged = true;           // Flag for persistence
       newState.shouldReconnect = true;              // Flag for connection attempt
       newState.mode = MODE_CONNECTING;              // Change to connecting state
       return newState;
       
+    case INPUT_CREDENTIALS_CANCELLED:
+      // Credential entry abandoned - fall back to the stored network if we have one
+      if (!newState.credentials.isEmpty()) {
+        newState.shouldReconnect = true;
+        newState.mode = MODE_CONNECTING;
+      } else {
+        newState.mode = MODE_DISCONNECTED;
+      }
+      return newState;
+      
     case INPUT_CONNECTION_STARTED:
-      // WiFi.begin() was called - clear the reconnect flag
+      // The connect request was posted - clear the reconnect flag and time the
+      // attempt from here
       newState.shouldReconnect = false;
+      newState.modeSince = now;
       return newState;
       
     case INPUT_RETRY_CONNECTION:
@@ -71,6 +147,11 @@ AppState transitionFunction(const AppState& state, const Input& input) {
       
     case INPUT_WIFI_CONNECTED:
       // Hardware reports successful WiFi connection
+      if (newState.mode == MODE_ENTERING_CREDENTIALS) {
+        // Don't pull the user out of a half-typed prompt
+        newState.wifiStatus = input.wifiStatus;
+        return newState;
+      }
       newState.mode = MODE_CONNECTED;           // Update mode
       newState.wifiStatus = input.wifiStatus;  // Store hardware status
       newState.shouldReconnect = false;        // Clear retry flag
@@ -80,22 +161,55 @@ AppState transitionFunction(const AppState& state, const Input& input) {
       
     case INPUT_WIFI_DISCONNECTED:
       // Hardware reports WiFi connection lost
+      if (newState.mode == MODE_ENTERING_CREDENTIALS) {
+        newState.wifiStatus = input.wifiStatus;
+        return newState;
+      }
       newState.mode = MODE_DISCONNECTED;        // Update mode
       newState.wifiStatus = input.wifiStatus;  // Store hardware status
       return newState;
       
     case INPUT_SCHEDULE_RECEIVED:
-      // New irrigation schedule received from HTTP endpoint
-      newState.schedule = input.newSchedule;
-      newState.lastPollTime = millis();
-      newState.httpError = false;
-      newState.scheduleChanged = true;  // Flag for persistence
+      // Complete schedule (restored from flash at boot)
+      acceptSchedule(state, input.newSchedule, input.pollHintMs, &newState);
       return newState;
       
+    case INPUT_SCHEDULE_PATCH: {
+      // Poll response - apply the snapshot or delta to our schedule as a whole
+      IrrigationSchedule patched;
+      if (!input.patch.applyTo(state.schedule, &patched)) {
+        // A delta against a version we don't hold: keep the zones as they
+        // are (the staleness clock keeps running) and poll again soon,
+        // asking for a full snapshot
+        newState.schedule.seq = 0;
+        newState.lastPollTime = now;
+        newState.pollIntervalMs = poll_interval_min_ms;
+        return newState;
+      }
+      patched.lastUpdate = now;
+      acceptSchedule(state, patched, input.pollHintMs, &newState);
+      return newState;
+    }
+      
     case INPUT_HTTP_ERROR:
-      // HTTP request failed
+      // HTTP request failed - retry at the server's requested delay, or at
+      // the base interval so a backed-off poller recovers before going stale
       newState.httpError = true;
-      newState.lastPollTime = millis();
+      newState.lastPollTime = now;
+      newState.pollIntervalMs = (input.pollHintMs > 0) ? clampPollInterval(input.pollHintMs)
+                                                       : poll_interval_base_ms;
+      return newState;
+      
+    case INPUT_NETWORKS_REPLACED:
+      // The whole list at once (staged beside the machine, only its primary
+      // travels here); saved like entered credentials, but only joined
+      // straight away if asked
+      newState.credentials = input.newCredentials;
+      newState.credentialsChanged = true;
+      if (input.connectNow && !newState.credentials.isEmpty()) {
+        newState.shouldReconnect = true;
+        newState.mode = MODE_CONNECTING;
+      }
       return newState;
       
     case INPUT_CREDENTIALS_SAVED:
@@ -109,17 +223,91 @@ AppState transitionFunction(const AppState& state, const Input& input) {
       return newState;
       
     case INPUT_POLL_STARTED:
-      // HTTP polling has started - clear the immediate poll flag
+      // HTTP polling has started - clear the immediate poll flag and restart
+      // the interval so the in-flight request isn't posted again
       newState.shouldPollNow = false;
+      newState.lastPollTime = now;
+      return newState;
+      
+    case INPUT_MOISTURE_READING:
+      // Filtered sensor readings - recompute which zones are wet enough to skip
+      for (int i = 0; i < ZONE_COUNT; i++) {
+        newState.moisture.permille[i] = input.moisturePermille[i];
+      }
+      newState.moisture.wetMask = nextWetMask(state.moisture.wetMask, input.moisturePermille);
+      newState.moisture.lastReading = now;
       return newState;
       
+    case INPUT_FIRMWARE_READY:
+      // A newer build is in the inactive bank - install it when the zones close
+      newState.firmwareReady = true;
+      return newState;
+      
+    case INPUT_FIRMWARE_FAILED:
+      // The switch didn't happen; carry on with this build until the next
+      // reminder from the network side
+      newState.firmwareReady = false;
+      return newState;
+      
+    case INPUT_TIME_SYNCED:
+      // SNTP sample - correct the wall clock and its drift estimate
+      newState.clock = wallClockSync(state.clock, now, input.unixMs);
+      return newState;
+      
+    case INPUT_ZONE_OVERRIDE: {
+      // Technician on the LAN server - hold the zone, or hand it back
+      if (input.overrideZone >= ZONE_COUNT) {
+        return newState;
+      }
+      uint8_t bit = 1 << input.overrideZone;
+      if (input.overrideAction == OVERRIDE_RELEASE) {
+        newState.overrides.mask &= ~bit;
+        newState.overrides.openMask &= ~bit;
+        return newState;
+      }
+      unsigned long durationMs = input.overrideMs < lan_override_max_ms ? input.overrideMs : lan_override_max_ms;
+      newState.overrides.mask |= bit;
+      if (input.overrideAction == OVERRIDE_OPEN) {
+        newState.overrides.openMask |= bit;
+      } else {
+        newState.overrides.openMask &= ~bit;
+      }
+      newState.overrides.until[input.overrideZone] = now + durationMs;
+      return newState;
+    }
+      
     case INPUT_TICK: {
       // Connection timeout check (pure logic based on state)
-      if (newState.mode == MODE_CONNECTING) {
-        unsigned long currentTime = millis();
-        if (currentTime - newState.lastUpdate > 30000) { // 30 second timeout
-          DEBUG_PRINTLN("DEBUG: Connection timeout, switching to disconnected");
-          newState.mode = MODE_DISCONNECTED;
+      if (newState.mode == MODE_CONNECTING && now - state.modeSince > wifi_connect_timeout_ms) {
+        DEBUG_PRINTLN("DEBUG: Connection timeout, switching to disconnected");
+        newState.mode = MODE_DISCONNECTED;
+      }
+      
+      // Fail-safe: never leave valves open on a schedule nobody has confirmed
+      // recently (server unreachable, WiFi down, controller wedged offline)
+      if (stale_schedule_failsafe && !newState.failSafeActive &&
+          newState.schedule.lastUpdate != 0 && newState.schedule.anyZoneOn() &&
+          newState.schedule.isStale(now)) {
+        newState.schedule.zone1 = false;
+        newState.schedule.zone2 = false;
+        newState.schedule.zone3 = false;
+        newState.schedule.seq = 0;        // No longer the server's version - ask for a snapshot
+        newState.failSafeActive = true;
+        newState.scheduleChanged = true;  // Persist closed zones across reboots
+      }
+      
+      // Sensors that stop reporting can't keep zones dry - fall back to the
+      // server's schedule alone
+      if (newState.moisture.lastReading != 0 &&
+          now - newState.moisture.lastReading > moisture_stale_ms) {
+        newState.moisture = MoistureState();
+      }
+      
+      // Overrides that have run their time hand the zone back
+      for (int i = 0; i < ZONE_COUNT; i++) {
+        if ((newState.overrides.mask & (1 << i)) && now >= newState.overrides.until[i]) {
+          newState.overrides.mask &= ~(1 << i);
+          newState.overrides.openMask &= ~(1 << i);
         }
       }
       return newState;
@@ -132,11 +320,36 @@ AppState transitionFunction(const AppState& state, const Input& input) {
   }
 }
 
+static Output requestedEffect(const AppState& state);  // See outputFunction()
+
+AppState transitionFunction(const AppState& state, const Input& input) {
+  AppState newState = applyInput(state, input);
+  if (newState.mode != state.mode) {
+    newState.modeSince = input.nowMs;
+  }
+  
+  // Sequence the requested zones onto the supply, leaving out zones whose
+  // soil is already wet, then applying the technician's overrides over
+  // both. Runs on every input, so rotation is checked at least every tick
+  // (100 ms).
+  uint8_t requested = newState.overrides.apply(newState.schedule.zoneMask() & ~newState.moisture.wetMask);
+  newState.zones = advanceZoneQueue(newState.zones, requested, input.nowMs);
+  
+  // A new effect request gets a new sequence ID; an unchanged one keeps its
+  // ID however often outputFunction() is asked, so the executor can tell a
+  // repeat of work it has done from new work
+  if (!requestedEffect(newState).sameRequest(requestedEffect(state))) {
+    newState.effectSeq = state.effectSeq + 1;
+  }
+  return newState;
+}
+
 //----------------------------------------------------------------------------//
 // Pure Output Function λ: Q → Γ
 //----------------------------------------------------------------------------//
 
-Output outputFunction(const AppState& state) {
+// The effect a state calls for, without its sequence ID
+static Output requestedEffect(const AppState& state) {
   // Priority 1: Handle shouldReconnect flag
   if (state.shouldReconnect) {
     return Output::startWiFiConnection();
@@ -152,17 +365,21 @@ Output outputFunction(const AppState& state) {
     return Output::saveSchedule();
   }
   
-  // Priority 4: HTTP polling when connected (immediate or interval based)
+  // Priority 4: Install a downloaded build, but never with a valve open -
+  // the reset would cut a watering run short
+  if (state.firmwareReady && state.zones.openMask == 0) {
+    return Output::activateFirmware();
+  }
+  
+  // Priority 5: HTTP polling when connected (immediate or interval based)
   if (state.mode == MODE_CONNECTED) {
     if (state.shouldPollNow) {
-      DEBUG_PRINTLN("DEBUG: Immediate HTTP poll triggered");
       return Output::pollSchedule();
     }
     
-    unsigned long currentTime = millis();
-    unsigned long timeSinceLastPoll = currentTime - state.lastPollTime;
-    if (timeSinceLastPoll > 30000) { // 30 second poll interval
-      DEBUG_PRINTLN("DEBUG: 30-second HTTP poll triggered");
+    // "Now" is the last input's time; ticks keep it within 100 ms
+    uint64_t timeSinceLastPoll = state.lastUpdate - state.lastPollTime;
+    if (timeSinceLastPoll > state.pollIntervalMs) { // Adaptive poll interval
       return Output::pollSchedule();
     }
   }
@@ -188,71 +405,12 @@ Output outputFunction(const AppState& state) {
   return Output::none();
 }
 
-//----------------------------------------------------------------------------//
-// Output Execution
-//----------------------------------------------------------------------------//
-
-Input executeEffect(const Output& effect) {
-  switch (effect.type) {
-    case EFFECT_UPDATE_LEDS:
-      updateLEDs(effect.currentMode);
-      break;
-      
-    case EFFECT_SAVE_CREDENTIALS: {
-      const AppState& state = g_machine.getState();
-      saveCredentials(&state.credentials);
-      // Return input to clear the credentialsChanged flag
-      return Input::credentialsSaved();
-    }
-    
-    case EFFECT_SAVE_SCHEDULE: {
-      const AppState& state = g_machine.getState();
-      saveSchedule(&state.schedule);
-      // Return input to clear the scheduleChanged flag
-      return Input::scheduleSaved();
-    }
-    
-    case EFFECT_START_WIFI_CONNECTION: {
-      const AppState& state = g_machine.getState();
-      Serial.println("Initiating WiFi connection...");
-      connectWiFi(&state.credentials);
-      // Return follow-up input to clear shouldReconnect flag
-      return Input::connectionStarted();
-    }
-    
-    case EFFECT_RENDER_UI:
-      renderUI(effect.currentMode);
-      break;
-      
-    case EFFECT_LOG_CONNECTION_SUCCESS:
-      Serial.println("✓ Successfully connected to WiFi!");
-      Serial.print("IP address: ");
-      Serial.println(WiFi.localIP());
-      break;
-      
-    case EFFECT_LOG_CONNECTION_LOST:
-      Serial.println("✗ WiFi connection lost");
-      break;
-      
-    case EFFECT_POLL_SCHEDULE: {
-      // Clear the immediate poll flag first
-      Input pollStartedInput = Input::pollStarted();
-      g_machine.step(pollStartedInput);
-      // Make HTTP request to get irrigation schedule
-      return pollIrrigationSchedule();
-    }
-      
-    case EFFECT_UPDATE_ZONES: {
-      const AppState& state = g_machine.getState();
-      updateZoneLEDs(state.schedule);
-      break;
-    }
-      
-    case EFFECT_NONE:
-    default:
-      // No effect to execute
-      break;
+Output outputFunction(const AppState& state) {
+  Output output = requestedEffect(state);
+  output.seq = state.effectSeq;
+  if (output.type == EFFECT_POLL_SCHEDULE) {
+    DEBUG_PRINTLN(state.shouldPollNow ? "DEBUG: Immediate HTTP poll triggered"
+                                      : "DEBUG: Interval HTTP poll triggered");
   }
-  
-  return Input::none();
+  return output;
 }
@@ -24,13 +24,40 @@ AppState transitionFunction(const AppState& state, const Input& input);
  */
 Output outputFunction(const AppState& state);
 
+//----------------------------------------------------------------------------//
+// Effect Execution (Effects.cpp)
+//----------------------------------------------------------------------------//
+
+struct EffectStats {
+  unsigned long executed;         // Effects carried out
+  unsigned long deferred;         // Attempts that couldn't run yet (request mailbox full), retried
+  unsigned long repeatsSkipped;   // Outputs whose sequence ID had already been carried out
+  unsigned long workRepeatsSkipped; // ...of which would have polled, connected or written flash
+  unsigned long heldInFlight;     // Polls held back until the previous one's result arrived
+};
+
 /**
  * Execute effects produced by the Moore machine
- * This is where all I/O operations happen
+ * This is where all I/O operations happen. Each effect sequence ID
+ * (Output::seq) is carried out at most once; asking again returns
+ * INPUT_NONE. A poll is held back while the previous one is still in flight.
  * @param effect Output to execute
  * @return Follow-up input if needed, or INPUT_NONE
  */
 // TODO: Rename to `interpretOutput`
 Input executeEffect(const Output& effect);
 
+/**
+ * Note an input that completes in-flight work (a poll result)
+ * Called for every input stepped into the machine
+ * @param input Input just applied
+ */
+void effectsObserveInput(const Input& input);
+
+/**
+ * Access effect counters
+ * @return Statistics since boot
+ */
+const EffectStats& effectStats();
+
 #endif // STATE_MACHINE_H
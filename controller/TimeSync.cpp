@@ -0,0 +1,124 @@
+#include "TimeSync.h"
+#include "WiFiConnection.h"
+#include "Clock.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+// Until the first reply, and after a failure, try again after this long
+static const unsigned long TIME_SYNC_RETRY_MS = 60000;
+// Longest wait for a reply; SNTP servers answer in tens of milliseconds
+static const unsigned long TIME_SYNC_TIMEOUT_MS = 1000;
+
+static const unsigned int NTP_PORT = 123;
+static const unsigned int NTP_LOCAL_PORT = 2390;
+static const size_t NTP_PACKET_SIZE = 48;
+
+static TimeSyncStats g_timeSyncStats = {0, 0, 0, 0};
+static WiFiUDP g_ntpUdp;
+static bool g_ntpUdpOpen = false;
+static unsigned long g_nextSyncMs = 0;
+static IPAddress g_ntpServer;          // Looked up on the pass before an exchange
+static bool g_ntpServerKnown = false;  // Forgotten after a failure
+
+//----------------------------------------------------------------------------//
+// Exchange
+//----------------------------------------------------------------------------//
+
+static bool syncFailed(const char* reason) {
+  g_timeSyncStats.failures++;
+  Serial.print("Time sync failed: ");
+  Serial.println(reason);
+  return false;
+}
+
+static bool lookUpServer() {
+  g_ntpServerKnown = WiFi.hostByName(ntp_server_hostname, g_ntpServer) == 1;
+  return g_ntpServerKnown || syncFailed("DNS lookup");
+}
+
+static bool exchange(uint64_t* unixMs) {
+  if (!g_ntpUdpOpen) {
+    g_ntpUdpOpen = g_ntpUdp.begin(NTP_LOCAL_PORT) == 1;
+    if (!g_ntpUdpOpen) {
+      return syncFailed("no UDP socket");
+    }
+  }
+
+  // Client request, version 4. The transmit timestamp is a nonce: the
+  // server echoes it as the origin timestamp, tying the reply to this request.
+  uint8_t packet[NTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x23;  // LI 0, VN 4, mode 3 (client)
+  uint32_t nonce = micros();
+  memcpy(packet + 40, &nonce, sizeof(nonce));
+  uint8_t origin[8];
+  memcpy(origin, packet + 40, sizeof(origin));
+
+  while (g_ntpUdp.parsePacket() > 0) {
+    g_ntpUdp.flush();  // A late reply to an earlier request
+  }
+  g_timeSyncStats.requests++;
+  unsigned long sentAt = millis();
+  if (!g_ntpUdp.beginPacket(g_ntpServer, NTP_PORT) || g_ntpUdp.write(packet, sizeof(packet)) != sizeof(packet) ||
+      !g_ntpUdp.endPacket()) {
+    return syncFailed("send");
+  }
+
+  while (millis() - sentAt < TIME_SYNC_TIMEOUT_MS) {
+    if (g_ntpUdp.parsePacket() < (int)NTP_PACKET_SIZE) {
+      delay(1);
+      continue;
+    }
+    unsigned long receivedAt = millis();
+    g_ntpUdp.read(packet, sizeof(packet));
+    if (memcmp(packet + 24, origin, sizeof(origin)) != 0) {
+      continue;  // Not the reply to this request
+    }
+    uint8_t leap = packet[0] >> 6;
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t stratum = packet[1];
+    if (leap == 3 || mode != 4 || stratum == 0 || stratum > 15) {
+      return syncFailed("server not synchronized");  // Or a kiss-o'-death
+    }
+
+    // Round trip without the server's own processing time; the reply left
+    // the server half of it ago
+    uint64_t serverReceived = ntpToUnixMs(packet + 32);
+    uint64_t serverSent = ntpToUnixMs(packet + 40);
+    unsigned long processing = serverSent > serverReceived ? (unsigned long)(serverSent - serverReceived) : 0;
+    unsigned long elapsed = receivedAt - sentAt;
+    unsigned long rtt = elapsed > processing ? elapsed - processing : 0;
+
+    g_timeSyncStats.replies++;
+    g_timeSyncStats.lastRttMs = rtt;
+    *unixMs = serverSent + rtt / 2 + (millis() - receivedAt);
+    return true;
+  }
+  return syncFailed("no reply");
+}
+
+//----------------------------------------------------------------------------//
+// Time Sync API
+//----------------------------------------------------------------------------//
+
+bool serviceTimeSync(uint64_t* unixMs, bool* sampled) {
+  *sampled = false;
+  if (wifiLinkStatus() != WL_CONNECTED || (long)(millis() - g_nextSyncMs) < 0) {
+    return false;
+  }
+  // The lookup and the exchange each block, so they take separate passes
+  if (!g_ntpServerKnown) {
+    if (!lookUpServer()) {
+      g_nextSyncMs = millis() + TIME_SYNC_RETRY_MS;
+    }
+    return true;
+  }
+  *sampled = exchange(unixMs);
+  g_ntpServerKnown = *sampled;  // The server may have moved; look it up again
+  g_nextSyncMs = millis() + (*sampled ? time_sync_interval_ms : TIME_SYNC_RETRY_MS);
+  return true;
+}
+
+const TimeSyncStats& timeSyncStats() {
+  return g_timeSyncStats;
+}
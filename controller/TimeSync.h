@@ -0,0 +1,49 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// SNTP Client
+//----------------------------------------------------------------------------//
+
+/*
+ * Asks ntp_server_hostname for the time every time_sync_interval_ms (every
+ * minute until the first reply) and hands the result to the control side,
+ * which keeps the wall clock (Clock.h).
+ *
+ *   network idle   serviceTimeSync() - looks the server up on one pass and
+ *                  makes one request/reply exchange on the next, waiting at
+ *                  most TIME_SYNC_TIMEOUT_MS for the reply
+ *
+ * A reply is checked against the request (origin timestamp, mode, stratum,
+ * leap indicator) and the server's time is advanced by half the round trip,
+ * so the sample is the time at the moment the reply arrived. It reaches the
+ * machine one loop pass later, which is well inside the clock's tolerance.
+ *
+ * Runs on the network side only (see NetworkMailbox.h).
+ */
+
+struct TimeSyncStats {
+  unsigned long requests;       // SNTP requests sent
+  unsigned long replies;        // Valid replies
+  unsigned long failures;       // Lookups, sends and replies that failed or timed out
+  unsigned long lastRttMs;      // Round trip of the last valid reply
+};
+
+/**
+ * Sync with the SNTP server if a sync is due
+ * Call when the network side is idle; does nothing while WiFi is down.
+ * @param unixMs Populated with the current wall time (ms since 1970 UTC)
+ * @param sampled Set to whether unixMs holds a new sample
+ * @return true if an exchange was attempted (this pass's blocking job)
+ */
+bool serviceTimeSync(uint64_t* unixMs, bool* sampled);
+
+/**
+ * Access SNTP counters
+ * @return Time sync statistics since boot
+ */
+const TimeSyncStats& timeSyncStats();
+
+#endif // TIME_SYNC_H
@@ -13,6 +13,9 @@ extern const int wifi_led_pin;
 extern const int zone1_led_pin;
 extern const int zone2_led_pin;
 extern const int zone3_led_pin;
+extern const int valve_shift_registers;   // 74HC595s chained on SPI for the valves, 0 = zone pins
+extern const int valve_latch_pin;         // The chain's storage clock (RCLK)
+extern const int valve_enable_pin;        // The chain's /OE, pulled high on the board; -1 = tied low
 
 //----------------------------------------------------------------------------//
 // Network Configuration (extern declarations)
@@ -20,6 +23,86 @@ extern const int zone3_led_pin;
 
 extern const char* server_hostname;
 extern const int server_port;
+extern const unsigned long server_address_ttl_ms;     // Lifetime of a resolved server address
+extern const unsigned long http_keepalive_idle_ms;    // Reconnect instead of reusing a connection idle this long
+extern const unsigned long http_response_timeout_ms;  // Give up on any one wait for response bytes after this long
+extern const unsigned long wifi_connect_timeout_ms;   // Give up on a WiFi association after this long
+
+//----------------------------------------------------------------------------//
+// LAN Server Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const int lan_http_port;                       // Status/override server port, 0 = off
+extern const char* lan_http_token;                    // Bearer token for overrides, "" = overrides off
+extern const unsigned long lan_http_idle_ms;          // Drop a connection that hasn't sent a full request by then
+extern const unsigned long lan_override_default_ms;   // Override length when the request gives none
+extern const unsigned long lan_override_max_ms;       // Longest override a request may set
+
+//----------------------------------------------------------------------------//
+// Clock Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const char* ntp_server_hostname;            // SNTP server for wall-clock time
+extern const unsigned long time_sync_interval_ms;  // How often to re-sync the wall clock
+extern const int utc_offset_minutes;               // Local time zone offset from UTC
+
+//----------------------------------------------------------------------------//
+// Watchdog Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const unsigned long watchdog_timeout_ms;       // Reset if loop() doesn't complete a pass this long
+
+//----------------------------------------------------------------------------//
+// Polling Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const unsigned long poll_interval_min_ms;   // Fastest poll (schedule just changed)
+extern const unsigned long poll_interval_base_ms;  // Starting poll interval and retry after errors
+extern const unsigned long poll_interval_max_ms;   // Slowest poll while the schedule is stable
+extern const unsigned long schedule_stale_ms;      // Age at which a schedule is considered stale
+extern const bool stale_schedule_failsafe;         // Close all zones when the schedule goes stale
+
+//----------------------------------------------------------------------------//
+// Zone Sequencing Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+const int ZONE_COUNT = 3;                          // Irrigation zones (valves) on this board
+
+extern const int max_concurrent_zones;             // Valves the supply can pressurize at once
+extern const unsigned long zone_rotation_ms;       // Longest run before yielding to a waiting zone
+extern const unsigned int zone_flow_lpm[ZONE_COUNT]; // Flow each zone draws (L/min), 0 = unknown
+extern const unsigned int supply_flow_lpm;         // Supply flow budget (L/min), 0 = count zones only
+
+//----------------------------------------------------------------------------//
+// Soil Moisture Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const bool moisture_sensing_enabled;        // Sample the per-zone moisture sensors
+extern const int zone_moisture_pins[ZONE_COUNT];   // Analog input for each zone's sensor
+extern const unsigned long moisture_sample_rate_hz; // ADC rate per channel (DMA-paced)
+extern const unsigned long moisture_report_ms;     // How often a filtered reading enters the machine
+extern const unsigned long moisture_stale_ms;      // Ignore readings older than this
+extern const uint16_t moisture_raw_dry;            // Calibration: ADC reading in dry soil
+extern const uint16_t moisture_raw_wet;            // Calibration: ADC reading in saturated soil
+extern const uint16_t moisture_wet_permille;       // At or above: zone is wet, skip watering
+extern const uint16_t moisture_dry_permille;       // Below: a wet zone is dry again (hysteresis)
+
+const uint16_t MOISTURE_UNKNOWN = 0xFFFF;          // No reading, or the sensor is faulty
+
+//----------------------------------------------------------------------------//
+// Firmware Update Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const uint32_t firmware_version;            // Build number of this firmware
+extern const bool ota_enabled;                     // Fetch and install newer builds from the server
+extern const unsigned long ota_check_interval_ms;  // How often to ask the server for a newer build
+extern const uint8_t ota_public_key[];             // Image signing key (uncompressed P-256, 65 bytes)
+
+//----------------------------------------------------------------------------//
+// Event Journal Configuration (extern declarations)
+//----------------------------------------------------------------------------//
+
+extern const unsigned long journal_flush_ms;       // Longest an event waits in RAM before reaching flash
 
 //----------------------------------------------------------------------------//
 // Type Definitions (Moore Machine Architecture Data Structures)
@@ -46,15 +129,23 @@ enum InputType {
   INPUT_RETRY_CONNECTION,         // User pressed 'r' to retry WiFi connection
   INPUT_REQUEST_CREDENTIALS,      // User pressed 'c' to enter new WiFi credentials
   INPUT_CREDENTIALS_ENTERED,      // User finished entering SSID and password
-  INPUT_CONNECTION_STARTED,       // WiFi.begin() was called, reset shouldReconnect flag
+  INPUT_CREDENTIALS_CANCELLED,    // Credential entry failed validation or timed out
+  INPUT_CONNECTION_STARTED,       // Connect request posted, reset shouldReconnect flag
   INPUT_WIFI_CONNECTED,           // Hardware detected WiFi connection established
   INPUT_WIFI_DISCONNECTED,        // Hardware detected WiFi connection lost
-  INPUT_SCHEDULE_RECEIVED,        // HTTP response with new zone schedule received
+  INPUT_SCHEDULE_RECEIVED,        // Complete zone schedule (restored from flash at boot)
   INPUT_HTTP_ERROR,               // HTTP request failed
   INPUT_CREDENTIALS_SAVED,        // Credentials have been saved to flash
   INPUT_SCHEDULE_SAVED,           // Schedule has been saved to flash
   INPUT_POLL_STARTED,             // HTTP polling has started
-  INPUT_TICK                      // Timer event - check for state changes
+  INPUT_TICK,                     // Timer event - check for state changes
+  INPUT_MOISTURE_READING,         // Filtered soil moisture for every zone
+  INPUT_SCHEDULE_PATCH,           // HTTP response: schedule snapshot or changes since ours
+  INPUT_FIRMWARE_READY,           // A verified newer build is waiting in the inactive flash bank
+  INPUT_FIRMWARE_FAILED,          // Switching to the waiting build failed
+  INPUT_TIME_SYNCED,              // SNTP reply: wall-clock time at this input
+  INPUT_ZONE_OVERRIDE,            // Technician took over (or handed back) a zone on the LAN server
+  INPUT_NETWORKS_REPLACED         // Every known network given at once (boot, or the serial link)
 };
 
 /*
@@ -74,7 +165,8 @@ enum OutputType {
   EFFECT_LOG_CONNECTION_SUCCESS,  // Display successful connection message
   EFFECT_LOG_CONNECTION_LOST,     // Display disconnection message
   EFFECT_POLL_SCHEDULE,           // Make HTTP request to get irrigation schedule
-  EFFECT_UPDATE_ZONES             // Update zone LEDs based on current schedule
+  EFFECT_UPDATE_ZONES,            // Update zone LEDs based on current schedule
+  EFFECT_ACTIVATE_FIRMWARE        // Switch flash banks and reset into the new build
 };
 
 /*
@@ -111,19 +203,193 @@ struct Credentials {
  * 
  * Represents the irrigation schedule received from the HTTP endpoint.
  * Each zone corresponds to a different irrigation area/valve.
+ * 
+ * The server numbers every version of a schedule. Polls send the number we
+ * hold so the server can answer with only what changed (see SchedulePatch).
+ * 0 means we don't hold a server version (fresh boot, fail-safe) and need a
+ * full snapshot.
  */
 struct IrrigationSchedule {
   bool zone1;  // Zone 1 activation state
   bool zone2;  // Zone 2 activation state
   bool zone3;  // Zone 3 activation state
-  unsigned long lastUpdate;  // Timestamp of last successful update
+  uint64_t lastUpdate;       // Timestamp of last successful update
+  uint32_t seq;              // Server sequence number of these zones, 0 = unknown
   
   // Constructor with default values
-  IrrigationSchedule() : zone1(false), zone2(false), zone3(false), lastUpdate(0) {}
+  IrrigationSchedule() : zone1(false), zone2(false), zone3(false), lastUpdate(0), seq(0) {}
+  
+  // Check if schedule data is older than maxAgeMs (schedule_stale_ms by default)
+  bool isStale(uint64_t now, unsigned long maxAgeMs = schedule_stale_ms) const {
+    return (now - lastUpdate) > maxAgeMs;
+  }
+  
+  // Check if any zone is open
+  bool anyZoneOn() const {
+    return zone1 || zone2 || zone3;
+  }
+  
+  // Compare zone states only (timestamps differ on every poll)
+  bool sameZones(const IrrigationSchedule& other) const {
+    return zone1 == other.zone1 && zone2 == other.zone2 && zone3 == other.zone3;
+  }
+  
+  // Zones as a bit mask (bit 0 = zone 1), the form the sequencer and flash use
+  uint8_t zoneMask() const {
+    return (zone1 ? 0x01 : 0) | (zone2 ? 0x02 : 0) | (zone3 ? 0x04 : 0);
+  }
+  
+  void setZoneMask(uint8_t mask) {
+    zone1 = (mask & 0x01) != 0;
+    zone2 = (mask & 0x02) != 0;
+    zone3 = (mask & 0x04) != 0;
+  }
+};
+
+/*
+ * SchedulePatch: One poll response, as a change to the schedule we hold
+ * 
+ * A poll sends the sequence number of our schedule. The server answers
+ * with one of:
+ * - a full snapshot (we have no version, or the gap is too large);
+ * - only the zones changed since our version (a delta);
+ * - 304 Not Modified (nothing changed), an empty delta.
+ * 
+ * A delta only applies to the exact version it was computed against, and
+ * it applies as a whole or not at all, so the zones never mix two versions.
+ */
+struct SchedulePatch {
+  uint32_t seq;         // Server version after applying the patch
+  uint32_t baseSeq;     // Version the delta was computed against (ignored if full)
+  bool full;            // Snapshot: replaces every zone
+  uint8_t changedMask;  // Zones the patch sets (bit 0 = zone 1)
+  uint8_t valueMask;    // New on/off state of the changed zones
+  
+  SchedulePatch() : seq(0), baseSeq(0), full(false), changedMask(0), valueMask(0) {}
+  
+  /**
+   * Apply to the schedule we hold
+   * @param current Schedule we hold
+   * @param patched Populated with the result (lastUpdate is left as in current)
+   * @return false if this is a delta against a version we don't hold
+   */
+  bool applyTo(const IrrigationSchedule& current, IrrigationSchedule* patched) const {
+    if (!full && (current.seq == 0 || baseSeq != current.seq)) {
+      return false;
+    }
+    uint8_t zones = (current.zoneMask() & ~changedMask) | (valueMask & changedMask);
+    *patched = current;
+    patched->setZoneMask(zones);
+    patched->seq = seq;
+    return true;
+  }
+};
+
+/*
+ * ZoneQueue: Which requested zones are actually open
+ * 
+ * The schedule says which zones *want* water; the supply can only pressurize
+ * max_concurrent_zones of them (and supply_flow_lpm worth) at a time. The
+ * zone sequencer (ZoneSequencer.h) keeps the rest waiting and rotates them
+ * in. Kept in AppState so the choice is made by the pure transition function
+ * and is visible to the rest of the firmware.
+ * 
+ * Arrays are indexed by zone number - 1.
+ */
+struct ZoneQueue {
+  uint8_t requestedMask;                // Zones the schedule wants on
+  uint8_t openMask;                     // Zones whose valves are open now
+  uint64_t openedAt[ZONE_COUNT];        // When each open zone was opened
+  uint64_t waitingSince[ZONE_COUNT];    // When each waiting zone was queued
+  unsigned long servedMs[ZONE_COUNT];   // Open time since the zone was requested
+  uint64_t lastAdvance;                 // When the queue was last advanced
   
-  // Check if schedule data is stale (older than 5 minutes)
-  bool isStale() const {
-    return (millis() - lastUpdate) > 300000;  // 5 minutes in milliseconds
+  ZoneQueue() : requestedMask(0), openMask(0), lastAdvance(0) {
+    for (int i = 0; i < ZONE_COUNT; i++) {
+      openedAt[i] = 0;
+      waitingSince[i] = 0;
+      servedMs[i] = 0;
+    }
+  }
+  
+  // Zones requested but not yet open
+  uint8_t waitingMask() const {
+    return requestedMask & ~openMask;
+  }
+};
+
+/*
+ * MoistureState: What the soil sensors last reported
+ * 
+ * Zones in wetMask are dropped from the requested set before sequencing, so
+ * a zone the server wants on is skipped (or cut short) while its soil is
+ * already wet. The wet/dry thresholds are apart so a reading hovering around
+ * one of them doesn't toggle the valve.
+ */
+struct MoistureState {
+  uint16_t permille[ZONE_COUNT];  // Latest reading (0-1000), MOISTURE_UNKNOWN if none
+  uint8_t wetMask;                // Zones wet enough to skip (bit 0 = zone 1)
+  uint64_t lastReading;           // When the last reading arrived, 0 = never
+  
+  MoistureState() : wetMask(0), lastReading(0) {
+    for (int i = 0; i < ZONE_COUNT; i++) {
+      permille[i] = MOISTURE_UNKNOWN;
+    }
+  }
+};
+
+/*
+ * WallClock: Calendar time, carried forward from the last SNTP sync
+ * 
+ * Wall time is the synced time plus the monotonic time elapsed since, with
+ * the local oscillator's measured rate error taken out (see Clock.h). It
+ * keeps running through network outages; syncs only correct it.
+ */
+struct WallClock {
+  uint64_t syncedAt;      // Monotonic time of the last sync, 0 = never synced
+  uint64_t syncedUnixMs;  // Wall time at syncedAt (ms since 1970-01-01 UTC)
+  uint64_t referenceAt;   // Monotonic time the current drift measurement began
+  uint64_t referenceUnixMs; // Wall time then
+  int32_t driftPpb;       // Oscillator rate error (parts per billion, + = fast)
+  uint32_t syncs;         // Syncs applied since boot
+  
+  WallClock() : syncedAt(0), syncedUnixMs(0), referenceAt(0), referenceUnixMs(0),
+                driftPpb(0), syncs(0) {}
+  
+  bool isSet() const {
+    return syncedAt != 0;
+  }
+};
+
+/*
+ * ZoneOverrides: Zones a technician has taken over from the schedule
+ * 
+ * Set from the LAN server (LanServer.h). An overridden zone is held open or
+ * closed whatever the schedule, the soil moisture or the stale-schedule
+ * fail-safe say, until its time runs out or it is handed back. A held-open
+ * zone still goes through the sequencer, so the supply limits hold. Not
+ * persisted: a reboot hands every zone back to the schedule.
+ */
+enum ZoneOverrideAction {
+  OVERRIDE_RELEASE,               // Hand the zone back to the schedule
+  OVERRIDE_OPEN,                  // Hold the zone open
+  OVERRIDE_CLOSE                  // Hold the zone closed
+};
+
+struct ZoneOverrides {
+  uint8_t mask;                   // Zones under manual control (bit 0 = zone 1)
+  uint8_t openMask;               // Which of them are held open (the rest are held closed)
+  uint64_t until[ZONE_COUNT];     // When each override lapses
+  
+  ZoneOverrides() : mask(0), openMask(0) {
+    for (int i = 0; i < ZONE_COUNT; i++) {
+      until[i] = 0;
+    }
+  }
+  
+  // Requested zones once the overrides are applied on top
+  uint8_t apply(uint8_t requestedMask) const {
+    return (requestedMask & ~mask) | (openMask & mask);
   }
 };
 
@@ -165,33 +431,47 @@ enum AppMode {
  * Key C++ concepts:
  * - Constructor: Special method called when creating an object
  * - Initialization list: Efficient way to set member values in constructor
- * - unsigned long: 32-bit positive integer (for timestamps)
+ * - uint64_t: 64-bit monotonic timestamps that never wrap (see Clock.h)
  * - Member initialization: Setting values when the object is created
  */
 struct AppState {
-  Credentials credentials;      // Current WiFi network credentials
+  Credentials credentials;      // Current WiFi network (the others: knownNetworks())
   AppMode mode;                // What the application is currently doing
   int wifiStatus;              // Last known WiFi hardware status
-  unsigned long lastUpdate;    // Timestamp of last state change (milliseconds)
+  uint64_t lastUpdate;         // Time of the last input (milliseconds)
+  uint64_t modeSince;          // Time the current mode was entered
   bool credentialsChanged;     // Flag: need to save credentials to flash
-  bool shouldReconnect;        // Flag: need to call WiFi.begin()
+  bool shouldReconnect;        // Flag: need to post a connect request
   bool shouldPollNow;          // Flag: need to poll immediately
   bool scheduleChanged;        // Flag: need to save schedule to flash
-  IrrigationSchedule schedule; // Current irrigation zone schedule
-  unsigned long lastPollTime;  // Timestamp of last HTTP poll attempt
+  IrrigationSchedule schedule; // Current irrigation zone schedule (requested zones)
+  ZoneQueue zones;             // Requested zones sequenced onto the supply
+  MoistureState moisture;      // Soil moisture, used to skip wet zones
+  uint64_t lastPollTime;       // Timestamp of last HTTP poll attempt
+  unsigned long pollIntervalMs;// Current adaptive poll interval
   bool httpError;              // Flag: last HTTP request failed
+  bool failSafeActive;         // Flag: zones closed because the schedule went stale
+  bool firmwareReady;          // Flag: install the waiting build once the zones are closed
+  uint32_t effectSeq;          // Sequence ID of the effect this state calls for (Output::seq)
+  WallClock clock;             // Calendar time, if synced
+  ZoneOverrides overrides;     // Zones held open or closed from the LAN server
   
   // Constructor: Called when creating a new AppState
   // The colon starts an "initialization list" - efficient way to set member values
   AppState() : mode(MODE_INITIALIZING),           // Start in initializing mode
                wifiStatus(WL_IDLE_STATUS),        // WiFi not started yet
                lastUpdate(0),                     // No timestamp yet
+               modeSince(0),                      // In the initial mode since boot
                credentialsChanged(false),         // No changes to save
                shouldReconnect(false),            // No connection needed yet
                shouldPollNow(false),              // No immediate polling needed
                scheduleChanged(false),            // No schedule changes to save
                lastPollTime(0),                   // No polls yet
-               httpError(false) {                 // No HTTP errors yet
+               pollIntervalMs(poll_interval_base_ms), // Start at the base interval
+               httpError(false),                  // No HTTP errors yet
+               failSafeActive(false),             // Zones under schedule control
+               firmwareReady(false),              // No update waiting
+               effectSeq(0) {                     // First effect request
     // Set credential strings to empty (null-terminated)
     credentials.ssid[0] = '\0';  // Empty string
     credentials.pass[0] = '\0';  // Empty string
@@ -214,14 +494,31 @@ struct AppState {
  */
 struct Input {
   InputType type;                 // Which input symbol this is
-  Credentials newCredentials;     // New credentials (if INPUT_CREDENTIALS_ENTERED)
+  Credentials newCredentials;     // New credentials (if INPUT_CREDENTIALS_ENTERED), or the
+                                  // primary of the staged list (if INPUT_NETWORKS_REPLACED)
   int wifiStatus;                // WiFi status code (if INPUT_WIFI_*)
   IrrigationSchedule newSchedule; // New schedule (if INPUT_SCHEDULE_RECEIVED)
+  SchedulePatch patch;            // Poll response (if INPUT_SCHEDULE_PATCH)
+  unsigned long pollHintMs;       // Server-requested poll delay, 0 = none (if INPUT_SCHEDULE_PATCH/HTTP_ERROR)
+  int httpStatus;                 // Status of the failed poll (if INPUT_HTTP_ERROR): the HTTP status
+                                  // (200 = unusable body), the client's negative error, 0 = no link
+  uint16_t moisturePermille[ZONE_COUNT]; // Filtered readings (if INPUT_MOISTURE_READING)
+  uint64_t unixMs;                // Wall-clock time at nowMs (if INPUT_TIME_SYNCED)
+  uint8_t overrideZone;           // Zone index, 0-based (if INPUT_ZONE_OVERRIDE)
+  bool connectNow;                // Join it straight away (if INPUT_NETWORKS_REPLACED)
+  ZoneOverrideAction overrideAction; // What to do with it (if INPUT_ZONE_OVERRIDE)
+  unsigned long overrideMs;       // How long to hold it (if INPUT_ZONE_OVERRIDE)
+  uint64_t nowMs;                 // Monotonic time the input is applied at, stamped
+                                  // by whoever steps the machine (clockMonotonicMs())
   
   // Default constructor
-  Input() : type(INPUT_NONE), wifiStatus(0) {
+  Input() : type(INPUT_NONE), wifiStatus(0), pollHintMs(0), httpStatus(0), unixMs(0),
+            overrideZone(0), connectNow(false), overrideAction(OVERRIDE_RELEASE), overrideMs(0), nowMs(0) {
     newCredentials.ssid[0] = '\0';
     newCredentials.pass[0] = '\0';
+    for (int i = 0; i < ZONE_COUNT; i++) {
+      moisturePermille[i] = MOISTURE_UNKNOWN;
+    }
   }
   
   // Factory methods: Static functions that create Input symbols
@@ -254,6 +551,22 @@ struct Input {
     return i;
   }
   
+  // The whole list waits in stageKnownNetworks() (WiFiCredentials.h); the
+  // input carries only its primary, so no Input holds every password
+  static Input networksReplaced(const Credentials& primary, bool connectNow) {
+    Input i;
+    i.type = INPUT_NETWORKS_REPLACED;
+    i.newCredentials = primary;
+    i.connectNow = connectNow;
+    return i;
+  }
+  
+  static Input credentialsCancelled() {
+    Input i;
+    i.type = INPUT_CREDENTIALS_CANCELLED;
+    return i;
+  }
+  
   static Input connectionStarted() {
     Input i;
     i.type = INPUT_CONNECTION_STARTED;
@@ -274,16 +587,28 @@ struct Input {
     return i;
   }
   
-  static Input scheduleReceived(const IrrigationSchedule& schedule) {
+  // pollHintMs comes from Cache-Control: max-age or Retry-After
+  static Input scheduleReceived(const IrrigationSchedule& schedule, unsigned long pollHintMs = 0) {
     Input i;
     i.type = INPUT_SCHEDULE_RECEIVED;
     i.newSchedule = schedule;
+    i.pollHintMs = pollHintMs;
     return i;
   }
   
-  static Input httpError() {
+  static Input schedulePatch(const SchedulePatch& patch, unsigned long pollHintMs = 0) {
+    Input i;
+    i.type = INPUT_SCHEDULE_PATCH;
+    i.patch = patch;
+    i.pollHintMs = pollHintMs;
+    return i;
+  }
+  
+  static Input httpError(unsigned long pollHintMs = 0, int httpStatus = 0) {
     Input i;
     i.type = INPUT_HTTP_ERROR;
+    i.pollHintMs = pollHintMs;
+    i.httpStatus = httpStatus;
     return i;
   }
   
@@ -304,6 +629,47 @@ struct Input {
     i.type = INPUT_POLL_STARTED;
     return i;
   }
+  
+  static Input firmwareReady() {
+    Input i;
+    i.type = INPUT_FIRMWARE_READY;
+    return i;
+  }
+  
+  static Input firmwareFailed() {
+    Input i;
+    i.type = INPUT_FIRMWARE_FAILED;
+    return i;
+  }
+  
+  // unixMs is the server's time, corrected for the round trip, as of
+  // the moment this input is stamped
+  static Input timeSynced(uint64_t unixMs) {
+    Input i;
+    i.type = INPUT_TIME_SYNCED;
+    i.unixMs = unixMs;
+    return i;
+  }
+  
+  // zone is 0-based; durationMs is ignored for OVERRIDE_RELEASE
+  static Input zoneOverride(uint8_t zone, ZoneOverrideAction action, unsigned long durationMs) {
+    Input i;
+    i.type = INPUT_ZONE_OVERRIDE;
+    i.overrideZone = zone;
+    i.overrideAction = action;
+    i.overrideMs = durationMs;
+    return i;
+  }
+  
+  // One reading per zone, 0-1000 or MOISTURE_UNKNOWN
+  static Input moistureReading(const uint16_t permille[ZONE_COUNT]) {
+    Input i;
+    i.type = INPUT_MOISTURE_READING;
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      i.moisturePermille[z] = permille[z];
+    }
+    return i;
+  }
 };
 
 /*
@@ -312,15 +678,28 @@ struct Input {
  * Outputs carry information about what operations should be performed
  * based on the current state. They are generated by the output function λ
  * and executed by the main loop.
+ * 
+ * The loop asks for the current output more than once per pass, and a
+ * state keeps asking for its effect until the follow-up Input clears it, so
+ * the same request is seen repeatedly. `seq` tells them apart: the
+ * transition function gives each new request the next ID, and the executor
+ * (executeEffect) carries out a given ID once.
  */
 struct Output {
   OutputType type;                // Which effect this is
   AppMode currentMode;            // Current mode for UI updates
   bool shouldStartConnection;     // Flag: should initiate WiFi connection
   bool credentialsNeedSaving;     // Flag: should save credentials to flash
+  uint32_t seq;                   // Effect sequence ID: the same every time one request is
+                                  // asked for, new for the next (set by outputFunction)
   
   Output() : type(EFFECT_NONE), currentMode(MODE_INITIALIZING),
-             shouldStartConnection(false), credentialsNeedSaving(false) {}
+             shouldStartConnection(false), credentialsNeedSaving(false), seq(0) {}
+  
+  // Same effect with the same arguments, whatever the sequence ID
+  bool sameRequest(const Output& other) const {
+    return type == other.type && currentMode == other.currentMode;
+  }
   
   // Factory methods for creating specific effects
   static Output none() {
@@ -386,6 +765,12 @@ struct Output {
     e.type = EFFECT_UPDATE_ZONES;
     return e;
   }
+  
+  static Output activateFirmware() {
+    Output e;
+    e.type = EFFECT_ACTIVATE_FIRMWARE;
+    return e;
+  }
 };
 
 #endif // TYPES_H
@@ -1,6 +1,11 @@
 #include "WiFiConnection.h"
-#include "WiFiCredentials.h"
 #include "IrrigationController.h"
+#include "NetworkMailbox.h"
+#include "SerialInput.h"
+#include "SerialLink.h"
+#include "MoistureSensor.h"
+#include "EventLog.h"
+#include "Clock.h"
 #include <WiFi.h>
 #include <MooreArduino.h>
 
@@ -19,18 +24,111 @@ extern MooreMachine<AppState, Input, Output> g_machine;  // Defined in main file
 // WiFi Connection Functions
 //----------------------------------------------------------------------------//
 
-void connectWiFi(const Credentials* creds) {
-  // Log connection attempt with SSID details
-  Serial.print("Connecting to SSID: '");
-  Serial.print(creds->ssid);
-  Serial.print("' (length: ");
-  Serial.print(strlen(creds->ssid));
+// The Giga core's WiFi.begin() runs its own scanNetworks() and then blocks
+// on the association, so every attempt through it would rescan. Connections
+// go straight to the mbed interface instead, with the security type and
+// channel from our one scan. WiFi.status() only follows begin(), so link
+// state comes from the interface too (wifiLinkStatus()).
+#define WIFI_SCAN_MAX 16
+
+// Known networks and the order to try them in, from the last scan
+static CredentialStore g_knownNetworks;
+static NetworkPlan g_networkPlan;
+static nsapi_security_t g_security[CREDENTIAL_STORE_SIZE];  // As scanned
+static uint8_t g_channel[CREDENTIAL_STORE_SIZE];
+static WiFiAccessPoint g_scanResults[WIFI_SCAN_MAX];
+static bool g_attemptPending = false;  // Plan has a network left to try
+static int g_currentNetwork = -1;      // Index into g_knownNetworks once up
+static int g_linkDownStatus = WL_IDLE_STATUS;  // Reported while not up
+
+static WiFiInterface* wifiInterface() {
+  NetworkInterface* network = WiFi.getNetwork();
+  return network != nullptr ? network->wifiInterface() : nullptr;
+}
+
+int wifiLinkStatus() {
+  WiFiInterface* wifi = wifiInterface();
+  if (wifi == nullptr) {
+    return WL_NO_MODULE;
+  }
+  switch (wifi->get_connection_status()) {
+    case NSAPI_STATUS_GLOBAL_UP:
+    case NSAPI_STATUS_LOCAL_UP:
+      return WL_CONNECTED;
+    case NSAPI_STATUS_CONNECTING:
+      return WL_IDLE_STATUS;
+    default:
+      return g_linkDownStatus;
+  }
+}
+
+const char* wifiNetworkName() {
+  return g_currentNetwork >= 0 ? g_knownNetworks.networks[g_currentNetwork].ssid : "";
+}
+
+uint8_t wifiNetworkSecurity() {
+  return g_currentNetwork >= 0 ? (uint8_t)g_security[g_currentNetwork] : (uint8_t)NSAPI_SECURITY_NONE;
+}
+
+// Associate with the next network in the plan (blocks until the driver's
+// join succeeds or gives up)
+static void connectNextNetwork() {
+  uint8_t index = g_networkPlan.order[g_networkPlan.next++];
+  const Credentials& network = g_knownNetworks.networks[index];
+  Serial.print("Starting WiFi connection to '");
+  Serial.print(network.ssid);
+  Serial.print("' (");
+  Serial.print(g_networkPlan.rssi[index]);
+  Serial.print(" dBm, choice ");
+  Serial.print(g_networkPlan.next);
+  Serial.print(" of ");
+  Serial.print(g_networkPlan.count);
   Serial.println(")");
+
+  nsapi_error_t result = wifiInterface()->connect(network.ssid, network.pass,
+                                                  g_security[index], g_channel[index]);
+  if (result == NSAPI_ERROR_OK) {
+    g_currentNetwork = index;
+    g_linkDownStatus = WL_CONNECTION_LOST;  // What a later drop reads as
+    g_attemptPending = false;
+    return;
+  }
+  Serial.print("WiFi connection failed (error ");
+  Serial.print(result);
+  Serial.println(")");
+  g_linkDownStatus = result == NSAPI_ERROR_NO_SSID ? WL_NO_SSID_AVAIL : WL_CONNECT_FAILED;
+  g_attemptPending = g_networkPlan.next < g_networkPlan.count;
+  if (!g_attemptPending) {
+    Serial.println("WiFi connection failed on every known network in range");
+  }
+}
+
+void connectWiFi(const CredentialStore* networks) {
+  // Kept for serviceWiFiConnect(), which works down the plan
+  g_knownNetworks = *networks;
+  g_attemptPending = false;
+  g_currentNetwork = -1;
+  Serial.print("Connecting to the strongest of ");
+  Serial.print(g_knownNetworks.count);
+  Serial.print(" known networks (primary: '");
+  Serial.print(g_knownNetworks.networks[0].ssid);
+  Serial.println("')");
+
+  WiFiInterface* wifi = wifiInterface();
+  if (wifi == nullptr) {
+    Serial.println("ERROR: WiFi module not detected!");
+    g_linkDownStatus = WL_NO_MODULE;
+    return;
+  }
+  wifi->disconnect();  // No-op unless an earlier association is still up
   
   // Scan for available networks before connecting
   Serial.println("Scanning for networks...");
   Serial.println("This may take 10-15 seconds...");
-  int numNetworks = WiFi.scanNetworks();  // Blocking call
+  int numNetworks = wifi->scan(g_scanResults, WIFI_SCAN_MAX);  // Blocking call
+  if (numNetworks < 0) {
+    numNetworks = 0;
+  }
   Serial.print("Scan completed. Found ");
   Serial.print(numNetworks);
   Serial.println(" networks:");
@@ -44,36 +142,49 @@ void connectWiFi(const Credentials* creds) {
     Serial.println("4. WiFi module not properly initialized");
   }
   
-  // Search scan results for target network
-  bool networkFound = false;
+  // Rank the known networks the scan found by signal strength
+  networkPlanBegin(&g_networkPlan);
   for (int i = 0; i < numNetworks; i++) {
+    const WiFiAccessPoint& ap = g_scanResults[i];
     // Display each network: index, SSID, signal strength
     Serial.print(i);
     Serial.print(": ");
-    Serial.print(WiFi.SSID(i));
+    Serial.print(ap.get_ssid());
     Serial.print(" (");
-    Serial.print(WiFi.RSSI(i));  // Received Signal Strength Indicator
+    Serial.print(ap.get_rssi());  // Received Signal Strength Indicator
     Serial.println(" dBm)");
     
-    // Check if this is our target network (case-sensitive string compare)
-    if (strcmp(WiFi.SSID(i), creds->ssid) == 0) {
-      networkFound = true;
-      Serial.println("  ^ Target network found!");
+    int known = credentialStoreFind(g_knownNetworks, ap.get_ssid());
+    if (known >= 0) {
+      Serial.println("  ^ Known network");
+      // Keep the strongest sighting's security and channel for connect()
+      if (ap.get_rssi() > g_networkPlan.rssi[known]) {
+        g_security[known] = ap.get_security();
+        g_channel[known] = ap.get_channel();
+      }
     }
+    networkPlanSeen(&g_networkPlan, g_knownNetworks, ap.get_ssid(), ap.get_rssi());
   }
+  networkPlanRank(&g_networkPlan, g_knownNetworks);
   
-  // Abort connection if target network not found in scan
-  if (!networkFound) {
-    Serial.println("ERROR: Target network not found in scan!");
-    digitalWrite(wifi_led_pin, LOW);  // Turn off WiFi LED
+  // Abort connection if no known network was found in scan
+  if (g_networkPlan.count == 0) {
+    Serial.println("ERROR: No known network found in scan!");
+    g_linkDownStatus = WL_NO_SSID_AVAIL;
     return;  // Early exit
   }
 
-  // Begin connection attempt (non-blocking)
-  Serial.println("Starting WiFi connection...");
-  WiFi.begin(creds->ssid, creds->pass);
-  
-  // Don't block here - let the Moore machine tick system handle status polling
+  // The scan was this pass's blocking job; serviceWiFiConnect() joins the
+  // strongest on a later pass and moves down the list from there
+  g_attemptPending = true;
+}
+
+bool serviceWiFiConnect() {
+  if (!g_attemptPending) {
+    return false;
+  }
+  connectNextNetwork();  // From the same scan
+  return true;
 }
 
 //----------------------------------------------------------------------------//
@@ -99,14 +210,47 @@ Input parseUserInput(char input, AppMode currentMode) {
 Input readEvents() {
   const AppState& state = g_machine.getState();
   
+  // Bench tool frames on the serial port; console text is queued for below
+  Input linkInput;
+  if (serviceSerialLink(state, &linkInput)) {
+    return linkInput;
+  }
+  
   // Check for user input via serial (highest priority)
-  char input = readSingleChar();
-  if (input != '\0') {
-    return parseUserInput(input, state.mode);  // Convert char to Input
+  if (state.mode == MODE_ENTERING_CREDENTIALS) {
+    // Serial bytes belong to the credential line editor while it's active
+    Credentials creds;
+    switch (pollCredentialEntry(&creds)) {
+      case CREDENTIAL_ENTRY_COMPLETE:
+        return Input::credentialsEntered(creds);
+      case CREDENTIAL_ENTRY_FAILED:
+        return Input::credentialsCancelled();
+      case CREDENTIAL_ENTRY_PENDING:
+        break;  // Keep going - other events still flow while the user types
+    }
+  } else {
+    char input = readSingleChar();
+    if (input == 'j' || input == 'J') {
+      printEventLog();  // Read-only: nothing for the machine
+    } else if (input != '\0') {
+      return parseUserInput(input, state.mode);  // Convert char to Input
+    }
+  }
+
+  // Check for results posted by the network side (schedule or HTTP error)
+  Input networkInput;
+  if (receiveNetworkInput(&networkInput)) {
+    return networkInput;
+  }
+  
+  // Filtered soil moisture (drains the ADC's DMA buffers every pass)
+  Input moistureInput;
+  if (readMoistureInput(&moistureInput)) {
+    return moistureInput;
   }
   
   // Check for WiFi status changes (hardware polling happens here, not in transition function)
-  int currentWifiStatus = WiFi.status();
+  int currentWifiStatus = wifiLinkStatus();
   if (currentWifiStatus != state.wifiStatus) {
     Serial.print("DEBUG: WiFi status changed from ");
     Serial.print(state.wifiStatus);
@@ -2,17 +2,52 @@
 #define WIFI_CONNECTION_H
 
 #include "Types.h"
+#include "CredentialStore.h"
 
 //----------------------------------------------------------------------------//
 // WiFi Connection Management
 //----------------------------------------------------------------------------//
 
 /**
- * Initiate WiFi connection to specified network
- * Performs network scan first to verify target exists
- * @param creds Pointer to credentials for target network
+ * Start a WiFi connection to the strongest known network
+ * Scans once and ranks `networks` by signal strength; the association
+ * itself is left to serviceWiFiConnect(), so a pass never both scans and
+ * joins. Network side: the networks come in the connect request, never
+ * from flash.
+ * @param networks Known networks, [0] = the current one
  */
-void connectWiFi(const Credentials* creds);
+void connectWiFi(const CredentialStore* networks);
+
+/**
+ * Join the next known network from the last scan (network side, call while
+ * idle). Connects through the mbed interface with the security type and
+ * channel the scan reported (WiFi.begin() would scan again) and blocks until
+ * the driver's join succeeds or gives up. A refused network moves the plan
+ * on to the next one for the following call; no rescan between attempts.
+ * @return true if an association was attempted (this pass's blocking job)
+ */
+bool serviceWiFiConnect();
+
+/**
+ * Link state in WiFi.status() terms. Connections bypass WiFi.begin(), so
+ * WiFi.status() never sees them - use this everywhere instead.
+ * @return WL_CONNECTED, WL_IDLE_STATUS while associating, WL_CONNECT_FAILED
+ *         or WL_NO_SSID_AVAIL after a refused attempt, WL_CONNECTION_LOST
+ *         after a drop, or WL_NO_MODULE
+ */
+int wifiLinkStatus();
+
+/**
+ * SSID of the network last connected to (WiFi.SSID() only follows begin())
+ * @return SSID, or "" before the first connection
+ */
+const char* wifiNetworkName();
+
+/**
+ * Security type of the network last connected to, as scanned
+ * @return nsapi_security_t value
+ */
+uint8_t wifiNetworkSecurity();
 
 /**
  * Parse single character user input into Input symbols
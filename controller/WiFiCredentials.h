@@ -2,54 +2,49 @@
 #define WIFI_CREDENTIALS_H
 
 #include "Types.h"
+#include "CredentialStore.h"
 
 //----------------------------------------------------------------------------//
 // WiFi Credentials Management
 //----------------------------------------------------------------------------//
 
 /**
- * Persist WiFi credentials to flash memory using KVStore
- * @param creds Pointer to credentials structure to save
+ * Persist every known network in the flash configuration record, in one write
+ * The first becomes the primary one; the rest are kept as backups, most
+ * recent first (see CredentialStore.h).
+ * @param store Networks to keep, the primary one first (at least one)
  */
-void saveCredentials(const Credentials* creds);
+void saveCredentialStore(const CredentialStore* store);
 
 /**
- * Load WiFi credentials from flash memory
+ * Load the primary WiFi network from the configuration record (read once at boot)
  * @param creds Pointer to credentials structure to populate
  * @return true if credentials were found and loaded, false otherwise
  */
 bool loadCredentials(Credentials* creds);
 
 /**
- * Prompt user for WiFi credentials via Serial (blocking)
- * @param creds Pointer to credentials structure to populate
- * @return true if valid credentials were entered, false on validation failure
- */
-bool promptForCredentialsBlocking(Credentials* creds);
-
-/**
- * Validate WiFi credential length
- * @param credential String to validate (SSID or password)
- * @return true if length is valid (1-63 characters), false otherwise
- */
-bool isValidCredentialLength(const String& credential);
-
-/**
- * Clear any pending serial input to prevent stale data
+ * Hand a whole list of networks to the machine alongside
+ * INPUT_NETWORKS_REPLACED, which carries only the primary one. Call just
+ * before stepping that input; the list stays here, on the control side.
+ * @param store Networks to keep, the primary one first
  */
-void flushSerialInput();
+void stageKnownNetworks(const CredentialStore* store);
 
 /**
- * Persist irrigation schedule to flash memory using KVStore
- * @param schedule Pointer to schedule structure to save
+ * The known networks as the machine sees them: the staged list with the
+ * current network (AppState.credentials) at its front. Read by the save
+ * and connect effects.
+ * @param current The machine's current network
+ * @return Known networks, [0] = current
  */
-void saveSchedule(const IrrigationSchedule* schedule);
+const CredentialStore& knownNetworks(const Credentials& current);
 
 /**
- * Load irrigation schedule from flash memory
- * @param schedule Pointer to schedule structure to populate
- * @return true if schedule was found and loaded, false otherwise
+ * Load every known network from the configuration record
+ * @param store Populated with the primary network first, then the backups
+ * @return true if any network was stored
  */
-bool loadSchedule(IrrigationSchedule* schedule);
+bool loadCredentialStore(CredentialStore* store);
 
 #endif // WIFI_CREDENTIALS_H
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "ZoneSequencer.h"
+
+//----------------------------------------------------------------------------//
+// Capacity Checks
+//----------------------------------------------------------------------------//
+
+static int countZones(uint8_t mask) {
+  int count = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (mask & (1 << i)) count++;
+  }
+  return count;
+}
+
+static unsigned long flowOf(uint8_t mask) {
+  unsigned long flow = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (mask & (1 << i)) flow += zone_flow_lpm[i];
+  }
+  return flow;
+}
+
+// Can `zone` open alongside `openMask` without exceeding the supply?
+static bool fitsSupply(uint8_t openMask, int zone) {
+  if (countZones(openMask) >= max_concurrent_zones) {
+    return false;
+  }
+  if (supply_flow_lpm == 0) {
+    return true;  // No flow budget configured - zone count is the only limit
+  }
+  // A zone that alone exceeds the budget still gets the supply to itself,
+  // otherwise it would never run
+  return openMask == 0 || flowOf(openMask) + zone_flow_lpm[zone] <= supply_flow_lpm;
+}
+
+//----------------------------------------------------------------------------//
+// Turns
+//----------------------------------------------------------------------------//
+
+static void creditOpenZones(ZoneQueue* queue, uint64_t at) {
+  unsigned long elapsed = (unsigned long)(at - queue->lastAdvance);
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (queue->openMask & (1 << i)) {
+      queue->servedMs[i] += elapsed;
+    }
+  }
+  queue->lastAdvance = at;
+}
+
+/*
+ * The next open zone to yield its slot, and when. A zone yields once it has
+ * run zone_rotation_ms and has been served more than some waiting zone;
+ * waiting zones don't accrue service, so that moment is known in advance.
+ * The earliest goes first, the most served on a tie.
+ */
+static int nextYield(const ZoneQueue& queue, uint64_t* at) {
+  uint8_t waiting = queue.waitingMask();
+  if (waiting == 0) {
+    return -1;
+  }
+  unsigned long leastWaitingServed = 0;
+  bool anyWaiting = false;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if ((waiting & (1 << i)) && (!anyWaiting || queue.servedMs[i] < leastWaitingServed)) {
+      leastWaitingServed = queue.servedMs[i];
+      anyWaiting = true;
+    }
+  }
+
+  int yielding = -1;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (!(queue.openMask & (1 << i))) {
+      continue;
+    }
+    uint64_t yieldAt = queue.openedAt[i] + zone_rotation_ms;
+    if (queue.servedMs[i] <= leastWaitingServed) {
+      uint64_t overtakes = queue.lastAdvance + (leastWaitingServed - queue.servedMs[i]) + 1;
+      if (overtakes > yieldAt) yieldAt = overtakes;
+    }
+    if (yieldAt < queue.lastAdvance) {
+      yieldAt = queue.lastAdvance;
+    }
+    if (yielding < 0 || yieldAt < *at ||
+        (yieldAt == *at && queue.servedMs[i] > queue.servedMs[yielding])) {
+      yielding = i;
+      *at = yieldAt;
+    }
+  }
+  return yielding;
+}
+
+/*
+ * Fill free capacity: least served first, then longest waiting. Strictly in
+ * that order - when the zone at the head doesn't fit beside the open ones,
+ * the capacity is held for it rather than handed to a smaller zone behind
+ * it. Otherwise a zone too big to share the supply would watch the smaller
+ * ones take turns refilling every gap and never open.
+ */
+static void fillSupply(ZoneQueue* queue, uint64_t now) {
+  while (true) {
+    int head = -1;
+    for (int i = 0; i < ZONE_COUNT; i++) {
+      if (!(queue->waitingMask() & (1 << i))) {
+        continue;
+      }
+      if (head < 0 || queue->servedMs[i] < queue->servedMs[head] ||
+          (queue->servedMs[i] == queue->servedMs[head] &&
+           now - queue->waitingSince[i] > now - queue->waitingSince[head])) {
+        head = i;
+      }
+    }
+    if (head < 0 || !fitsSupply(queue->openMask, head)) {
+      break;  // Nothing waiting, or held until the open zones drain
+    }
+    queue->openMask |= 1 << head;
+    queue->openedAt[head] = now;
+  }
+}
+
+// Play out every turn that ends by `now`, each at the moment it ends
+static void rotateUntil(ZoneQueue* queue, uint64_t now) {
+  // Each pass closes one zone and opens another; a handful covers any
+  // interval between two calls
+  for (int pass = 0; pass < ZONE_COUNT * ZONE_COUNT; pass++) {
+    uint64_t at = 0;
+    int yielding = nextYield(*queue, &at);
+    if (yielding < 0 || at > now) {
+      break;
+    }
+    creditOpenZones(queue, at);
+    queue->openMask &= ~(1 << yielding);
+    queue->waitingSince[yielding] = at;
+    fillSupply(queue, at);
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Queue Advance
+//----------------------------------------------------------------------------//
+
+ZoneQueue advanceZoneQueue(const ZoneQueue& queue, uint8_t requestedMask, uint64_t now) {
+  ZoneQueue next = queue;
+  requestedMask &= (1 << ZONE_COUNT) - 1;
+
+  // Turns that ended since the last advance play out first, under the
+  // requests of the time
+  rotateUntil(&next, now);
+  creditOpenZones(&next, now);
+
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    uint8_t bit = 1 << i;
+    bool wasRequested = next.requestedMask & bit;
+    bool requested = requestedMask & bit;
+
+    if (!requested) {
+      // 1. No longer requested - close and forget its history
+      next.openMask &= ~bit;
+      next.servedMs[i] = 0;
+      next.waitingSince[i] = 0;
+    } else if (!wasRequested) {
+      // Newly requested - join the back of the queue
+      next.servedMs[i] = 0;
+      next.waitingSince[i] = now;
+    }
+  }
+  next.requestedMask = requestedMask;
+
+  // 2. Zones whose turn is over yield to newly waiting ones right away
+  rotateUntil(&next, now);
+
+  // 3. Fill free capacity
+  fillSupply(&next, now);
+  return next;
+}
+
+IrrigationSchedule openZoneSchedule(const ZoneQueue& queue, uint64_t lastUpdate) {
+  IrrigationSchedule schedule;
+  schedule.zone1 = (queue.openMask & 0x01) != 0;
+  schedule.zone2 = (queue.openMask & 0x02) != 0;
+  schedule.zone3 = (queue.openMask & 0x04) != 0;
+  schedule.lastUpdate = lastUpdate;
+  return schedule;
+}
+
+void openZoneDeadlines(const ZoneQueue& queue, uint64_t scheduleUpdated, const ZoneOverrides& overrides,
+                       uint64_t closeBy[ZONE_COUNT]) {
+  // The transition function closes a schedule once it is older than
+  // schedule_stale_ms; the timer closes the valves at the same moment
+  uint64_t staleAt = (stale_schedule_failsafe && scheduleUpdated != 0)
+                         ? scheduleUpdated + schedule_stale_ms + 1 : 0;
+
+  // The next turn to end, exactly as advanceZoneQueue() will play it out
+  uint64_t yieldAt = 0;
+  int yielding = nextYield(queue, &yieldAt);
+
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    closeBy[i] = 0;
+    if (!(queue.openMask & (1 << i))) {
+      continue;
+    }
+    // A zone held open from the LAN server outlives a stale schedule, but
+    // not its own override
+    closeBy[i] = (overrides.openMask & (1 << i)) ? overrides.until[i] : staleAt;
+    if (i == yielding && (closeBy[i] == 0 || yieldAt < closeBy[i])) {
+      closeBy[i] = yieldAt;
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef ZONE_SEQUENCER_H
+#define ZONE_SEQUENCER_H
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Hydraulic-Aware Zone Sequencer
+//----------------------------------------------------------------------------//
+
+/*
+ * Sits between the received schedule and the valve outputs. The schedule
+ * requests zones; the sequencer opens at most max_concurrent_zones of them,
+ * within supply_flow_lpm if zone flows are configured, and queues the rest.
+ *
+ * Policy, applied on every advance:
+ * 1. Zones no longer requested close immediately.
+ * 2. An open zone that has run zone_rotation_ms yields its slot to a
+ *    waiting zone that has been served less.
+ * 3. Free capacity is filled with the least-served waiting zone first,
+ *    then the longest-waiting. If that zone doesn't fit beside the open
+ *    ones, the capacity is held for it until they yield, rather than
+ *    backfilled with a zone behind it (with a zone count limit alone,
+ *    nothing waits while a slot is free).
+ *
+ * Turns end at exact times rather than at the next call: advancing past the
+ * moment a zone's turn ends plays the rotation out at that moment. That
+ * makes the next valve edge known in advance (openZoneDeadlines()), so a
+ * hardware timer can make it however late the loop runs.
+ *
+ * The schedule carries on/off requests rather than runtimes, so there is no
+ * known finish time to optimize against. Serving the least-watered zone
+ * first, and holding the supply for it when it needs more than is free,
+ * keeps every requested zone progressing, a zone that can only run alone
+ * included.
+ *
+ * Pure functions (no hardware access): called from the transition function
+ * and from boot, and linkable into host tools.
+ */
+
+/**
+ * Advance the queue to `now` against the current requests
+ * @param queue Current queue state
+ * @param requestedMask Zones the schedule wants on (bit 0 = zone 1)
+ * @param now Current monotonic time in milliseconds (clockMonotonicMs())
+ * @return Updated queue
+ */
+ZoneQueue advanceZoneQueue(const ZoneQueue& queue, uint8_t requestedMask, uint64_t now);
+
+/**
+ * The valve outputs the queue calls for, as a schedule for updateZoneLEDs()
+ * @param queue Current queue state
+ * @param lastUpdate Timestamp to carry (the requested schedule's)
+ * @return Schedule with only the open zones on
+ */
+IrrigationSchedule openZoneSchedule(const ZoneQueue& queue, uint64_t lastUpdate);
+
+/**
+ * Latest time each open zone may stay open without the loop confirming it,
+ * for the output engine to enforce in hardware (OutputEngine.h):
+ * - the schedule going stale, if the fail-safe is enabled, or for a zone
+ *   held open by an override, the override running out
+ * - the end of the zone's turn, for the open zone that will be the next to
+ *   yield to a waiting one
+ * @param queue Current queue state
+ * @param scheduleUpdated When the schedule was last confirmed (0 = never)
+ * @param overrides Zones held open or closed from the LAN server
+ * @param closeBy Populated per zone: monotonic deadline, 0 = none
+ */
+void openZoneDeadlines(const ZoneQueue& queue, uint64_t scheduleUpdated, const ZoneOverrides& overrides,
+                       uint64_t closeBy[ZONE_COUNT]);
+
+#endif // ZONE_SEQUENCER_H
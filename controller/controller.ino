@@ -9,7 +9,8 @@
  * - Receiving scheduling commands from the web server (configurable hostname/port)
  * - Controlling 3 irrigation zones via LED indicators
  * - Providing real-time status feedback through LEDs
- * - Allowing local WiFi credential management
+ * - Allowing local WiFi credential management; the last four networks
+ *   entered are remembered, and the strongest one in range is used
  * 
  * WiFi Connection States:
  * - INITIALIZING: System startup, checking for saved credentials
@@ -25,20 +26,58 @@
  * - Zone 1 LED (Pin 4): Irrigation zone 1 status
  * - Zone 2 LED (Pin 5): Irrigation zone 2 status  
  * - Zone 3 LED (Pin 6): Irrigation zone 3 status
+ * - Or, for more zones than free pins: valves on chained 74HC595 shift
+ *   registers over SPI (valve_shift_registers), latched on pin 10
  * - Serial interface (115200 baud): User interaction and debugging
  * 
  * Irrigation Schedule:
- * - Polls configured server every 30 seconds when connected
- * - Expects JSON: {"zone1":true,"zone2":false,"zone3":true}
- * - LEDs reflect current zone activation state
- * - Schedule data cached with 5-minute staleness detection
+ * - Polls configured server every 10 s to 2 min when connected, adapting to
+ *   schedule changes and server Cache-Control/Retry-After hints
+ * - Sends GET /?since=<version held>; expects a snapshot
+ *   {"seq":7,"zone1":true,"zone2":false,"zone3":true}, only the changed zones
+ *   {"seq":9,"base":7,"zone2":true}, or 304 Not Modified
+ * - LEDs reflect current zone activation state; at most max_concurrent_zones
+ *   are open at once, the rest take turns
+ * - Zones close automatically if the schedule goes 5 minutes unconfirmed
+ * 
+ * LAN Status and Overrides (port 80, optional bearer token):
+ * - GET /status: mode, schedule age and, per zone, scheduled/open/waiting,
+ *   soil moisture and any override, as JSON
+ * - POST /zones/{1-3}/open or /close [?minutes=M]: hold a zone open or closed
+ *   regardless of the schedule (default 10 minutes, at most an hour); the
+ *   sequencer still limits how many zones are open at once
+ * - POST /zones/{1-3}/auto: hand the zone back to the schedule
+ * 
+ * Time:
+ * - All timing runs on a 64-bit millisecond clock that never wraps
+ * - Wall-clock time comes from SNTP (hourly) and keeps running, drift
+ *   corrected, while the network is down
+ * 
+ * Soil Moisture (optional):
+ * - One analog sensor per zone (A0-A2), sampled by DMA and median/average filtered
+ * - A requested zone whose soil is already wet is skipped, or closed early
+ * 
+ * Firmware Updates (optional):
+ * - Newer signed builds are fetched from the server in chunks, written to
+ *   the inactive flash bank and installed by a bank swap once no zone is open
  * 
  * User Commands:
  * - 'c': Change WiFi credentials
  * - 'r': Retry connection when disconnected
+ * - 'j': Print the newest events from the event journal
+ * 
+ * Bench Tools (same serial port):
+ * - CRC-checked binary frames between the console text (SerialFrame.h):
+ *   provision the known networks, read status, counters and loop timing,
+ *   dump the whole event journal or trace machine steps (host/serial-tool)
  * 
  * Persistent Storage:
- * - WiFi credentials saved to flash memory (survives power cycles)
+ * - One versioned, CRC-checked record holds the known networks, the last
+ *   schedule and connection hints (survives power cycles, read once at boot)
+ * - A crash record naming the loop stage that hung (watchdog) or the error
+ *   that forced a reset
+ * - An append-only journal of zone, link and poll-failure events on the
+ *   QSPI flash, written a page of events at a time
  */
 
 // Arduino WiFi library for managing wireless connections
@@ -57,9 +96,23 @@
 // Local modules
 #include "Types.h"
 #include "WiFiCredentials.h"
+#include "ConfigStore.h"
 #include "WiFiConnection.h"
 #include "IrrigationController.h"
 #include "StateMachine.h"
+#include "NetworkMailbox.h"
+#include "SerialInput.h"
+#include "Boot.h"
+#include "HeapAudit.h"
+#include "LoopWatchdog.h"
+#include "ZoneSequencer.h"
+#include "MoistureSensor.h"
+#include "FirmwareUpdate.h"
+#include "Clock.h"
+#include "OutputEngine.h"
+#include "EventLog.h"
+#include "LanServer.h"
+#include "SerialLink.h"
 
 using namespace MooreArduino;
 
@@ -96,6 +149,15 @@ const int zone1_led_pin = 4;  // Zone 1 irrigation LED
 const int zone2_led_pin = 5;  // Zone 2 irrigation LED
 const int zone3_led_pin = 6;  // Zone 3 irrigation LED
 
+// Valves on a chain of 74HC595 shift registers instead of the zone pins
+// above: zone N is output N-1 of the chain (Q0 of the register on MOSI
+// first). Wire the chain to the board's SPI header (MOSI, SCK), RCLK to
+// the latch pin and /OE to the enable pin with a pull-up, so no valve opens
+// before the first all-off frame is latched. 0 keeps the zone pins.
+const int valve_shift_registers = 0;
+const int valve_latch_pin = 10;
+const int valve_enable_pin = 9;
+
 //----------------------------------------------------------------------------//
 // Network Configuration
 //----------------------------------------------------------------------------//
@@ -104,6 +166,129 @@ const int zone3_led_pin = 6;  // Zone 3 irrigation LED
 const char* server_hostname = "192.168.5.7";  // Server hostname or IP address  
 const int server_port = 3000;           // Server port number
 
+// A hostname is resolved once and refreshed in the background; the WiFi
+// library doesn't expose the DNS record's TTL, so this stands in for it.
+// Ignored when server_hostname is an IP address.
+const unsigned long server_address_ttl_ms = 3600000;  // 1 hour
+
+// Schedule polls reuse one keep-alive connection. Warp closes connections
+// idle for 30 s, so don't trust one that has been idle nearly that long.
+const unsigned long http_keepalive_idle_ms = 25000;   // 25 seconds
+const unsigned long http_response_timeout_ms = 10000; // 10 seconds
+
+// An association that hasn't completed this long after the connect request
+// is given up (mode falls back to DISCONNECTED)
+const unsigned long wifi_connect_timeout_ms = 30000;  // 30 seconds
+
+//----------------------------------------------------------------------------//
+// LAN Server Configuration
+//----------------------------------------------------------------------------//
+
+// Technicians on the site network can read status over HTTP on this port (0
+// turns the server off); reading status never needs a token. Zone overrides
+// stay off (403) until lan_http_token is set, then need it on every POST:
+//   curl -X POST -H "Authorization: Bearer <token>" http://<controller>/zones/1/open
+// Overrides aren't persisted: a reboot hands every zone back to the schedule.
+const int lan_http_port = 80;
+const char* lan_http_token = "";
+const unsigned long lan_http_idle_ms = 5000;          // 5 seconds
+const unsigned long lan_override_default_ms = 600000; // 10 minutes
+const unsigned long lan_override_max_ms = 3600000;    // 1 hour
+
+//----------------------------------------------------------------------------//
+// Clock Configuration
+//----------------------------------------------------------------------------//
+
+// Wall-clock time is synced from this SNTP server and carried forward on the
+// board's clock in between. The offset is fixed (no daylight saving rules):
+// e.g. 60 for CET, -300 for EST.
+const char* ntp_server_hostname = "pool.ntp.org";
+const unsigned long time_sync_interval_ms = 3600000;  // 1 hour
+const int utc_offset_minutes = 0;
+
+//----------------------------------------------------------------------------//
+// Zone Sequencing Configuration
+//----------------------------------------------------------------------------//
+
+// The supply can't pressurize every zone at once. Requested zones beyond
+// these limits wait their turn; each open zone yields to a waiting one after
+// zone_rotation_ms. Set zone flows and the supply budget (L/min) to limit by
+// flow as well as by count; leave them 0 to count zones only.
+const int max_concurrent_zones = 2;
+const unsigned long zone_rotation_ms = 900000;      // 15 minutes
+const unsigned int zone_flow_lpm[ZONE_COUNT] = {0, 0, 0};
+const unsigned int supply_flow_lpm = 0;
+
+//----------------------------------------------------------------------------//
+// Soil Moisture Configuration
+//----------------------------------------------------------------------------//
+
+// One sensor per zone on the analog pins below. Calibrate by reading each
+// sensor in dry air/soil and in a glass of water (capacitive sensors read
+// lower when wet). A zone at or above the wet threshold is skipped until it
+// falls below the dry threshold. Readings feed the machine once a second;
+// if they stop for a minute, zones follow the schedule alone.
+const bool moisture_sensing_enabled = false;
+const int zone_moisture_pins[ZONE_COUNT] = {A0, A1, A2};
+const unsigned long moisture_sample_rate_hz = 100;  // Per channel
+const unsigned long moisture_report_ms = 1000;      // 1 second
+const unsigned long moisture_stale_ms = 60000;      // 1 minute
+const uint16_t moisture_raw_dry = 3000;             // 12-bit ADC counts
+const uint16_t moisture_raw_wet = 1300;
+const uint16_t moisture_wet_permille = 700;
+const uint16_t moisture_dry_permille = 550;
+
+//----------------------------------------------------------------------------//
+// Firmware Update Configuration
+//----------------------------------------------------------------------------//
+
+// Bump firmware_version for every release: the controller installs an image
+// from the server only if its build number is higher. Images must be signed
+// with the key whose public half is below - `just host-firmware-sign` signs a
+// build and prints the array to paste here. All zeros accepts nothing.
+const uint32_t firmware_version = 1;
+const bool ota_enabled = false;
+const unsigned long ota_check_interval_ms = 3600000;  // 1 hour
+const uint8_t ota_public_key[65] = {0};
+
+//----------------------------------------------------------------------------//
+// Event Journal Configuration
+//----------------------------------------------------------------------------//
+
+// Events are kept in RAM and written to flash a page (16 events) at a time;
+// a partial page is written once its oldest event has waited this long, so
+// a power cut loses at most this much history
+const unsigned long journal_flush_ms = 60000;       // 1 minute
+
+//----------------------------------------------------------------------------//
+// Watchdog Configuration
+//----------------------------------------------------------------------------//
+
+// The hardware watchdog resets the board if one loop() pass takes longer than
+// this. serviceNetworkMailbox() runs at most one blocking network job per
+// pass: a WiFi scan (10-15 s), one association, one DNS lookup, one SNTP
+// exchange (1 s) or one HTTP request (cut off at HTTP_REQUEST_DEADLINE_MS =
+// 15 s). Must exceed the slowest of these and stay under the IWDG limit of
+// ~32 s.
+const unsigned long watchdog_timeout_ms = 30000;    // 30 seconds
+
+//----------------------------------------------------------------------------//
+// Polling Configuration
+//----------------------------------------------------------------------------//
+
+// Poll interval adapts between these bounds: it snaps to the minimum when the
+// schedule changes, grows 1.5x per unchanged poll, and follows the server's
+// Cache-Control: max-age / Retry-After hints. Keep the maximum well under the
+// staleness bound so several polls can fail before the fail-safe trips.
+const unsigned long poll_interval_min_ms = 10000;   // 10 seconds
+const unsigned long poll_interval_base_ms = 30000;  // 30 seconds
+const unsigned long poll_interval_max_ms = 120000;  // 2 minutes
+
+// A schedule not confirmed by the server for this long is stale. With the
+// fail-safe enabled, stale schedules close every zone until the next poll.
+const unsigned long schedule_stale_ms = 300000;     // 5 minutes
+const bool stale_schedule_failsafe = true;
+
 //----------------------------------------------------------------------------//
 // Global State Management
 //----------------------------------------------------------------------------//
@@ -119,56 +304,52 @@ Button g_resetButton(13);       // Reset button on pin 13
 WiFiClient g_wifiClient;
 HttpClient g_httpClient(g_wifiClient, server_hostname, server_port);
 
+// Every input reaches the machine through here, stamped with the time it is
+// applied at - the transition function's only source of time
+static void stepMachine(Input input) {
+  input.nowMs = clockMonotonicMs();
+  g_machine.step(input);
+  eventLogInput(input, g_machine.getState());
+  effectsObserveInput(input);
+  serialLinkTrace(input, g_machine.getState());
+}
+
 //----------------------------------------------------------------------------//
 // Arduino Setup Function
 //----------------------------------------------------------------------------//
 
 void setup() {
-  // Configure LED pins as outputs
-  pinMode(wifi_led_pin, OUTPUT);    // WiFi status LED
-  pinMode(power_led_pin, OUTPUT);   // Power indicator LED
-  pinMode(zone1_led_pin, OUTPUT);   // Zone 1 LED
-  pinMode(zone2_led_pin, OUTPUT);   // Zone 2 LED
-  pinMode(zone3_led_pin, OUTPUT);   // Zone 3 LED
-  
-  // Initialize LEDs
+  // The output engine owns the WiFi LED (PWM) and the zone outputs, all
+  // starting off; the power LED is a plain output
+  outputEngineBegin();
+  pinMode(power_led_pin, OUTPUT);
   digitalWrite(power_led_pin, HIGH); // Turn on power LED immediately
-  digitalWrite(wifi_led_pin, LOW);   // WiFi LED starts off
-  digitalWrite(zone1_led_pin, LOW);  // Zone LEDs start off
-  digitalWrite(zone2_led_pin, LOW);
-  digitalWrite(zone3_led_pin, LOW);
 
-  // Initialize serial communication at 115200 baud
+  // Initialize serial communication at 115200 baud. This doesn't wait for a
+  // USB host; output before one attaches is simply dropped.
   Serial.begin(115200);
-  while (!Serial);  // Wait for serial port to connect (USB serial)
-
-  delay(1000);  // Brief pause for system stabilization
-
-  // Verify WiFi hardware is present
-  Serial.println("Checking WiFi module...");
-  if (WiFi.status() == WL_NO_MODULE) {
-    Serial.println("ERROR: WiFi module not detected!");
-    // Infinite error loop with fast blinking WiFi LED
-    while (true) {
-      digitalWrite(wifi_led_pin, HIGH);
-      delay(100);
-      digitalWrite(wifi_led_pin, LOW);
-      delay(100);
-    }
-  }
-  
-  // Log current WiFi module status for debugging
-  Serial.print("WiFi module status: ");
-  Serial.println(WiFi.status());
-  
-  // Display firmware version for diagnostics
-  Serial.print("WiFi firmware: ");
-  Serial.println(WiFi.firmwareVersion());
+
+  // Restore persisted zone outputs before anything slow happens
+  IrrigationSchedule loadedSchedule;
+  bool hasSchedule = bootRestoreZones(&loadedSchedule);
+
+  // Save the previous reset's crash record and arm the hardware watchdog
+  watchdogBegin();
+
+  // Find the end of the event journal (reads a fixed number of flash pages)
+  eventLogBegin();
+
+  // Start DMA sampling of the soil moisture sensors (if enabled)
+  moistureBegin();
 
   // Set up state observers for reactive UI updates
   g_machine.addStateObserver(observeConnectedState);
   g_machine.addStateObserver(observeDisconnectedState);
   g_machine.addStateObserver(observeCredentialChanges);
+  g_machine.addStateObserver(observeCredentialEntry);
+  g_machine.addStateObserver(observeScheduleFailSafe);
+  g_machine.addStateObserver(observeMoistureSkips);
+  g_machine.addStateObserver(observeEventLog);
   
   // Set up output function for side effects
   // TODO: This should be provided when construction g_machine.
@@ -182,46 +363,47 @@ void setup() {
   Serial.print("Initial state mode: ");
   Serial.println(g_machine.getState().mode);
   
-  // Attempt to load saved WiFi credentials from flash memory
-  Credentials loadedCreds;
+  // Inject the restored schedule into state (zones are already driven)
+  if (hasSchedule) {
+    loadedSchedule.lastUpdate = clockMonotonicMs();  // Update to current boot time
+    stepMachine(Input::scheduleReceived(loadedSchedule));
+  }
+  
+  // Hand the network side the server address from the last boot, so the
+  // first poll needn't wait on DNS
+  NetworkCache networkCache;
+  if (loadNetworkCache(&networkCache)) {
+    requestServerAddressSeed(networkCache.serverAddress);
+  }
+
+  // Attempt to load saved WiFi networks (from the cached config record)
+  CredentialStore loadedNetworks;
   bool hasCredentials = false;
-  if (!loadCredentials(&loadedCreds)) {
+  if (!loadCredentialStore(&loadedNetworks)) {
     Serial.println("No stored credentials found.");
     // No credentials found - start credential entry process
     Serial.println("Requesting credentials...");
-    g_machine.step(Input::requestCredentials());
+    stepMachine(Input::requestCredentials());
   } else {
     Serial.print("Loaded credentials for SSID: ");
-    Serial.println(loadedCreds.ssid);
-    // Credentials found - inject them into state and attempt to connect
-    g_machine.step(Input::credentialsEntered(loadedCreds));
+    Serial.print(loadedNetworks.networks[0].ssid);
+    Serial.print(" (of ");
+    Serial.print(loadedNetworks.count);
+    Serial.println(" known)");
+    // Credentials found - inject them into state. The connection itself is
+    // started from loop() through the network mailbox, after the WiFi probe.
+    stageKnownNetworks(&loadedNetworks);
+    stepMachine(Input::networksReplaced(loadedNetworks.networks[0], true));
     hasCredentials = true;
   }
   
-  // Attempt to load saved irrigation schedule from flash memory
-  IrrigationSchedule loadedSchedule;
-  bool hasSchedule = false;
-  if (loadSchedule(&loadedSchedule)) {
-    // Schedule found and valid - update timestamp and inject it into state
-    loadedSchedule.lastUpdate = millis();  // Update to current boot time
-    g_machine.step(Input::scheduleReceived(loadedSchedule));
-    hasSchedule = true;
-    
-    Serial.print("Loaded schedule: zones=");
-    Serial.print(loadedSchedule.zone1 ? "1" : "0");
-    Serial.print(loadedSchedule.zone2 ? "1" : "0");
-    Serial.println(loadedSchedule.zone3 ? "1" : "0");
-    
-    // Force immediate zone LED update during setup
-    updateZoneLEDs(loadedSchedule);
-  }
-  
   // If we have credentials but no schedule, trigger immediate poll when connected
   if (hasCredentials && !hasSchedule) {
     Serial.println("No saved schedule - will poll immediately when connected");
     // The shouldPollNow flag will be set when WiFi connects
   }
   
+  bootSetupComplete();
   Serial.println("=== Setup Complete ===");
 }
 
@@ -232,6 +414,8 @@ void setup() {
 void loop() {
   const AppState& state = g_machine.getState();
   
+  // Deferred boot work (WiFi probe, boot metrics report)
+  serviceBoot();
   
   // Status summary every 10 seconds  
   static unsigned long lastStatusOutput = 0;
@@ -241,11 +425,67 @@ void loop() {
     DEBUG_PRINT(", zones=");
     DEBUG_PRINT(state.schedule.zone1 ? "1" : "0");
     DEBUG_PRINT(state.schedule.zone2 ? "1" : "0");
-    DEBUG_PRINTLN(state.schedule.zone3 ? "1" : "0");
+    DEBUG_PRINT(state.schedule.zone3 ? "1" : "0");
+    DEBUG_PRINT(" (open=");
+    DEBUG_PRINT(state.zones.openMask & 0x01 ? "1" : "0");
+    DEBUG_PRINT(state.zones.openMask & 0x02 ? "1" : "0");
+    DEBUG_PRINT(state.zones.openMask & 0x04 ? "1" : "0");
+    DEBUG_PRINT(" waiting=");
+    DEBUG_PRINT(state.zones.waitingMask() & 0x01 ? "1" : "0");
+    DEBUG_PRINT(state.zones.waitingMask() & 0x02 ? "1" : "0");
+    DEBUG_PRINT(state.zones.waitingMask() & 0x04 ? "1" : "0");
+    DEBUG_PRINT(")");
+    int minuteOfDay = wallClockMinuteOfDay(state.clock, clockMonotonicMs());
+    if (minuteOfDay >= 0) {
+      DEBUG_PRINT(", time=");
+      DEBUG_PRINT(minuteOfDay / 60);
+      DEBUG_PRINT(minuteOfDay % 60 < 10 ? ":0" : ":");
+      DEBUG_PRINT(minuteOfDay % 60);
+    }
+    if (moistureSensorStats().running) {
+      DEBUG_PRINT(", moisture=");
+      for (int i = 0; i < ZONE_COUNT; i++) {
+        if (i > 0) DEBUG_PRINT("/");
+        if (state.moisture.permille[i] == MOISTURE_UNKNOWN) {
+          DEBUG_PRINT("?");
+        } else {
+          DEBUG_PRINT(state.moisture.permille[i]);
+        }
+      }
+    }
+    const FirmwareUpdateStats& update = firmwareUpdateStats();
+    if (update.pendingVersion != 0) {
+      DEBUG_PRINT(", update=");
+      DEBUG_PRINT(update.pendingVersion);
+      DEBUG_PRINT(" ");
+      DEBUG_PRINT(update.pendingWritten / 1024);
+      DEBUG_PRINT("/");
+      DEBUG_PRINT(update.pendingSize / 1024);
+      DEBUG_PRINT(" KB");
+    }
+    const EffectStats& effects = effectStats();
+    DEBUG_PRINT(", effects=");
+    DEBUG_PRINT(effects.executed);
+    DEBUG_PRINT(" (repeats skipped=");
+    DEBUG_PRINT(effects.repeatsSkipped);
+    DEBUG_PRINT(", of them I/O=");
+    DEBUG_PRINT(effects.workRepeatsSkipped);
+    DEBUG_PRINT(")");
+    const HeapAuditStats& heap = heapAudit();
+    DEBUG_PRINT(", heap=");
+    DEBUG_PRINT(heap.inUseBytes);
+    DEBUG_PRINT("/");
+    DEBUG_PRINT(heap.peakInUseBytes);
+    if (heap.counting) {
+      DEBUG_PRINT(", steady-state mallocs=");
+      DEBUG_PRINT(heap.steadyAllocations);
+    }
+    DEBUG_PRINTLN("");
     lastStatusOutput = millis();
   }
   
   // 1. Read events from environment (user input, hardware status)
+  watchdogStage(LOOP_STAGE_READ_EVENTS);
   Input input = readEvents();
   
   // 2. Check for polling timer expiry when connected (let outputFunction handle the timing)
@@ -261,25 +501,13 @@ void loop() {
       DEBUG_PRINTLN(input.type);
     }
     
-    // Handle credential entry (blocking operation for better UX)
-    if (input.type == INPUT_REQUEST_CREDENTIALS) {
-      g_machine.step(input);  // Enter credential entry mode
-      
-      // Prompt user for credentials (blocking)
-      Credentials newCreds;
-      if (promptForCredentialsBlocking(&newCreds)) {
-        DEBUG_PRINTLN("DEBUG: Processing entered credentials");
-        g_machine.step(Input::credentialsEntered(newCreds));
-      } else {
-        // Credential entry cancelled - return to WiFi status-based state
-        g_machine.step(Input::tick());
-      }
-    } else {
-      // Process input through state machine
-      g_machine.step(input);
-    }
+    // Process input through state machine. Credential entry is driven
+    // incrementally by readEvents(), so nothing here blocks on the user.
+    watchdogStage(LOOP_STAGE_STEP);
+    stepMachine(input);
     
     // Execute any side effects from state change
+    watchdogStage(LOOP_STAGE_EFFECT);
     Output effect = g_machine.getCurrentOutput();
     Input followUpInput = executeEffect(effect);
     
@@ -289,11 +517,14 @@ void loop() {
         DEBUG_PRINT("DEBUG: Follow-up input type=");
         DEBUG_PRINTLN(followUpInput.type);
       }
-      g_machine.step(followUpInput);
+      stepMachine(followUpInput);
     }
   }
   
-  // Always generate and execute output based on current state (Moore machine behavior)
+  // Always generate and execute output based on current state (Moore machine
+  // behavior). Often the same request as the step's output just above; the
+  // executor recognizes its sequence ID and doesn't repeat it.
+  watchdogStage(LOOP_STAGE_OUTPUT);
   Output currentOutput = outputFunction(state);
   if (currentOutput.type != EFFECT_NONE) {
     Input outputInput = executeEffect(currentOutput);
@@ -302,17 +533,36 @@ void loop() {
         DEBUG_PRINT("DEBUG: Output generated input type=");
         DEBUG_PRINTLN(outputInput.type);
       }
-      g_machine.step(outputInput);
+      stepMachine(outputInput);
     }
   }
   
-  // Always update LEDs (needed for blinking and responsive indicators)
+  // Hand the current LED pattern to the output engine; only a change
+  // touches the hardware, and the blink itself runs on a PWM timer
   updateLEDs(state.mode);
   
-  // Always update zone LEDs when we have a valid schedule
-  if (state.schedule.lastUpdate > 0) {
-    updateZoneLEDs(state.schedule);
+  // Same for the zones, once we have a valid schedule or an override: only
+  // the zones the sequencer has opened are driven, not every requested one,
+  // each with a deadline the engine enforces from a timer even if this loop
+  // stalls
+  if (state.schedule.lastUpdate > 0 || state.overrides.mask != 0) {
+    uint64_t closeBy[ZONE_COUNT];
+    openZoneDeadlines(state.zones, state.schedule.lastUpdate, state.overrides, closeBy);
+    updateZoneLEDs(openZoneSchedule(state.zones, state.schedule.lastUpdate), closeBy);
   }
   
+  // Write journal events out once a page is full or the oldest is due
+  serviceEventLog();
+
+  // Latest state for the LAN status page (a copy, never waits on the reader)
+  publishControllerStatus(state, clockMonotonicMs());
+  
+  // Network side - run one pending request per iteration
+  watchdogStage(LOOP_STAGE_NETWORK);
+  serviceNetworkMailbox();
+
+  // Pass complete - feed the hardware watchdog
+  watchdogKick();
+
   delay(10);  // Small delay to prevent overwhelming the system
 }
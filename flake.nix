@@ -132,6 +132,8 @@
                 pkgs.arduinoLibraries.ArduinoHttpClient."0.6.1"
                 # JSON parsing library  
                 pkgs.arduinoLibraries.ArduinoJson."7.2.1"
+                # DMA-driven ADC sampling (soil moisture sensors)
+                pkgs.arduinoLibraries.Arduino_AdvancedAnalog."1.5.0"
               ];
               packages = with pkgs.arduinoPackages; [
                 platforms.arduino.mbed_giga."4.2.4"
@@ -140,7 +142,8 @@
 
             arduino-build = pkgs.writeShellScriptBin "build" ''
               SKETCH="''${1:-MySketch}"
-              ${arduino-cli}/bin/arduino-cli compile --warnings all --fqbn arduino:mbed_giga:giga --libraries ${moore-arduino.packages.${system}.moore-arduino} $SKETCH
+              # Any further arguments go to arduino-cli (e.g. --build-property)
+              ${arduino-cli}/bin/arduino-cli compile --warnings all --fqbn arduino:mbed_giga:giga --libraries ${moore-arduino.packages.${system}.moore-arduino} $SKETCH "''${@:2}"
             '';
 
             arduino-upload = pkgs.writeShellScriptBin "upload" ''
@@ -0,0 +1,712 @@
+/*
+ * Schedule Server Chaos Benchmark
+ *
+ * Runs one controller's poll path against the stand-in server while the
+ * server misbehaves in one way at a time (StandInServer.h): slow answers,
+ * answers that never come in time, connection resets, bodies cut short,
+ * bodies that aren't a schedule, and error statuses with and without
+ * Retry-After. Each fault is switched on for a window and off again, and
+ * for each class the run reports:
+ *
+ *   recover  from the server healing until the controller's poll error is
+ *            cleared by a good response (0 if it never saw an error)
+ *   wasted   polls from the fault's start to recovery that brought no schedule
+ *   stall    time loop() passes spent blocked in the network stage, and the
+ *            worst single pass, against the hardware watchdog's limit
+ *
+ * What is real: transitionFunction/outputFunction, the network mailbox
+ * protocol (networkEventToInput()) and the loop order of controller.ino in
+ * the firmware, where serviceNetworkMailbox() runs at the end of each pass - so a slow poll holds up the loop just as it does
+ * on the board. The HTTP client mirrors httpSessionGet() and
+ * pollIrrigationSchedule(): one keep-alive connection retried once when a
+ * reused socket turns out closed (never on a timeout), each wait cut off at
+ * http_response_timeout_ms and the whole request at HTTP_REQUEST_DEADLINE_MS,
+ * a body that ends early handed to the parser as it is, and 304 confirming
+ * the version held. Schedule bodies go through
+ * parseScheduleJson() when built with HOST_BENCH_JSON, otherwise through
+ * the same rules as fleet-sim's parser.
+ *
+ * The machine runs on a virtual clock that advances by each pass's real
+ * duration plus the loop's delay(10), so the minutes between polls pass in
+ * milliseconds while every network wait counts at full length. A fault
+ * window costs a few real seconds, except under `slow` and `hang`, where
+ * each poll waits out the server's delay or the whole timeout for real.
+ *
+ * Usage: chaos-bench [options]
+ *   --fault NAME[,NAME]  Classes to run (default all): slow, hang, reset,
+ *                        truncate, malformed, status-500, status-503
+ *   --fault-s S          Virtual seconds each fault window lasts (default 120,
+ *                        the longest poll interval)
+ *   --trials N           Fault windows per class (default 3)
+ *   --slow-ms N          Server delay for `slow` (default 2000)
+ *   --http-timeout-ms N  Response timeout (default http_response_timeout_ms);
+ *                        `hang` delays answers 5 s past it
+ *   --seed N             RNG seed for where in the poll cycle faults start (default 1)
+ *
+ * A fault-free baseline always runs first. Exits non-zero if the controller
+ * failed to recover from a fault within poll_interval_max_ms of the server
+ * healing, wasted polls against a healthy server, or held up a loop() pass
+ * past watchdog_timeout_ms (a reset on the board).
+ */
+
+#include "StateMachine.h"
+#include "NetworkMailbox.h"
+#include "HttpSession.h"
+#include "StandInServer.h"
+#ifdef HOST_BENCH_JSON
+#include "ScheduleJson.h"
+#endif
+
+#include <WiFi.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+//----------------------------------------------------------------------------//
+// Configuration
+//----------------------------------------------------------------------------//
+
+struct FaultClass {
+  const char* name;
+  StandInFault fault;
+  int status;                 // For STAND_IN_FAULT_STATUS
+  unsigned long retryAfterS;  // For STAND_IN_FAULT_STATUS
+};
+
+static const FaultClass FAULT_CLASSES[] = {
+  {"none", STAND_IN_FAULT_NONE, 0, 0},
+  {"slow", STAND_IN_FAULT_LATENCY, 0, 0},
+  {"hang", STAND_IN_FAULT_LATENCY, 0, 0},
+  {"reset", STAND_IN_FAULT_RESET, 0, 0},
+  {"truncate", STAND_IN_FAULT_TRUNCATE, 0, 0},
+  {"malformed", STAND_IN_FAULT_MALFORMED, 0, 0},
+  {"status-500", STAND_IN_FAULT_STATUS, 500, 0},
+  {"status-503", STAND_IN_FAULT_STATUS, 503, 60},
+};
+
+static const int FAULT_CLASS_COUNT = sizeof(FAULT_CLASSES) / sizeof(FAULT_CLASSES[0]);
+
+struct BenchConfig {
+  std::vector<int> classes;   // Indices into FAULT_CLASSES, after the baseline
+  double faultS = 120;
+  unsigned trials = 3;
+  unsigned long slowMs = 2000;
+  unsigned long httpTimeoutMs = http_response_timeout_ms;
+  unsigned seed = 1;
+};
+
+const unsigned long TICK_MS = 100;          // g_tickTimer period in the firmware
+const unsigned long LOOP_DELAY_MS = 10;     // delay() at the end of loop()
+const unsigned long ASSOCIATION_MS = 1500;  // Virtual radio: scan + join
+const size_t HTTP_BODY_CAPACITY = 1024;     // g_responseBody in IrrigationController.cpp
+
+// ArduinoHttpClient's error codes, as pollIrrigationSchedule() passes them on
+const int HTTP_ERROR_CONNECTION_FAILED = -1;
+const int HTTP_ERROR_TIMED_OUT = -3;
+const int HTTP_ERROR_INVALID_RESPONSE = -4;
+
+//----------------------------------------------------------------------------//
+// Measurements
+//----------------------------------------------------------------------------//
+
+// Accumulated from a fault's start until the controller recovers
+struct TrialResult {
+  bool recovered = false;
+  unsigned long recoverMs = 0;
+  unsigned long polls = 0;
+  unsigned long wasted = 0;
+  uint64_t stallUs = 0;           // Spent in the network stage
+  uint64_t worstPassUs = 0;
+  unsigned long watchdogOverruns = 0;
+  bool failSafe = false;          // Zones closed because the schedule went stale
+  std::map<int, unsigned long> errorStatuses;  // Input::httpStatus of wasted polls
+};
+
+//----------------------------------------------------------------------------//
+// Controller
+//----------------------------------------------------------------------------//
+
+class ChaosController {
+public:
+  ChaosController(const BenchConfig& cfg, uint16_t serverPort);
+  ~ChaosController() { sessionClose(); }
+
+  void boot();
+  void pass();
+
+  unsigned long now() const { return (unsigned long)(virtualUs / 1000); }
+  const AppState& machine() const { return state; }
+
+  TrialResult* recording = nullptr;  // Where pass() adds its measurements
+
+private:
+  void step(Input input);
+  Input readEvents();
+  Input executeEffect(const Output& effect);
+  void serviceNetwork();
+
+  // Mirror of HttpSession.cpp and pollIrrigationSchedule()
+  Input pollSchedule(uint32_t scheduleSeq);
+  int sessionGet(const char* path);
+  int sendGet(const char* path, bool reused);
+  bool sessionUsable();
+  void sessionEnd(bool keepOpen);
+  void sessionClose();
+  int readBody(std::string* body);
+  int waitReadable(uint64_t deadlineUs);
+  uint64_t waitDeadlineUs();
+
+  const BenchConfig& config;
+  sockaddr_in server;
+  AppState state;
+  NetworkMailbox mailbox;
+  uint64_t virtualUs = 0;
+  unsigned long lastTickMs = 0;
+  int radioStatus = WL_IDLE_STATUS;
+  unsigned long radioConnectAtMs = 0;  // 0 = no association under way
+
+  int fd = -1;
+  unsigned long sessionLastUsed = 0;
+  uint64_t requestStartUs = 0;
+  std::string rx;                      // Received, not yet consumed
+  long contentLength = -1;
+};
+
+ChaosController::ChaosController(const BenchConfig& cfg, uint16_t serverPort) : config(cfg) {
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons(serverPort);
+  server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+void ChaosController::step(Input input) {
+  input.nowMs = now();
+  state = transitionFunction(state, input);
+}
+
+// Same as setup() with stored credentials: go straight to CONNECTING
+void ChaosController::boot() {
+  Credentials creds;
+  snprintf(creds.ssid, sizeof(creds.ssid), "chaos-bench");
+  snprintf(creds.pass, sizeof(creds.pass), "password");
+  step(Input::credentialsEntered(creds));
+}
+
+// Mirrors readEvents(): network results, then WiFi status, then the tick timer
+Input ChaosController::readEvents() {
+  NetworkEvent event;
+  if (mailbox.events.pop(&event)) {
+    return networkEventToInput(event);
+  }
+  if (radioConnectAtMs != 0 && now() >= radioConnectAtMs) {
+    radioStatus = WL_CONNECTED;
+    radioConnectAtMs = 0;
+  }
+  if (radioStatus != state.wifiStatus) {
+    return Input::wifiStatusChanged(radioStatus);
+  }
+  if (now() - lastTickMs >= TICK_MS) {
+    lastTickMs = now();
+    return Input::tick();
+  }
+  return Input::none();
+}
+
+// Mirrors executeEffect() for the effects that reach the network side
+Input ChaosController::executeEffect(const Output& effect) {
+  switch (effect.type) {
+    case EFFECT_START_WIFI_CONNECTION:
+      radioConnectAtMs = now() + ASSOCIATION_MS;
+      return Input::connectionStarted();
+
+    case EFFECT_SAVE_CREDENTIALS:
+      return Input::credentialsSaved();
+
+    case EFFECT_SAVE_SCHEDULE:
+      return Input::scheduleSaved();
+
+    case EFFECT_POLL_SCHEDULE: {
+      NetworkRequest request;
+      request.type = NET_REQUEST_POLL_SCHEDULE;
+      request.networks.count = 0;
+      request.scheduleSeq = state.schedule.seq;
+      if (!mailbox.requests.push(request)) return Input::none();  // Deferred
+      return Input::pollStarted();
+    }
+
+    default:
+      return Input::none();
+  }
+}
+
+// Mirrors the NET_REQUEST_POLL_SCHEDULE arm of serviceNetworkMailbox()
+void ChaosController::serviceNetwork() {
+  NetworkRequest request;
+  if (!mailbox.requests.pop(&request) || request.type != NET_REQUEST_POLL_SCHEDULE) return;
+
+  Input result = pollSchedule(request.scheduleSeq);
+  NetworkEvent event;
+  event.pollHintMs = result.pollHintMs;
+  event.httpStatus = result.httpStatus;
+  event.unixMs = 0;
+  if (result.type == INPUT_SCHEDULE_PATCH) {
+    event.type = NET_EVENT_SCHEDULE_RECEIVED;
+    event.patch = result.patch;
+  } else {
+    event.type = NET_EVENT_HTTP_ERROR;
+  }
+  mailbox.events.push(event);
+
+  if (recording) {
+    recording->polls++;
+    if (result.type != INPUT_SCHEDULE_PATCH) {
+      recording->wasted++;
+      recording->errorStatuses[result.httpStatus]++;
+    }
+  }
+}
+
+// One loop() pass, in controller.ino's order
+void ChaosController::pass() {
+  uint64_t start = micros();
+
+  Input input = readEvents();
+  if (input.type != INPUT_NONE) {
+    step(input);
+    Input followUp = executeEffect(outputFunction(state));
+    if (followUp.type != INPUT_NONE) step(followUp);
+  }
+  Input outputInput = executeEffect(outputFunction(state));
+  if (outputInput.type != INPUT_NONE) step(outputInput);
+
+  uint64_t networkStart = micros();
+  serviceNetwork();
+  uint64_t end = micros();
+
+  uint64_t passUs = end - start;
+  virtualUs += passUs + LOOP_DELAY_MS * 1000;
+  if (recording) {
+    recording->stallUs += end - networkStart;
+    if (passUs > recording->worstPassUs) recording->worstPassUs = passUs;
+    if (passUs >= watchdog_timeout_ms * 1000ULL) recording->watchdogOverruns++;
+    if (state.failSafeActive) recording->failSafe = true;
+  }
+}
+
+//----------------------------------------------------------------------------//
+// HTTP Client (mirrors HttpSession.cpp)
+//----------------------------------------------------------------------------//
+
+// Same checks as sessionUsable(): open, not idle too long, nothing unsolicited
+bool ChaosController::sessionUsable() {
+  if (fd < 0) return false;
+  if (now() - sessionLastUsed >= http_keepalive_idle_ms) return false;
+  char byte;
+  ssize_t n = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void ChaosController::sessionClose() {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+void ChaosController::sessionEnd(bool keepOpen) {
+  if (!keepOpen) {
+    sessionClose();
+    return;
+  }
+  sessionLastUsed = now();
+}
+
+// 1 when readable, 0 on timeout
+int ChaosController::waitReadable(uint64_t deadlineUs) {
+  uint64_t nowUs = micros();
+  if (nowUs >= deadlineUs) return 0;
+  pollfd pfd = {fd, POLLIN, 0};
+  return poll(&pfd, 1, (int)((deadlineUs - nowUs + 999) / 1000)) > 0 ? 1 : 0;
+}
+
+// Same cut-off as httpSessionWaitOver(): this wait's timeout or the
+// request's deadline, whichever comes first
+uint64_t ChaosController::waitDeadlineUs() {
+  uint64_t wait = micros() + config.httpTimeoutMs * 1000ULL;
+  uint64_t request = requestStartUs + HTTP_REQUEST_DEADLINE_MS * 1000ULL;
+  return wait < request ? wait : request;
+}
+
+// Send the request and read up to the end of the headers; rx keeps the head
+int ChaosController::sendGet(const char* path, bool reused) {
+  if (!reused) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&server, sizeof(server)) < 0) {
+      return HTTP_ERROR_CONNECTION_FAILED;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  char request[256];
+  int length = snprintf(request, sizeof(request),
+                        "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: Arduino/2.2.0\r\n"
+                        "Accept-Encoding: gzip, deflate\r\n\r\n",
+                        path, server_hostname);
+  if (send(fd, request, length, MSG_NOSIGNAL) != length) {
+    return HTTP_ERROR_CONNECTION_FAILED;
+  }
+
+  rx.clear();
+  uint64_t deadline = waitDeadlineUs();
+  while (rx.find("\r\n\r\n") == std::string::npos) {
+    if (!waitReadable(deadline)) return HTTP_ERROR_TIMED_OUT;
+    char buf[1024];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0 && rx.empty()) return HTTP_ERROR_CONNECTION_FAILED;  // Closed before answering
+    if (n <= 0) return HTTP_ERROR_INVALID_RESPONSE;  // Closed or reset before a full head
+    rx.append(buf, n);
+  }
+  int status;
+  if (sscanf(rx.c_str(), "HTTP/1.%*d %d", &status) != 1) return HTTP_ERROR_INVALID_RESPONSE;
+  return status;
+}
+
+int ChaosController::sessionGet(const char* path) {
+  requestStartUs = micros();
+  bool reused = sessionUsable();
+  if (!reused) sessionClose();
+
+  int status = sendGet(path, reused);
+  if (reused && status == HTTP_ERROR_CONNECTION_FAILED && micros() < waitDeadlineUs()) {
+    // The server dropped the connection between liveness check and request
+    sessionClose();
+    status = sendGet(path, false);
+  }
+  if (status < 0) sessionClose();
+  return status;
+}
+
+// Mirrors readResponseBody(): to Content-Length, or to the close without one;
+// a close before Content-Length just ends the body early. -1 on timeout.
+int ChaosController::readBody(std::string* body) {
+  size_t headEnd = rx.find("\r\n\r\n") + 4;
+  *body = rx.substr(headEnd);
+  uint64_t deadline = waitDeadlineUs();
+  while (contentLength < 0 || body->size() < (size_t)contentLength) {
+    if (!waitReadable(deadline)) return -1;
+    char buf[1024];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) break;
+    body->append(buf, n);
+    if (body->size() >= HTTP_BODY_CAPACITY) return -1;
+  }
+  return (int)body->size();
+}
+
+// Returns a pointer just past `key` (case-insensitive) in the head, or nullptr
+static const char* findHeader(const std::string& head, const char* key) {
+  size_t n = strlen(key);
+  for (size_t i = 0; i + n <= head.size(); i++) {
+    if (strncasecmp(head.c_str() + i, key, n) == 0) return head.c_str() + i + n;
+  }
+  return nullptr;
+}
+
+#ifndef HOST_BENCH_JSON
+// Finds "key": in the body and returns the offset of its value, or npos
+static size_t findValue(const std::string& body, const char* key) {
+  size_t at = body.find(key);
+  if (at == std::string::npos) return std::string::npos;
+  return body.find_first_not_of(" \t\r\n:", at + strlen(key));
+}
+
+// Same rules as parseScheduleJson() (and fleet-sim's parsePatch())
+static bool parseScheduleBody(const std::string& body, SchedulePatch* patch) {
+  size_t first = body.find_first_not_of(" \t\r\n");
+  size_t last = body.find_last_not_of(" \t\r\n");
+  if (first == std::string::npos || body[first] != '{' || body[last] != '}') return false;
+
+  size_t seq = findValue(body, "\"seq\"");
+  size_t base = findValue(body, "\"base\"");
+  if (base != std::string::npos && seq == std::string::npos) return false;
+  patch->seq = seq != std::string::npos ? (uint32_t)strtoul(body.c_str() + seq, nullptr, 10) : 0;
+  patch->full = base == std::string::npos;
+  patch->baseSeq = patch->full ? 0 : (uint32_t)strtoul(body.c_str() + base, nullptr, 10);
+  patch->changedMask = patch->full ? 0x07 : 0;
+  patch->valueMask = 0;
+
+  for (int i = 0; i < 3; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "\"zone%d\"", i + 1);
+    size_t value = findValue(body, key);
+    if (value == std::string::npos) continue;
+    patch->changedMask |= 1 << i;
+    if (body.compare(value, 4, "true") == 0) {
+      patch->valueMask |= 1 << i;
+    } else if (body.compare(value, 5, "false") != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+#else
+static bool parseScheduleBody(const std::string& body, SchedulePatch* patch) {
+  return parseScheduleJson(body.c_str(), body.size(), patch);
+}
+#endif
+
+// Mirrors pollIrrigationSchedule() for uncompressed bodies (the stand-in
+// never compresses)
+Input ChaosController::pollSchedule(uint32_t scheduleSeq) {
+  char path[32];
+  snprintf(path, sizeof(path), "/?since=%lu", (unsigned long)scheduleSeq);
+  int status = sessionGet(path);
+  if (status < 0) {
+    return Input::httpError(0, status);
+  }
+
+  std::string head = rx.substr(0, rx.find("\r\n\r\n") + 2);
+  unsigned long hintMs = 0;
+  if (const char* value = findHeader(head, "\r\nretry-after:")) {
+    hintMs = strtoul(value, nullptr, 10) * 1000UL;
+  } else if (const char* value = findHeader(head, "max-age=")) {
+    hintMs = strtoul(value, nullptr, 10) * 1000UL;
+  }
+  bool keepOpen = findHeader(head, "\r\nconnection: close") == nullptr;
+  const char* length = findHeader(head, "\r\ncontent-length:");
+  contentLength = length ? strtol(length, nullptr, 10) : -1;
+
+  bool noBody = status == 304;
+  std::string body;
+  int bodyLength = noBody ? 0 : readBody(&body);
+  bool endOfBody = noBody || (contentLength >= 0 && body.size() >= (size_t)contentLength);
+  sessionEnd(keepOpen && bodyLength >= 0 && endOfBody);
+  if (bodyLength < 0) {
+    return Input::httpError(hintMs, status);
+  }
+
+  if (status == 304) {
+    SchedulePatch unchanged;
+    unchanged.seq = scheduleSeq;
+    unchanged.baseSeq = scheduleSeq;
+    return Input::schedulePatch(unchanged, hintMs);
+  }
+  if (status != 200) {
+    return Input::httpError(hintMs, status);
+  }
+  SchedulePatch patch;
+  if (!parseScheduleBody(body, &patch)) {
+    return Input::httpError(0, status);
+  }
+  return Input::schedulePatch(patch, hintMs);
+}
+
+//----------------------------------------------------------------------------//
+// Fault Runs
+//----------------------------------------------------------------------------//
+
+struct ClassResult {
+  const char* name;
+  bool booted = false;
+  std::vector<TrialResult> trials;
+};
+
+static bool recovered(const ChaosController& controller) {
+  const AppState& state = controller.machine();
+  return state.schedule.lastUpdate != 0 && !state.httpError;
+}
+
+static void runUntil(ChaosController& controller, unsigned long untilMs) {
+  while (controller.now() < untilMs) controller.pass();
+}
+
+static ClassResult runClass(const BenchConfig& config, int index, std::mt19937& rng) {
+  const FaultClass& fault = FAULT_CLASSES[index];
+  ClassResult result;
+  result.name = fault.name;
+
+  StandInConfig standInConfig;
+  standInConfig.port = 0;
+  standInConfig.fault = fault.fault;
+  standInConfig.faultStatus = fault.status;
+  standInConfig.faultRetryAfterS = fault.retryAfterS;
+  standInConfig.faultLatencyMs = strcmp(fault.name, "hang") == 0 ? config.httpTimeoutMs + 5000
+                                                                  : config.slowMs;
+  StandInServer server;
+  if (!server.start(standInConfig)) return result;
+  server.setFaulting(false);
+  std::atomic<bool> stop(false);
+  std::thread serverThread([&]() { server.run(stop); });
+
+  ChaosController controller(config, server.port());
+  controller.boot();
+  unsigned long giveUpMs = controller.now() + 60000;
+  while (!recovered(controller) && controller.now() < giveUpMs) controller.pass();
+  result.booted = recovered(controller);
+
+  std::uniform_int_distribution<unsigned long> phase(0, poll_interval_base_ms);
+  for (unsigned t = 0; result.booted && t < config.trials; t++) {
+    // Start each fault at a different point in the poll cycle
+    runUntil(controller, controller.now() + phase(rng));
+
+    TrialResult trial;
+    controller.recording = &trial;
+    server.setFaulting(true);
+    runUntil(controller, controller.now() + (unsigned long)(config.faultS * 1000));
+    server.setFaulting(false);
+
+    unsigned long healedAt = controller.now();
+    while (!recovered(controller) && controller.now() - healedAt < poll_interval_max_ms) {
+      controller.pass();
+    }
+    trial.recovered = recovered(controller);
+    trial.recoverMs = controller.now() - healedAt;
+    controller.recording = nullptr;
+    result.trials.push_back(trial);
+    printf("  %-10s trial %u: %s after %.1f s, %lu polls, %lu wasted, stall %.1f s\n",
+           fault.name, t + 1, trial.recovered ? "recovered" : "NOT recovered",
+           trial.recoverMs / 1000.0, trial.polls, trial.wasted, trial.stallUs / 1e6);
+    fflush(stdout);
+  }
+
+  stop.store(true);
+  serverThread.join();
+  return result;
+}
+
+// Most frequent failure status, as the controller saw it
+static std::string commonErrors(const std::vector<TrialResult>& trials) {
+  std::map<int, unsigned long> counts;
+  for (const TrialResult& trial : trials) {
+    for (const auto& entry : trial.errorStatuses) counts[entry.first] += entry.second;
+  }
+  std::string text;
+  for (const auto& entry : counts) {
+    char item[32];
+    snprintf(item, sizeof(item), "%s%d x%lu", text.empty() ? "" : ", ", entry.first, entry.second);
+    text += item;
+  }
+  return text.empty() ? "-" : text;
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+static bool parseClasses(const char* list, std::vector<int>* classes) {
+  std::string names = list;
+  size_t at = 0;
+  while (at <= names.size()) {
+    size_t comma = names.find(',', at);
+    std::string name = names.substr(at, comma == std::string::npos ? std::string::npos : comma - at);
+    int index = 1;  // "none" is the baseline and always runs
+    while (index < FAULT_CLASS_COUNT && name != FAULT_CLASSES[index].name) index++;
+    if (index == FAULT_CLASS_COUNT) {
+      fprintf(stderr, "Unknown fault class: %s\n", name.c_str());
+      return false;
+    }
+    classes->push_back(index);
+    if (comma == std::string::npos) break;
+    at = comma + 1;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  BenchConfig config;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (!value) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 2;
+    }
+    i++;
+    if (strcmp(arg, "--fault") == 0) {
+      if (!parseClasses(value, &config.classes)) return 2;
+    } else if (strcmp(arg, "--fault-s") == 0) config.faultS = atof(value);
+    else if (strcmp(arg, "--trials") == 0) config.trials = (unsigned)strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--slow-ms") == 0) config.slowMs = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--http-timeout-ms") == 0) config.httpTimeoutMs = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--seed") == 0) config.seed = (unsigned)strtoul(value, nullptr, 10);
+    else {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      return 2;
+    }
+  }
+  if (config.classes.empty()) {
+    for (int i = 1; i < FAULT_CLASS_COUNT; i++) config.classes.push_back(i);
+  }
+  config.classes.insert(config.classes.begin(), 0);
+
+  printf("chaos-bench: %.0f s fault windows, %u trials per class, http timeout %lu ms, "
+         "retry after errors %lu s\n",
+         config.faultS, config.trials, config.httpTimeoutMs, poll_interval_base_ms / 1000);
+  fflush(stdout);
+
+  std::mt19937 rng(config.seed);
+  std::vector<ClassResult> results;
+  for (int index : config.classes) results.push_back(runClass(config, index, rng));
+
+  bool ok = true;
+  printf("\n%-11s %9s %9s %7s %7s %10s %10s %5s %5s  %s\n", "class", "recover s", "max s",
+         "polls", "wasted", "stall s", "worst ms", "wdog", "stale", "errors (status x count)");
+  for (const ClassResult& result : results) {
+    if (!result.booted) {
+      printf("FAIL: %s: controller never got its first schedule\n", result.name);
+      ok = false;
+      continue;
+    }
+    double recoverSum = 0, recoverMax = 0, stallS = 0, worstMs = 0;
+    unsigned long polls = 0, wasted = 0, overruns = 0;
+    bool failSafe = false;
+    for (const TrialResult& trial : result.trials) {
+      recoverSum += trial.recoverMs / 1000.0;
+      if (trial.recoverMs / 1000.0 > recoverMax) recoverMax = trial.recoverMs / 1000.0;
+      polls += trial.polls;
+      wasted += trial.wasted;
+      stallS += trial.stallUs / 1e6;
+      if (trial.worstPassUs / 1000.0 > worstMs) worstMs = trial.worstPassUs / 1000.0;
+      overruns += trial.watchdogOverruns;
+      failSafe = failSafe || trial.failSafe;
+      if (!trial.recovered) ok = false;
+    }
+    double trials = result.trials.empty() ? 1.0 : (double)result.trials.size();
+    printf("%-11s %9.1f %9.1f %7lu %7lu %10.2f %10.1f %5lu %5s  %s\n", result.name,
+           recoverSum / trials, recoverMax, polls, wasted, stallS, worstMs, overruns,
+           failSafe ? "yes" : "no", commonErrors(result.trials).c_str());
+    if (strcmp(result.name, "none") == 0 && wasted > 0) {
+      printf("FAIL: %lu polls wasted against a healthy server\n", wasted);
+      ok = false;
+    }
+    if (overruns > 0) {
+      printf("FAIL: %s: %lu loop passes outlasted the %lu ms watchdog\n", result.name, overruns,
+             watchdog_timeout_ms);
+      ok = false;
+    }
+  }
+  for (const ClassResult& result : results) {
+    for (const TrialResult& trial : result.trials) {
+      if (!trial.recovered) {
+        printf("FAIL: %s: not recovered %lu s after the server healed\n", result.name,
+               poll_interval_max_ms / 1000);
+        break;
+      }
+    }
+  }
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+/*
+ * Wall Clock Check
+ *
+ * Drives the wall clock (Clock.h) the way TimeSync and the machine do and
+ * checks that
+ *
+ *   - with hourly SNTP samples of a crystal up to --ppm fast or slow and
+ *     up to --jitter ms of error on every sample, the drift estimate
+ *     settles near the true rate, and wall time then stays within 0.2 s
+ *     through a day with no syncs (3.5 s uncorrected at 40 ppm). That
+ *     holds up to about 10 ms of jitter; a LAN SNTP reply is typically a
+ *     few ms off,
+ *   - samples that imply a rate no crystal has - a server step, a reply
+ *     from the past - step the clock without touching the estimate, and a
+ *     sample inside the one-hour baseline doesn't measure drift,
+ *   - ntpToUnixMs() converts both NTP eras and the fraction,
+ *   - wallClockMinuteOfDay() wraps local time correctly around midnight
+ *     for the built-in utc_offset_minutes.
+ *
+ * Clock.cpp reads utc_offset_minutes from the extern configuration, so this
+ * check defines it itself as CLOCK_CHECK_UTC_OFFSET. `just host-clock-check`
+ * builds and runs it with a negative whole-hour and a negative half-hour
+ * offset.
+ *
+ * Usage: clock-check [--ppm N] [--jitter MS] [--days N] [--seed N]
+ */
+
+#include "Clock.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#ifndef CLOCK_CHECK_UTC_OFFSET
+#define CLOCK_CHECK_UTC_OFFSET -300
+#endif
+
+//----------------------------------------------------------------------------//
+// Configuration Under Test
+//----------------------------------------------------------------------------//
+
+const int utc_offset_minutes = CLOCK_CHECK_UTC_OFFSET;
+
+static const uint64_t HOUR_MS = 3600000ULL;
+static const uint64_t DAY_MS = 24 * HOUR_MS;
+static const uint64_t EPOCH_2026_MS = 1767225600000ULL;  // 2026-01-01 00:00 UTC
+static const double OFFLINE_LIMIT_MS = 200.0;           // Within 0.2 s per day
+
+static unsigned long g_failures = 0;
+
+static void fail(const char* what) {
+  if (g_failures++ < 10) {
+    printf("FAIL: %s\n", what);
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Drift Estimate
+//----------------------------------------------------------------------------//
+
+// A crystal `ppm` fast: local intervals are longer than true ones
+struct Crystal {
+  double ppm;
+  uint64_t bootUnixMs;
+
+  uint64_t localAt(uint64_t unixMs) const {
+    double elapsed = (double)(unixMs - bootUnixMs);
+    return 1000 + (uint64_t)(elapsed * (1.0 + ppm / 1e6));
+  }
+};
+
+// Hourly syncs for `days`, then a day offline; returns the worst error
+// over the offline day (ms) and the final estimate
+static double runDrift(double ppm, double jitterMs, int days, std::mt19937_64& rng,
+                       int32_t* driftPpb) {
+  Crystal crystal = {ppm, EPOCH_2026_MS};
+  std::uniform_real_distribution<double> jitter(-jitterMs, jitterMs);
+  WallClock clock;
+  uint64_t unix = EPOCH_2026_MS;
+  for (int hour = 0; hour <= days * 24; hour++) {
+    unix = EPOCH_2026_MS + hour * HOUR_MS;
+    int64_t sampleError = (int64_t)jitter(rng);
+    clock = wallClockSync(clock, crystal.localAt(unix), unix + sampleError);
+  }
+  *driftPpb = clock.driftPpb;
+
+  double worst = 0;
+  for (uint64_t at = unix; at <= unix + DAY_MS; at += 60000) {
+    double error = (double)(int64_t)(wallClockUnixMs(clock, crystal.localAt(at)) - at);
+    if (error < 0) error = -error;
+    if (error > worst) worst = error;
+  }
+  return worst;
+}
+
+static void checkDrift(double ppm, double jitterMs, int days, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  double worst = 0;
+  double worstPpmError = 0;
+  const int RUNS = 200;
+  for (int run = 0; run < RUNS; run++) {
+    // Both directions, and rates spread up to the nominal one
+    double runPpm = ppm * (run % 2 ? -1.0 : 1.0) * (0.25 + 0.75 * (run % 8) / 7.0);
+    int32_t driftPpb;
+    double error = runDrift(runPpm, jitterMs, days, rng, &driftPpb);
+    double ppmError = driftPpb / 1000.0 - runPpm;
+    if (ppmError < 0) ppmError = -ppmError;
+    if (error > worst) worst = error;
+    if (ppmError > worstPpmError) worstPpmError = ppmError;
+  }
+  Crystal crystal = {ppm, EPOCH_2026_MS};
+  double uncorrected = (double)(crystal.localAt(EPOCH_2026_MS + DAY_MS) - crystal.localAt(EPOCH_2026_MS)) -
+                       (double)DAY_MS;
+  printf("drift: %d runs up to +-%.0f ppm, +-%.0f ms jitter, %d days of hourly syncs\n",
+         RUNS, ppm, jitterMs, days);
+  printf("  estimate error   worst %.2f ppm\n", worstPpmError);
+  printf("  day offline      worst %.0f ms (uncorrected %.0f ms)\n", worst, uncorrected);
+  if (worst > OFFLINE_LIMIT_MS) {
+    fail("wall time drifted more than 0.2 s over a day offline");
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Step Rejection
+//----------------------------------------------------------------------------//
+
+static void checkSteps() {
+  Crystal crystal = {40, EPOCH_2026_MS};
+  WallClock clock;
+  uint64_t unix = EPOCH_2026_MS;
+  for (int hour = 0; hour <= 6; hour++) {
+    unix = EPOCH_2026_MS + hour * HOUR_MS;
+    clock = wallClockSync(clock, crystal.localAt(unix), unix);
+  }
+  int32_t settled = clock.driftPpb;
+  uint64_t lastSync = unix;
+  if (settled < 35000 || settled > 45000) {
+    fail("estimate did not settle near 40 ppm from exact samples");
+  }
+
+  // The server steps an hour forward: follow it, keep the estimate
+  unix += HOUR_MS;
+  uint64_t local = crystal.localAt(unix);
+  WallClock stepped = wallClockSync(clock, local, unix + HOUR_MS);
+  if (stepped.driftPpb != settled) {
+    fail("a forward step changed the drift estimate");
+  }
+  if (wallClockUnixMs(stepped, local) != unix + HOUR_MS) {
+    fail("wall time did not follow a forward step");
+  }
+  if (stepped.referenceAt != local) {
+    fail("a forward step did not restart the drift measurement");
+  }
+
+  // A reply from before the last reference
+  WallClock backward = wallClockSync(clock, local, clock.referenceUnixMs - 1000);
+  if (backward.driftPpb != settled) {
+    fail("a backward step changed the drift estimate");
+  }
+  if (wallClockUnixMs(backward, local) != clock.referenceUnixMs - 1000) {
+    fail("wall time did not follow a backward step");
+  }
+
+  // Half an hour in: too short a baseline to measure, the sample still counts
+  uint64_t soon = lastSync + HOUR_MS / 2;
+  WallClock early = wallClockSync(clock, crystal.localAt(soon), soon + 5000);
+  if (early.driftPpb != settled || early.referenceAt != clock.referenceAt) {
+    fail("a sample inside the baseline measured drift");
+  }
+  if (wallClockUnixMs(early, crystal.localAt(soon)) != soon + 5000) {
+    fail("a sample inside the baseline did not set the time");
+  }
+
+  // Never synced
+  if (wallClockUnixMs(WallClock(), 5000) != 0 || wallClockMinuteOfDay(WallClock(), 5000) != -1) {
+    fail("an unsynced clock reported a time");
+  }
+  printf("steps: forward, backward and early samples checked\n");
+}
+
+//----------------------------------------------------------------------------//
+// NTP Eras
+//----------------------------------------------------------------------------//
+
+static void putNtp(uint8_t* timestamp, uint32_t seconds, uint32_t fraction) {
+  for (int i = 0; i < 4; i++) {
+    timestamp[i] = (uint8_t)(seconds >> (24 - 8 * i));
+    timestamp[4 + i] = (uint8_t)(fraction >> (24 - 8 * i));
+  }
+}
+
+static void checkEras() {
+  struct Case {
+    uint32_t seconds;
+    uint32_t fraction;
+    uint64_t unixMs;
+    const char* what;
+  };
+  const Case cases[] = {
+    {2208988800U, 0, 0, "1970-01-01, the Unix epoch"},
+    {3976214400U, 0, 1767225600000ULL, "2026-01-01"},
+    {3976214400U, 0x80000000U, 1767225600500ULL, "2026-01-01 plus half a second"},
+    {3976214400U, 0xFFFFFFFFU, 1767225600999ULL, "fraction just under a second"},
+    {0xFFFFFFFFU, 0, 2085978495000ULL, "last second of era 0 (2036-02-07)"},
+    {0, 0, 2085978496000ULL, "first second of era 1"},
+    {0x7FFFFFFFU, 0, 4233462143000ULL, "last second taken as era 1 (2104)"},
+  };
+  for (const Case& c : cases) {
+    uint8_t timestamp[8];
+    putNtp(timestamp, c.seconds, c.fraction);
+    uint64_t got = ntpToUnixMs(timestamp);
+    if (got != c.unixMs) {
+      char what[128];
+      snprintf(what, sizeof(what), "ntpToUnixMs %s: %llu, expected %llu", c.what,
+               (unsigned long long)got, (unsigned long long)c.unixMs);
+      fail(what);
+    }
+  }
+  printf("eras: %zu timestamps checked\n", sizeof(cases) / sizeof(cases[0]));
+}
+
+//----------------------------------------------------------------------------//
+// Local Time of Day
+//----------------------------------------------------------------------------//
+
+static void checkMinuteOfDay() {
+  // Exact clock: monotonic 1000 is 2026-01-01 00:00 UTC
+  WallClock clock = wallClockSync(WallClock(), 1000, EPOCH_2026_MS);
+  unsigned long checked = 0;
+  for (int utcMinute = 0; utcMinute < 3 * 1440; utcMinute++) {
+    uint64_t now = 1000 + (uint64_t)utcMinute * 60000 + 30000;  // Mid-minute
+    int expected = ((utcMinute % 1440) + utc_offset_minutes + 1440) % 1440;
+    int got = wallClockMinuteOfDay(clock, now);
+    if (got != expected) {
+      char what[96];
+      snprintf(what, sizeof(what), "minute of day at UTC minute %d: %d, expected %d",
+               utcMinute, got, expected);
+      fail(what);
+    }
+    checked++;
+  }
+  printf("minute of day: %lu minutes checked at UTC%+d min\n", checked, utc_offset_minutes);
+}
+
+int main(int argc, char** argv) {
+  double ppm = 40;
+  double jitterMs = 5;
+  int days = 2;
+  uint64_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+      ppm = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+      jitterMs = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+      days = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: clock-check [--ppm N] [--jitter MS] [--days N] [--seed N]\n");
+      return 2;
+    }
+  }
+
+  checkDrift(ppm, jitterMs, days, seed);
+  checkSteps();
+  checkEras();
+  checkMinuteOfDay();
+
+  printf("%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,499 @@
+/*
+ * Controller Hot-Path Benchmarks
+ *
+ * Times the pure code every loop() pass runs through, linked straight from
+ * controller/: transitionFunction for every InputType, outputFunction, the
+ * Input factories, AppState copies and (when built against ArduinoJson)
+ * parseScheduleJson on realistic and worst-case bodies. Each result is
+ *
+ *   ns/op      fastest of several timed batches, so scheduler noise only
+ *              ever makes a result look slower, never faster
+ *   copied B   bytes of state the call copies or returns by value (its
+ *              signature's cost: an AppState out of transitionFunction, an
+ *              Input out of a factory)
+ *   alloc B    bytes allocated per call - from the heap, or from
+ *              ScheduleJson's arena for the parser
+ *   allocs     heap allocations per call (the firmware's steady state
+ *              allows none, see HeapAudit.h)
+ *
+ * and is checked against a budget file (host/controller-bench/budgets.txt):
+ *
+ *   # name                       ns/op  copied B  alloc B  allocs
+ *   transition/tick                300       480        0       0
+ *
+ * The run fails if any result is over its budget or has none. ns budgets
+ * are set a few times above a desktop's numbers, so they catch a hot path
+ * that has gone quadratic or started copying, not run-to-run jitter; the
+ * copy and heap budgets are exact (for this host's type sizes), the arena
+ * budgets a ceiling. The board is slower than the host
+ * in absolute terms but not in shape, so a regression here is one there.
+ *
+ * Usage: controller-bench [options]
+ *   --budgets FILE    Budget file (default host/controller-bench/budgets.txt)
+ *   --min-time-ms N   Shortest timed batch per benchmark (default 20)
+ *   --filter TEXT     Only benchmarks whose name contains TEXT
+ *   --ns-scale F      Multiply every ns budget by F (slow or shared machines)
+ *
+ * The parser benchmarks need ArduinoJson: build with HOST_BENCH_JSON and
+ * its src/ directory on the include path (`just host-controller-bench` does
+ * when ARDUINOJSON_SRC is set). Without it they are reported as skipped.
+ */
+
+#include "StateMachine.h"
+#ifdef HOST_BENCH_JSON
+#include "ScheduleJson.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+//----------------------------------------------------------------------------//
+// Allocation Counting
+//----------------------------------------------------------------------------//
+
+// Interposed over glibc's allocator (operator new lands here too); counts
+// only while a benchmark's allocation pass is running
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static bool g_countAllocations = false;
+static unsigned long g_allocations = 0;
+static unsigned long g_allocatedBytes = 0;
+
+extern "C" void* malloc(size_t size) {
+  if (g_countAllocations) {
+    g_allocations++;
+    g_allocatedBytes += size;
+  }
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  if (g_countAllocations) {
+    g_allocations++;
+    g_allocatedBytes += count * size;
+  }
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  if (g_countAllocations) {
+    g_allocations++;
+    g_allocatedBytes += size;
+  }
+  return __libc_realloc(ptr, size);
+}
+
+//----------------------------------------------------------------------------//
+// Harness
+//----------------------------------------------------------------------------//
+
+// Makes a value look used and memory look clobbered, so the optimizer can
+// neither drop a benchmarked call nor hoist it out of the loop
+template <typename T>
+static inline void keep(const T& value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct Bench {
+  std::string name;
+  size_t copiedBytes;                        // Per call, by signature
+  std::function<void(unsigned long)> run;    // Runs the call N times
+  std::function<size_t()> arenaBytes;        // Arena taken by the last call, if any
+};
+
+struct Result {
+  double nsPerOp;
+  size_t copiedBytes;
+  double allocBytes;
+  double allocs;
+};
+
+struct Budget {
+  double nsPerOp;
+  double copiedBytes;
+  double allocBytes;
+  double allocs;
+};
+
+static const unsigned long ALLOCATION_PASS = 1000;
+static const int TIMED_SAMPLES = 5;
+
+static Result measure(const Bench& bench, unsigned long minTimeMs) {
+  Result result;
+  result.copiedBytes = bench.copiedBytes;
+
+  // Warm up first: anything set up lazily isn't a per-call cost
+  bench.run(ALLOCATION_PASS);
+  g_allocations = 0;
+  g_allocatedBytes = 0;
+  g_countAllocations = true;
+  bench.run(ALLOCATION_PASS);
+  g_countAllocations = false;
+  result.allocs = (double)g_allocations / ALLOCATION_PASS;
+  result.allocBytes = (double)g_allocatedBytes / ALLOCATION_PASS;
+  if (bench.arenaBytes) {
+    result.allocBytes += bench.arenaBytes();
+  }
+
+  // Grow the batch until it runs long enough to time, then keep the fastest
+  unsigned long iterations = 1;
+  double best = 0;
+  for (int sample = 0; sample < TIMED_SAMPLES;) {
+    Clock::time_point start = Clock::now();
+    bench.run(iterations);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (ns < minTimeMs * 1e6) {
+      iterations = ns < minTimeMs * 1e5 ? iterations * 10 : iterations * 2;
+      continue;
+    }
+    double perOp = ns / iterations;
+    if (sample == 0 || perOp < best) {
+      best = perOp;
+    }
+    sample++;
+  }
+  result.nsPerOp = best;
+  return result;
+}
+
+// One line per benchmark: name, ns/op, copied B, alloc B, allocs
+static bool readBudgets(const char* path, std::map<std::string, Budget>* budgets) {
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    lineNumber++;
+    char* comment = strchr(line, '#');
+    if (comment != nullptr) {
+      *comment = '\0';
+    }
+    char name[128];
+    Budget budget;
+    int fields = sscanf(line, "%127s %lf %lf %lf %lf", name, &budget.nsPerOp, &budget.copiedBytes,
+                        &budget.allocBytes, &budget.allocs);
+    if (fields <= 0) {
+      continue;  // Blank or comment
+    }
+    if (fields != 5) {
+      fprintf(stderr, "%s:%d: expected: name ns/op copied-bytes alloc-bytes allocs\n", path, lineNumber);
+      fclose(file);
+      return false;
+    }
+    (*budgets)[name] = budget;
+  }
+  fclose(file);
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Fixtures
+//----------------------------------------------------------------------------//
+
+static const uint64_t T0 = 3600000;  // An hour after boot
+
+// A controller an hour in: connected, clock synced, two zones requested
+// (one open, one waiting on the supply), sensors reporting
+static AppState steadyState() {
+  Credentials creds;
+  strcpy(creds.ssid, "greenhouse");
+  strcpy(creds.pass, "correct horse battery");
+
+  SchedulePatch snapshot;
+  snapshot.seq = 41;
+  snapshot.full = true;
+  snapshot.changedMask = 0x07;
+  snapshot.valueMask = 0x05;
+
+  uint16_t permille[ZONE_COUNT] = {310, 420, MOISTURE_UNKNOWN};
+
+  std::vector<Input> boot = {
+    Input::credentialsEntered(creds), Input::credentialsSaved(), Input::connectionStarted(),
+    Input::wifiStatusChanged(WL_CONNECTED), Input::timeSynced(1760000000000ULL),
+    Input::pollStarted(), Input::schedulePatch(snapshot, 60000), Input::scheduleSaved(),
+    Input::moistureReading(permille), Input::tick()
+  };
+  AppState state;
+  uint64_t now = T0 - 1000;
+  for (Input& input : boot) {
+    input.nowMs = now;
+    now += 100;
+    state = transitionFunction(state, input);
+  }
+  return state;
+}
+
+// One representative input of each type, applied 100 ms after the last
+static std::vector<std::pair<std::string, Input>> inputsByType(const AppState& state) {
+  Credentials creds;
+  strcpy(creds.ssid, "greenhouse-5g");
+  strcpy(creds.pass, "another long passphrase");
+
+  IrrigationSchedule schedule;
+  schedule.zone2 = true;
+  schedule.seq = 42;
+  schedule.lastUpdate = state.lastUpdate;
+
+  SchedulePatch delta;
+  delta.seq = state.schedule.seq + 1;
+  delta.baseSeq = state.schedule.seq;
+  delta.changedMask = 0x02;
+  delta.valueMask = 0x02;
+
+  uint16_t permille[ZONE_COUNT] = {640, 415, MOISTURE_UNKNOWN};
+
+  std::vector<std::pair<std::string, Input>> inputs = {
+    {"none", Input::none()},
+    {"retry-connection", Input::retryConnection()},
+    {"request-credentials", Input::requestCredentials()},
+    {"credentials-entered", Input::credentialsEntered(creds)},
+    {"credentials-cancelled", Input::credentialsCancelled()},
+    {"connection-started", Input::connectionStarted()},
+    {"wifi-connected", Input::wifiStatusChanged(WL_CONNECTED)},
+    {"wifi-disconnected", Input::wifiStatusChanged(WL_CONNECTION_LOST)},
+    {"schedule-received", Input::scheduleReceived(schedule)},
+    {"http-error", Input::httpError(30000, 503)},
+    {"credentials-saved", Input::credentialsSaved()},
+    {"schedule-saved", Input::scheduleSaved()},
+    {"poll-started", Input::pollStarted()},
+    {"tick", Input::tick()},
+    {"moisture-reading", Input::moistureReading(permille)},
+    {"schedule-patch", Input::schedulePatch(delta, 60000)},
+    {"firmware-ready", Input::firmwareReady()},
+    {"firmware-failed", Input::firmwareFailed()},
+    {"time-synced", Input::timeSynced(1760003600000ULL)},
+    {"zone-override", Input::zoneOverride(0, OVERRIDE_OPEN, 600000)},
+    {"networks-replaced", Input::networksReplaced(state.credentials, false)},
+  };
+  for (auto& entry : inputs) {
+    entry.second.nowMs = state.lastUpdate + 100;
+  }
+  return inputs;
+}
+
+#ifdef HOST_BENCH_JSON
+// Fills a body up to the firmware's 1 KB response buffer with keys the
+// parser has to walk past: what a chatty or future server could send
+static std::string largeScheduleBody() {
+  std::string body = "{\"seq\":4294967295,\"zone1\":true,\"zone2\":false,\"zone3\":true,"
+                     "\"server\":\"irrigation-web-server/0.1\",\"history\":[";
+  for (int i = 0; body.size() < 600; i++) {
+    char entry[64];
+    snprintf(entry, sizeof(entry), "%s{\"seq\":%u,\"zones\":%d}", i == 0 ? "" : ",", 4294967000u + i, i % 8);
+    body += entry;
+  }
+  body += "],\"note\":\"";
+  while (body.size() < 1020) {
+    body += 'x';
+  }
+  body += "\"}";
+  return body;
+}
+#endif
+
+//----------------------------------------------------------------------------//
+// Benchmarks
+//----------------------------------------------------------------------------//
+
+static AppState g_state;
+static AppState g_sink;
+
+// The factory is a template argument, so it inlines as it does in the firmware
+template <typename Factory>
+static Bench factoryBench(const char* name, Factory make) {
+  return {name, sizeof(Input), [make](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+      Input input = make();
+      keep(input);
+    }
+  }, nullptr};
+}
+
+static std::vector<Bench> buildBenches() {
+  std::vector<Bench> benches;
+  g_state = steadyState();
+
+  for (const auto& entry : inputsByType(g_state)) {
+    Input input = entry.second;
+    benches.push_back({"transition/" + entry.first, sizeof(AppState), [input](unsigned long n) {
+      for (unsigned long i = 0; i < n; i++) {
+        AppState next = transitionFunction(g_state, input);
+        keep(next);
+      }
+    }, nullptr});
+  }
+
+  // Outputs: the usual pass (LEDs only), a poll falling due, a pending save
+  AppState pollDue = g_state;
+  pollDue.lastUpdate = pollDue.lastPollTime + pollDue.pollIntervalMs + 1;
+  AppState saving = g_state;
+  saving.scheduleChanged = true;
+  std::vector<std::pair<std::string, AppState>> outputStates = {
+    {"output/idle", g_state}, {"output/poll-due", pollDue}, {"output/save-schedule", saving}
+  };
+  for (const auto& entry : outputStates) {
+    AppState state = entry.second;
+    benches.push_back({entry.first, sizeof(Output), [state](unsigned long n) {
+      for (unsigned long i = 0; i < n; i++) {
+        Output output = outputFunction(state);
+        keep(output);
+      }
+    }, nullptr});
+  }
+
+  // Factories, with the arguments the firmware passes them
+  Credentials creds;
+  strcpy(creds.ssid, "greenhouse");
+  strcpy(creds.pass, "correct horse battery");
+  SchedulePatch patch;
+  patch.seq = 43;
+  patch.baseSeq = 42;
+  patch.changedMask = 0x01;
+  uint16_t permille[ZONE_COUNT] = {500, 500, 500};
+  benches.push_back(factoryBench("input/tick", [] { return Input::tick(); }));
+  benches.push_back(factoryBench("input/wifi-status", [] { return Input::wifiStatusChanged(WL_CONNECTED); }));
+  benches.push_back(factoryBench("input/credentials-entered", [creds] { return Input::credentialsEntered(creds); }));
+  benches.push_back(factoryBench("input/schedule-patch", [patch] { return Input::schedulePatch(patch, 60000); }));
+  benches.push_back(factoryBench("input/http-error", [] { return Input::httpError(30000, 503); }));
+  benches.push_back(factoryBench("input/moisture-reading", [permille] { return Input::moistureReading(permille); }));
+  benches.push_back(factoryBench("input/time-synced", [] { return Input::timeSynced(1760000000000ULL); }));
+
+  benches.push_back({"state/copy", sizeof(AppState), [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+      AppState copy(g_state);
+      keep(copy);
+    }
+  }, nullptr});
+  benches.push_back({"state/assign", sizeof(AppState), [](unsigned long n) {
+    for (unsigned long i = 0; i < n; i++) {
+      g_sink = g_state;
+      keep(g_sink);
+    }
+  }, nullptr});
+
+#ifdef HOST_BENCH_JSON
+  std::vector<std::pair<std::string, std::string>> bodies = {
+    {"parse/snapshot", "{\"seq\":41,\"zone1\":true,\"zone2\":false,\"zone3\":true}"},
+    {"parse/delta", "{\"seq\":42,\"base\":41,\"zone2\":true}"},
+    {"parse/unversioned", "{\"zone1\":true,\"zone2\":false,\"zone3\":false}"},
+    {"parse/large", largeScheduleBody()},
+  };
+  for (const auto& entry : bodies) {
+    std::string body = entry.second;
+    SchedulePatch check;
+    if (!parseScheduleJson(body.c_str(), body.size(), &check)) {
+      fprintf(stderr, "controller-bench: %s body (%zu bytes) doesn't parse\n", entry.first.c_str(), body.size());
+      exit(1);
+    }
+    benches.push_back({entry.first, sizeof(SchedulePatch), [body](unsigned long n) {
+      for (unsigned long i = 0; i < n; i++) {
+        SchedulePatch parsed;
+        keep(parseScheduleJson(body.c_str(), body.size(), &parsed));
+        keep(parsed);
+      }
+    }, scheduleJsonArenaUsed});
+  }
+#endif
+  return benches;
+}
+
+//----------------------------------------------------------------------------//
+// Main
+//----------------------------------------------------------------------------//
+
+int main(int argc, char** argv) {
+  const char* budgetPath = "host/controller-bench/budgets.txt";
+  unsigned long minTimeMs = 20;
+  const char* filter = "";
+  double nsScale = 1.0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--budgets") == 0) {
+      budgetPath = argv[i + 1];
+    } else if (strcmp(argv[i], "--min-time-ms") == 0) {
+      minTimeMs = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--filter") == 0) {
+      filter = argv[i + 1];
+    } else if (strcmp(argv[i], "--ns-scale") == 0) {
+      nsScale = strtod(argv[i + 1], nullptr);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (minTimeMs == 0 || nsScale <= 0) {
+    fprintf(stderr, "--min-time-ms and --ns-scale must be positive\n");
+    return 2;
+  }
+
+  std::map<std::string, Budget> budgets;
+  if (!readBudgets(budgetPath, &budgets)) {
+    return 2;
+  }
+
+  int failures = 0;
+  std::map<std::string, bool> measured;
+  printf("%-34s %9s %9s %9s %9s %7s\n", "benchmark", "ns/op", "budget", "copied B", "alloc B", "allocs");
+  for (const Bench& bench : buildBenches()) {
+    if (bench.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    Result result = measure(bench, minTimeMs);
+    measured[bench.name] = true;
+
+    const char* verdict = "ok";
+    auto it = budgets.find(bench.name);
+    if (it == budgets.end()) {
+      verdict = "NO BUDGET";
+      failures++;
+    } else {
+      const Budget& budget = it->second;
+      if (result.nsPerOp > budget.nsPerOp * nsScale) {
+        verdict = "OVER (time)";
+      } else if (result.copiedBytes > budget.copiedBytes) {
+        verdict = "OVER (copied)";
+      } else if (result.allocBytes > budget.allocBytes) {
+        verdict = "OVER (alloc B)";
+      } else if (result.allocs > budget.allocs) {
+        verdict = "OVER (allocs)";
+      }
+      if (strcmp(verdict, "ok") != 0) {
+        failures++;
+      }
+    }
+    printf("%-34s %9.1f %9.0f %9zu %9.0f %7.2f  %s\n", bench.name.c_str(), result.nsPerOp,
+           it == budgets.end() ? 0.0 : it->second.nsPerOp * nsScale, result.copiedBytes,
+           result.allocBytes, result.allocs, verdict);
+  }
+  for (const auto& entry : budgets) {
+    if (!measured.count(entry.first) && entry.first.find(filter) != std::string::npos) {
+#ifdef HOST_BENCH_JSON
+      printf("%-34s %9s  (budgeted but not run)\n", entry.first.c_str(), "-");
+#else
+      printf("%-34s %9s  %s\n", entry.first.c_str(), "-",
+             entry.first.compare(0, 6, "parse/") == 0 ? "skipped (built without ArduinoJson)"
+                                                      : "(budgeted but not run)");
+#endif
+    }
+  }
+
+  if (failures > 0) {
+    printf("FAIL: %d benchmark%s over or without a budget\n", failures, failures == 1 ? "" : "s");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,600 @@
+/*
+ * Firmware Update Signer and Download Check
+ *
+ * Signs sketch binaries into update images (FirmwareImage.h), and checks the
+ * controller's update path end to end against the stand-in server: a
+ * random image is fetched chunk by chunk over one keep-alive connection and
+ * written through the firmware's own firmwareWriteChunk() into a file-backed
+ * slot that enforces flash rules (program only erased bytes, erase by
+ * sector). Responses cut off mid-body and simulated resets - mid-program,
+ * or between a chunk's program and its checkpoint - exercise resuming, and
+ * the result is verified with firmwareVerifySlot() as on the board.
+ *
+ * Reports payload throughput and what the download holds in RAM: the
+ * update path's fixed buffers, heap allocations while downloading (expect
+ * 0) and the process's peak RSS during the download against before it.
+ *
+ * Usage: firmware-ota --sign SKETCH.bin --key KEY.pem --version N --out IMAGE
+ *   Sign a build (make a key with
+ *   `openssl ecparam -name prime256v1 -genkey -noout -out KEY.pem`) and print
+ *   the public key array for ota_public_key in controller.ino.
+ *
+ * Usage: firmware-ota [options]
+ *   --size KB            Payload size (default 512)
+ *   --chunk N            Bytes per request (default 4096, the firmware's)
+ *   --cut-every N        Stand-in cuts every Nth firmware response (default 7, 0 = never)
+ *   --power-loss-every N Reset during or just after every Nth chunk write
+ *                        (default 50, 0 = never)
+ *   --seed N             RNG seed (default 1)
+ */
+
+#include "FirmwareImage.h"
+#include "StandInServer.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+//----------------------------------------------------------------------------//
+// Allocation Counting
+//----------------------------------------------------------------------------//
+
+// Interposed over glibc's allocator; counts only on the thread that sets
+// g_countAllocations, so the stand-in server thread isn't counted
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static thread_local bool g_countAllocations = false;
+static unsigned long g_allocations = 0;
+
+extern "C" void* malloc(size_t size) {
+  if (g_countAllocations) g_allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  if (g_countAllocations) g_allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  if (g_countAllocations) g_allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+//----------------------------------------------------------------------------//
+// Signatures (OpenSSL)
+//----------------------------------------------------------------------------//
+
+// DER SubjectPublicKeyInfo prefix for an uncompressed P-256 point, so a raw
+// 65-byte key can go through d2i_PUBKEY without the version-specific EC APIs
+static const uint8_t P256_SPKI_PREFIX[26] = {
+  0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+  0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03, 0x42, 0x00
+};
+
+static const size_t SIGNED_BYTES = offsetof(FirmwareImageHeader, signature);
+
+bool firmwareHeaderSigned(const FirmwareImageHeader& header,
+                          const uint8_t publicKey[FIRMWARE_PUBLIC_KEY_SIZE]) {
+  uint8_t spki[sizeof(P256_SPKI_PREFIX) + FIRMWARE_PUBLIC_KEY_SIZE];
+  memcpy(spki, P256_SPKI_PREFIX, sizeof(P256_SPKI_PREFIX));
+  memcpy(spki + sizeof(P256_SPKI_PREFIX), publicKey, FIRMWARE_PUBLIC_KEY_SIZE);
+  const uint8_t* p = spki;
+  EVP_PKEY* key = d2i_PUBKEY(nullptr, &p, sizeof(spki));
+
+  const size_t half = FIRMWARE_SIGNATURE_SIZE / 2;
+  ECDSA_SIG* sig = ECDSA_SIG_new();
+  ECDSA_SIG_set0(sig, BN_bin2bn(header.signature, half, nullptr),
+                 BN_bin2bn(header.signature + half, half, nullptr));
+  uint8_t der[80];
+  uint8_t* out = der;
+  int derLength = i2d_ECDSA_SIG(sig, &out);
+  ECDSA_SIG_free(sig);
+
+  bool valid = false;
+  EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+  if (key != nullptr && EVP_DigestVerifyInit(ctx, nullptr, EVP_sha256(), nullptr, key) == 1) {
+    valid = EVP_DigestVerify(ctx, der, derLength, (const uint8_t*)&header, SIGNED_BYTES) == 1;
+  }
+  EVP_MD_CTX_free(ctx);
+  EVP_PKEY_free(key);
+  return valid;
+}
+
+static bool publicKeyBytes(EVP_PKEY* key, uint8_t out[FIRMWARE_PUBLIC_KEY_SIZE]) {
+  uint8_t spki[128];
+  uint8_t* p = spki;
+  int length = i2d_PUBKEY(key, &p);
+  if (length != (int)(sizeof(P256_SPKI_PREFIX) + FIRMWARE_PUBLIC_KEY_SIZE)) {
+    return false;  // Not a P-256 key
+  }
+  memcpy(out, spki + sizeof(P256_SPKI_PREFIX), FIRMWARE_PUBLIC_KEY_SIZE);
+  return true;
+}
+
+// Header for `payload`, signed with `key`
+static bool signedHeader(EVP_PKEY* key, uint32_t version, const std::string& payload,
+                         FirmwareImageHeader* header) {
+  memset(header, 0, sizeof(*header));
+  header->magic = FIRMWARE_MAGIC;
+  header->headerSize = FIRMWARE_HEADER_SIZE;
+  header->version = version;
+  header->payloadSize = (uint32_t)payload.size();
+  Sha256 hash;
+  sha256Begin(&hash);
+  sha256Update(&hash, payload.data(), payload.size());
+  sha256End(&hash, header->digest);
+
+  uint8_t der[80];
+  size_t derLength = sizeof(der);
+  EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+  bool ok = EVP_DigestSignInit(ctx, nullptr, EVP_sha256(), nullptr, key) == 1 &&
+            EVP_DigestSign(ctx, der, &derLength, (const uint8_t*)header, SIGNED_BYTES) == 1;
+  EVP_MD_CTX_free(ctx);
+  if (!ok) return false;
+
+  const uint8_t* p = der;
+  ECDSA_SIG* sig = d2i_ECDSA_SIG(nullptr, &p, derLength);
+  const size_t half = FIRMWARE_SIGNATURE_SIZE / 2;
+  ok = sig != nullptr &&
+       BN_bn2binpad(ECDSA_SIG_get0_r(sig), header->signature, half) == (int)half &&
+       BN_bn2binpad(ECDSA_SIG_get0_s(sig), header->signature + half, half) == (int)half;
+  ECDSA_SIG_free(sig);
+  return ok;
+}
+
+//----------------------------------------------------------------------------//
+// File-Backed Slot
+//----------------------------------------------------------------------------//
+
+// The inactive bank's geometry, with the STM32H7's rules enforced: a flash
+// word can only be programmed once after an erase
+class FileSlot : public FirmwareSlot {
+public:
+  FileSlot() : file(tmpfile()), programs(0), erases(0), tearNextProgram(false), corruptNextProgram(false) {
+    std::vector<uint8_t> blank(size(), 0x00);  // Garbage until erased
+    fwrite(blank.data(), 1, blank.size(), file);
+    fflush(file);
+  }
+  ~FileSlot() { fclose(file); }
+
+  uint32_t size() const override { return 0xC0000; }        // 768 KB past the bootloader
+  uint32_t sectorSize() const override { return 0x20000; }  // 128 KB
+  uint32_t programSize() const override { return 32; }
+
+  bool erase(uint32_t offset, uint32_t length) override {
+    if (offset % sectorSize() != 0 || length % sectorSize() != 0 || offset + length > size()) {
+      return false;
+    }
+    static uint8_t blank[0x20000];
+    memset(blank, 0xFF, sizeof(blank));
+    for (uint32_t done = 0; done < length; done += sectorSize()) {
+      if (pwrite(fileno(file), blank, sizeof(blank), offset + done) != (ssize_t)sizeof(blank)) {
+        return false;
+      }
+    }
+    erases++;
+    return true;
+  }
+
+  bool program(uint32_t offset, const void* data, uint32_t length) override {
+    if (offset % programSize() != 0 || length % programSize() != 0 || offset + length > size()) {
+      return false;
+    }
+    uint8_t current[4096];
+    for (uint32_t done = 0; done < length; done += sizeof(current)) {
+      uint32_t n = length - done < sizeof(current) ? length - done : sizeof(current);
+      if (!read(offset + done, current, n)) return false;
+      for (uint32_t i = 0; i < n; i++) {
+        if (current[i] != 0xFF) {
+          fprintf(stderr, "firmware-ota: program over unerased byte at %u\n", offset + done + i);
+          return false;
+        }
+      }
+    }
+    programs++;
+    if (tearNextProgram || corruptNextProgram) {
+      // Power lost partway: the first half of the words landed, and maybe
+      // one word with only some of its bits programmed
+      uint32_t landed = length / 2 / programSize() * programSize();
+      pwrite(fileno(file), data, landed, offset);
+      if (corruptNextProgram) {
+        uint8_t word[32];
+        memcpy(word, (const uint8_t*)data + landed, sizeof(word));
+        for (uint8_t& b : word) b |= 0x0F;  // Programming only clears bits
+        word[0] = 0x0F;
+        pwrite(fileno(file), word, sizeof(word), offset + landed);
+      }
+      tearNextProgram = false;
+      corruptNextProgram = false;
+      return false;
+    }
+    return pwrite(fileno(file), data, length, offset) == (ssize_t)length;
+  }
+
+  bool read(uint32_t offset, void* data, uint32_t length) override {
+    return pread(fileno(file), data, length, offset) == (ssize_t)length;
+  }
+
+  FILE* file;
+  unsigned long programs;
+  unsigned long erases;
+  bool tearNextProgram;     // Simulate a reset in the middle of the next program
+  bool corruptNextProgram;  // ...that also leaves one flash word half-programmed
+};
+
+//----------------------------------------------------------------------------//
+// Keep-Alive HTTP Client
+//----------------------------------------------------------------------------//
+
+// Fixed buffers only, like the firmware's: request path, one header line at a
+// time and the chunk itself
+struct RangeClient {
+  uint16_t port;
+  int fd = -1;
+  unsigned long requests = 0;
+  unsigned long connects = 0;
+  unsigned long failures = 0;
+  char path[64];
+  char rx[512];                // Response head
+  size_t rxLength = 0;
+
+  void close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+  }
+
+  bool open() {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    connects++;
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  // GET a byte range into `body`; returns bytes received, or -1
+  int fetch(uint32_t offset, uint32_t length, uint8_t* body, size_t capacity) {
+    requests++;
+    int received = attempt(offset, length, body, capacity);
+    if (received < 0) {
+      failures++;
+      close();  // Whatever is left on this connection is unusable
+    }
+    return received;
+  }
+
+private:
+  int attempt(uint32_t offset, uint32_t length, uint8_t* body, size_t capacity) {
+    if (fd < 0 && !open()) return -1;
+    int n = snprintf(path, sizeof(path), "GET /firmware?offset=%u&length=%u HTTP/1.1\r\n\r\n", offset, length);
+    if (write(fd, path, n) != n) return -1;
+
+    // Head, then whatever part of the body came with it
+    rxLength = 0;
+    char* end = nullptr;
+    while (end == nullptr) {
+      ssize_t got = read(fd, rx + rxLength, sizeof(rx) - 1 - rxLength);
+      if (got <= 0) return -1;
+      rxLength += got;
+      rx[rxLength] = '\0';
+      end = strstr(rx, "\r\n\r\n");
+      if (end == nullptr && rxLength == sizeof(rx) - 1) return -1;
+    }
+    int status = atoi(rx + 9);
+    const char* lengthHeader = strcasestr(rx, "Content-Length:");
+    if (lengthHeader == nullptr || lengthHeader > end) return -1;
+    size_t contentLength = strtoul(lengthHeader + 15, nullptr, 10);
+    if (contentLength > capacity) return -1;
+
+    size_t have = rxLength - (end + 4 - rx);
+    memcpy(body, end + 4, have);
+    while (have < contentLength) {
+      ssize_t got = read(fd, body + have, contentLength - have);
+      if (got <= 0) return -1;  // Cut off
+      have += got;
+    }
+    if (strcasestr(rx, "Connection: close") != nullptr) close();
+    return status == 200 ? (int)have : -1;
+  }
+};
+
+//----------------------------------------------------------------------------//
+// Sign
+//----------------------------------------------------------------------------//
+
+static bool readFile(const char* path, std::string* contents) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *contents = buffer.str();
+  return (bool)file;
+}
+
+static int signImage(const char* sketchPath, const char* keyPath, uint32_t version, const char* outPath) {
+  std::string payload;
+  if (!readFile(sketchPath, &payload) || payload.empty()) {
+    fprintf(stderr, "Can't read %s\n", sketchPath);
+    return 1;
+  }
+  FILE* keyFile = fopen(keyPath, "r");
+  EVP_PKEY* key = keyFile ? PEM_read_PrivateKey(keyFile, nullptr, nullptr, nullptr) : nullptr;
+  if (keyFile) fclose(keyFile);
+  uint8_t publicKey[FIRMWARE_PUBLIC_KEY_SIZE];
+  if (key == nullptr || !publicKeyBytes(key, publicKey)) {
+    fprintf(stderr, "%s is not a P-256 private key\n", keyPath);
+    return 1;
+  }
+
+  FileSlot slot;
+  FirmwareImageHeader header;
+  if (payload.size() > slot.size() || !signedHeader(key, version, payload, &header)) {
+    fprintf(stderr, "Can't sign: payload larger than the %u-byte slot?\n", slot.size());
+    return 1;
+  }
+  EVP_PKEY_free(key);
+
+  std::ofstream out(outPath, std::ios::binary);
+  out.write((const char*)&header, sizeof(header));
+  out.write(payload.data(), payload.size());
+  if (!out) {
+    fprintf(stderr, "Can't write %s\n", outPath);
+    return 1;
+  }
+
+  printf("firmware-ota: build %u, %zu bytes -> %s\n", version, payload.size(), outPath);
+  printf("const uint8_t ota_public_key[65] = {");
+  for (size_t i = 0; i < FIRMWARE_PUBLIC_KEY_SIZE; i++) {
+    printf("%s0x%02x", i == 0 ? "" : (i % 12 == 0 ? ",\n  " : ", "), publicKey[i]);
+  }
+  printf("};\n");
+  return 0;
+}
+
+//----------------------------------------------------------------------------//
+// Download Check
+//----------------------------------------------------------------------------//
+
+struct CheckConfig {
+  unsigned long sizeKb = 512;
+  size_t chunk = 4096;
+  unsigned long cutEvery = 7;
+  unsigned long powerLossEvery = 50;
+  unsigned seed = 1;
+};
+
+// VmHWM or VmRSS from /proc/self/status, in KB
+static unsigned long procStatusKb(const char* field) {
+  FILE* status = fopen("/proc/self/status", "r");
+  char line[128];
+  unsigned long kb = 0;
+  while (status && fgets(line, sizeof(line), status)) {
+    if (strncmp(line, field, strlen(field)) == 0) kb = strtoul(line + strlen(field) + 1, nullptr, 10);
+  }
+  if (status) fclose(status);
+  return kb;
+}
+
+static int runCheck(const CheckConfig& config) {
+  std::mt19937 rng(config.seed);
+  std::string payload(config.sizeKb * 1024, '\0');
+  for (char& c : payload) c = (char)(rng() & 0xFF);
+
+  EVP_PKEY* key = EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256");
+  uint8_t publicKey[FIRMWARE_PUBLIC_KEY_SIZE];
+  FirmwareImageHeader signedImage;
+  if (key == nullptr || !publicKeyBytes(key, publicKey) || !signedHeader(key, 2, payload, &signedImage)) {
+    fprintf(stderr, "firmware-ota: key generation or signing failed\n");
+    return 1;
+  }
+  EVP_PKEY_free(key);
+
+  // A tampered copy must be refused
+  FirmwareImageHeader tampered = signedImage;
+  tampered.payloadSize ^= 1;
+  if (!firmwareHeaderSigned(signedImage, publicKey) || firmwareHeaderSigned(tampered, publicKey)) {
+    fprintf(stderr, "firmware-ota: signature check is broken\n");
+    return 1;
+  }
+
+  StandInConfig serverConfig;
+  serverConfig.firmware.assign((const char*)&signedImage, sizeof(signedImage));
+  serverConfig.firmware += payload;
+  serverConfig.firmwareCutEvery = config.cutEvery;
+  StandInServer server;
+  if (!server.start(serverConfig)) return 1;
+  std::atomic<bool> stop(false);
+  std::thread serverThread([&] { server.run(stop); });
+
+  FileSlot slot;
+  RangeClient client;
+  client.port = server.port();
+  std::vector<uint8_t> chunk(config.chunk + 1);
+  FirmwareProgress progress;
+  FirmwareProgress saved;          // What the key-value store holds
+  memset(&progress, 0, sizeof(progress));
+  memset(&saved, 0, sizeof(saved));
+  unsigned long chunks = 0, rewinds = 0, resumes = 0, powerLosses = 0, writes = 0;
+  bool downloading = false;
+
+  // Reset the peak-RSS counter so VmHWM covers the download alone
+  FILE* clearRefs = fopen("/proc/self/clear_refs", "w");
+  if (clearRefs) {
+    fputs("5", clearRefs);
+    fclose(clearRefs);
+  }
+  unsigned long rssBeforeKb = procStatusKb("VmRSS:");
+  g_allocations = 0;
+  g_countAllocations = true;
+  auto started = std::chrono::steady_clock::now();
+
+  // The firmware's serviceFirmwareUpdate() loop, one request per pass
+  for (unsigned long pass = 0; !progress.complete; pass++) {
+    if (pass > 100000) {
+      fprintf(stderr, "firmware-ota: no progress\n");
+      break;
+    }
+    if (!downloading) {
+      if (client.fetch(0, FIRMWARE_HEADER_SIZE, chunk.data(), config.chunk) != (int)FIRMWARE_HEADER_SIZE) {
+        continue;  // The firmware waits FIRMWARE_RETRY_MS here
+      }
+      FirmwareImageHeader header;
+      memcpy(&header, chunk.data(), sizeof(header));
+      if (saved.header.version != 0 && memcmp(&header, &saved.header, sizeof(header)) == 0) {
+        progress = saved;
+        resumes++;
+      } else {
+        g_countAllocations = false;  // OpenSSL here; mbedTLS on the board, once per image
+        bool valid = firmwareHeaderUsable(header, slot.size()) && firmwareHeaderSigned(header, publicKey);
+        g_countAllocations = true;
+        if (!valid) {
+          fprintf(stderr, "firmware-ota: served image rejected\n");
+          break;
+        }
+        firmwareProgressBegin(&progress, header);
+        saved = progress;
+      }
+      downloading = true;
+      continue;
+    }
+
+    uint32_t remaining = progress.header.payloadSize - progress.written;
+    uint32_t length = remaining < config.chunk ? remaining : (uint32_t)config.chunk;
+    if (client.fetch(FIRMWARE_HEADER_SIZE + progress.written, length, chunk.data(), config.chunk) != (int)length) {
+      downloading = false;  // Back to the header check, which resumes
+      continue;
+    }
+    // Every powerLossEvery-th chunk write the board resets: in turn just
+    // after programming (before the checkpoint), between two flash words,
+    // and in the middle of one
+    bool powerLoss = config.powerLossEvery > 0 && ++writes % config.powerLossEvery == 0;
+    slot.tearNextProgram = powerLoss && powerLosses % 3 == 1;
+    slot.corruptNextProgram = powerLoss && powerLosses % 3 == 2;
+    FirmwareWriteResult result = firmwareWriteChunk(&progress, slot, chunk.data(), length, config.chunk);
+    if (result == FIRMWARE_WRITE_FAILED && !powerLoss) {
+      fprintf(stderr, "firmware-ota: flash write failed at %u\n", progress.written);
+      break;
+    }
+    if (result == FIRMWARE_WRITE_REWOUND) {
+      rewinds++;
+    } else if (result == FIRMWARE_WRITE_OK) {
+      chunks++;
+    }
+    if (powerLoss && result != FIRMWARE_WRITE_REWOUND) {
+      powerLosses++;
+      client.close();
+      memset(&progress, 0, sizeof(progress));  // RAM is gone; `saved` survives
+      downloading = false;
+      continue;
+    }
+    if (progress.written == progress.header.payloadSize && !firmwareVerifySlot(&progress, slot)) {
+      fprintf(stderr, "firmware-ota: digest mismatch\n");
+      break;
+    }
+    saved = progress;
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  g_countAllocations = false;
+  unsigned long peakKb = procStatusKb("VmHWM:");
+  stop.store(true);
+  serverThread.join();
+
+  // Independent of firmwareVerifySlot(): compare the slot byte for byte
+  std::vector<uint8_t> check(payload.size());
+  bool identical = slot.read(0, check.data(), (uint32_t)check.size()) &&
+                   memcmp(check.data(), payload.data(), payload.size()) == 0;
+
+  const StandInStats& served = server.stats();
+  printf("firmware-ota: %lu KB payload in %.2f s = %.1f MB/s (%lu-byte chunks)\n",
+         config.sizeKb, seconds, payload.size() / seconds / 1e6, config.chunk);
+  printf("firmware-ota: %lu requests, %lu connections, %lu cut short by the server, %lu failed\n",
+         client.requests, client.connects, served.firmwareCuts.load(), client.failures);
+  printf("firmware-ota: %lu chunks written, %lu power losses, %lu resumes, %lu rewinds, %lu erases, %lu programs\n",
+         chunks, powerLosses, resumes, rewinds, slot.erases, slot.programs);
+  printf("firmware-ota: update path RAM %zu B (chunk %zu + progress %zu + request/head %zu), "
+         "heap allocations while downloading: %lu\n",
+         chunk.size() + sizeof(progress) + sizeof(client.path) + sizeof(client.rx), chunk.size(),
+         sizeof(progress), sizeof(client.path) + sizeof(client.rx), g_allocations);
+  printf("firmware-ota: process RSS %lu KB before, peak %lu KB during the download\n", rssBeforeKb, peakKb);
+
+  bool ok = progress.complete && identical && g_allocations == 0;
+  printf("firmware-ota: %s\n", ok ? "ok - slot verified" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  CheckConfig config;
+  const char* sketch = nullptr;
+  const char* keyPath = nullptr;
+  const char* outPath = nullptr;
+  uint32_t version = 0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--sign") == 0) {
+      sketch = argv[i + 1];
+    } else if (strcmp(argv[i], "--key") == 0) {
+      keyPath = argv[i + 1];
+    } else if (strcmp(argv[i], "--version") == 0) {
+      version = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--out") == 0) {
+      outPath = argv[i + 1];
+    } else if (strcmp(argv[i], "--size") == 0) {
+      config.sizeKb = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--chunk") == 0) {
+      config.chunk = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--cut-every") == 0) {
+      config.cutEvery = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--power-loss-every") == 0) {
+      config.powerLossEvery = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      config.seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  if (sketch != nullptr) {
+    if (keyPath == nullptr || outPath == nullptr || version == 0) {
+      fprintf(stderr, "--sign needs --key, --version and --out\n");
+      return 2;
+    }
+    return signImage(sketch, keyPath, version, outPath);
+  }
+  if (config.sizeKb == 0 || config.sizeKb * 1024 > 0xC0000 || config.chunk == 0 || config.chunk % 32 != 0) {
+    fprintf(stderr, "--size must be 1-768 KB and --chunk a multiple of 32\n");
+    return 2;
+  }
+  return runCheck(config);
+}
@@ -0,0 +1,868 @@
+/*
+ * Controller Fleet Simulator
+ *
+ * Load generator for the schedule endpoint. Each virtual controller runs the
+ * firmware's real transitionFunction/outputFunction (linked from
+ * controller/StateMachine.cpp) against a virtual WiFi radio, and its schedule
+ * polls go out as real HTTP requests. All sockets are multiplexed over one
+ * epoll loop, so thousands of controllers fit in a single thread.
+ *
+ * What is real: the Moore machine, so polling cadence (the adaptive interval,
+ * server Cache-Control/Retry-After hints, an immediate poll after every
+ * reconnect), connection timeouts and reconnect handling are exactly what the
+ * firmware does. HTTP connections are kept alive between polls with the same
+ * liveness rules as HttpSession.cpp, and polls ask for changes since the
+ * schedule version each controller holds. What is simulated: radio
+ * association time, link drops and their outages, and flash writes.
+ *
+ * Usage: fleet-sim [options]
+ *   --controllers N     Number of virtual controllers (default 100)
+ *   --duration S        Run time in seconds (default 120)
+ *   --ramp S            Boot controllers uniformly over S seconds (default 30)
+ *   --server HOST:PORT  Schedule server (default 127.0.0.1:3000)
+ *   --local             Start the bundled stand-in server and target it
+ *   --max-age S         Stand-in sends Cache-Control: max-age=S (default 0 = none)
+ *   --flip-every S      Stand-in changes one zone every S seconds (default 0 = never)
+ *   --no-delta          Stand-in sends the full unversioned schedule every poll (pre-delta server)
+ *   --http-timeout-ms N Per-request timeout (default http_response_timeout_ms)
+ *   --no-keep-alive     Open a new connection for every poll (pre-HttpSession firmware)
+ *   --idle-timeout S    Stand-in closes connections idle this long (default 30, Warp's)
+ *   --drop-mean S       Mean seconds between link drops per controller (default 0 = never)
+ *   --outage-mean S     Mean seconds a dropped link stays down (default 10)
+ *   --connect-fail P    Probability an association attempt fails (default 0)
+ *   --report S          Progress report interval in seconds (default 10)
+ *   --seed N            RNG seed (default 1)
+ */
+
+#include "StateMachine.h"
+#include "StandInServer.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+//----------------------------------------------------------------------------//
+// Configuration
+//----------------------------------------------------------------------------//
+
+struct SimConfig {
+  unsigned long controllers = 100;
+  double durationS = 120;
+  double rampS = 30;
+  std::string host = "127.0.0.1";
+  uint16_t port = 3000;
+  bool local = false;
+  unsigned long standInMaxAgeS = 0;
+  unsigned long standInIdleTimeoutS = 30;
+  unsigned long standInFlipEveryS = 0;
+  bool standInDelta = true;
+  unsigned long httpTimeoutMs = http_response_timeout_ms;
+  bool keepAlive = true;
+  double dropMeanS = 0;
+  double outageMeanS = 10;
+  double connectFailP = 0;
+  double reportS = 10;
+  unsigned seed = 1;
+};
+
+const unsigned long TICK_MS = 100;        // g_tickTimer period in the firmware
+const int MAX_STEPS_PER_LOOP = 8;         // Bound on chained inputs per loop pass
+
+//----------------------------------------------------------------------------//
+// Statistics
+//----------------------------------------------------------------------------//
+
+enum HttpErrorKind {
+  ERR_NO_LINK,      // Poll requested while the radio was down
+  ERR_CONNECT,      // TCP connect failed
+  ERR_RESET,        // Read/write error after connecting
+  ERR_TIMEOUT,      // No complete response within the timeout
+  ERR_STATUS,       // Non-200 status
+  ERR_PARSE,        // Body isn't a schedule response
+  ERR_KIND_COUNT
+};
+
+static const char* ERROR_NAMES[ERR_KIND_COUNT] = {
+  "no-link", "connect", "reset", "timeout", "status", "parse"
+};
+
+struct SimStats {
+  unsigned long requests = 0;           // HTTP requests started
+  unsigned long successes = 0;          // 200 + valid schedule
+  unsigned long errors[ERR_KIND_COUNT] = {0};
+  unsigned long connectAttempts = 0;    // EFFECT_START_WIFI_CONNECTION
+  unsigned long saveEffects = 0;        // EFFECT_SAVE_* (flash writes on a device)
+  unsigned long linkDrops = 0;
+  unsigned long keepAliveHits = 0;      // Requests sent on an open connection
+  unsigned long keepAliveMisses = 0;    // Requests that needed a TCP handshake
+  unsigned long staleRetries = 0;       // Reused connections found dead and retried
+  unsigned long idleCloses = 0;         // Idle connections closed by the server
+  unsigned long snapshots = 0;          // Successful polls answered with a full schedule
+  unsigned long deltas = 0;             // ...with only the changed zones
+  unsigned long notModified = 0;        // ...with 304 Not Modified
+  unsigned long bodyBytes = 0;          // Response body bytes received on successful polls
+  unsigned long resyncs = 0;            // Deltas that didn't match the held version
+  std::vector<uint32_t> latenciesUs;    // Successful request latencies
+  std::vector<uint32_t> hitLatenciesUs; // ...of those, on a reused connection
+
+  unsigned long errorTotal() const {
+    unsigned long total = 0;
+    for (int i = 0; i < ERR_KIND_COUNT; i++) total += errors[i];
+    return total;
+  }
+};
+
+//----------------------------------------------------------------------------//
+// Virtual Controller
+//----------------------------------------------------------------------------//
+
+enum HttpPhase {
+  HTTP_IDLE,
+  HTTP_CONNECTING,
+  HTTP_SENDING,
+  HTTP_RECEIVING
+};
+
+struct VirtualController {
+  unsigned id;
+  bool booted;
+  unsigned long bootAtMs;
+  unsigned long lastTickMs;
+
+  AppState state;                 // The real machine state
+
+  // Virtual radio: what wifiLinkStatus() would report
+  int radioStatus;
+  int radioPendingStatus;
+  unsigned long radioChangeAtMs;  // 0 = no transition pending
+  unsigned long nextDropAtMs;
+
+  // Result waiting to be read by readEvents(), like the network mailbox
+  bool hasNetworkInput;
+  Input networkInput;
+
+  // HTTP request in flight, or an idle keep-alive connection (phase HTTP_IDLE)
+  HttpPhase phase;
+  int fd;
+  bool reused;                    // Request went out on a kept-alive connection
+  unsigned long lastUsedMs;       // When the connection last finished a response
+  std::string request;
+  size_t sent;
+  std::string rx;
+  uint64_t startUs;
+  unsigned long deadlineMs;
+};
+
+class FleetSim {
+public:
+  FleetSim(const SimConfig& cfg) : config(cfg), rng(cfg.seed), epollFd(epoll_create1(0)) {}
+
+  bool resolveServer();
+  void run();
+  void printSummary(double elapsedS);
+
+private:
+  // Firmware loop emulation
+  void boot(VirtualController& c, unsigned long now);
+  void runLoop(VirtualController& c, unsigned long now);
+  Input readEvents(VirtualController& c, unsigned long now);
+  Input executeEffect(VirtualController& c, const Output& effect, unsigned long now);
+  void serviceRadio(VirtualController& c, unsigned long now);
+
+  // HTTP client
+  void startRequest(VirtualController& c, unsigned long now, bool retry = false);
+  bool connectionUsable(VirtualController& c, unsigned long now);
+  void retryStale(VirtualController& c);
+  void onSocketEvent(VirtualController& c, uint32_t events);
+  void trySend(VirtualController& c);
+  void tryReceive(VirtualController& c);
+  void completeRequest(VirtualController& c, bool reusable);
+  void keepOrClose(VirtualController& c, bool reusable);
+  void failRequest(VirtualController& c, HttpErrorKind kind);
+  void closeSocket(VirtualController& c);
+
+  void printProgress(unsigned long now, double intervalS);
+
+  unsigned long randomMs(double meanS) {
+    std::exponential_distribution<double> d(1.0 / meanS);
+    return (unsigned long)(d(rng) * 1000.0) + 1;
+  }
+  unsigned long uniformMs(unsigned long lo, unsigned long hi) {
+    std::uniform_int_distribution<unsigned long> d(lo, hi);
+    return d(rng);
+  }
+  bool chance(double p) {
+    std::uniform_real_distribution<double> d(0.0, 1.0);
+    return d(rng) < p;
+  }
+
+  SimConfig config;
+  std::mt19937 rng;
+  int epollFd;
+  sockaddr_in server;
+  std::vector<VirtualController> fleet;
+  SimStats stats;
+  unsigned long inFlight = 0;
+  unsigned long lastReportRequests = 0;
+};
+
+bool FleetSim::resolveServer() {
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons(config.port);
+  if (inet_pton(AF_INET, config.host.c_str(), &server.sin_addr) == 1) return true;
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  addrinfo* result = nullptr;
+  if (getaddrinfo(config.host.c_str(), nullptr, &hints, &result) != 0 || !result) {
+    fprintf(stderr, "fleet-sim: cannot resolve %s\n", config.host.c_str());
+    return false;
+  }
+  server.sin_addr = ((sockaddr_in*)result->ai_addr)->sin_addr;
+  freeaddrinfo(result);
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Firmware Loop Emulation
+//----------------------------------------------------------------------------//
+
+void FleetSim::boot(VirtualController& c, unsigned long now) {
+  c.booted = true;
+  c.lastTickMs = now;
+  c.state = AppState();
+
+  // Same as setup() with stored credentials: go straight to CONNECTING
+  Credentials creds;
+  snprintf(creds.ssid, sizeof(creds.ssid), "fleet-%u", c.id);
+  snprintf(creds.pass, sizeof(creds.pass), "password");
+  Input input = Input::credentialsEntered(creds);
+  input.nowMs = now;
+  c.state = transitionFunction(c.state, input);
+}
+
+void FleetSim::serviceRadio(VirtualController& c, unsigned long now) {
+  if (c.radioChangeAtMs != 0 && now >= c.radioChangeAtMs) {
+    c.radioStatus = c.radioPendingStatus;
+    c.radioChangeAtMs = 0;
+    if (c.radioStatus == WL_CONNECTED && config.dropMeanS > 0) {
+      c.nextDropAtMs = now + randomMs(config.dropMeanS);
+    }
+  }
+
+  if (config.dropMeanS > 0 && c.radioStatus == WL_CONNECTED && now >= c.nextDropAtMs) {
+    // Link lost; the radio reassociates on its own after the outage
+    stats.linkDrops++;
+    c.radioStatus = WL_CONNECTION_LOST;
+    c.radioPendingStatus = WL_CONNECTED;
+    c.radioChangeAtMs = now + randomMs(config.outageMeanS);
+    if (c.phase != HTTP_IDLE) {
+      failRequest(c, ERR_RESET);
+    } else {
+      closeSocket(c);  // A kept-alive socket doesn't survive the link either
+    }
+  }
+}
+
+// Mirrors readEvents(): network results, then WiFi status, then the tick timer
+Input FleetSim::readEvents(VirtualController& c, unsigned long now) {
+  if (c.hasNetworkInput) {
+    c.hasNetworkInput = false;
+    return c.networkInput;
+  }
+  if (c.radioStatus != c.state.wifiStatus) {
+    return Input::wifiStatusChanged(c.radioStatus);
+  }
+  if (now - c.lastTickMs >= TICK_MS) {
+    c.lastTickMs = now;
+    return Input::tick();
+  }
+  return Input::none();
+}
+
+// Mirrors executeEffect() with the virtual radio and the epoll HTTP client
+Input FleetSim::executeEffect(VirtualController& c, const Output& effect, unsigned long now) {
+  switch (effect.type) {
+    case EFFECT_START_WIFI_CONNECTION:
+      stats.connectAttempts++;
+      if (chance(config.connectFailP)) {
+        c.radioPendingStatus = WL_CONNECT_FAILED;
+      } else {
+        c.radioPendingStatus = WL_CONNECTED;
+      }
+      c.radioChangeAtMs = now + uniformMs(500, 3000);  // Scan + association
+      return Input::connectionStarted();
+
+    case EFFECT_SAVE_CREDENTIALS:
+      stats.saveEffects++;
+      return Input::credentialsSaved();
+
+    case EFFECT_SAVE_SCHEDULE:
+      stats.saveEffects++;
+      return Input::scheduleSaved();
+
+    case EFFECT_POLL_SCHEDULE:
+      if (c.radioStatus != WL_CONNECTED) {
+        stats.errors[ERR_NO_LINK]++;
+        closeSocket(c);
+        c.hasNetworkInput = true;
+        c.networkInput = Input::httpError();
+      } else if (c.phase == HTTP_IDLE) {
+        startRequest(c, now);
+      }
+      return Input::pollStarted();
+
+    default:
+      return Input::none();
+  }
+}
+
+void FleetSim::runLoop(VirtualController& c, unsigned long now) {
+  for (int i = 0; i < MAX_STEPS_PER_LOOP; i++) {
+    Input input = readEvents(c, now);
+    if (input.type != INPUT_NONE) {
+      input.nowMs = now;
+      c.state = transitionFunction(c.state, input);
+    }
+    Input followUp = executeEffect(c, outputFunction(c.state), now);
+    if (followUp.type != INPUT_NONE) {
+      followUp.nowMs = now;
+      c.state = transitionFunction(c.state, followUp);
+    }
+    if (input.type == INPUT_NONE && followUp.type == INPUT_NONE) break;
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Epoll HTTP Client
+//----------------------------------------------------------------------------//
+
+static uint64_t nowUs() {
+  return (uint64_t)micros();
+}
+
+// Same checks as sessionUsable() in HttpSession.cpp: still connected, not idle
+// too long, and nothing unsolicited waiting in the receive buffer
+bool FleetSim::connectionUsable(VirtualController& c, unsigned long now) {
+  if (!config.keepAlive || c.fd < 0) return false;
+  if (now - c.lastUsedMs >= http_keepalive_idle_ms) return false;
+  char byte;
+  ssize_t n = recv(c.fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void FleetSim::startRequest(VirtualController& c, unsigned long now, bool retry) {
+  if (!retry) {
+    stats.requests++;
+    c.startUs = nowUs();
+    c.deadlineMs = now + config.httpTimeoutMs;
+  }
+
+  // Same request ArduinoHttpClient sends for g_httpClient.get(path); with
+  // connectionKeepAlive() it simply omits the Connection header
+  char request[256];
+  snprintf(request, sizeof(request),
+           "GET /?since=%lu HTTP/1.1\r\nHost: %s\r\nUser-Agent: Arduino/2.2.0\r\n%s\r\n",
+           (unsigned long)c.state.schedule.seq, config.host.c_str(),
+           config.keepAlive ? "" : "Connection: close\r\n");
+  c.request = request;
+  c.sent = 0;
+  c.rx.clear();
+
+  c.reused = connectionUsable(c, now);
+  if (c.reused) {
+    stats.keepAliveHits++;
+    inFlight++;
+    c.phase = HTTP_SENDING;
+    trySend(c);
+    return;
+  }
+  closeSocket(c);
+  stats.keepAliveMisses++;
+
+  c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (c.fd < 0) {
+    failRequest(c, ERR_CONNECT);  // Out of descriptors
+    return;
+  }
+  int one = 1;
+  setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  inFlight++;
+
+  c.phase = HTTP_CONNECTING;
+  int rc = connect(c.fd, (sockaddr*)&server, sizeof(server));
+  if (rc < 0 && errno != EINPROGRESS) {
+    failRequest(c, ERR_CONNECT);
+    return;
+  }
+  epoll_event ev;
+  ev.events = EPOLLOUT;
+  ev.data.ptr = &c;
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, c.fd, &ev);
+}
+
+void FleetSim::closeSocket(VirtualController& c) {
+  if (c.fd >= 0) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    c.fd = -1;
+  }
+  if (c.phase != HTTP_IDLE) inFlight--;
+  c.phase = HTTP_IDLE;
+}
+
+// The server dropped a kept-alive connection under the request; retry once on
+// a fresh connection, like httpSessionGet()
+void FleetSim::retryStale(VirtualController& c) {
+  stats.staleRetries++;
+  stats.keepAliveHits--;
+  closeSocket(c);
+  startRequest(c, millis(), true);
+}
+
+void FleetSim::failRequest(VirtualController& c, HttpErrorKind kind) {
+  stats.errors[kind]++;
+  closeSocket(c);
+  c.hasNetworkInput = true;
+  c.networkInput = Input::httpError();
+}
+
+void FleetSim::trySend(VirtualController& c) {
+  while (c.sent < c.request.size()) {
+    ssize_t n = send(c.fd, c.request.data() + c.sent, c.request.size() - c.sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      c.sent += n;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      epoll_event ev;
+      ev.events = EPOLLOUT;
+      ev.data.ptr = &c;
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+      return;  // Wait for EPOLLOUT
+    } else if (c.reused) {
+      retryStale(c);
+      return;
+    } else {
+      failRequest(c, ERR_RESET);
+      return;
+    }
+  }
+  c.phase = HTTP_RECEIVING;
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = &c;
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+// Returns a pointer just past `key` (case-insensitive) in the head, or nullptr
+static const char* findHeader(const std::string& head, const char* key) {
+  size_t n = strlen(key);
+  for (size_t i = 0; i + n <= head.size(); i++) {
+    if (strncasecmp(head.c_str() + i, key, n) == 0) return head.c_str() + i + n;
+  }
+  return nullptr;
+}
+
+// Returns the Content-Length header value, or -1 if absent
+static long contentLength(const std::string& head) {
+  const char* value = findHeader(head, "\r\ncontent-length:");
+  return value ? strtol(value, nullptr, 10) : -1;
+}
+
+// Same hints parsePollHint() understands on the device
+static unsigned long pollHintMs(const std::string& head) {
+  const char* value = findHeader(head, "\r\nretry-after:");
+  if (value) return strtoul(value, nullptr, 10) * 1000UL;
+  value = findHeader(head, "max-age=");
+  if (value) return strtoul(value, nullptr, 10) * 1000UL;
+  return 0;
+}
+
+void FleetSim::tryReceive(VirtualController& c) {
+  char buf[4096];
+  while (true) {
+    ssize_t n = read(c.fd, buf, sizeof(buf));
+    if (n > 0) {
+      c.rx.append(buf, n);
+      continue;
+    }
+    if (n == 0 && c.reused && c.rx.empty()) {
+      retryStale(c);  // Closed before answering: the connection was stale
+      return;
+    }
+    if (n == 0) {
+      completeRequest(c, false);  // Server closed: response is complete
+      return;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+    if (c.reused && c.rx.empty()) {
+      retryStale(c);
+      return;
+    }
+    failRequest(c, ERR_RESET);
+    return;
+  }
+
+  // Don't wait for close if the body length is already satisfied (a 304
+  // never has a body)
+  size_t headEnd = c.rx.find("\r\n\r\n");
+  if (headEnd != std::string::npos && c.rx.compare(9, 3, "304") == 0) {
+    completeRequest(c, true);
+  } else if (headEnd != std::string::npos) {
+    long length = contentLength(c.rx.substr(0, headEnd));
+    if (length >= 0 && c.rx.size() >= headEnd + 4 + (size_t)length) {
+      completeRequest(c, true);
+    }
+  }
+}
+
+void FleetSim::onSocketEvent(VirtualController& c, uint32_t events) {
+  switch (c.phase) {
+    case HTTP_CONNECTING: {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err != 0 || (events & EPOLLERR)) {
+        failRequest(c, ERR_CONNECT);
+        return;
+      }
+      c.phase = HTTP_SENDING;
+      trySend(c);
+      return;
+    }
+    case HTTP_SENDING:
+      trySend(c);
+      return;
+    case HTTP_RECEIVING:
+      tryReceive(c);
+      return;
+    case HTTP_IDLE:
+      // Kept-alive connection became readable: the server closed it
+      stats.idleCloses++;
+      closeSocket(c);
+      return;
+  }
+}
+
+// Finds "key": in the body and returns the offset of its value, or npos
+static size_t findValue(const std::string& body, const char* key) {
+  size_t at = body.find(key);
+  if (at == std::string::npos) return std::string::npos;
+  return body.find_first_not_of(" \t\r\n:", at + strlen(key));
+}
+
+// Same rules as parseScheduleJson(): an object; "seq" versions it, "base"
+// makes it a delta; a snapshot's missing zones are off, a delta's unchanged
+static bool parsePatch(const std::string& body, SchedulePatch* patch) {
+  size_t first = body.find_first_not_of(" \t\r\n");
+  size_t last = body.find_last_not_of(" \t\r\n");
+  if (first == std::string::npos || body[first] != '{' || body[last] != '}') return false;
+
+  size_t seq = findValue(body, "\"seq\"");
+  size_t base = findValue(body, "\"base\"");
+  if (base != std::string::npos && seq == std::string::npos) return false;
+  patch->seq = seq != std::string::npos ? (uint32_t)strtoul(body.c_str() + seq, nullptr, 10) : 0;
+  patch->full = base == std::string::npos;
+  patch->baseSeq = patch->full ? 0 : (uint32_t)strtoul(body.c_str() + base, nullptr, 10);
+  patch->changedMask = patch->full ? 0x07 : 0;
+  patch->valueMask = 0;
+
+  for (int i = 0; i < 3; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "\"zone%d\"", i + 1);
+    size_t value = findValue(body, key);
+    if (value == std::string::npos) continue;
+    patch->changedMask |= 1 << i;
+    if (body.compare(value, 4, "true") == 0) {
+      patch->valueMask |= 1 << i;
+    } else if (body.compare(value, 5, "false") != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Mirrors httpSessionEnd(): park the connection for the next poll unless the
+// server asked to close it
+void FleetSim::keepOrClose(VirtualController& c, bool reusable) {
+  if (!config.keepAlive || !reusable) {
+    closeSocket(c);
+    return;
+  }
+  inFlight--;
+  c.phase = HTTP_IDLE;
+  c.lastUsedMs = millis();
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = &c;
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void FleetSim::completeRequest(VirtualController& c, bool reusable) {
+  uint32_t latency = (uint32_t)(nowUs() - c.startUs);
+  int status = 0;
+  size_t headEnd = c.rx.find("\r\n\r\n");
+  std::string head = c.rx.substr(0, headEnd);
+  unsigned long hint = pollHintMs(head);
+  if (findHeader(head, "\r\nconnection: close")) reusable = false;
+  if (sscanf(c.rx.c_str(), "HTTP/1.%*d %d", &status) != 1 || (status != 200 && status != 304)) {
+    stats.errors[ERR_STATUS]++;
+    keepOrClose(c, reusable);
+    c.hasNetworkInput = true;
+    c.networkInput = Input::httpError(hint);
+    return;
+  }
+  SchedulePatch patch;
+  if (status == 304) {
+    patch.seq = c.state.schedule.seq;  // Same empty delta pollIrrigationSchedule() makes
+    patch.baseSeq = c.state.schedule.seq;
+    stats.notModified++;
+  } else if (headEnd == std::string::npos || !parsePatch(c.rx.substr(headEnd + 4), &patch)) {
+    failRequest(c, ERR_PARSE);
+    return;
+  } else {
+    stats.bodyBytes += c.rx.size() - (headEnd + 4);
+    if (patch.full) {
+      stats.snapshots++;
+    } else {
+      stats.deltas++;
+    }
+  }
+  IrrigationSchedule patched;
+  if (!patch.applyTo(c.state.schedule, &patched)) stats.resyncs++;
+  stats.successes++;
+  stats.latenciesUs.push_back(latency);
+  if (c.reused) stats.hitLatenciesUs.push_back(latency);
+  keepOrClose(c, reusable);
+  c.hasNetworkInput = true;
+  c.networkInput = Input::schedulePatch(patch, hint);
+}
+
+//----------------------------------------------------------------------------//
+// Main Loop
+//----------------------------------------------------------------------------//
+
+void FleetSim::printProgress(unsigned long now, double intervalS) {
+  unsigned long connected = 0;
+  for (const VirtualController& c : fleet) {
+    if (c.booted && c.state.mode == MODE_CONNECTED) connected++;
+  }
+  unsigned long requests = stats.requests - lastReportRequests;
+  lastReportRequests = stats.requests;
+  printf("[%6.1fs] %7.1f req/s  in-flight %5lu  connected %5lu/%lu  ok %lu  errors %lu\n",
+         now / 1000.0, requests / intervalS, inFlight, connected, (unsigned long)fleet.size(),
+         stats.successes, stats.errorTotal());
+  fflush(stdout);
+}
+
+void FleetSim::run() {
+  unsigned long start = millis();
+  unsigned long end = start + (unsigned long)(config.durationS * 1000);
+  unsigned long reportEvery = (unsigned long)(config.reportS * 1000);
+  unsigned long nextReport = start + reportEvery;
+
+  fleet.resize(config.controllers);
+  for (unsigned i = 0; i < fleet.size(); i++) {
+    VirtualController& c = fleet[i];
+    c.id = i;
+    c.booted = false;
+    c.bootAtMs = start + (config.rampS > 0 ? uniformMs(0, (unsigned long)(config.rampS * 1000)) : 0);
+    c.radioStatus = WL_IDLE_STATUS;
+    c.radioPendingStatus = WL_IDLE_STATUS;
+    c.radioChangeAtMs = 0;
+    c.nextDropAtMs = 0;
+    c.hasNetworkInput = false;
+    c.phase = HTTP_IDLE;
+    c.fd = -1;
+    c.reused = false;
+    c.lastUsedMs = 0;
+  }
+
+  std::vector<epoll_event> events(1024);
+  unsigned long now = start;
+  while (now < end) {
+    int n = epoll_wait(epollFd, events.data(), (int)events.size(), 10);
+    for (int i = 0; i < n; i++) {
+      onSocketEvent(*static_cast<VirtualController*>(events[i].data.ptr), events[i].events);
+    }
+
+    now = millis();
+    for (VirtualController& c : fleet) {
+      if (!c.booted) {
+        if (now < c.bootAtMs) continue;
+        boot(c, now);
+      }
+      serviceRadio(c, now);
+      if (c.phase != HTTP_IDLE && now >= c.deadlineMs) {
+        failRequest(c, ERR_TIMEOUT);
+      }
+      if (c.hasNetworkInput || c.radioStatus != c.state.wifiStatus || now - c.lastTickMs >= TICK_MS) {
+        runLoop(c, now);
+      }
+    }
+
+    if (now >= nextReport) {
+      printProgress(now - start, config.reportS);
+      nextReport += reportEvery;
+    }
+  }
+
+  for (VirtualController& c : fleet) closeSocket(c);
+}
+
+static double percentileMs(std::vector<uint32_t>& samples, double p) {
+  if (samples.empty()) return 0.0;
+  size_t index = (size_t)(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index] / 1000.0;
+}
+
+void FleetSim::printSummary(double elapsedS) {
+  unsigned long modes[5] = {0};
+  for (const VirtualController& c : fleet) {
+    if (c.booted) modes[c.state.mode]++;
+  }
+  unsigned long attempts = stats.requests + stats.errors[ERR_NO_LINK];
+
+  printf("\n=== Fleet Summary ===\n");
+  printf("controllers      %lu over %.0f s\n", (unsigned long)fleet.size(), elapsedS);
+  printf("requests         %lu (%.1f req/s)\n", stats.requests, stats.requests / elapsedS);
+  printf("successes        %lu\n", stats.successes);
+  printf("errors           %lu (%.2f%% of %lu polls)\n", stats.errorTotal(),
+         attempts ? 100.0 * stats.errorTotal() / attempts : 0.0, attempts);
+  for (int i = 0; i < ERR_KIND_COUNT; i++) {
+    if (stats.errors[i]) printf("  %-14s %lu\n", ERROR_NAMES[i], stats.errors[i]);
+  }
+  printf("latency ms       p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+         percentileMs(stats.latenciesUs, 0.50), percentileMs(stats.latenciesUs, 0.90),
+         percentileMs(stats.latenciesUs, 0.99), percentileMs(stats.latenciesUs, 0.999),
+         percentileMs(stats.latenciesUs, 1.0));
+  printf("keep-alive       %lu hits, %lu misses (%.1f%% reuse), %lu stale retries, %lu idle closes\n",
+         stats.keepAliveHits, stats.keepAliveMisses,
+         stats.requests ? 100.0 * stats.keepAliveHits / stats.requests : 0.0,
+         stats.staleRetries, stats.idleCloses);
+  printf("reused p50 ms    %.2f (all requests %.2f)\n",
+         percentileMs(stats.hitLatenciesUs, 0.50), percentileMs(stats.latenciesUs, 0.50));
+  printf("responses        %lu snapshots, %lu deltas, %lu not modified, %lu resyncs\n",
+         stats.snapshots, stats.deltas, stats.notModified, stats.resyncs);
+  printf("body bytes       %lu (%.1f per successful poll)\n", stats.bodyBytes,
+         stats.successes ? (double)stats.bodyBytes / stats.successes : 0.0);
+  printf("connect attempts %lu, link drops %lu, save effects %lu\n",
+         stats.connectAttempts, stats.linkDrops, stats.saveEffects);
+  printf("final modes      initializing %lu  connecting %lu  connected %lu  disconnected %lu  credentials %lu\n",
+         modes[MODE_INITIALIZING], modes[MODE_CONNECTING], modes[MODE_CONNECTED],
+         modes[MODE_DISCONNECTED], modes[MODE_ENTERING_CREDENTIALS]);
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+static void raiseFileLimit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int main(int argc, char** argv) {
+  SimConfig config;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--local") == 0) {
+      config.local = true;
+      continue;
+    }
+    if (strcmp(arg, "--no-keep-alive") == 0) {
+      config.keepAlive = false;
+      continue;
+    }
+    if (strcmp(arg, "--no-delta") == 0) {
+      config.standInDelta = false;
+      continue;
+    }
+    if (!value) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 2;
+    }
+    i++;
+    if (strcmp(arg, "--controllers") == 0) config.controllers = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--duration") == 0) config.durationS = atof(value);
+    else if (strcmp(arg, "--ramp") == 0) config.rampS = atof(value);
+    else if (strcmp(arg, "--http-timeout-ms") == 0) config.httpTimeoutMs = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--drop-mean") == 0) config.dropMeanS = atof(value);
+    else if (strcmp(arg, "--outage-mean") == 0) config.outageMeanS = atof(value);
+    else if (strcmp(arg, "--connect-fail") == 0) config.connectFailP = atof(value);
+    else if (strcmp(arg, "--report") == 0) config.reportS = atof(value);
+    else if (strcmp(arg, "--max-age") == 0) config.standInMaxAgeS = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--idle-timeout") == 0) config.standInIdleTimeoutS = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--flip-every") == 0) config.standInFlipEveryS = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--seed") == 0) config.seed = (unsigned)strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--server") == 0) {
+      std::string server = value;
+      size_t colon = server.rfind(':');
+      config.host = server.substr(0, colon);
+      if (colon != std::string::npos) config.port = (uint16_t)atoi(server.c_str() + colon + 1);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      return 2;
+    }
+  }
+
+  raiseFileLimit();
+
+  // Optional in-process stand-in for the Servant endpoint
+  std::atomic<bool> stopStandIn(false);
+  StandInServer standIn;
+  std::thread standInThread;
+  if (config.local) {
+    StandInConfig standInConfig;
+    standInConfig.port = 0;
+    if (!config.standInDelta) {
+      standInConfig.body = "{\"zone1\":true,\"zone2\":false,\"zone3\":true}";
+    }
+    standInConfig.flipEveryS = config.standInFlipEveryS;
+    standInConfig.maxAgeS = config.standInMaxAgeS;
+    standInConfig.idleTimeoutS = config.standInIdleTimeoutS;
+    if (!standIn.start(standInConfig)) return 1;
+    config.host = "127.0.0.1";
+    config.port = standIn.port();
+    standInThread = std::thread([&]() { standIn.run(stopStandIn); });
+  }
+
+  FleetSim sim(config);
+  if (!sim.resolveServer()) return 1;
+
+  printf("fleet-sim: %lu controllers -> %s:%u for %.0f s (ramp %.0f s)%s\n",
+         config.controllers, config.host.c_str(), config.port, config.durationS, config.rampS,
+         config.local ? " [local stand-in]" : "");
+  fflush(stdout);
+
+  unsigned long start = millis();
+  sim.run();
+  sim.printSummary((millis() - start) / 1000.0);
+
+  if (config.local) {
+    stopStandIn.store(true);
+    standInThread.join();
+  }
+  return 0;
+}
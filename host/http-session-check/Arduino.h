@@ -0,0 +1,114 @@
+#ifndef HTTP_SESSION_CHECK_ARDUINO_H
+#define HTTP_SESSION_CHECK_ARDUINO_H
+
+/*
+ * The parts of the Arduino core ArduinoHttpClient builds on, over the shared
+ * host stand-in (host/shim/Arduino.h): String, Print, Stream and the helpers
+ * its sources call. Only this check puts them on the include path.
+ */
+
+#include_next <Arduino.h>
+
+#include <cstdlib>
+#include <string>
+
+inline bool isHexadecimalDigit(int c) {
+  return isxdigit(c) != 0;
+}
+
+template <typename A, typename B>
+inline auto min(const A& a, const B& b) -> decltype(a < b ? a : b) {
+  return a < b ? a : b;
+}
+
+//----------------------------------------------------------------------------//
+// String
+//----------------------------------------------------------------------------//
+
+class String {
+public:
+  String() : valid(true) {}
+  String(const char* text) : value(text != nullptr ? text : ""), valid(text != nullptr) {}
+  const char* c_str() const { return valid ? value.c_str() : nullptr; }
+  unsigned int length() const { return (unsigned int)value.size(); }
+  unsigned char reserve(unsigned int size) {
+    value.reserve(size);
+    return 1;
+  }
+  String& operator+=(char c) {
+    value += c;
+    return *this;
+  }
+  String& operator+=(const char* text) {
+    value += text;
+    return *this;
+  }
+  void concat(char c) { value += c; }
+  void concat(const char* text) { value += text; }
+  bool operator==(const char* text) const { return valid && value == text; }
+
+private:
+  std::string value;
+  bool valid;                   // String(nullptr) - the core's failed allocation
+};
+
+//----------------------------------------------------------------------------//
+// Print and Stream
+//----------------------------------------------------------------------------//
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size-- > 0 && write(*buffer++) == 1) n++;
+    return n;
+  }
+  size_t write(const char* text) { return text != nullptr ? write((const uint8_t*)text, strlen(text)) : 0; }
+
+  size_t print(const char* text) { return write(text); }
+  size_t print(const String& text) { return write(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), base == HEX ? "%lx" : "%ld", value);
+    return write(text);
+  }
+  size_t print(unsigned long value, int base = DEC) {
+    char text[24];
+    snprintf(text, sizeof(text), base == HEX ? "%lx" : "%lu", value);
+    return write(text);
+  }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(const T& value) { return print(value) + println(); }
+  template <typename T> size_t println(const T& value, int base) { return print(value, base) + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+  void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+
+protected:
+  int timedRead() {
+    unsigned long start = millis();
+    do {
+      int c = read();
+      if (c >= 0) return c;
+    } while (millis() - start < timeoutMs);
+    return -1;
+  }
+
+  unsigned long timeoutMs = 1000;
+};
+
+#include "IPAddress.h"
+
+#endif // HTTP_SESSION_CHECK_ARDUINO_H
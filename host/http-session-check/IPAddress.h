@@ -0,0 +1,19 @@
+#ifndef HTTP_SESSION_CHECK_IPADDRESS_H
+#define HTTP_SESSION_CHECK_IPADDRESS_H
+
+#include "Arduino.h"
+
+// The core's IPv4 address, as far as ArduinoHttpClient and the session use it
+class IPAddress {
+public:
+  IPAddress() : bytes{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+  uint8_t operator[](int index) const { return bytes[index]; }
+  uint8_t* raw_address() { return bytes; }
+  bool operator==(const IPAddress& other) const { return memcmp(bytes, other.bytes, 4) == 0; }
+
+private:
+  uint8_t bytes[4];
+};
+
+#endif // HTTP_SESSION_CHECK_IPADDRESS_H
@@ -0,0 +1,81 @@
+#ifndef HTTP_SESSION_CHECK_WIFI_H
+#define HTTP_SESSION_CHECK_WIFI_H
+
+/*
+ * A WiFiClient whose far end is a script: each complete request it is sent
+ * queues the next scripted response, on the same connection, as a
+ * keep-alive server would. The session (HttpSession.cpp) and HttpClient
+ * drive it exactly as they drive the board's socket.
+ */
+
+#include_next <WiFi.h>
+
+#include "Client.h"
+
+#include <string>
+#include <vector>
+
+class WiFiClient : public Client {
+public:
+  std::vector<std::string> responses;  // Answers, in order, one per request
+  std::vector<std::string> requests;   // Requests received, head only
+  unsigned long addressConnects = 0;   // connect() to the cached address
+  unsigned long hostnameConnects = 0;  // connect() by name (HttpClient's own DNS path)
+
+  int connect(IPAddress, uint16_t) override {
+    addressConnects++;
+    return open();
+  }
+  int connect(const char*, uint16_t) override {
+    hostnameConnects++;
+    return open();
+  }
+
+  size_t write(uint8_t byte) override { return write(&byte, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (!isOpen) return 0;
+    pendingRequest.append((const char*)buffer, size);
+    size_t end;
+    while ((end = pendingRequest.find("\r\n\r\n")) != std::string::npos) {
+      requests.push_back(pendingRequest.substr(0, end + 4));
+      pendingRequest.erase(0, end + 4);
+      if (next < responses.size()) rx += responses[next++];
+    }
+    return size;
+  }
+
+  int available() override { return isOpen ? (int)(rx.size() - rxPos) : 0; }
+  int read() override { return available() > 0 ? (uint8_t)rx[rxPos++] : -1; }
+  int read(uint8_t* buffer, size_t size) override {
+    size_t n = (size_t)available() < size ? (size_t)available() : size;
+    if (n == 0) return -1;
+    memcpy(buffer, rx.data() + rxPos, n);
+    rxPos += n;
+    return (int)n;
+  }
+  int peek() override { return available() > 0 ? (uint8_t)rx[rxPos] : -1; }
+  void flush() override {}
+  void stop() override {
+    isOpen = false;
+    rx.clear();
+    rxPos = 0;
+    pendingRequest.clear();
+  }
+  uint8_t connected() override { return isOpen; }
+  operator bool() override { return isOpen; }
+
+private:
+  int open() {
+    stop();
+    isOpen = true;
+    return 1;
+  }
+
+  bool isOpen = false;
+  std::string rx;
+  size_t rxPos = 0;
+  std::string pendingRequest;
+  size_t next = 0;
+};
+
+#endif // HTTP_SESSION_CHECK_WIFI_H
@@ -0,0 +1,188 @@
+/*
+ * Keep-Alive Session Check (against the real ArduinoHttpClient)
+ *
+ * Builds HttpSession.cpp with ArduinoHttpClient's own sources (the version
+ * flake.nix pins) over a scripted socket (WiFi.h here), and sends several
+ * requests down one connection, reading each response the way
+ * readHeaderLine() and readResponseBody() do. Fails unless
+ *
+ *   - every response after the first is read whole: its body is all there
+ *     and endOfBodyReached() isn't true before it has been read, whatever
+ *     the previous response was (longer, shorter, a bodiless 304),
+ *   - the connection is opened once, to the cached address, and reused.
+ *
+ * Chunked bodies aren't covered: endOfBodyReached() never turns true for
+ * one, so the session never keeps a connection past it.
+ *
+ * It also reports whether the library on its own (no reset before
+ * beginRequest()) carries one response's body counts into the next - the
+ * reason HttpSession.cpp resets it.
+ *
+ * Needs ARDUINO_HTTP_CLIENT_SRC (the library's src/ directory): run through
+ * `just host-http-session-check`.
+ *
+ * Usage: http-session-check
+ */
+
+#include "HttpSession.h"
+#include "ServerResolver.h"
+#include <ArduinoHttpClient.h>
+#include <WiFi.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+WiFiClient g_wifiClient;
+HttpClient g_httpClient(g_wifiClient, server_hostname, server_port);
+
+static int g_failures = 0;
+
+static void check(bool ok, const char* what, const std::string& detail = "") {
+  if (!ok) {
+    g_failures++;
+    printf("FAIL: %s%s%s\n", what, detail.empty() ? "" : " - ", detail.c_str());
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Resolver Stand-In
+//----------------------------------------------------------------------------//
+
+bool serverAddress(IPAddress* address) {
+  *address = IPAddress(127, 0, 0, 1);
+  return true;
+}
+
+void invalidateServerAddress() {}
+
+//----------------------------------------------------------------------------//
+// Responses
+//----------------------------------------------------------------------------//
+
+static std::string response(int status, const std::string& body) {
+  char head[128];
+  snprintf(head, sizeof(head), "HTTP/1.1 %d OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+           status, body.size());
+  return head + body;
+}
+
+static const std::string NOT_MODIFIED = "HTTP/1.1 304 Not Modified\r\nCache-Control: max-age=30\r\n\r\n";
+
+static const std::string LONG_BODY = "{\"seq\":7,\"zone1\":true,\"zone2\":false,\"zone3\":true}";
+static const std::string SHORT_BODY = "{\"seq\":8,\"base\":7,\"zone2\":true}";
+
+//----------------------------------------------------------------------------//
+// Reading (as pollIrrigationSchedule() does)
+//----------------------------------------------------------------------------//
+
+struct Read {
+  int status;
+  std::string body;
+  bool endBeforeBody;           // endOfBodyReached() before any body byte
+  bool complete;                // Body read to its end
+};
+
+static Read getOnSession(HttpClient& client, bool throughSession) {
+  Read result = {0, "", false, false};
+  if (throughSession) {
+    result.status = httpSessionGet("/?since=7");
+  } else {
+    // The library alone, as the session called it before the reset
+    client.connectionKeepAlive();
+    client.beginRequest();
+    client.get("/?since=7");
+    client.endRequest();
+    result.status = client.responseStatusCode();
+  }
+  if (result.status < 0) {
+    return result;
+  }
+  unsigned long start = millis();
+  while (!client.endOfHeadersReached() && millis() - start < 1000) {
+    if (client.available()) client.readHeader();
+  }
+  result.endBeforeBody = client.endOfBodyReached();
+  start = millis();
+  while (!client.endOfBodyReached() && millis() - start < 1000) {
+    if (client.available()) {
+      int c = client.read();
+      if (c >= 0) result.body += (char)c;
+    } else if (result.status == 304) {
+      break;  // No body, and no length to say so
+    }
+  }
+  result.complete = client.endOfBodyReached() || result.status == 304;
+  if (throughSession) {
+    httpSessionEnd(result.complete);
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------//
+// Checks
+//----------------------------------------------------------------------------//
+
+struct Exchange {
+  std::string response;
+  int status;
+  std::string body;
+};
+
+static void checkSequence(const char* name, const std::vector<Exchange>& exchanges) {
+  g_wifiClient.stop();
+  g_wifiClient = WiFiClient();
+  httpSessionClose();
+  for (const Exchange& exchange : exchanges) g_wifiClient.responses.push_back(exchange.response);
+
+  unsigned long hitsBefore = httpSessionStats().keepAliveHits;
+  for (size_t i = 0; i < exchanges.size(); i++) {
+    Read read = getOnSession(g_httpClient, true);
+    std::string where = std::string(name) + ", response " + std::to_string(i + 1);
+    check(read.status == exchanges[i].status, "wrong status", where + ": " + std::to_string(read.status));
+    check(read.body == exchanges[i].body, "body not read whole", where + ": \"" + read.body + "\"");
+    if (!exchanges[i].body.empty()) {
+      check(!read.endBeforeBody, "body reported ended before it was read", where);
+    }
+  }
+  check(g_wifiClient.addressConnects == 1, "connection not reused", name);
+  check(g_wifiClient.hostnameConnects == 0, "HttpClient connected by hostname", name);
+  check(httpSessionStats().keepAliveHits - hitsBefore == exchanges.size() - 1, "keep-alive hits don't add up", name);
+  printf("  %-28s %zu requests on %lu connection(s)\n", name, exchanges.size(), g_wifiClient.addressConnects);
+}
+
+// The library on its own: does a second response on the socket start with
+// the first one's body count?
+static bool libraryCarriesState() {
+  WiFiClient socket;
+  HttpClient client(socket, server_hostname, server_port);
+  socket.responses.push_back(response(200, LONG_BODY));
+  socket.responses.push_back(response(200, SHORT_BODY));
+  socket.connect(IPAddress(127, 0, 0, 1), server_port);
+  getOnSession(client, false);
+  Read second = getOnSession(client, false);
+  return second.endBeforeBody || second.body != SHORT_BODY;
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+int main() {
+  printf("http-session-check: requests sharing one keep-alive connection\n");
+  checkSequence("long then short", {{response(200, LONG_BODY), 200, LONG_BODY},
+                                    {response(200, SHORT_BODY), 200, SHORT_BODY}});
+  checkSequence("short then long", {{response(200, SHORT_BODY), 200, SHORT_BODY},
+                                    {response(200, LONG_BODY), 200, LONG_BODY}});
+  checkSequence("body, 304, body", {{response(200, LONG_BODY), 200, LONG_BODY},
+                                    {NOT_MODIFIED, 304, ""},
+                                    {response(200, SHORT_BODY), 200, SHORT_BODY}});
+  checkSequence("304, then body", {{NOT_MODIFIED, 304, ""},
+                                   {response(200, LONG_BODY), 200, LONG_BODY},
+                                   {NOT_MODIFIED, 304, ""}});
+
+  printf("library alone carries the last response's body state: %s\n",
+         libraryCarriesState() ? "yes (the session resets it)" : "no");
+  printf("%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+/*
+ * Streaming Inflate Check and Benchmark
+ *
+ * Compresses schedule-shaped JSON bodies (and incompressible noise) with
+ * the system zlib in every format the server or a proxy might send - gzip,
+ * zlib and bare DEFLATE, at each level and strategy, with the 1 KB window
+ * the controller decodes - and checks that the controller's Inflater
+ * (Inflate.h) gives back exactly the original. It also checks that the
+ * decoder never accepts a damaged stream:
+ *
+ *   - every truncation of a stream fails,
+ *   - a corrupted stream fails or decodes to the original, never to
+ *     anything else (the CRC-32/Adler-32 trailer catches the rest),
+ *   - a stream compressed with a window larger than 1 KB is refused,
+ *   - a decompression bomb stops at the output limit.
+ *
+ * Then reports, per body size, the compression ratio with the 1 KB window
+ * (and what zlib's default 32 KB window would have saved on top) and the
+ * decode cost per byte and per body.
+ *
+ * Usage: inflate-check [options]
+ *   --iterations N   Decodes per benchmark body (default 2000)
+ *   --corruptions N  Random corruptions per stream (default 200)
+ *   --seed N         RNG seed (default 1)
+ */
+
+#include "Inflate.h"
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+typedef std::vector<uint8_t> Bytes;
+
+struct CheckConfig {
+  unsigned long iterations = 2000;
+  unsigned long corruptions = 200;
+  unsigned seed = 1;
+};
+
+static const uint32_t OUTPUT_LIMIT = 8192;  // As HTTP_INFLATE_LIMIT
+static const int WINDOW_BITS = 10;          // log2(INFLATE_WINDOW_SIZE)
+
+//----------------------------------------------------------------------------//
+// Sources and Bodies
+//----------------------------------------------------------------------------//
+
+class MemorySource : public InflateSource {
+public:
+  MemorySource(const Bytes& bytes, size_t length) : bytes(bytes), length(length), position(0) {}
+
+  int read() override { return position < length ? bytes[position++] : -1; }
+
+private:
+  const Bytes& bytes;
+  size_t length;
+  size_t position;
+};
+
+// A schedule response grown into per-zone programs, about `size` bytes
+static Bytes scheduleBody(size_t size, std::mt19937* rng) {
+  static const char* const DAYS[] = {"MTWTFSS", "MWF", "TTS", "SS", "MTWTF"};
+  std::string json = "{\"seq\":" + std::to_string((*rng)() % 100000) +
+                     ",\"zone1\":true,\"zone2\":false,\"zone3\":true";
+  if (size > json.size() + 1) {
+    json += ",\"programs\":[";
+    for (int i = 0; json.size() + 2 < size; i++) {
+      char program[160];
+      snprintf(program, sizeof(program),
+               "%s{\"zone\":%u,\"start\":\"%02u:%02u\",\"minutes\":%u,\"days\":\"%s\",\"skipIfWet\":%s}",
+               i == 0 ? "" : ",", (unsigned)((*rng)() % 3 + 1), (unsigned)((*rng)() % 24),
+               (unsigned)((*rng)() % 4 * 15), (unsigned)((*rng)() % 40 + 5), DAYS[(*rng)() % 5],
+               (*rng)() % 2 ? "true" : "false");
+      json += program;
+    }
+    json += "]";
+  }
+  json += "}";
+  return Bytes(json.begin(), json.end());
+}
+
+static Bytes noiseBody(size_t size, std::mt19937* rng) {
+  Bytes bytes(size);
+  for (uint8_t& byte : bytes) {
+    byte = (uint8_t)(*rng)();
+  }
+  return bytes;
+}
+
+//----------------------------------------------------------------------------//
+// zlib
+//----------------------------------------------------------------------------//
+
+static const char* formatName(InflateFormat format) {
+  switch (format) {
+    case INFLATE_RAW:  return "raw";
+    case INFLATE_ZLIB: return "zlib";
+    case INFLATE_GZIP: return "gzip";
+  }
+  return "?";
+}
+
+// deflateInit2's windowBits selects the wrapper: negative for raw, +16 for gzip
+static Bytes compress(const Bytes& body, InflateFormat format, int level, int strategy, int windowBits) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int bits = format == INFLATE_RAW ? -windowBits : format == INFLATE_GZIP ? windowBits + 16 : windowBits;
+  if (deflateInit2(&stream, level, Z_DEFLATED, bits, 8, strategy) != Z_OK) {
+    fprintf(stderr, "deflateInit2 failed\n");
+    exit(1);
+  }
+  Bytes out(deflateBound(&stream, body.size()) + 64);
+  stream.next_in = const_cast<Bytef*>(body.data());
+  stream.avail_in = (uInt)body.size();
+  stream.next_out = out.data();
+  stream.avail_out = (uInt)out.size();
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+    fprintf(stderr, "deflate failed\n");
+    exit(1);
+  }
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+//----------------------------------------------------------------------------//
+// Decoding
+//----------------------------------------------------------------------------//
+
+struct Decoded {
+  bool ok;                     // Stream ended cleanly with a good trailer
+  InflateError error;
+  Bytes output;
+};
+
+static Decoded decode(const Bytes& stream, size_t length, InflateFormat format, uint32_t limit = OUTPUT_LIMIT) {
+  MemorySource source(stream, length);
+  static Inflater inflater;  // 1.7 KB, as the firmware's is static
+  inflateBegin(&inflater, &source, format, limit);
+  Decoded decoded;
+  for (int c; (c = inflateRead(&inflater)) >= 0;) {
+    decoded.output.push_back((uint8_t)c);
+  }
+  decoded.ok = inflateFinish(&inflater);
+  decoded.error = inflater.error;
+  return decoded;
+}
+
+static bool checkRoundTrip(const Bytes& body, const Bytes& stream, InflateFormat format, const char* what) {
+  Decoded decoded = decode(stream, stream.size(), format);
+  if (!decoded.ok || decoded.output != body) {
+    printf("FAIL: %s %s: %s, %zu of %zu bytes\n", formatName(format), what,
+           inflateErrorName(decoded.error), decoded.output.size(), body.size());
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Checks
+//----------------------------------------------------------------------------//
+
+static int runChecks(const CheckConfig& config, const std::vector<Bytes>& bodies, std::mt19937* rng) {
+  static const InflateFormat FORMATS[] = {INFLATE_GZIP, INFLATE_ZLIB, INFLATE_RAW};
+  static const int LEVELS[] = {0, 1, 6, 9};
+  static const int STRATEGIES[] = {Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED};
+  static const char* const STRATEGY_NAMES[] = {"default", "filtered", "huffman", "rle", "fixed"};
+  unsigned long streams = 0, truncations = 0, corruptions = 0, caught = 0;
+  int failures = 0;
+
+  for (const Bytes& body : bodies) {
+    for (InflateFormat format : FORMATS) {
+      for (int level : LEVELS) {
+        for (int s = 0; s < 5; s++) {
+          for (int windowBits = 9; windowBits <= WINDOW_BITS; windowBits++) {
+            Bytes stream = compress(body, format, level, STRATEGIES[s], windowBits);
+            char what[96];
+            snprintf(what, sizeof(what), "%zu-byte body, level %d, %s, windowBits %d", body.size(), level,
+                     STRATEGY_NAMES[s], windowBits);
+            streams++;
+            if (!checkRoundTrip(body, stream, format, what)) {
+              failures++;
+              continue;
+            }
+            if (level != 9 || windowBits != WINDOW_BITS) {
+              continue;
+            }
+
+            // Damage: every truncation must fail; a flipped byte must fail
+            // or (rarely, in a field nobody checks) change nothing. Bare
+            // DEFLATE has no trailer to catch a flip, so it only gets the
+            // truncations.
+            for (size_t length = 0; length < stream.size(); length++) {
+              truncations++;
+              if (decode(stream, length, format).ok) {
+                printf("FAIL: %s %s: accepted truncation to %zu bytes\n", formatName(format), what, length);
+                failures++;
+                break;
+              }
+            }
+            for (unsigned long i = 0; format != INFLATE_RAW && i < config.corruptions; i++) {
+              Bytes damaged = stream;
+              damaged[(*rng)() % damaged.size()] ^= (uint8_t)((*rng)() % 255 + 1);
+              Decoded decoded = decode(damaged, damaged.size(), format);
+              corruptions++;
+              if (!decoded.ok) {
+                caught++;
+              } else if (decoded.output != body) {
+                printf("FAIL: %s %s: accepted a corrupted stream\n", formatName(format), what);
+                failures++;
+                break;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  printf("Round trips: %lu streams, %lu truncations refused, %lu/%lu corruptions caught\n", streams,
+         truncations, caught, corruptions);
+
+  // Bare DEFLATE mislabelled "deflate" is refused: accepting it would mean
+  // accepting a zlib stream with a damaged header, unchecked
+  const Bytes& largest = bodies.back();
+  Bytes bare = compress(largest, INFLATE_RAW, 9, Z_DEFAULT_STRATEGY, WINDOW_BITS);
+  if (decode(bare, bare.size(), INFLATE_ZLIB).ok) {
+    printf("FAIL: accepted bare DEFLATE as zlib\n");
+    failures++;
+  }
+
+  // A 32 KB window reaches past ours: refused, never decoded wrongly. The
+  // body repeats at a 3 KB distance so zlib has to use long matches.
+  Bytes far = noiseBody(3000, rng);
+  far.insert(far.end(), far.begin(), far.end());
+  for (InflateFormat format : FORMATS) {
+    Bytes stream = compress(far, format, 9, Z_DEFAULT_STRATEGY, 15);
+    Decoded decoded = decode(stream, stream.size(), format, 0);
+    if (decoded.ok || decoded.error != INFLATE_FAR_DISTANCE) {
+      printf("FAIL: %s with a 32 KB window: %s\n", formatName(format), inflateErrorName(decoded.error));
+      failures++;
+    }
+  }
+
+  // A megabyte of zeros compresses to about a kilobyte
+  Bytes bomb(1 << 20, 0);
+  for (InflateFormat format : FORMATS) {
+    Bytes stream = compress(bomb, format, 9, Z_DEFAULT_STRATEGY, WINDOW_BITS);
+    Decoded decoded = decode(stream, stream.size(), format);
+    if (decoded.ok || decoded.error != INFLATE_TOO_LONG || decoded.output.size() != OUTPUT_LIMIT) {
+      printf("FAIL: %s bomb: %s after %zu bytes\n", formatName(format), inflateErrorName(decoded.error),
+             decoded.output.size());
+      failures++;
+    }
+  }
+  printf("Refused: 32 KB windows, decompression bombs past %u bytes\n", (unsigned)OUTPUT_LIMIT);
+  return failures;
+}
+
+//----------------------------------------------------------------------------//
+// Benchmark
+//----------------------------------------------------------------------------//
+
+static void runBenchmark(const CheckConfig& config, const std::vector<Bytes>& bodies) {
+  printf("\n%8s %8s %7s %11s %9s %10s\n", "body", "gzip", "ratio", "32KB ratio", "ns/byte", "us/body");
+  for (const Bytes& body : bodies) {
+    Bytes stream = compress(body, INFLATE_GZIP, 9, Z_DEFAULT_STRATEGY, WINDOW_BITS);
+    Bytes wide = compress(body, INFLATE_GZIP, 9, Z_DEFAULT_STRATEGY, 15);
+
+    static Inflater inflater;
+    unsigned long sink = 0;
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < config.iterations; i++) {
+      MemorySource source(stream, stream.size());
+      inflateBegin(&inflater, &source, INFLATE_GZIP, OUTPUT_LIMIT);
+      for (int c; (c = inflateRead(&inflater)) >= 0;) {
+        sink += c;
+      }
+      sink += inflateFinish(&inflater);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / config.iterations;
+    if (sink == 0) {
+      printf("(no output)\n");
+    }
+    printf("%8zu %8zu %6.2fx %10.2fx %9.1f %10.2f\n", body.size(), stream.size(),
+           (double)body.size() / stream.size(), (double)body.size() / wide.size(), ns / body.size(), ns / 1000);
+  }
+}
+
+int main(int argc, char** argv) {
+  CheckConfig config;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--iterations") == 0) {
+      config.iterations = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--corruptions") == 0) {
+      config.corruptions = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      config.seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (config.iterations == 0) {
+    fprintf(stderr, "--iterations must be at least 1\n");
+    return 2;
+  }
+
+  std::mt19937 rng(config.seed);
+  std::vector<Bytes> bodies;
+  for (size_t size : {45, 256, 1024, 2048, 6144}) {
+    bodies.push_back(scheduleBody(size, &rng));
+  }
+  bodies.push_back(noiseBody(1500, &rng));  // Stored blocks
+
+  int failures = runChecks(config, bodies, &rng);
+  bodies.pop_back();
+  runBenchmark(config, bodies);
+  printf("\n%s\n", failures == 0 ? "PASS" : "FAIL");
+  return failures == 0 ? 0 : 1;
+}
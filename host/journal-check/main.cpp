@@ -0,0 +1,312 @@
+/*
+ * Event Journal Power-Loss Check and Benchmark
+ *
+ * Drives the controller's event journal (EventJournal.h) over a RAM flash
+ * region that enforces NOR rules (erase by sector, program only erased
+ * bytes) and cuts the power at random flash operations: a program that
+ * lands only partway, with one byte half-programmed, or an erase that
+ * stops partway through the sector. After every cut the journal is opened
+ * again as at boot and read back in full, and the check fails unless
+ *
+ *   - records come back in sequence order with no gaps,
+ *   - every record the journal reported flushed is still there (unless the
+ *     ring has since wrapped past it), with the contents it was given,
+ *   - opening read no more than the sector headers plus one sector.
+ *
+ * Reports erase counts per sector (wear spread), flash programs per event
+ * and the time to open a full journal.
+ *
+ * Usage: journal-check [options]
+ *   --events N           Events to append (default 200000)
+ *   --sectors N          4 KB sectors in the region (default 64)
+ *   --program-size N     Flash program unit in bytes (default 1, QSPI NOR)
+ *   --power-loss-every N Cut the power at about every Nth flash operation
+ *                        (default 300, 0 = never)
+ *   --seed N             RNG seed (default 1)
+ */
+
+#include "EventJournal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+//----------------------------------------------------------------------------//
+// RAM Flash Region
+//----------------------------------------------------------------------------//
+
+static const uint32_t SECTOR_SIZE = 4096;  // QSPI NOR erase unit
+
+class RamRegion : public JournalRegion {
+public:
+  RamRegion(uint32_t sectors, uint32_t programUnit, std::mt19937* rng)
+      : bytes(sectors * SECTOR_SIZE, 0x00), erasesPerSector(sectors, 0), programUnit(programUnit),
+        rng(rng), cutAt(0), operations(0), programs(0), reads(0), cuts(0), powerOn(true) {}
+
+  uint32_t size() const override { return (uint32_t)bytes.size(); }
+  uint32_t sectorSize() const override { return SECTOR_SIZE; }
+  uint32_t programSize() const override { return programUnit; }
+
+  bool erase(uint32_t offset, uint32_t length) override {
+    if (!powerOn || offset % SECTOR_SIZE != 0 || length % SECTOR_SIZE != 0 || offset + length > size()) {
+      return false;
+    }
+    erasesPerSector[offset / SECTOR_SIZE]++;
+    if (cutNow()) {
+      // Stopped partway: the start of the sector is blank, the rest isn't
+      uint32_t done = (*rng)() % length;
+      memset(&bytes[offset], 0xFF, done);
+      return false;
+    }
+    memset(&bytes[offset], 0xFF, length);
+    return true;
+  }
+
+  bool program(uint32_t offset, const void* data, uint32_t length) override {
+    if (!powerOn || offset % programUnit != 0 || length % programUnit != 0 || offset + length > size()) {
+      return false;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+      if (bytes[offset + i] != 0xFF) {
+        fprintf(stderr, "journal-check: program over unerased byte at %u\n", offset + i);
+        exit(1);
+      }
+    }
+    programs++;
+    const uint8_t* source = (const uint8_t*)data;
+    if (cutNow()) {
+      // Landed partway, with the byte at the cut only partly programmed
+      uint32_t landed = (*rng)() % length;
+      memcpy(&bytes[offset], source, landed);
+      bytes[offset + landed] = source[landed] | (uint8_t)((*rng)() | 0x01);
+      return false;
+    }
+    memcpy(&bytes[offset], source, length);
+    return true;
+  }
+
+  bool read(uint32_t offset, void* data, uint32_t length) override {
+    if (!powerOn || offset + length > size()) {
+      return false;
+    }
+    reads++;
+    memcpy(data, &bytes[offset], length);
+    return true;
+  }
+
+  // Power comes back: the journal must be opened again
+  void restore() { powerOn = true; }
+
+  std::vector<uint8_t> bytes;
+  std::vector<unsigned long> erasesPerSector;
+  uint32_t programUnit;
+  std::mt19937* rng;
+  unsigned long cutAt;        // Operation count to cut the power at, 0 = never
+  unsigned long operations;
+  unsigned long programs;
+  unsigned long reads;
+  unsigned long cuts;
+  bool powerOn;
+
+private:
+  bool cutNow() {
+    operations++;
+    if (cutAt == 0 || operations < cutAt) {
+      return false;
+    }
+    cuts++;
+    cutAt = 0;
+    powerOn = false;  // Nothing else reaches flash until the next open
+    return true;
+  }
+};
+
+//----------------------------------------------------------------------------//
+// Check
+//----------------------------------------------------------------------------//
+
+struct CheckConfig {
+  unsigned long events = 200000;
+  unsigned long sectors = 64;
+  unsigned long programSize = 1;
+  unsigned long powerLossEvery = 300;
+  unsigned seed = 1;
+};
+
+struct Expected {
+  uint8_t type;
+  uint32_t time;
+  uint8_t subject;
+  int16_t value;
+};
+
+static const uint64_t FLUSH_AGE_MS = 60000;  // journal_flush_ms
+
+static EventJournal g_journal;
+
+static void scheduleCut(RamRegion* region, const CheckConfig& config, std::mt19937* rng) {
+  if (config.powerLossEvery > 0) {
+    region->cutAt = region->operations + 1 + (*rng)() % (2 * config.powerLossEvery);
+  }
+}
+
+// Reads the whole journal back and checks it against what was appended.
+// `durable` is the newest sequence the journal reported flushed.
+static bool verifyJournal(const std::map<uint32_t, Expected>& appended, uint32_t durable,
+                          unsigned long* recordsRead) {
+  JournalCursor cursor;
+  JournalRecord record;
+  journalBeginRead(g_journal, &cursor);
+  uint32_t first = 0;
+  uint32_t last = 0;
+  unsigned long count = 0;
+  while (journalNext(&g_journal, &cursor, &record)) {
+    if (count > 0 && record.sequence != last + 1) {
+      fprintf(stderr, "journal-check: sequence %u follows %u\n", record.sequence, last);
+      return false;
+    }
+    auto it = appended.find(record.sequence);
+    if (it == appended.end() || it->second.type != record.type || it->second.time != record.time ||
+        it->second.subject != record.subject || it->second.value != record.value) {
+      fprintf(stderr, "journal-check: record %u doesn't match what was appended\n", record.sequence);
+      return false;
+    }
+    if (count == 0) {
+      first = record.sequence;
+    }
+    last = record.sequence;
+    count++;
+  }
+  if (durable > 0 && (count == 0 || last < durable || first > durable)) {
+    fprintf(stderr, "journal-check: flushed record %u lost (read %u-%u)\n", durable, first, last);
+    return false;
+  }
+  *recordsRead = count;
+  return true;
+}
+
+static int runCheck(const CheckConfig& config) {
+  std::mt19937 rng(config.seed);
+  RamRegion region((uint32_t)config.sectors, (uint32_t)config.programSize, &rng);
+  std::map<uint32_t, Expected> appended;
+  uint32_t durable = 0;
+  uint64_t now = 0;
+  unsigned long maxRecoveryReads = 0;
+  unsigned long damaged = 0;
+  unsigned long dropped = 0;
+  unsigned long flushes = 0;
+  unsigned long recordsRead = 0;
+  const unsigned long readBound = config.sectors + SECTOR_SIZE / JOURNAL_PAGE_SIZE;
+
+  if (!journalOpen(&g_journal, &region)) {
+    fprintf(stderr, "journal-check: region geometry rejected\n");
+    return 1;
+  }
+  scheduleCut(&region, config, &rng);
+
+  Clock::time_point start = Clock::now();
+  for (unsigned long i = 0; i < config.events; i++) {
+    Expected event;
+    event.type = (uint8_t)(JOURNAL_BOOT + rng() % 7) | (rng() % 4 == 0 ? JOURNAL_UPTIME : 0);
+    event.time = (uint32_t)(1700000000 + i);
+    event.subject = (uint8_t)(rng() % 3);
+    event.value = (int16_t)(rng() % 600 - 100);
+    uint32_t sequence = g_journal.nextSequence;
+    now += rng() % 20000;  // Events up to 20 s apart
+    if (journalAppend(&g_journal, event.type, event.time, event.subject, event.value, now)) {
+      appended[sequence] = event;
+    }
+    // Full pages, and partial ones after a minute, as serviceEventLog() does
+    if (region.powerOn && journalFlushDue(g_journal, now, FLUSH_AGE_MS) && journalFlush(&g_journal)) {
+      durable = g_journal.nextSequence - 1;
+    }
+
+    if (!region.powerOn) {
+      // Boot again: whatever was pending is gone
+      dropped += g_journal.stats.dropped;
+      flushes += g_journal.stats.flushes;
+      region.restore();
+      unsigned long readsBefore = region.reads;
+      if (!journalOpen(&g_journal, &region)) {
+        fprintf(stderr, "journal-check: reopen failed\n");
+        return 1;
+      }
+      damaged += g_journal.stats.damaged;
+      unsigned long reads = region.reads - readsBefore;
+      maxRecoveryReads = std::max(maxRecoveryReads, reads);
+      if (reads > readBound) {
+        fprintf(stderr, "journal-check: opening took %lu reads (bound %lu)\n", reads, readBound);
+        return 1;
+      }
+      if (!verifyJournal(appended, durable, &recordsRead)) {
+        return 1;
+      }
+      // Sequences past the journal's end are reused from here on
+      appended.erase(appended.lower_bound(g_journal.nextSequence), appended.end());
+      scheduleCut(&region, config, &rng);
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  // A last flush and a clean open, timed
+  region.cutAt = 0;
+  journalFlush(&g_journal);
+  durable = g_journal.nextSequence - 1;
+  dropped += g_journal.stats.dropped;
+  flushes += g_journal.stats.flushes;
+  Clock::time_point openStart = Clock::now();
+  journalOpen(&g_journal, &region);
+  double openUs = std::chrono::duration<double, std::micro>(Clock::now() - openStart).count();
+  if (!verifyJournal(appended, durable, &recordsRead)) {
+    return 1;
+  }
+
+  unsigned long minErases = *std::min_element(region.erasesPerSector.begin(), region.erasesPerSector.end());
+  unsigned long maxErases = *std::max_element(region.erasesPerSector.begin(), region.erasesPerSector.end());
+  printf("Journal: %lu x %u B sectors, program unit %lu B, %lu events, seed %u\n",
+         config.sectors, SECTOR_SIZE, config.programSize, config.events, config.seed);
+  printf("  power cuts        %lu (reopened and verified each time)\n", region.cuts);
+  printf("  damaged slots     %lu found while opening\n", damaged);
+  printf("  dropped events    %lu\n", dropped);
+  printf("  batches           %lu, %.2f flash programs per event\n", flushes,
+         (double)region.programs / config.events);
+  printf("  sector erases     min %lu, max %lu per sector\n", minErases, maxErases);
+  printf("  recovery reads    at most %lu (bound %lu)\n", maxRecoveryReads, readBound);
+  printf("  open (full ring)  %.1f us, %lu records readable\n", openUs, recordsRead);
+  printf("  append rate       %.0f events/s (RAM flash)\n", config.events / seconds);
+  printf("PASS\n");
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  CheckConfig config;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--events") == 0) {
+      config.events = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--sectors") == 0) {
+      config.sectors = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--program-size") == 0) {
+      config.programSize = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--power-loss-every") == 0) {
+      config.powerLossEvery = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      config.seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (config.sectors < 2 || config.programSize == 0 || JOURNAL_PAGE_SIZE % config.programSize != 0) {
+    fprintf(stderr, "--sectors must be at least 2 and --program-size divide %u\n",
+            (unsigned)JOURNAL_PAGE_SIZE);
+    return 2;
+  }
+  return runCheck(config);
+}
@@ -0,0 +1,481 @@
+/*
+ * LAN Status/Override Server Check and Benchmark
+ *
+ * Drives the controller's LAN HTTP handler (LanHttp.h) and the override path
+ * through the Moore machine without a socket:
+ *
+ *   - every request is framed the same whether it arrives whole, split at
+ *     any byte, or a byte at a time; oversized headers are refused with 431
+ *     and never overrun the fixed buffer,
+ *   - routing, methods, `minutes` parsing, the max-override cap and bearer
+ *     token checks give the documented status codes - overrides refused
+ *     outright while no token is set - and each response's Content-Length
+ *     matches its body,
+ *   - the status page fits LAN_RESPONSE_CAPACITY even with every field at
+ *     its widest,
+ *   - an override posted as a NetworkEvent holds its zone open or closed
+ *     over the schedule, expires on time, outlives a stale schedule only
+ *     while it runs, and gives the output engine the matching deadline.
+ *
+ * Then reports the cost of framing and answering each kind of request.
+ *
+ * Usage: lan-check [--iterations N]
+ */
+
+#include "LanHttp.h"
+#include "StateMachine.h"
+#include "ZoneSequencer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static int g_failures = 0;
+
+static void check(bool ok, const char* what, const std::string& detail = "") {
+  if (!ok) {
+    g_failures++;
+    printf("FAIL: %s%s%s\n", what, detail.empty() ? "" : " - ", detail.c_str());
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Fake Controller
+//----------------------------------------------------------------------------//
+
+// Queues overrides as NetworkEvents, as postZoneOverride() does on the board
+class FakeControl : public LanControl {
+public:
+  bool published = true;
+  bool mailboxFull = false;
+  ControllerStatus status;
+  std::vector<NetworkEvent> events;
+
+  bool readStatus(ControllerStatus* out) override {
+    *out = status;
+    return published;
+  }
+
+  bool postOverride(uint8_t zone, ZoneOverrideAction action, unsigned long durationMs) override {
+    if (mailboxFull) {
+      return false;
+    }
+    NetworkEvent event;
+    event.type = NET_EVENT_ZONE_OVERRIDE;
+    event.pollHintMs = 0;
+    event.httpStatus = 0;
+    event.unixMs = 0;
+    event.overrideZone = zone;
+    event.overrideAction = action;
+    event.overrideMs = durationMs;
+    events.push_back(event);
+    return true;
+  }
+};
+
+static AppState connectedState(uint64_t now) {
+  AppState state;
+  Input input = Input::wifiStatusChanged(WL_CONNECTED);
+  input.nowMs = now;
+  state = transitionFunction(state, input);
+
+  IrrigationSchedule schedule;
+  schedule.zone1 = true;
+  schedule.seq = 7;
+  schedule.lastUpdate = now;
+  input = Input::scheduleReceived(schedule);
+  input.nowMs = now;
+  return transitionFunction(state, input);
+}
+
+//----------------------------------------------------------------------------//
+// Request Helpers
+//----------------------------------------------------------------------------//
+
+struct Reply {
+  LanFraming framing;
+  int status;
+  std::string text;
+  std::string body;
+};
+
+static Reply respond(const std::string& raw, FakeControl* control) {
+  static LanRequest request;
+  static LanResponse response;
+  lanRequestReset(&request);
+  Reply reply;
+  reply.framing = lanRequestAppend(&request, reinterpret_cast<const uint8_t*>(raw.data()), raw.size());
+  if (reply.framing == LAN_FRAMING_TOO_LARGE) {
+    lanErrorResponse(431, &response);
+  } else if (reply.framing == LAN_FRAMING_COMPLETE) {
+    lanHandleRequest(request, control, &response);
+  } else {
+    reply.status = 0;
+    return reply;
+  }
+  reply.status = response.status;
+  reply.text.assign(response.text, response.length);
+  size_t split = reply.text.find("\r\n\r\n");
+  reply.body = split == std::string::npos ? "" : reply.text.substr(split + 4);
+  return reply;
+}
+
+static std::string get(const std::string& target, const std::string& headers = "") {
+  return "GET " + target + " HTTP/1.1\r\nHost: controller\r\n" + headers + "\r\n";
+}
+
+// Overrides are off without a token, so the checks run with this one set
+static const char* CHECK_TOKEN = "s3cret";
+static const std::string CHECK_AUTH = "Authorization: Bearer s3cret\r\n";
+
+static std::string post(const std::string& target, const std::string& headers = CHECK_AUTH) {
+  return "POST " + target + " HTTP/1.1\r\nHost: controller\r\nContent-Length: 0\r\n" + headers + "\r\n";
+}
+
+// Bytes up to and including the blank line
+static size_t headersEnd(const std::string& raw) {
+  size_t crlf = raw.find("\r\n\r\n");
+  size_t lf = raw.find("\n\n");
+  crlf = crlf == std::string::npos ? crlf : crlf + 4;
+  lf = lf == std::string::npos ? lf : lf + 2;
+  return crlf < lf ? crlf : lf;
+}
+
+static void checkWellFormed(const Reply& reply, const std::string& what) {
+  char expected[32];
+  snprintf(expected, sizeof(expected), "Content-Length: %zu\r\n", reply.body.size());
+  check(reply.text.find(expected) != std::string::npos, "Content-Length matches body", what);
+  check(reply.text.find("Connection: close\r\n") != std::string::npos, "Connection: close sent", what);
+  check(reply.text.compare(0, 9, "HTTP/1.1 ") == 0, "status line", what);
+}
+
+//----------------------------------------------------------------------------//
+// Checks
+//----------------------------------------------------------------------------//
+
+static void checkFraming() {
+  FakeControl control;
+  control.status = controllerStatusOf(connectedState(1000), 2000);
+  std::vector<std::string> requests = {
+    get("/status"),
+    post("/zones/2/open?minutes=5", "Authorization: Bearer x\r\n"),
+    "GET /status HTTP/1.0\n\n",
+    post("/zones/1/close") + "ignored body bytes",
+  };
+
+  for (const std::string& raw : requests) {
+    Reply whole = respond(raw, &control);
+    check(whole.framing == LAN_FRAMING_COMPLETE, "whole request framed", raw);
+
+    // Split at every byte: the first part must never look complete early
+    for (size_t cut = 1; cut < raw.size(); cut++) {
+      LanRequest request;
+      lanRequestReset(&request);
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(raw.data());
+      LanFraming first = lanRequestAppend(&request, bytes, cut);
+      LanFraming second = lanRequestAppend(&request, bytes + cut, raw.size() - cut);
+      bool headersDone = headersEnd(raw) <= cut;
+      check(first == (headersDone ? LAN_FRAMING_COMPLETE : LAN_FRAMING_INCOMPLETE), "framing of first part",
+            raw.substr(0, cut));
+      check(second == LAN_FRAMING_COMPLETE, "framing after the rest");
+    }
+
+    LanRequest request;
+    lanRequestReset(&request);
+    LanFraming framing = LAN_FRAMING_INCOMPLETE;
+    for (char c : raw) {
+      uint8_t byte = (uint8_t)c;
+      framing = lanRequestAppend(&request, &byte, 1);
+    }
+    check(framing == LAN_FRAMING_COMPLETE, "byte-at-a-time framing", raw);
+    check(raw.compare(0, request.length, request.text) == 0 && request.length <= raw.size(),
+          "buffered bytes are the headers", raw);
+  }
+
+  // Headers bigger than the buffer, in one piece or trickled in
+  std::string huge = "GET /status HTTP/1.1\r\nCookie: " + std::string(LAN_REQUEST_CAPACITY, 'c') + "\r\n\r\n";
+  Reply reply = respond(huge, &control);
+  check(reply.framing == LAN_FRAMING_TOO_LARGE && reply.status == 431, "oversized headers get 431");
+  LanRequest request;
+  lanRequestReset(&request);
+  LanFraming framing = LAN_FRAMING_INCOMPLETE;
+  for (size_t i = 0; i < huge.size() && framing == LAN_FRAMING_INCOMPLETE; i++) {
+    framing = lanRequestAppend(&request, reinterpret_cast<const uint8_t*>(&huge[i]), 1);
+  }
+  check(framing == LAN_FRAMING_TOO_LARGE && request.length < LAN_REQUEST_CAPACITY, "trickled oversize stops at the buffer");
+}
+
+static void checkRoutes() {
+  struct Case {
+    std::string raw;
+    int status;
+    const char* what;
+  };
+  std::vector<Case> cases = {
+    {get("/status"), 200, "status"},
+    {get("/status?verbose=1"), 200, "status with a query"},
+    {post("/status"), 405, "status by POST"},
+    {get("/"), 404, "root"},
+    {get("/statusx"), 404, "near-miss path"},
+    {post("/zones/1/open"), 202, "open, default length"},
+    {post("/zones/3/close?minutes=15"), 202, "close for 15 minutes"},
+    {post("/zones/2/auto"), 202, "release"},
+    {post("/zones/2/auto?minutes=bad"), 202, "release ignores minutes"},
+    {post("/zones/0/open"), 404, "zone 0"},
+    {post("/zones/4/open"), 404, "zone past ZONE_COUNT"},
+    {post("/zones/01/open"), 202, "leading zero"},
+    {post("/zones/1/drain"), 404, "unknown action"},
+    {post("/zones/1/open/"), 404, "trailing slash"},
+    {post("/zones/1"), 404, "no action"},
+    {get("/zones/1/open"), 405, "open by GET"},
+    {post("/zones/1/open?minutes=0"), 400, "zero minutes"},
+    {post("/zones/1/open?minutes=-5"), 400, "negative minutes"},
+    {post("/zones/1/open?minutes="), 400, "empty minutes"},
+    {post("/zones/1/open?minutes=100000"), 400, "absurd minutes"},
+    {post("/zones/1/open?x=1&minutes=2"), 202, "minutes after another parameter"},
+    {"GARBAGE\r\n\r\n", 400, "no request line"},
+    {"GET status HTTP/1.1\r\n\r\n", 400, "relative target"},
+    {"GET /status\r\nHost: x HTTP/1.1\r\n\r\n", 400, "HTTP/0.9 style line"},
+  };
+
+  FakeControl control;
+  control.status = controllerStatusOf(connectedState(1000), 2000);
+  for (const Case& c : cases) {
+    Reply reply = respond(c.raw, &control);
+    check(reply.status == c.status, c.what, "got " + std::to_string(reply.status));
+    checkWellFormed(reply, c.what);
+  }
+  check(control.events.size() == 6, "one event per accepted override", std::to_string(control.events.size()));
+
+  // Default length, requested length, and the cap
+  control.events.clear();
+  respond(post("/zones/1/open"), &control);
+  respond(post("/zones/1/open?minutes=5"), &control);
+  Reply capped = respond(post("/zones/1/open?minutes=600"), &control);
+  check(control.events.size() == 3, "three overrides posted");
+  if (control.events.size() == 3) {
+    check(control.events[0].overrideMs == lan_override_default_ms, "default override length");
+    check(control.events[1].overrideMs == 300000 && control.events[1].overrideZone == 0 &&
+          control.events[1].overrideAction == OVERRIDE_OPEN, "5 minutes, zone 1 (index 0), open");
+    check(control.events[2].overrideMs == lan_override_max_ms, "override capped at the max");
+  }
+  char capBody[64];
+  snprintf(capBody, sizeof(capBody), "\"override_s\":%lu", lan_override_max_ms / 1000);
+  check(capped.body.find(capBody) != std::string::npos, "reply reports the capped length", capped.body);
+
+  // Nothing published yet, or the mailbox full
+  control.published = false;
+  check(respond(get("/status"), &control).status == 503, "status before the first publish");
+  control.mailboxFull = true;
+  Reply full = respond(post("/zones/1/open"), &control);
+  check(full.status == 503 && full.text.find("Retry-After: 1\r\n") != std::string::npos, "mailbox full");
+
+  // Bearer token: POSTs need it, GETs don't
+  control.published = true;
+  control.mailboxFull = false;
+  struct AuthCase {
+    std::string header;
+    int status;
+  };
+  std::vector<AuthCase> auth = {
+    {"", 401},
+    {"Authorization: Bearer s3cret\r\n", 202},
+    {"authorization: bearer s3cret  \r\n", 202},
+    {"Authorization: Bearer s3cre\r\n", 401},
+    {"Authorization: Bearer s3cretx\r\n", 401},
+    {"Authorization: Basic czNjcmV0\r\n", 401},
+    {"X-Authorization: Bearer s3cret\r\n", 401},
+  };
+  for (const AuthCase& c : auth) {
+    Reply reply = respond(post("/zones/1/open", c.header), &control);
+    check(reply.status == c.status, "bearer token", c.header + " got " + std::to_string(reply.status));
+    if (c.status == 401) {
+      check(reply.text.find("WWW-Authenticate: Bearer\r\n") != std::string::npos, "401 names the scheme");
+    }
+  }
+  check(respond(get("/status"), &control).status == 200, "status needs no token");
+
+  // No token set (the shipped default): every override refused, status still served
+  lan_http_token = "";
+  size_t posted = control.events.size();
+  for (const AuthCase& c : auth) {
+    Reply reply = respond(post("/zones/1/open", c.header), &control);
+    check(reply.status == 403, "override without a configured token", c.header + " got " + std::to_string(reply.status));
+  }
+  check(respond(post("/zones/1/open", "Authorization: Bearer \r\n"), &control).status == 403, "empty bearer, no token");
+  check(control.events.size() == posted, "refused overrides posted nothing");
+  check(respond(get("/status"), &control).status == 200, "status with no token");
+  lan_http_token = CHECK_TOKEN;
+}
+
+static void checkStatusPage() {
+  FakeControl control;
+  AppState state = connectedState(1000);
+  control.status = controllerStatusOf(state, 31000);
+  Reply reply = respond(get("/status"), &control);
+  check(reply.status == 200, "status page");
+  const char* fields[] = {
+    "\"mode\":\"connected\"", "\"uptime_s\":31", "\"seq\":7", "\"age_s\":30", "\"fail_safe\":false",
+    "{\"zone\":1,\"scheduled\":true,\"wet\":false,\"open\":true,\"waiting\":false,\"override\":null",
+    "\"moisture_permille\":null",
+  };
+  for (const char* field : fields) {
+    check(reply.body.find(field) != std::string::npos, "status field", field);
+  }
+
+  size_t typical = reply.text.size();
+
+  // Every number at its widest, every zone overridden, to size the buffer
+  ControllerStatus& wide = control.status;
+  wide.mode = MODE_ENTERING_CREDENTIALS;
+  wide.uptimeS = wide.scheduleSeq = wide.scheduleAgeS = 4294967295u;
+  wide.hasSchedule = wide.failSafeActive = wide.pollFailing = true;
+  wide.scheduledMask = wide.wetMask = wide.openMask = wide.waitingMask = 0xFF;
+  wide.overrideMask = 0xFF;
+  wide.overrideOpenMask = 0x00;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    wide.overrideLeftS[i] = 4294967295u;
+    wide.moisturePermille[i] = 1000;
+  }
+  reply = respond(get("/status"), &control);
+  check(reply.status == 200, "widest status page fits", std::to_string(reply.text.size()) + " bytes");
+  printf("status page: %zu bytes typical, %zu widest, of %zu\n", typical, reply.text.size(),
+         LAN_RESPONSE_CAPACITY);
+
+  int depth = 0;
+  bool balanced = true;
+  for (char c : reply.body) {
+    depth += (c == '{' || c == '[') - (c == '}' || c == ']');
+    balanced = balanced && depth >= 0;
+  }
+  check(balanced && depth == 0, "status JSON brackets balance", reply.body);
+}
+
+static AppState step(const AppState& state, Input input, uint64_t now) {
+  input.nowMs = now;
+  return transitionFunction(state, input);
+}
+
+static void checkOverrides() {
+  FakeControl control;
+  uint64_t now = 1000;
+  AppState state = connectedState(now);
+  check(state.zones.openMask == 0x01, "schedule opens zone 1");
+
+  // Close zone 1 and open zone 2 for ten minutes, through the mailbox mapping
+  control.status = controllerStatusOf(state, now);
+  respond(post("/zones/1/close?minutes=10"), &control);
+  respond(post("/zones/2/open?minutes=10"), &control);
+  for (const NetworkEvent& event : control.events) {
+    state = step(state, networkEventToInput(event), now);
+  }
+  check(state.zones.openMask == 0x02, "zone 1 held closed, zone 2 held open",
+        std::to_string(state.zones.openMask));
+
+  uint64_t closeBy[ZONE_COUNT];
+  openZoneDeadlines(state.zones, state.schedule.lastUpdate, state.overrides, closeBy);
+  check(closeBy[1] == now + 600000, "zone 2 deadline is its override's end");
+
+  ControllerStatus status = controllerStatusOf(state, now + 1000);
+  check(status.overrideMask == 0x03 && status.overrideOpenMask == 0x02 && status.overrideLeftS[1] == 599,
+        "status shows both overrides");
+
+  // The schedule goes stale: zone 2 stays open on its override alone
+  now += schedule_stale_ms + 1000;
+  state = step(state, Input::tick(), now);
+  check(state.failSafeActive && state.zones.openMask == 0x02, "held-open zone outlives a stale schedule");
+
+  // Overrides run out and the zones follow the (now closed) schedule
+  now = 1000 + 600000;
+  state = step(state, Input::tick(), now);
+  check(state.overrides.mask == 0 && state.zones.openMask == 0, "overrides expire on time",
+        std::to_string(state.overrides.mask) + "/" + std::to_string(state.zones.openMask));
+
+  // Released early, and an out-of-range zone is ignored by the machine
+  state = connectedState(now);
+  state = step(state, Input::zoneOverride(0, OVERRIDE_CLOSE, 60000), now);
+  check(state.zones.openMask == 0, "held closed");
+  state = step(state, Input::zoneOverride(0, OVERRIDE_RELEASE, 0), now + 10);
+  check(state.zones.openMask == 0x01 && state.overrides.mask == 0, "released back to the schedule");
+  AppState before = state;
+  state = step(state, Input::zoneOverride(ZONE_COUNT, OVERRIDE_OPEN, 60000), now + 20);
+  check(state.overrides.mask == before.overrides.mask, "out-of-range zone ignored");
+
+  // The machine caps a duration the HTTP side didn't (defence in depth)
+  state = step(state, Input::zoneOverride(2, OVERRIDE_OPEN, 0xFFFFFFFFUL), now + 30);
+  check(state.overrides.until[2] == now + 30 + lan_override_max_ms, "machine caps override length");
+}
+
+//----------------------------------------------------------------------------//
+// Benchmark
+//----------------------------------------------------------------------------//
+
+static void runBenchmark(unsigned long iterations) {
+  FakeControl control;
+  control.status = controllerStatusOf(connectedState(1000), 2000);
+  struct Bench {
+    const char* name;
+    std::string raw;
+  };
+  std::vector<Bench> benches = {
+    {"GET /status", get("/status", "User-Agent: curl/8.5.0\r\nAccept: */*\r\n")},
+    {"POST open", post("/zones/2/open?minutes=20", "User-Agent: curl/8.5.0\r\nAccept: */*\r\n" + CHECK_AUTH)},
+    {"404", get("/favicon.ico", "User-Agent: Mozilla/5.0\r\nAccept: image/*\r\n")},
+  };
+
+  printf("\n%-12s %8s %10s %10s\n", "request", "bytes", "frame ns", "answer ns");
+  static LanRequest request;
+  static LanResponse response;
+  for (const Bench& bench : benches) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(bench.raw.data());
+    size_t sink = 0;
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < iterations; i++) {
+      lanRequestReset(&request);
+      sink += lanRequestAppend(&request, bytes, bench.raw.size());
+    }
+    double frameNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+    start = Clock::now();
+    for (unsigned long i = 0; i < iterations; i++) {
+      control.events.clear();
+      lanHandleRequest(request, &control, &response);
+      sink += response.length;
+    }
+    double answerNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+    if (sink == 0) {
+      printf("(no output)\n");
+    }
+    printf("%-12s %8zu %10.0f %10.0f\n", bench.name, bench.raw.size(), frameNs, answerNs);
+  }
+}
+
+int main(int argc, char** argv) {
+  unsigned long iterations = 200000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--iterations") == 0) {
+      iterations = strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (iterations == 0) {
+    fprintf(stderr, "--iterations must be at least 1\n");
+    return 2;
+  }
+
+  lan_http_token = CHECK_TOKEN;
+  checkFraming();
+  checkRoutes();
+  checkStatusPage();
+  checkOverrides();
+  runBenchmark(iterations);
+  printf("\n%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/*
+ * Network Mailbox Host Benchmark
+ *
+ * Runs the controller's network mailbox protocol between two threads on Linux:
+ * a "control side" thread that posts requests and drains events exactly like
+ * executeEffect()/readEvents(), and a "network side" thread that services
+ * requests with a simulated network. Verifies that every poll gets exactly
+ * one event, in order, with its payload intact, and reports round-trip
+ * latency and pipelined throughput.
+ *
+ * Usage: mailbox-bench [--iterations N] [--work-us N]
+ *   --iterations  Number of polls per phase (default 200000)
+ *   --work-us     Simulated network work per request in microseconds (default 0)
+ *
+ * Exits non-zero if any protocol violation is detected.
+ */
+
+#include "NetworkMailbox.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+//----------------------------------------------------------------------------//
+// Simulated Network Core
+//----------------------------------------------------------------------------//
+
+static NetworkMailbox g_mailbox;
+static std::atomic<bool> g_stop(false);
+static std::atomic<unsigned long> g_connectRequests(0);
+
+// Every tenth poll fails so both event types cross the mailbox. The sequence
+// number rides in the patch so the control side can check ordering.
+static NetworkEvent simulatePoll(unsigned long sequence) {
+  NetworkEvent event;
+  event.pollHintMs = 0;
+  if (sequence % 10 == 9) {
+    event.type = NET_EVENT_HTTP_ERROR;
+  } else {
+    event.type = NET_EVENT_SCHEDULE_RECEIVED;
+    event.patch.full = true;
+    event.patch.changedMask = 0x07;
+    event.patch.valueMask = sequence & 0x07;
+  }
+  event.patch.seq = (uint32_t)sequence;
+  return event;
+}
+
+static void busyWaitMicros(unsigned long us) {
+  if (us == 0) return;
+  Clock::time_point until = Clock::now() + std::chrono::microseconds(us);
+  while (Clock::now() < until) {}
+}
+
+static void networkCore(unsigned long workMicros) {
+  unsigned long sequence = 0;
+  while (!g_stop.load(std::memory_order_relaxed)) {
+    NetworkRequest request;
+    if (!g_mailbox.requests.pop(&request)) {
+      std::this_thread::yield();  // Yield so 1-CPU hosts progress
+      continue;
+    }
+    busyWaitMicros(workMicros);
+    if (request.type == NET_REQUEST_CONNECT) {
+      g_connectRequests.fetch_add(1, std::memory_order_relaxed);
+      continue;  // Connect results arrive as WiFi status, not events
+    }
+    NetworkEvent event = simulatePoll(sequence++);
+    while (!g_mailbox.events.push(event)) {
+      if (g_stop.load(std::memory_order_relaxed)) return;
+      std::this_thread::yield();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Control Core
+//----------------------------------------------------------------------------//
+
+struct PhaseResult {
+  unsigned long polls;
+  unsigned long errors;       // Protocol violations
+  double seconds;
+  std::vector<uint32_t> latenciesNs;
+};
+
+static bool postPoll() {
+  NetworkRequest request;
+  request.type = NET_REQUEST_POLL_SCHEDULE;
+  request.networks.count = 0;
+  request.scheduleSeq = 0;
+  return g_mailbox.requests.push(request);
+}
+
+// Checks one drained event against the sequence the network side must have used
+static bool checkEvent(const NetworkEvent& event, unsigned long expected) {
+  NetworkEvent want = simulatePoll(expected);
+  Input input = networkEventToInput(event);
+  if (event.patch.seq != (uint32_t)expected) return false;
+  if (want.type == NET_EVENT_HTTP_ERROR) {
+    return input.type == INPUT_HTTP_ERROR;
+  }
+  return input.type == INPUT_SCHEDULE_PATCH &&
+         input.patch.full &&
+         input.patch.valueMask == want.patch.valueMask;
+}
+
+// One poll outstanding at a time: the cadence the controller actually uses
+static PhaseResult runRoundTrips(unsigned long iterations, unsigned long* sequence) {
+  PhaseResult result = {iterations, 0, 0.0, {}};
+  result.latenciesNs.reserve(iterations);
+  Clock::time_point start = Clock::now();
+  for (unsigned long i = 0; i < iterations; i++) {
+    Clock::time_point sent = Clock::now();
+    while (!postPoll()) std::this_thread::yield();
+    NetworkEvent event;
+    while (!g_mailbox.events.pop(&event)) std::this_thread::yield();
+    result.latenciesNs.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - sent).count());
+    if (!checkEvent(event, (*sequence)++)) result.errors++;
+  }
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+// Keep the request mailbox full to measure raw mailbox throughput
+static PhaseResult runPipelined(unsigned long iterations, unsigned long* sequence) {
+  PhaseResult result = {iterations, 0, 0.0, {}};
+  unsigned long posted = 0;
+  unsigned long received = 0;
+  Clock::time_point start = Clock::now();
+  while (received < iterations) {
+    while (posted < iterations && postPoll()) posted++;
+    NetworkEvent event;
+    bool drained = false;
+    while (g_mailbox.events.pop(&event)) {
+      if (!checkEvent(event, (*sequence)++)) result.errors++;
+      received++;
+      drained = true;
+    }
+    if (!drained) std::this_thread::yield();
+  }
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& samples, double p) {
+  if (samples.empty()) return 0;
+  size_t index = (size_t)(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+int main(int argc, char** argv) {
+  unsigned long iterations = 200000;
+  unsigned long workMicros = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--iterations") == 0) {
+      iterations = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--work-us") == 0) {
+      workMicros = strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::thread network(networkCore, workMicros);
+
+  // Connect requests produce no events; make sure they're consumed silently
+  NetworkRequest connect;
+  connect.type = NET_REQUEST_CONNECT;
+  strcpy(connect.networks.networks[0].ssid, "bench");
+  strcpy(connect.networks.networks[0].pass, "password");
+  connect.networks.count = 1;
+  connect.scheduleSeq = 0;
+  while (!g_mailbox.requests.push(connect)) std::this_thread::yield();
+
+  unsigned long sequence = 0;
+  PhaseResult roundTrip = runRoundTrips(iterations, &sequence);
+  PhaseResult pipelined = runPipelined(iterations, &sequence);
+
+  g_stop.store(true);
+  network.join();
+
+  unsigned long errors = roundTrip.errors + pipelined.errors;
+  if (g_connectRequests.load() != 1) errors++;
+  NetworkEvent stray;
+  if (g_mailbox.events.pop(&stray)) errors++;  // Nothing may be left over
+
+  printf("mailbox-bench: %lu polls per phase, %lu us simulated work\n", iterations, workMicros);
+  printf("  round-trip  %10.0f polls/s  p50 %6u ns  p99 %6u ns  max %6u ns\n",
+         roundTrip.polls / roundTrip.seconds,
+         percentile(roundTrip.latenciesNs, 0.50),
+         percentile(roundTrip.latenciesNs, 0.99),
+         percentile(roundTrip.latenciesNs, 1.00));
+  printf("  pipelined   %10.0f polls/s\n", pipelined.polls / pipelined.seconds);
+  printf("  protocol errors: %lu\n", errors);
+
+  return errors == 0 ? 0 : 1;
+}
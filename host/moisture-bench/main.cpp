@@ -0,0 +1,306 @@
+/*
+ * Soil Moisture Filter Benchmark
+ *
+ * Feeds a recorded sample file through the controller's moisture filters
+ * (controller/MoistureFilter.cpp) in DMA-buffer-sized blocks, exactly as
+ * MoistureSensor.cpp does on the board. Checks every filtered value against
+ * a straightforward reference (sort the median window, re-add the average
+ * window), reports filter throughput, then replays the recording at its
+ * real sample rate through the firmware's transitionFunction and prints
+ * when each zone would have been skipped as wet.
+ *
+ * Sample files hold raw 12-bit ADC readings as little-endian uint16,
+ * interleaved by zone (zone 1, zone 2, zone 3, zone 1, ...) - the layout of
+ * the ADC's DMA buffers, so a capture of those buffers replays directly.
+ *
+ * Usage: moisture-bench FILE [--repeat N]
+ *        moisture-bench --generate FILE [--seconds S] [--seed N]
+ *   --repeat    Passes over the file for the throughput run (default 20)
+ *   --generate  Write a synthetic recording: zone 1 stays dry, zone 2 is
+ *               watered and dries out again, zone 3 has no sensor connected;
+ *               all with noise, ripple and switching spikes
+ *   --seconds   Length of the synthetic recording (default 600)
+ *   --seed      RNG seed for --generate (default 1)
+ *
+ * Exits non-zero if the filters disagree with the reference.
+ */
+
+#include "MoistureFilter.h"
+#include "StateMachine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Frames per block, matching MOISTURE_DMA_FRAMES in MoistureSensor.cpp
+static const size_t BLOCK_FRAMES = 64;
+
+//----------------------------------------------------------------------------//
+// Sample Files
+//----------------------------------------------------------------------------//
+
+static bool readSamples(const char* path, std::vector<uint16_t>* samples) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+  uint16_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, sizeof(uint16_t), 4096, file)) > 0) {
+    samples->insert(samples->end(), chunk, chunk + n);
+  }
+  fclose(file);
+  samples->resize(samples->size() - samples->size() % ZONE_COUNT);  // Whole frames only
+  return true;
+}
+
+static bool generateSamples(const char* path, unsigned long seconds, unsigned long seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 25.0);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  unsigned long frames = seconds * moisture_sample_rate_hz;
+  double rippleHz = 11.0;  // Beats against the sample rate like sensor oscillator leakage
+
+  std::vector<uint16_t> samples;
+  samples.reserve(frames * ZONE_COUNT);
+  for (unsigned long f = 0; f < frames; f++) {
+    double t = (double)f / moisture_sample_rate_hz;
+    double phase = t / seconds;
+    double ripple = 40.0 * sin(2.0 * M_PI * rippleHz * t);
+
+    // Zone 2: watered through the first third, then dries back out
+    double wetness = phase < 0.33 ? phase / 0.33 : std::max(0.0, 1.0 - (phase - 0.33) / 0.5);
+    double level[ZONE_COUNT] = {
+      2850.0,                                           // Dry, steady
+      2900.0 - wetness * 1550.0,                        // Wetting then drying
+      4095.0                                            // Open input at the rail
+    };
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      double v = level[z] + ripple + noise(rng);
+      if (unit(rng) < 0.005) v = unit(rng) < 0.5 ? 0.0 : 4095.0;  // Valve switching spike
+      samples.push_back((uint16_t)std::min(4095.0, std::max(0.0, v)));
+    }
+  }
+
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+  fwrite(samples.data(), sizeof(uint16_t), samples.size(), file);
+  fclose(file);
+  printf("moisture-bench: wrote %lu s (%lu frames at %lu Hz) to %s\n",
+         seconds, frames, moisture_sample_rate_hz, path);
+  return true;
+}
+
+//----------------------------------------------------------------------------//
+// Reference Filter
+//----------------------------------------------------------------------------//
+
+// The obvious implementation: keep the windows, sort for the median and
+// re-add the whole average window for every sample
+struct ReferenceChannel {
+  std::vector<uint16_t> raw = std::vector<uint16_t>(MOISTURE_MEDIAN_TAPS, 0);
+  std::vector<uint16_t> medians = std::vector<uint16_t>(MOISTURE_AVERAGE_TAPS, 0);
+  size_t count = 0;
+
+  uint16_t push(uint16_t sample) {
+    raw[count % MOISTURE_MEDIAN_TAPS] = sample;
+    std::vector<uint16_t> sorted = raw;
+    std::sort(sorted.begin(), sorted.end());
+    medians[count % MOISTURE_AVERAGE_TAPS] = sorted[MOISTURE_MEDIAN_TAPS / 2];
+    count++;
+    uint32_t sum = 0;
+    for (uint16_t m : medians) sum += m;
+    return (uint16_t)(sum / MOISTURE_AVERAGE_TAPS);
+  }
+};
+
+static unsigned long checkAgainstReference(const std::vector<uint16_t>& samples) {
+  MoistureFilterBank bank;
+  moistureFilterReset(&bank);
+  ReferenceChannel reference[ZONE_COUNT];
+  unsigned long mismatches = 0;
+  size_t frames = samples.size() / ZONE_COUNT;
+  for (size_t f = 0; f < frames; f++) {
+    moistureFilterBlock(&bank, &samples[f * ZONE_COUNT], 1);
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      uint16_t want = reference[z].push(samples[f * ZONE_COUNT + z]);
+      if (bank.channels[z].averageSum / MOISTURE_AVERAGE_TAPS != want) mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+//----------------------------------------------------------------------------//
+// Throughput
+//----------------------------------------------------------------------------//
+
+// Results land here so the timed loops can't be optimized away
+static volatile uint32_t g_sink;
+
+static double timeFilters(const std::vector<uint16_t>& samples, unsigned long repeat) {
+  MoistureFilterBank bank;
+  moistureFilterReset(&bank);
+  size_t frames = samples.size() / ZONE_COUNT;
+  Clock::time_point start = Clock::now();
+  for (unsigned long r = 0; r < repeat; r++) {
+    for (size_t f = 0; f < frames; f += BLOCK_FRAMES) {
+      size_t n = std::min(BLOCK_FRAMES, frames - f);
+      moistureFilterBlock(&bank, &samples[f * ZONE_COUNT], n);
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  for (int z = 0; z < ZONE_COUNT; z++) g_sink = g_sink + bank.channels[z].averageSum;
+  return seconds;
+}
+
+static double timeReference(const std::vector<uint16_t>& samples) {
+  ReferenceChannel reference[ZONE_COUNT];
+  uint32_t sum = 0;
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < samples.size(); i++) {
+    sum += reference[i % ZONE_COUNT].push(samples[i]);
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  g_sink = g_sink + sum;
+  return seconds;
+}
+
+//----------------------------------------------------------------------------//
+// Replay Through the State Machine
+//----------------------------------------------------------------------------//
+
+static void printLevel(uint16_t permille) {
+  if (permille == MOISTURE_UNKNOWN) {
+    printf("    ?");
+  } else {
+    printf(" %4u", permille);
+  }
+}
+
+// Every zone requested, readings posted every moisture_report_ms of sample
+// time (inputs are stamped with sample time, so zone rotation and sensor
+// staleness play out as on the board); prints each change of the wet set
+// and the share of time each zone was skipped
+static void replay(const std::vector<uint16_t>& samples) {
+  const uint64_t startMs = 1;  // 0 would read as "never" in the state
+  AppState state;
+  IrrigationSchedule allOn;
+  allOn.zone1 = allOn.zone2 = allOn.zone3 = true;
+  allOn.lastUpdate = startMs;
+  Input received = Input::scheduleReceived(allOn);
+  received.nowMs = startMs;
+  state = transitionFunction(state, received);
+
+  MoistureFilterBank bank;
+  moistureFilterReset(&bank);
+  size_t frames = samples.size() / ZONE_COUNT;
+  size_t framesPerReport = moisture_sample_rate_hz * moisture_report_ms / 1000;
+  unsigned long skippedReports[ZONE_COUNT] = {0};
+  unsigned long reports = 0;
+
+  printf("  replay (all zones requested, reading every %lu ms):\n", moisture_report_ms);
+  for (size_t f = 0; f + framesPerReport <= frames; f += framesPerReport) {
+    moistureFilterBlock(&bank, &samples[f * ZONE_COUNT], framesPerReport);
+    uint16_t permille[ZONE_COUNT];
+    for (int z = 0; z < ZONE_COUNT; z++) permille[z] = moistureFilterPermille(bank, z);
+
+    uint8_t wasWet = state.moisture.wetMask;
+    Input reading = Input::moistureReading(permille);
+    reading.nowMs = startMs + (f + framesPerReport) * 1000 / moisture_sample_rate_hz;
+    state = transitionFunction(state, reading);
+    reports++;
+    for (int z = 0; z < ZONE_COUNT; z++) {
+      if (state.moisture.wetMask & (1 << z)) skippedReports[z]++;
+    }
+    if (state.moisture.wetMask != wasWet) {
+      printf("    t=%6.1fs  moisture", (double)(f + framesPerReport) / moisture_sample_rate_hz);
+      for (int z = 0; z < ZONE_COUNT; z++) printLevel(permille[z]);
+      printf("  wet=%d%d%d  open=%d%d%d\n",
+             (state.moisture.wetMask & 1) != 0, (state.moisture.wetMask & 2) != 0,
+             (state.moisture.wetMask & 4) != 0, (state.zones.openMask & 1) != 0,
+             (state.zones.openMask & 2) != 0, (state.zones.openMask & 4) != 0);
+    }
+  }
+  printf("  skipped as wet:");
+  for (int z = 0; z < ZONE_COUNT; z++) {
+    printf("  zone %d %5.1f%%", z + 1, reports ? 100.0 * skippedReports[z] / reports : 0.0);
+  }
+  printf("\n");
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  const char* generatePath = nullptr;
+  unsigned long repeat = 20;
+  unsigned long seconds = 600;
+  unsigned long seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+      generatePath = argv[++i];
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] != '-' && path == nullptr) {
+      path = argv[i];
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  if (generatePath != nullptr) {
+    return generateSamples(generatePath, seconds, seed) ? 0 : 1;
+  }
+  if (path == nullptr) {
+    fprintf(stderr, "Usage: moisture-bench FILE [--repeat N] | --generate FILE [--seconds S]\n");
+    return 2;
+  }
+
+  std::vector<uint16_t> samples;
+  if (!readSamples(path, &samples)) return 1;
+  size_t frames = samples.size() / ZONE_COUNT;
+  if (frames == 0) {
+    fprintf(stderr, "%s: no complete frames\n", path);
+    return 1;
+  }
+  printf("moisture-bench: %zu frames (%.1f s at %lu Hz) from %s\n",
+         frames, (double)frames / moisture_sample_rate_hz, moisture_sample_rate_hz, path);
+
+  unsigned long mismatches = checkAgainstReference(samples);
+
+  double filterSeconds = timeFilters(samples, repeat);
+  double referenceSeconds = timeReference(samples);
+  double filterRate = samples.size() * repeat / filterSeconds;
+  double referenceRate = samples.size() / referenceSeconds;
+  printf("  filters     %8.1f Msamples/s  (%5.1f ns/sample, %lu passes, blocks of %zu frames)\n",
+         filterRate / 1e6, 1e9 / filterRate, repeat, BLOCK_FRAMES);
+  printf("  reference   %8.1f Msamples/s  (%5.1f ns/sample)  speedup %.1fx\n",
+         referenceRate / 1e6, 1e9 / referenceRate, filterRate / referenceRate);
+  printf("  board load  %.4f%% of one core at %lu Hz x %d channels (host speed)\n",
+         100.0 * moisture_sample_rate_hz * ZONE_COUNT / filterRate,
+         moisture_sample_rate_hz, ZONE_COUNT);
+
+  replay(samples);
+
+  printf("  reference mismatches: %lu\n", mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
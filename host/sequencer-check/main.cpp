@@ -0,0 +1,216 @@
+/*
+ * Zone Sequencer Check
+ *
+ * Advances the zone queue (ZoneSequencer.h) through a day of requests at
+ * uneven intervals, the way the loop does, and checks that
+ *
+ *   - only requested zones open, never more than max_concurrent_zones, and
+ *     never more flow than supply_flow_lpm unless a zone runs alone,
+ *   - with a zone count limit alone, no slot stays free while a zone waits,
+ *   - with every zone requested all day, each gets a fair share of open
+ *     time and none waits longer than a round of turns - including a zone
+ *     whose flow only fits when it has the supply to itself,
+ *   - a turn ends exactly at the deadline openZoneDeadlines() gave the
+ *     output engine.
+ *
+ * The sequencer reads its limits from the extern configuration, so this
+ * check defines them itself: zones drawing 10, 10 and 25 L/min, two at a
+ * time, on a supply of SEQUENCER_CHECK_SUPPLY_LPM (0 = count zones only).
+ * `just host-sequencer-check` builds and runs it both ways.
+ *
+ * Usage: sequencer-check [--hours N] [--seed N]
+ */
+
+#include "ZoneSequencer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#ifndef SEQUENCER_CHECK_SUPPLY_LPM
+#define SEQUENCER_CHECK_SUPPLY_LPM 0
+#endif
+
+//----------------------------------------------------------------------------//
+// Configuration Under Test
+//----------------------------------------------------------------------------//
+
+const int max_concurrent_zones = 2;
+const unsigned long zone_rotation_ms = 900000;
+const unsigned int zone_flow_lpm[ZONE_COUNT] = {10, 10, 25};
+const unsigned int supply_flow_lpm = SEQUENCER_CHECK_SUPPLY_LPM;
+const unsigned long schedule_stale_ms = 300000;
+const bool stale_schedule_failsafe = false;
+
+static unsigned long g_failures = 0;
+
+static void fail(const char* what, uint64_t at) {
+  if (g_failures++ < 10) {
+    printf("FAIL: %s (at %.1f min)\n", what, at / 60000.0);
+  }
+}
+
+static int countZones(uint8_t mask) {
+  int count = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (mask & (1 << i)) count++;
+  }
+  return count;
+}
+
+static unsigned long flowOf(uint8_t mask) {
+  unsigned long flow = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    if (mask & (1 << i)) flow += zone_flow_lpm[i];
+  }
+  return flow;
+}
+
+//----------------------------------------------------------------------------//
+// Run
+//----------------------------------------------------------------------------//
+
+struct RunResult {
+  uint64_t openMs[ZONE_COUNT];      // Wall time each zone's valve was open
+  uint64_t longestWaitMs[ZONE_COUNT];
+};
+
+static void checkInvariants(const ZoneQueue& queue, uint64_t now) {
+  if (queue.openMask & ~queue.requestedMask) fail("a zone is open that wasn't requested", now);
+  int open = countZones(queue.openMask);
+  if (open > max_concurrent_zones) fail("more zones open than max_concurrent_zones", now);
+  if (supply_flow_lpm != 0 && open > 1 && flowOf(queue.openMask) > supply_flow_lpm) {
+    fail("open zones draw more than the supply", now);
+  }
+  if (supply_flow_lpm == 0 && queue.waitingMask() != 0 && open < max_concurrent_zones) {
+    fail("a slot is free while a zone waits", now);
+  }
+}
+
+/*
+ * Advance from 0 to `durationMs` in random steps of up to `maxStepMs`,
+ * taking requests from `requestAt` at each step
+ */
+template <typename Requests>
+static RunResult run(uint64_t durationMs, unsigned long maxStepMs, std::mt19937& rng, Requests requestAt) {
+  RunResult result;
+  uint64_t waitingFrom[ZONE_COUNT];
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    result.openMs[i] = 0;
+    result.longestWaitMs[i] = 0;
+    waitingFrom[i] = 0;
+  }
+  std::uniform_int_distribution<unsigned long> step(1, maxStepMs);
+  ZoneOverrides overrides;
+
+  uint64_t start = 1000;  // The monotonic clock starts at boot, not at 0
+  ZoneQueue queue = advanceZoneQueue(ZoneQueue(), requestAt(0), start);
+  uint64_t closeBy[ZONE_COUNT];
+  openZoneDeadlines(queue, 0, overrides, closeBy);
+  for (uint64_t now = start; now < start + durationMs;) {
+    uint64_t next = now + step(rng);
+    uint8_t requested = requestAt(next - start);
+    ZoneQueue advanced = advanceZoneQueue(queue, requested, next);
+
+    for (int i = 0; i < ZONE_COUNT; i++) {
+      uint8_t bit = 1 << i;
+      if (queue.openMask & bit) result.openMs[i] += next - now;
+      // Under unchanged requests, a turn given to the timer ends exactly at
+      // its deadline: not sooner, and not left running past it (a change of
+      // requests can rightly end it early)
+      bool sameRequests = requested == queue.requestedMask;
+      bool closed = (queue.openMask & bit) && !(advanced.openMask & bit);
+      bool sameTurn = (advanced.openMask & bit) && advanced.openedAt[i] == queue.openedAt[i];
+      if (closeBy[i] != 0 && sameRequests && closed && next < closeBy[i]) {
+        fail("a zone closed before its deadline", next);
+      }
+      if (closeBy[i] != 0 && sameRequests && (queue.openMask & bit) && sameTurn && next >= closeBy[i]) {
+        fail("a zone stayed open past its deadline", next);
+      }
+      // Continuous waits, while the zone stays requested
+      if ((advanced.waitingMask() & bit) && !(queue.waitingMask() & bit)) {
+        waitingFrom[i] = next;
+      }
+      if ((advanced.waitingMask() & bit) && (queue.waitingMask() & bit)) {
+        uint64_t waited = next - waitingFrom[i];
+        if (waited > result.longestWaitMs[i]) result.longestWaitMs[i] = waited;
+      }
+    }
+
+    queue = advanced;
+    now = next;
+    checkInvariants(queue, now);
+    openZoneDeadlines(queue, 0, overrides, closeBy);
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------//
+// Checks
+//----------------------------------------------------------------------------//
+
+static void checkAllDay(unsigned long hours, std::mt19937& rng) {
+  uint64_t durationMs = (uint64_t)hours * 3600000;
+  RunResult result = run(durationMs, 10000, rng, [](uint64_t) { return (uint8_t)0x07; });
+
+  uint64_t total = 0;
+  for (int i = 0; i < ZONE_COUNT; i++) total += result.openMs[i];
+  uint64_t fairShare = total / ZONE_COUNT;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    printf("  zone %d (%2u L/min): open %6.2f h, longest wait %5.1f min\n", i + 1, zone_flow_lpm[i],
+           result.openMs[i] / 3600000.0, result.longestWaitMs[i] / 60000.0);
+    // Within a couple of turns of an even split, and never starved
+    if (result.openMs[i] + 2 * zone_rotation_ms < fairShare) {
+      fail("a zone got less than its share of the day", durationMs);
+    }
+    if (result.longestWaitMs[i] > (uint64_t)ZONE_COUNT * zone_rotation_ms) {
+      fail("a zone waited longer than a round of turns", durationMs);
+    }
+  }
+}
+
+static void checkRandomRequests(unsigned long hours, std::mt19937& rng) {
+  // Requests change every few minutes; the invariants hold throughout
+  std::mt19937 requestRng(rng());
+  uint8_t requested = 0;
+  uint64_t nextChange = 0;
+  run((uint64_t)hours * 3600000, 30000, rng, [&](uint64_t at) {
+    while (at >= nextChange) {
+      requested = (uint8_t)(requestRng() & 0x07);
+      nextChange += 60000 + requestRng() % 1200000;
+    }
+    return requested;
+  });
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+int main(int argc, char** argv) {
+  unsigned long hours = 24;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--hours") == 0) {
+      hours = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  if (supply_flow_lpm == 0) {
+    printf("sequencer-check: %d zones at a time, no flow budget\n", max_concurrent_zones);
+  } else {
+    printf("sequencer-check: %d zones at a time, %u L/min supply\n", max_concurrent_zones, supply_flow_lpm);
+  }
+  printf("every zone requested for %lu h:\n", hours);
+  checkAllDay(hours, rng);
+  checkRandomRequests(hours, rng);
+  printf("%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
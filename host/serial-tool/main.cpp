@@ -0,0 +1,824 @@
+/*
+ * Serial Link Bench Tool
+ *
+ * Talks to a controller over its USB serial port with the binary frames of
+ * SerialFrame.h, alongside (and without disturbing) the console:
+ *
+ *   serial-tool PORT ping
+ *   serial-tool PORT state
+ *   serial-tool PORT counters
+ *   serial-tool PORT histogram [--reset]
+ *   serial-tool PORT networks [--connect] SSID PASS [SSID PASS ...]
+ *   serial-tool PORT journal [--from SEQ]      CSV on stdout
+ *   serial-tool PORT trace SECONDS             One line per machine step
+ *
+ * PORT is the board's ACM device (e.g. /dev/ttyACM0). Console text the board
+ * prints meanwhile is dropped, or copied to stderr with --console (given
+ * before PORT). Requests that go unanswered are sent again a few times.
+ *
+ *   serial-tool --check [--frames N]
+ *
+ * needs no board: it checks the codec that both ends share - frames of every
+ * size survive a byte stream mixed with console text, corrupted or
+ * truncated frames are never accepted and the reader is back in step at the
+ * next frame boundary, and the payload field codecs round-trip - then
+ * reports encode and decode throughput.
+ */
+
+#include "SerialFrame.h"
+#include "CredentialStore.h"
+#include "EventJournal.h"
+#include "Checksum.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static unsigned long nowMs() {
+  static const Clock::time_point start = Clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+//----------------------------------------------------------------------------//
+// Port
+//----------------------------------------------------------------------------//
+
+static const int REPLY_TIMEOUT_MS = 1000;
+static const int REQUEST_ATTEMPTS = 3;
+// Between stream frames; the board sends a few every loop() pass
+static const int STREAM_TIMEOUT_MS = 3000;
+
+class SerialPort {
+public:
+  SerialPort() : fd(-1), echoConsole(false), nextTag(1) { serialFrameReaderReset(&reader); }
+  ~SerialPort() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  bool open(const char* path) {
+    fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+      perror(path);
+      return false;
+    }
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+      perror("tcgetattr");
+      return false;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B115200);  // The board's USB CDC port ignores the rate
+    cfsetospeed(&tty, B115200);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+      perror("tcsetattr");
+      return false;
+    }
+    tcflush(fd, TCIFLUSH);
+    return true;
+  }
+
+  // Tag and send a request
+  void send(SerialFrame* frame) {
+    frame->tag = nextTag++;
+    if (nextTag == 0) {
+      nextTag = 1;
+    }
+    resend(*frame);
+  }
+
+  void resend(const SerialFrame& frame) {
+    uint8_t wire[SERIAL_WIRE_CAPACITY];
+    size_t length = serialFrameEncode(frame, wire);
+    size_t written = 0;
+    while (written < length) {
+      ssize_t n = write(fd, wire + written, length - written);
+      if (n < 0) {
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        poll(&pfd, 1, 100);
+        continue;
+      }
+      written += (size_t)n;
+    }
+  }
+
+  // Next frame with this tag, oldest first; others wait for their turn
+  bool receive(uint8_t tag, SerialFrame* frame, int timeoutMs) {
+    unsigned long deadline = nowMs() + timeoutMs;
+    while (true) {
+      for (size_t i = 0; i < received.size(); i++) {
+        if (received[i].tag == tag) {
+          *frame = received[i];
+          received.erase(received.begin() + i);
+          return true;
+        }
+      }
+      unsigned long now = nowMs();
+      if (now >= deadline) {
+        return false;
+      }
+      struct pollfd pfd = {fd, POLLIN, 0};
+      poll(&pfd, 1, (int)(deadline - now));
+      readAvailable();
+    }
+  }
+
+  int fd;
+  bool echoConsole;
+
+private:
+  void readAvailable() {
+    uint8_t buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+      for (ssize_t i = 0; i < n; i++) {
+        SerialByte kind = serialFrameFeed(&reader, buffer[i], nowMs());
+        if (kind == SERIAL_BYTE_CONSOLE && echoConsole) {
+          fputc(buffer[i], stderr);
+        } else if (kind == SERIAL_BYTE_FRAME_READY) {
+          received.push_back(reader.frame);
+        }
+      }
+    }
+  }
+
+  SerialFrameReader reader;
+  uint8_t nextTag;
+  std::vector<SerialFrame> received;
+};
+
+static const char* errorName(uint8_t error) {
+  switch (error) {
+    case SERIAL_ERROR_UNKNOWN_TYPE: return "request not supported by this firmware";
+    case SERIAL_ERROR_BAD_PAYLOAD: return "request rejected as malformed";
+    case SERIAL_ERROR_BUSY: return "a journal dump is already running";
+    case SERIAL_ERROR_UNAVAILABLE: return "event journal unavailable";
+    default: return "unknown error";
+  }
+}
+
+// Send a request and wait for its reply, asking again on silence
+static bool transact(SerialPort& port, SerialFrame* request, SerialFrame* reply) {
+  port.send(request);
+  uint8_t tag = request->tag;
+  for (int attempt = 1; attempt <= REQUEST_ATTEMPTS; attempt++) {
+    if (port.receive(tag, reply, REPLY_TIMEOUT_MS)) {
+      if (reply->type == SERIAL_ERROR) {
+        fprintf(stderr, "serial-tool: %s\n", errorName(reply->length > 0 ? reply->payload[0] : 0));
+        return false;
+      }
+      return true;
+    }
+    if (attempt < REQUEST_ATTEMPTS) {
+      port.resend(*request);
+    }
+  }
+  fprintf(stderr, "serial-tool: no reply from the board\n");
+  return false;
+}
+
+//----------------------------------------------------------------------------//
+// Commands
+//----------------------------------------------------------------------------//
+
+static const char* modeName(uint8_t mode) {
+  switch (mode) {
+    case MODE_INITIALIZING: return "initializing";
+    case MODE_CONNECTING: return "connecting";
+    case MODE_CONNECTED: return "connected";
+    case MODE_DISCONNECTED: return "disconnected";
+    case MODE_ENTERING_CREDENTIALS: return "entering credentials";
+    default: return "unknown";
+  }
+}
+
+static const char* journalTypeName(uint8_t type) {
+  switch (type & ~JOURNAL_UPTIME) {
+    case JOURNAL_BOOT: return "boot";
+    case JOURNAL_ZONE_OPENED: return "zone_opened";
+    case JOURNAL_ZONE_CLOSED: return "zone_closed";
+    case JOURNAL_FAIL_SAFE: return "fail_safe";
+    case JOURNAL_LINK_UP: return "link_up";
+    case JOURNAL_LINK_DOWN: return "link_down";
+    case JOURNAL_HTTP_FAILED: return "poll_failed";
+    case JOURNAL_ZONE_OVERRIDE: return "zone_override";
+    default: return "unknown";
+  }
+}
+
+static std::string zoneMask(uint8_t mask) {
+  std::string text;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    text += mask & (1 << i) ? '1' : '0';
+  }
+  return text;
+}
+
+static int commandPing(SerialPort& port) {
+  SerialFrame request, reply;
+  serialFrameBegin(&request, SERIAL_PING, 0);
+  Clock::time_point start = Clock::now();
+  if (!transact(port, &request, &reply)) {
+    return 1;
+  }
+  double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  SerialCursor cursor(reply);
+  uint8_t version = serialTake8(&cursor);
+  uint32_t firmware = serialTake32(&cursor);
+  uint64_t uptime = serialTake64(&cursor);
+  uint16_t capacity = serialTake16(&cursor);
+  printf("protocol %u, firmware %u, up %.1f s, frames up to %u bytes, round trip %.2f ms\n", version,
+         firmware, uptime / 1000.0, capacity, ms);
+  if (version != SERIAL_PROTOCOL_VERSION) {
+    fprintf(stderr, "serial-tool: built for protocol %u\n", SERIAL_PROTOCOL_VERSION);
+    return 1;
+  }
+  return 0;
+}
+
+static int commandState(SerialPort& port) {
+  SerialFrame request, reply;
+  serialFrameBegin(&request, SERIAL_GET_STATE, 0);
+  if (!transact(port, &request, &reply)) {
+    return 1;
+  }
+  SerialCursor cursor(reply);
+  ControllerStatus status;
+  if (!serialTakeStatus(&cursor, &status)) {
+    fprintf(stderr, "serial-tool: malformed status (different zone count?)\n");
+    return 1;
+  }
+  printf("mode:        %s\n", modeName(status.mode));
+  printf("uptime:      %u s\n", status.uptimeS);
+  if (status.hasSchedule) {
+    printf("schedule:    seq %u, confirmed %u s ago%s\n", status.scheduleSeq, status.scheduleAgeS,
+           status.failSafeActive ? " (STALE - fail-safe closed the zones)" : "");
+  } else {
+    printf("schedule:    none\n");
+  }
+  printf("last poll:   %s\n", status.pollFailing ? "failed" : "ok");
+  printf("zones:       scheduled %s, open %s, waiting %s, wet %s\n", zoneMask(status.scheduledMask).c_str(),
+         zoneMask(status.openMask).c_str(), zoneMask(status.waitingMask).c_str(),
+         zoneMask(status.wetMask).c_str());
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    printf("zone %d:      moisture ", i + 1);
+    if (status.moisturePermille[i] == MOISTURE_UNKNOWN) {
+      printf("unknown");
+    } else {
+      printf("%.1f%%", status.moisturePermille[i] / 10.0);
+    }
+    if (status.overrideMask & (1 << i)) {
+      printf(", held %s for %u s", status.overrideOpenMask & (1 << i) ? "open" : "closed",
+             status.overrideLeftS[i]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
+
+static int commandCounters(SerialPort& port) {
+  SerialFrame request, reply;
+  serialFrameBegin(&request, SERIAL_GET_COUNTERS, 0);
+  if (!transact(port, &request, &reply)) {
+    return 1;
+  }
+  SerialCursor cursor(reply);
+  while (!cursor.atEnd()) {
+    uint8_t id = serialTake8(&cursor);
+    uint32_t value = serialTake32(&cursor);
+    printf("%-30s %u\n", serialCounterName(id), value);
+  }
+  return 0;
+}
+
+static const char* STAGE_NAMES[] = {"IDLE", "BOOT", "READ_EVENTS", "STEP", "EFFECT", "OUTPUT", "NETWORK"};
+
+static int commandHistogram(SerialPort& port, bool reset) {
+  SerialFrame request, reply;
+  serialFrameBegin(&request, SERIAL_GET_HISTOGRAM, 0);
+  serialPut8(&request, reset ? SERIAL_HISTOGRAM_RESET : 0);
+  if (!transact(port, &request, &reply)) {
+    return 1;
+  }
+  SerialCursor cursor(reply);
+  uint8_t buckets = serialTake8(&cursor);
+  uint32_t firstUs = serialTake32(&cursor);
+  std::vector<uint32_t> counts(buckets);
+  uint64_t total = 0;
+  for (uint8_t i = 0; i < buckets; i++) {
+    counts[i] = serialTake32(&cursor);
+    total += counts[i];
+  }
+  uint32_t worstUs = serialTake32(&cursor);
+
+  printf("loop() passes: %llu, worst %.3f ms\n", (unsigned long long)total, worstUs / 1000.0);
+  for (uint8_t i = 0; i < buckets; i++) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    unsigned long long low = i == 0 ? 0 : (unsigned long long)firstUs << (i - 1);
+    char range[48];
+    if (i + 1 == buckets) {
+      snprintf(range, sizeof(range), ">= %llu us", low);
+    } else {
+      snprintf(range, sizeof(range), "%llu-%llu us", low, ((unsigned long long)firstUs << i) - 1);
+    }
+    int bar = total > 0 ? (int)(50.0 * counts[i] / total + 0.5) : 0;
+    printf("  %-20s %10u  %s\n", range, counts[i], std::string(bar, '#').c_str());
+  }
+
+  uint8_t stages = serialTake8(&cursor);
+  printf("stage          worst ms   overruns\n");
+  for (uint8_t i = 0; i < stages; i++) {
+    uint32_t worstMs = serialTake32(&cursor);
+    uint32_t overruns = serialTake32(&cursor);
+    if (i == 0) {
+      continue;  // IDLE isn't timed
+    }
+    const char* name = i < sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) ? STAGE_NAMES[i] : "?";
+    printf("  %-12s %8u %10u\n", name, worstMs, overruns);
+  }
+  if (cursor.overrun) {
+    fprintf(stderr, "serial-tool: histogram reply was short\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int commandNetworks(SerialPort& port, bool connect, const std::vector<Credentials>& networks) {
+  SerialFrame request, reply;
+  serialFrameBegin(&request, SERIAL_WRITE_NETWORKS, 0);
+  serialPut8(&request, connect ? SERIAL_NETWORKS_CONNECT : 0);
+  serialPut8(&request, (uint8_t)networks.size());
+  for (const Credentials& network : networks) {
+    serialPutNetwork(&request, network);
+  }
+  if (!transact(port, &request, &reply)) {
+    return 1;
+  }
+  SerialCursor cursor(reply);
+  printf("stored %u networks%s\n", serialTake8(&cursor), connect ? ", connecting to the first" : "");
+  return 0;
+}
+
+static int commandJournal(SerialPort& port, uint32_t fromSequence) {
+  SerialFrame request, frame;
+  serialFrameBegin(&request, SERIAL_READ_JOURNAL, 0);
+  serialPut32(&request, fromSequence);
+  port.send(&request);
+  uint8_t tag = request.tag;
+
+  Clock::time_point start = Clock::now();
+  unsigned long records = 0, bytes = 0, corrupt = 0, gaps = 0;
+  uint32_t lastSequence = 0;
+  printf("sequence,clock,time,type,subject,value\n");
+  while (true) {
+    if (!port.receive(tag, &frame, records == 0 ? REPLY_TIMEOUT_MS * REQUEST_ATTEMPTS : STREAM_TIMEOUT_MS)) {
+      fprintf(stderr, "serial-tool: journal stream stopped after %lu records\n", records);
+      return 1;
+    }
+    bytes += frame.length;
+    if (frame.type == SERIAL_ERROR) {
+      fprintf(stderr, "serial-tool: %s\n", errorName(frame.length > 0 ? frame.payload[0] : 0));
+      return 1;
+    }
+    if (frame.type == SERIAL_JOURNAL_END) {
+      SerialCursor cursor(frame);
+      uint32_t sent = serialTake32(&cursor);
+      uint32_t damaged = serialTake32(&cursor);
+      double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      fprintf(stderr, "%lu of %u records in %.2f s (%.0f KB/s)", records, sent, seconds,
+              bytes / 1024.0 / (seconds > 0 ? seconds : 1));
+      fprintf(stderr, ", %lu sequence gaps, %lu failed CRC, %u damaged slots skipped at boot\n", gaps,
+              corrupt, damaged);
+      return records == sent && corrupt == 0 ? 0 : 1;
+    }
+    for (size_t offset = 0; offset + JOURNAL_RECORD_SIZE <= frame.length; offset += JOURNAL_RECORD_SIZE) {
+      JournalRecord record;
+      memcpy(&record, frame.payload + offset, sizeof(record));
+      records++;
+      if (crc32(&record, offsetof(JournalRecord, crc)) != record.crc) {
+        corrupt++;
+        continue;
+      }
+      if (lastSequence != 0 && record.sequence != lastSequence + 1) {
+        gaps++;  // Lost to the ring wrapping, or events dropped on the board
+      }
+      lastSequence = record.sequence;
+      printf("%u,%s,%u,%s,%u,%d\n", record.sequence, record.type & JOURNAL_UPTIME ? "uptime" : "unix",
+             record.time, journalTypeName(record.type), record.subject, record.value);
+    }
+  }
+}
+
+static int commandTrace(SerialPort& port, unsigned seconds) {
+  SerialFrame request, frame;
+  serialFrameBegin(&request, SERIAL_TRACE, 0);
+  serialPut16(&request, (uint16_t)seconds);
+  if (!transact(port, &request, &frame)) {
+    return 1;
+  }
+  uint8_t tag = request.tag;
+
+  unsigned long steps = 0;
+  uint32_t dropped = 0;
+  unsigned long deadline = nowMs() + seconds * 1000UL + REPLY_TIMEOUT_MS;
+  printf("at_ms,input,mode,open,effect_seq\n");
+  while (nowMs() < deadline) {
+    if (!port.receive(tag, &frame, (int)(deadline - nowMs()))) {
+      break;
+    }
+    if (frame.type != SERIAL_TRACE_RECORDS) {
+      continue;
+    }
+    SerialCursor cursor(frame);
+    dropped = serialTake32(&cursor);
+    SerialTraceRecord record;
+    while (!cursor.atEnd() && serialTakeTrace(&cursor, &record)) {
+      steps++;
+      printf("%u,%u,%s,%s,%u\n", record.atMs, record.input, modeName(record.mode),
+             zoneMask(record.openMask).c_str(), record.effectSeq);
+    }
+  }
+  fprintf(stderr, "%lu steps traced, %u lost on the board since boot\n", steps, dropped);
+  return 0;
+}
+
+//----------------------------------------------------------------------------//
+// Codec Check
+//----------------------------------------------------------------------------//
+
+static int g_failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    g_failures++;
+    printf("FAIL: %s\n", what);
+  }
+}
+
+static void randomFrame(std::mt19937& rng, SerialFrame* frame, size_t length) {
+  serialFrameBegin(frame, (uint8_t)rng(), (uint8_t)rng());
+  for (size_t i = 0; i < length; i++) {
+    // Plenty of 0x00 and 0x01, the bytes framing has to keep apart
+    uint32_t r = rng() % 8;
+    serialPut8(frame, r == 0 ? 0x00 : r == 1 ? 0x01 : (uint8_t)rng());
+  }
+}
+
+static bool sameFrame(const SerialFrame& a, const SerialFrame& b) {
+  return a.type == b.type && a.tag == b.tag && a.length == b.length &&
+         memcmp(a.payload, b.payload, a.length) == 0;
+}
+
+struct Received {
+  std::vector<SerialFrame> frames;
+  std::string console;
+  unsigned long bad = 0;
+};
+
+static void feed(SerialFrameReader* reader, const std::vector<uint8_t>& stream, Received* out) {
+  for (uint8_t byte : stream) {
+    switch (serialFrameFeed(reader, byte, 0)) {
+      case SERIAL_BYTE_CONSOLE: out->console += (char)byte; break;
+      case SERIAL_BYTE_FRAME_READY: out->frames.push_back(reader->frame); break;
+      case SERIAL_BYTE_FRAME_BAD: out->bad++; break;
+      case SERIAL_BYTE_FRAMED: break;
+    }
+  }
+}
+
+static void append(std::vector<uint8_t>* stream, const SerialFrame& frame) {
+  uint8_t wire[SERIAL_WIRE_CAPACITY];
+  size_t length = serialFrameEncode(frame, wire);
+  stream->insert(stream->end(), wire, wire + length);
+}
+
+static void checkFraming(std::mt19937& rng, unsigned long frames) {
+  // Every payload size, with console text between the frames
+  static SerialFrameReader reader;
+  serialFrameReaderReset(&reader);
+  std::vector<SerialFrame> sent;
+  std::vector<uint8_t> stream;
+  std::string console;
+  size_t worstWire = 0;
+  for (unsigned long i = 0; i < frames; i++) {
+    SerialFrame frame;
+    randomFrame(rng, &frame, i <= SERIAL_PAYLOAD_CAPACITY ? i : rng() % (SERIAL_PAYLOAD_CAPACITY + 1));
+    size_t before = stream.size();
+    append(&stream, frame);
+    worstWire = std::max(worstWire, stream.size() - before);
+    sent.push_back(frame);
+    std::string text = "Status: mode=2 zones=101 \xE2\x9C\x93\r\n";
+    text.resize(rng() % text.size());
+    console += text;
+    stream.insert(stream.end(), text.begin(), text.end());
+  }
+  Received received;
+  feed(&reader, stream, &received);
+  bool allMatch = received.frames.size() == sent.size();
+  for (size_t i = 0; allMatch && i < sent.size(); i++) {
+    allMatch = sameFrame(sent[i], received.frames[i]);
+  }
+  check(allMatch, "frames of every size round-trip");
+  check(received.bad == 0, "no good frame is rejected");
+  check(received.console == console, "console text passes through untouched");
+  check(worstWire <= SERIAL_WIRE_CAPACITY, "wire length stays within SERIAL_WIRE_CAPACITY");
+  printf("framing: %lu frames, largest %zu bytes on the wire\n", frames, worstWire);
+
+  // Damage: a changed byte is never accepted, and the frames after it decode
+  unsigned long falseAccepts = 0, lostAfter = 0;
+  for (unsigned long i = 0; i < frames; i++) {
+    SerialFrame damaged, following;
+    randomFrame(rng, &damaged, 1 + rng() % SERIAL_PAYLOAD_CAPACITY);
+    randomFrame(rng, &following, rng() % 64);
+    std::vector<uint8_t> wire;
+    append(&wire, damaged);
+    size_t at = 1 + rng() % (wire.size() - 2);
+    wire[at] ^= (uint8_t)(1 + rng() % 255);
+    append(&wire, following);
+    append(&wire, following);
+    Received got;
+    feed(&reader, wire, &got);
+    for (const SerialFrame& frame : got.frames) {
+      if (!sameFrame(frame, following)) {
+        falseAccepts++;
+      }
+    }
+    // A byte damaged into 0x00 ends the frame early; the rest reads as
+    // console text or a bad frame, which still ends at the original 0x00
+    if (got.frames.size() != 2) {
+      lostAfter++;
+    }
+    serialFrameReaderReset(&reader);
+  }
+  check(falseAccepts == 0, "a damaged frame is never accepted");
+  check(lostAfter == 0, "the frames after a damaged one decode");
+
+  // Truncation: a frame that lost its end byte takes only the next frame along
+  unsigned long resyncFailures = 0;
+  for (unsigned long i = 0; i < frames / 4; i++) {
+    SerialFrame cut, a, b;
+    randomFrame(rng, &cut, rng() % SERIAL_PAYLOAD_CAPACITY);
+    randomFrame(rng, &a, rng() % 64);
+    randomFrame(rng, &b, rng() % 64);
+    std::vector<uint8_t> wire;
+    append(&wire, cut);
+    wire.pop_back();
+    append(&wire, a);
+    append(&wire, b);
+    Received got;
+    feed(&reader, wire, &got);
+    if (got.frames.size() != 1 || !sameFrame(got.frames[0], b)) {
+      resyncFailures++;
+    }
+    serialFrameReaderReset(&reader);
+  }
+  check(resyncFailures == 0, "a truncated frame costs only the frame after it");
+
+  // A stalled frame gives the console back after SERIAL_FRAME_TIMEOUT_MS
+  serialFrameReaderReset(&reader);
+  serialFrameFeed(&reader, SERIAL_FRAME_START, 1000);
+  serialFrameFeed(&reader, 'x', 1000);
+  check(serialFrameFeed(&reader, 'j', 1000 + SERIAL_FRAME_TIMEOUT_MS + 1) == SERIAL_BYTE_CONSOLE,
+        "an abandoned frame releases the console");
+
+  // An endless frame is dropped without overrunning the buffer
+  serialFrameReaderReset(&reader);
+  std::vector<uint8_t> flood(1, SERIAL_FRAME_START);
+  flood.insert(flood.end(), SERIAL_WIRE_CAPACITY * 3, 0x55);
+  flood.push_back(SERIAL_FRAME_END);
+  Received got;
+  feed(&reader, flood, &got);
+  check(got.bad == 1 && got.frames.empty(), "an oversized frame is rejected");
+}
+
+static void checkFields(std::mt19937& rng) {
+  ControllerStatus status;
+  memset(&status, 0, sizeof(status));
+  status.mode = MODE_CONNECTED;
+  status.uptimeS = 86400;
+  status.hasSchedule = true;
+  status.scheduleSeq = 0xFFFFFFF0;
+  status.scheduleAgeS = 42;
+  status.pollFailing = true;
+  status.scheduledMask = 0x5;
+  status.openMask = 0x1;
+  status.waitingMask = 0x4;
+  status.overrideMask = 0x2;
+  status.overrideOpenMask = 0x2;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    status.overrideLeftS[i] = rng();
+    status.moisturePermille[i] = (uint16_t)rng();
+  }
+  SerialFrame frame;
+  serialFrameBegin(&frame, SERIAL_GET_STATE | SERIAL_REPLY, 7);
+  check(serialPutStatus(&frame, status), "status fits a frame");
+  SerialCursor cursor(frame);
+  ControllerStatus decoded;
+  bool ok = serialTakeStatus(&cursor, &decoded) && cursor.atEnd() && decoded.mode == status.mode &&
+            decoded.uptimeS == status.uptimeS && decoded.hasSchedule && decoded.pollFailing &&
+            !decoded.failSafeActive && decoded.scheduleSeq == status.scheduleSeq &&
+            decoded.scheduleAgeS == status.scheduleAgeS && decoded.openMask == status.openMask &&
+            decoded.waitingMask == status.waitingMask && decoded.overrideOpenMask == status.overrideOpenMask;
+  for (int i = 0; i < ZONE_COUNT; i++) {
+    ok = ok && decoded.overrideLeftS[i] == status.overrideLeftS[i] &&
+         decoded.moisturePermille[i] == status.moisturePermille[i];
+  }
+  check(ok, "status round-trips");
+  printf("fields: status %zu bytes\n", frame.length);
+
+  // The largest WRITE_NETWORKS request: every slot, every field at its longest
+  serialFrameBegin(&frame, SERIAL_WRITE_NETWORKS, 1);
+  serialPut8(&frame, SERIAL_NETWORKS_CONNECT);
+  serialPut8(&frame, CREDENTIAL_STORE_SIZE);
+  Credentials networks[CREDENTIAL_STORE_SIZE];
+  bool fits = true;
+  for (int i = 0; i < CREDENTIAL_STORE_SIZE; i++) {
+    memset(networks[i].ssid, 'a' + i, sizeof(networks[i].ssid) - 1);
+    networks[i].ssid[sizeof(networks[i].ssid) - 1] = '\0';
+    memset(networks[i].pass, 'p', sizeof(networks[i].pass) - 1);
+    networks[i].pass[sizeof(networks[i].pass) - 1] = '\0';
+    fits = fits && serialPutNetwork(&frame, networks[i]);
+  }
+  check(fits, "every known network fits one request");
+  SerialCursor networkCursor(frame);
+  serialTake8(&networkCursor);
+  uint8_t count = serialTake8(&networkCursor);
+  ok = count == CREDENTIAL_STORE_SIZE;
+  for (int i = 0; ok && i < count; i++) {
+    Credentials decodedNetwork;
+    ok = serialTakeNetwork(&networkCursor, &decodedNetwork) &&
+         strcmp(decodedNetwork.ssid, networks[i].ssid) == 0 && strcmp(decodedNetwork.pass, networks[i].pass) == 0;
+  }
+  check(ok && networkCursor.atEnd(), "networks round-trip");
+  printf("fields: %d networks at full length %zu bytes\n", CREDENTIAL_STORE_SIZE, frame.length);
+
+  // An empty SSID and a truncated request are refused
+  serialFrameBegin(&frame, SERIAL_WRITE_NETWORKS, 1);
+  serialPut8(&frame, 0);
+  serialPut8(&frame, 3);
+  serialPutBytes(&frame, "ab", 2);
+  SerialCursor shortCursor(frame);
+  Credentials rejected;
+  check(!serialTakeNetwork(&shortCursor, &rejected), "an empty SSID is refused");
+  SerialCursor truncatedCursor(frame);
+  serialTake8(&truncatedCursor);
+  check(!serialTakeNetwork(&truncatedCursor, &rejected), "a truncated network is refused");
+
+  // A full trace frame
+  serialFrameBegin(&frame, SERIAL_TRACE_RECORDS, 3);
+  serialPut32(&frame, 0);
+  int traced = 0;
+  SerialTraceRecord record = {0xDEADBEEF, INPUT_TICK, MODE_CONNECTED, 0x3, 200};
+  while (serialPutTrace(&frame, record)) {
+    traced++;
+  }
+  SerialCursor traceCursor(frame);
+  serialTake32(&traceCursor);
+  SerialTraceRecord decodedTrace;
+  ok = serialTakeTrace(&traceCursor, &decodedTrace) && decodedTrace.atMs == record.atMs &&
+       decodedTrace.input == record.input && decodedTrace.mode == record.mode &&
+       decodedTrace.openMask == record.openMask && decodedTrace.effectSeq == record.effectSeq;
+  check(ok, "trace records round-trip");
+  check(frame.length == 4 + traced * SERIAL_TRACE_RECORD_SIZE, "trace records are 8 bytes on the wire");
+}
+
+static void benchmark(std::mt19937& rng) {
+  SerialFrame frame;
+  randomFrame(rng, &frame, SERIAL_PAYLOAD_CAPACITY);
+  static uint8_t wire[SERIAL_WIRE_CAPACITY];
+  static SerialFrameReader reader;
+  serialFrameReaderReset(&reader);
+  const int rounds = 20000;
+
+  Clock::time_point start = Clock::now();
+  size_t length = 0;
+  for (int i = 0; i < rounds; i++) {
+    frame.tag = (uint8_t)i;
+    length = serialFrameEncode(frame, wire);
+  }
+  double encodeS = std::chrono::duration<double>(Clock::now() - start).count();
+
+  start = Clock::now();
+  unsigned long decoded = 0;
+  for (int i = 0; i < rounds; i++) {
+    for (size_t j = 0; j < length; j++) {
+      decoded += serialFrameFeed(&reader, wire[j], 0) == SERIAL_BYTE_FRAME_READY;
+    }
+  }
+  double decodeS = std::chrono::duration<double>(Clock::now() - start).count();
+  check(decoded == (unsigned long)rounds, "benchmark frames decode");
+
+  double payloadMb = (double)rounds * SERIAL_PAYLOAD_CAPACITY / 1e6;
+  printf("\n%-34s %10s %12s\n", "full frame (1024 B payload)", "us/frame", "MB/s");
+  printf("%-34s %10.2f %12.1f\n", "encode (COBS + CRC-32)", encodeS * 1e6 / rounds, payloadMb / encodeS);
+  printf("%-34s %10.2f %12.1f\n", "decode (byte at a time)", decodeS * 1e6 / rounds, payloadMb / decodeS);
+  printf("wire overhead: %zu bytes per full frame (%.1f%%)\n", length - SERIAL_PAYLOAD_CAPACITY,
+         100.0 * (length - SERIAL_PAYLOAD_CAPACITY) / SERIAL_PAYLOAD_CAPACITY);
+}
+
+static int runCheck(unsigned long frames) {
+  std::mt19937 rng(1);
+  checkFraming(rng, frames);
+  checkFields(rng);
+  benchmark(rng);
+  printf("\n%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
+
+//----------------------------------------------------------------------------//
+// Main
+//----------------------------------------------------------------------------//
+
+static int usage() {
+  fprintf(stderr,
+          "usage: serial-tool [--console] PORT ping|state|counters|histogram [--reset]\n"
+          "       serial-tool [--console] PORT networks [--connect] SSID PASS [SSID PASS ...]\n"
+          "       serial-tool [--console] PORT journal [--from SEQ]\n"
+          "       serial-tool [--console] PORT trace SECONDS\n"
+          "       serial-tool --check [--frames N]\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  int arg = 1;
+  if (arg < argc && strcmp(argv[arg], "--check") == 0) {
+    unsigned long frames = 2000;
+    if (arg + 2 < argc && strcmp(argv[arg + 1], "--frames") == 0) {
+      frames = strtoul(argv[arg + 2], nullptr, 10);
+    }
+    return runCheck(frames);
+  }
+
+  SerialPort port;
+  if (arg < argc && strcmp(argv[arg], "--console") == 0) {
+    port.echoConsole = true;
+    arg++;
+  }
+  if (arg + 1 >= argc) {
+    return usage();
+  }
+  const char* path = argv[arg++];
+  std::string command = argv[arg++];
+  if (!port.open(path)) {
+    return 1;
+  }
+
+  if (command == "ping") {
+    return commandPing(port);
+  } else if (command == "state") {
+    return commandState(port);
+  } else if (command == "counters") {
+    return commandCounters(port);
+  } else if (command == "histogram") {
+    return commandHistogram(port, arg < argc && strcmp(argv[arg], "--reset") == 0);
+  } else if (command == "networks") {
+    bool connect = arg < argc && strcmp(argv[arg], "--connect") == 0;
+    arg += connect ? 1 : 0;
+    std::vector<Credentials> networks;
+    for (; arg + 1 < argc; arg += 2) {
+      Credentials network;
+      if (strlen(argv[arg]) == 0 || strlen(argv[arg]) >= sizeof(network.ssid) ||
+          strlen(argv[arg + 1]) >= sizeof(network.pass)) {
+        fprintf(stderr, "serial-tool: SSIDs are 1-63 characters, passwords at most 63\n");
+        return 2;
+      }
+      strcpy(network.ssid, argv[arg]);
+      strcpy(network.pass, argv[arg + 1]);
+      networks.push_back(network);
+    }
+    if (arg != argc || networks.empty() || networks.size() > (size_t)CREDENTIAL_STORE_SIZE) {
+      fprintf(stderr, "serial-tool: give 1-%d SSID PASS pairs\n", CREDENTIAL_STORE_SIZE);
+      return 2;
+    }
+    return commandNetworks(port, connect, networks);
+  } else if (command == "journal") {
+    uint32_t from = 0;
+    if (arg + 1 < argc && strcmp(argv[arg], "--from") == 0) {
+      from = (uint32_t)strtoul(argv[arg + 1], nullptr, 10);
+    }
+    return commandJournal(port, from);
+  } else if (command == "trace" && arg < argc) {
+    unsigned long seconds = strtoul(argv[arg], nullptr, 10);
+    if (seconds == 0 || seconds > 65535) {
+      return usage();
+    }
+    return commandTrace(port, (unsigned)seconds);
+  }
+  return usage();
+}
@@ -0,0 +1,117 @@
+#ifndef HOST_SHIM_ARDUINO_H
+#define HOST_SHIM_ARDUINO_H
+
+/*
+ * Host stand-in for the Arduino core
+ *
+ * Just enough of <Arduino.h> for the controller's hardware-independent headers
+ * (Types.h, Mailbox.h, NetworkMailbox.h) to compile on Linux. Timing comes
+ * from std::chrono; pin writes land in an array so tools can inspect them.
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+typedef uint8_t byte;
+
+const int LOW = 0;
+const int HIGH = 1;
+const int INPUT = 0;
+const int OUTPUT = 1;
+const int DEC = 10;
+const int HEX = 16;
+
+//----------------------------------------------------------------------------//
+// Time
+//----------------------------------------------------------------------------//
+
+inline std::chrono::steady_clock::time_point hostBootTime() {
+  static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+  return boot;
+}
+
+inline unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - hostBootTime()).count();
+}
+
+inline unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - hostBootTime()).count();
+}
+
+inline void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+//----------------------------------------------------------------------------//
+// GPIO
+//----------------------------------------------------------------------------//
+
+const int HOST_PIN_COUNT = 64;
+
+inline int* hostPinStates() {
+  static int pins[HOST_PIN_COUNT] = {0};
+  return pins;
+}
+
+inline void pinMode(int, int) {}
+
+inline void digitalWrite(int pin, int value) {
+  if (pin >= 0 && pin < HOST_PIN_COUNT) hostPinStates()[pin] = value;
+}
+
+inline int digitalRead(int pin) {
+  return (pin >= 0 && pin < HOST_PIN_COUNT) ? hostPinStates()[pin] : LOW;
+}
+
+//----------------------------------------------------------------------------//
+// Serial
+//----------------------------------------------------------------------------//
+
+// Output is discarded unless HOST_SERIAL_ECHO is set, so benchmarks measure
+// the controller logic rather than the terminal
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  explicit operator bool() const { return true; }
+
+  template <typename T> void print(const T& value) { write(value); }
+  template <typename T> void print(const T& value, int) { write(value); }
+  template <typename T> void println(const T& value) { write(value); write("\n"); }
+  template <typename T> void println(const T& value, int) { write(value); write("\n"); }
+  void println() { write("\n"); }
+
+private:
+  void write(const char* s) { if (echo()) fputs(s, stdout); }
+  void write(char c) { if (echo()) fputc(c, stdout); }
+  void write(bool b) { write(b ? "1" : "0"); }
+  void write(int v) { if (echo()) printf("%d", v); }
+  void write(unsigned int v) { if (echo()) printf("%u", v); }
+  void write(long v) { if (echo()) printf("%ld", v); }
+  void write(unsigned long v) { if (echo()) printf("%lu", v); }
+  void write(unsigned long long v) { if (echo()) printf("%llu", v); }
+  void write(double v) { if (echo()) printf("%f", v); }
+  static bool echo() {
+#ifdef HOST_SERIAL_ECHO
+    return true;
+#else
+    return false;
+#endif
+  }
+};
+
+inline HostSerial& hostSerial() {
+  static HostSerial serial;
+  return serial;
+}
+
+#define Serial hostSerial()
+
+#endif // HOST_SHIM_ARDUINO_H
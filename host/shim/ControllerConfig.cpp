@@ -0,0 +1,105 @@
+/*
+ * Host copies of the configuration constants defined in controller.ino
+ *
+ * Host tools link the pure controller modules without the sketch itself,
+ * so the extern configuration from Types.h is defined here. Keep the values
+ * in step with controller.ino.
+ */
+
+#include "Types.h"
+
+//----------------------------------------------------------------------------//
+// Hardware Configuration
+//----------------------------------------------------------------------------//
+
+const int power_led_pin = 2;
+const int wifi_led_pin = 3;
+const int zone1_led_pin = 4;
+const int zone2_led_pin = 5;
+const int zone3_led_pin = 6;
+const int valve_shift_registers = 0;
+const int valve_latch_pin = 10;
+const int valve_enable_pin = 9;
+
+//----------------------------------------------------------------------------//
+// Network Configuration
+//----------------------------------------------------------------------------//
+
+const char* server_hostname = "127.0.0.1";
+const int server_port = 3000;
+const unsigned long server_address_ttl_ms = 3600000;
+const unsigned long http_keepalive_idle_ms = 25000;
+const unsigned long http_response_timeout_ms = 10000;
+const unsigned long wifi_connect_timeout_ms = 30000;
+
+//----------------------------------------------------------------------------//
+// LAN Server Configuration
+//----------------------------------------------------------------------------//
+
+const int lan_http_port = 80;
+const char* lan_http_token = "";
+const unsigned long lan_http_idle_ms = 5000;
+const unsigned long lan_override_default_ms = 600000;
+const unsigned long lan_override_max_ms = 3600000;
+
+//----------------------------------------------------------------------------//
+// Clock Configuration
+//----------------------------------------------------------------------------//
+
+const char* ntp_server_hostname = "pool.ntp.org";
+const unsigned long time_sync_interval_ms = 3600000;
+const int utc_offset_minutes = 0;
+
+//----------------------------------------------------------------------------//
+// Zone Sequencing Configuration
+//----------------------------------------------------------------------------//
+
+const int max_concurrent_zones = 2;
+const unsigned long zone_rotation_ms = 900000;
+const unsigned int zone_flow_lpm[ZONE_COUNT] = {0, 0, 0};
+const unsigned int supply_flow_lpm = 0;
+
+//----------------------------------------------------------------------------//
+// Soil Moisture Configuration
+//----------------------------------------------------------------------------//
+
+const bool moisture_sensing_enabled = false;
+const int zone_moisture_pins[ZONE_COUNT] = {0, 1, 2};  // A0-A2 on the board
+const unsigned long moisture_sample_rate_hz = 100;
+const unsigned long moisture_report_ms = 1000;
+const unsigned long moisture_stale_ms = 60000;
+const uint16_t moisture_raw_dry = 3000;
+const uint16_t moisture_raw_wet = 1300;
+const uint16_t moisture_wet_permille = 700;
+const uint16_t moisture_dry_permille = 550;
+
+//----------------------------------------------------------------------------//
+// Firmware Update Configuration
+//----------------------------------------------------------------------------//
+
+const uint32_t firmware_version = 1;
+const bool ota_enabled = false;
+const unsigned long ota_check_interval_ms = 3600000;
+const uint8_t ota_public_key[65] = {0};
+
+//----------------------------------------------------------------------------//
+// Event Journal Configuration
+//----------------------------------------------------------------------------//
+
+const unsigned long journal_flush_ms = 60000;
+
+//----------------------------------------------------------------------------//
+// Watchdog Configuration
+//----------------------------------------------------------------------------//
+
+const unsigned long watchdog_timeout_ms = 30000;
+
+//----------------------------------------------------------------------------//
+// Polling Configuration
+//----------------------------------------------------------------------------//
+
+const unsigned long poll_interval_min_ms = 10000;
+const unsigned long poll_interval_base_ms = 30000;
+const unsigned long poll_interval_max_ms = 120000;
+const unsigned long schedule_stale_ms = 300000;
+const bool stale_schedule_failsafe = true;
@@ -0,0 +1,25 @@
+#ifndef HOST_SHIM_WIFI_H
+#define HOST_SHIM_WIFI_H
+
+/*
+ * Host stand-in for the Arduino WiFi library
+ *
+ * Only the status codes are provided; host tools model the radio themselves.
+ * Values match the Arduino WiFi API so logs read the same as on the board.
+ */
+
+#include "Arduino.h"
+
+enum wl_status_t {
+  WL_NO_SHIELD = 255,
+  WL_NO_MODULE = WL_NO_SHIELD,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+};
+
+#endif // HOST_SHIM_WIFI_H
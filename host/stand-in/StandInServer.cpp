@@ -0,0 +1,423 @@
+#include "StandInServer.h"
+
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct StandInServer::Connection {
+  int fd;
+  std::string rx;   // Bytes received but not yet consumed as a request
+  unsigned long lastActiveMs;
+  std::string delayed;        // Late response waiting for delayedAtMs; later requests wait too
+  unsigned long delayedAtMs;
+  bool closeAfterDelayed;
+};
+
+static void setNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static const int SCHEDULE_ZONES = 3;
+
+StandInServer::StandInServer()
+  : listenFd(-1), epollFd(-1), boundPort(0), faulting(true), scheduleRequests(0),
+    delayedCount(0), firstSeq(1), lastFlipMs(0) {}
+
+StandInServer::~StandInServer() {
+  while (!liveConnections.empty()) closeConnection(*liveConnections.begin());
+  if (listenFd >= 0) close(listenFd);
+  if (epollFd >= 0) close(epollFd);
+}
+
+bool StandInServer::start(const StandInConfig& cfg) {
+  config = cfg;
+  if (config.historyDepth == 0) config.historyDepth = 1;
+  firstSeq = 1;
+  history.assign(1, config.zones);
+  lastFlipMs = millis();
+
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) return false;
+  int one = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(config.port);
+  if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 4096) < 0) {
+    perror("stand-in: bind/listen");
+    return false;
+  }
+
+  socklen_t len = sizeof(addr);
+  getsockname(listenFd, (sockaddr*)&addr, &len);
+  boundPort = ntohs(addr.sin_port);
+  setNonBlocking(listenFd);
+
+  epollFd = epoll_create1(0);
+  epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;  // nullptr marks the listening socket
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+  return true;
+}
+
+void StandInServer::acceptAll() {
+  while (true) {
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) return;  // EAGAIN - drained
+    setNonBlocking(fd);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    Connection* conn = new Connection{fd, std::string(), millis(), std::string(), 0, false};
+    liveConnections.insert(conn);
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    counters.connections++;
+  }
+}
+
+void StandInServer::closeConnection(Connection* conn) {
+  if (!conn->delayed.empty()) delayedCount--;
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+  close(conn->fd);
+  liveConnections.erase(conn);
+  delete conn;
+}
+
+void StandInServer::reapIdle() {
+  if (config.idleTimeoutS == 0) return;
+  unsigned long now = millis();
+  for (auto it = liveConnections.begin(); it != liveConnections.end();) {
+    Connection* conn = *it++;  // closeConnection() erases the current entry
+    if (conn->delayed.empty() && now - conn->lastActiveMs >= config.idleTimeoutS * 1000UL) {
+      counters.idleCloses++;
+      closeConnection(conn);
+    }
+  }
+}
+
+// Toggle the next zone in turn, as a new version
+void StandInServer::flipZone() {
+  uint32_t seq = firstSeq + (uint32_t)history.size() - 1;
+  history.push_back(history.back() ^ (uint8_t)(1 << (seq % SCHEDULE_ZONES)));
+  if (history.size() > config.historyDepth + 1) {
+    history.erase(history.begin());  // Only historyDepth versions can be patched
+    firstSeq++;
+  }
+}
+
+// Status and body for a schedule GET; `since` comes from the request line
+int StandInServer::scheduleResponse(const std::string& head, std::string* body) {
+  if (!config.body.empty()) {
+    *body = config.body;
+    counters.snapshots++;
+    return 200;
+  }
+
+  uint32_t seq = firstSeq + (uint32_t)history.size() - 1;
+  uint8_t zones = history.back();
+  uint32_t since = 0;
+  size_t lineEnd = head.find("\r\n");
+  size_t at = head.find("since=");
+  if (at != std::string::npos && at < lineEnd) {
+    since = (uint32_t)strtoul(head.c_str() + at + 6, nullptr, 10);
+  }
+
+  if (since == seq) {
+    body->clear();
+    counters.notModified++;
+    return 304;
+  }
+
+  char json[128];
+  if (since >= firstSeq && since < seq) {
+    uint8_t changed = zones ^ history[since - firstSeq];
+    int n = snprintf(json, sizeof(json), "{\"seq\":%u,\"base\":%u", seq, since);
+    for (int z = 0; z < SCHEDULE_ZONES; z++) {
+      if (changed & (1 << z)) {
+        n += snprintf(json + n, sizeof(json) - n, ",\"zone%d\":%s", z + 1,
+                      (zones & (1 << z)) ? "true" : "false");
+      }
+    }
+    snprintf(json + n, sizeof(json) - n, "}");
+    counters.deltas++;
+  } else {
+    snprintf(json, sizeof(json), "{\"seq\":%u,\"zone1\":%s,\"zone2\":%s,\"zone3\":%s}", seq,
+             (zones & 1) ? "true" : "false", (zones & 2) ? "true" : "false",
+             (zones & 4) ? "true" : "false");
+    counters.snapshots++;
+  }
+  *body = json;
+  return 200;
+}
+
+// Number following `name` in the request line, or `fallback` if absent
+static unsigned long queryParam(const std::string& head, const char* name, unsigned long fallback) {
+  size_t lineEnd = head.find("\r\n");
+  size_t at = head.find(name);
+  if (at == std::string::npos || at > lineEnd) return fallback;
+  return strtoul(head.c_str() + at + strlen(name), nullptr, 10);
+}
+
+// Status and body for a firmware range GET
+int StandInServer::firmwareResponse(const std::string& head, std::string* body, bool* cut) {
+  *cut = false;
+  if (config.firmware.empty()) {
+    body->clear();
+    return 404;
+  }
+  unsigned long offset = queryParam(head, "offset=", 0);
+  unsigned long length = queryParam(head, "length=", config.firmware.size());
+  if (offset >= config.firmware.size()) {
+    body->clear();
+    return 416;
+  }
+  *body = config.firmware.substr(offset, length);
+  counters.firmwareRequests++;
+  if (config.firmwareCutEvery > 0 && counters.firmwareRequests % config.firmwareCutEvery == 0) {
+    *cut = true;
+    counters.firmwareCuts++;
+  }
+  return 200;
+}
+
+// Firmware chunks can outgrow the socket buffer; wait for room rather than
+// treating a short write as a dead client
+static bool writeAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t n = write(fd, data, length);
+    if (n > 0) {
+      data += n;
+      length -= n;
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd pfd = {fd, POLLOUT, 0};
+      if (poll(&pfd, 1, 1000) > 0) continue;
+    }
+    return false;
+  }
+  return true;
+}
+
+// Case-insensitive search for a header token within the request head
+static bool headContains(const std::string& head, const char* needle) {
+  size_t n = strlen(needle);
+  for (size_t i = 0; i + n <= head.size(); i++) {
+    if (strncasecmp(head.c_str() + i, needle, n) == 0) return true;
+  }
+  return false;
+}
+
+// Whether this schedule GET is answered wrongly, and how
+StandInFault StandInServer::nextFault() {
+  scheduleRequests++;
+  if (config.fault == STAND_IN_FAULT_NONE || !faulting.load()) return STAND_IN_FAULT_NONE;
+  if (config.faultEvery > 1 && scheduleRequests % config.faultEvery != 0) return STAND_IN_FAULT_NONE;
+  counters.faults++;
+  return config.fault;
+}
+
+static const char* reasonPhrase(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 404: return "Not Found";
+    case 416: return "Range Not Satisfiable";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default: return "Error";
+  }
+}
+
+// Bodies a confused proxy or a half-deployed backend might send with a 200
+static const char* const MALFORMED_BODIES[] = {
+  "{\"seq\":7,\"zone1\":true,\"zo",
+  "{\"seq\":7,\"zone1\":yes,\"zone2\":false,\"zone3\":true}",
+  "<html><body><h1>Service temporarily unavailable</h1></body></html>"
+};
+
+// Write a response, or leave it until later; false if the connection was closed
+bool StandInServer::sendResponse(Connection* conn, const std::string& response, bool close) {
+  if (!writeAll(conn->fd, response.data(), response.size())) {
+    closeConnection(conn);
+    return false;
+  }
+  if (close) {
+    closeConnection(conn);
+    return false;
+  }
+  return true;
+}
+
+void StandInServer::handleReadable(Connection* conn) {
+  char buf[4096];
+  while (true) {
+    ssize_t n = read(conn->fd, buf, sizeof(buf));
+    if (n > 0) {
+      conn->rx.append(buf, n);
+      continue;
+    }
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      closeConnection(conn);  // Peer closed or error
+      return;
+    }
+    break;  // EAGAIN - drained
+  }
+  conn->lastActiveMs = millis();
+  answerRequests(conn);
+}
+
+// Answer every complete request in the buffer (pipelining is allowed), in
+// order: a late response holds back the ones behind it
+void StandInServer::answerRequests(Connection* conn) {
+  size_t end;
+  while (conn->delayed.empty() && (end = conn->rx.find("\r\n\r\n")) != std::string::npos) {
+    std::string head = conn->rx.substr(0, end);
+    conn->rx.erase(0, end + 4);
+    bool keepAlive = !headContains(head, "connection: close");
+    const char* connection = keepAlive ? "keep-alive" : "close";
+
+    char cacheControl[64] = "";
+    if (config.maxAgeS > 0) {
+      snprintf(cacheControl, sizeof(cacheControl), "Cache-Control: max-age=%lu\r\n", config.maxAgeS);
+    }
+    std::string body;
+    bool cut = false;
+    bool firmware = head.compare(0, 14, "GET /firmware?") == 0 || head.compare(0, 14, "GET /firmware ") == 0;
+    StandInFault fault = firmware ? STAND_IN_FAULT_NONE : nextFault();
+    if (fault == STAND_IN_FAULT_RESET) {
+      // Zero linger turns the close into an RST, whatever the client sent
+      linger hard = {1, 0};
+      setsockopt(conn->fd, SOL_SOCKET, SO_LINGER, &hard, sizeof(hard));
+      closeConnection(conn);
+      return;
+    }
+
+    int status;
+    if (firmware) {
+      status = firmwareResponse(head, &body, &cut);
+    } else if (fault == STAND_IN_FAULT_MALFORMED) {
+      status = 200;
+      body = MALFORMED_BODIES[(counters.faults - 1) % 3];
+    } else if (fault == STAND_IN_FAULT_STATUS) {
+      status = config.faultStatus;
+      body = reasonPhrase(status);
+    } else if (fault == STAND_IN_FAULT_TRUNCATE) {
+      // A 304 has no body to cut, so send a snapshot whatever `since` says
+      status = scheduleResponse(std::string(), &body);
+      cut = true;
+    } else {
+      status = scheduleResponse(head, &body);
+    }
+
+    char header[384];
+    int headerLen;
+    if (firmware) {
+      headerLen = snprintf(header, sizeof(header),
+          "HTTP/1.1 %d %s\r\n"
+          "Content-Type: application/octet-stream\r\n"
+          "Content-Length: %zu\r\n"
+          "Connection: %s\r\n\r\n",
+          status, reasonPhrase(status), body.size(), connection);
+    } else if (fault == STAND_IN_FAULT_STATUS) {
+      char retryAfter[48] = "";
+      if (config.faultRetryAfterS > 0) {
+        snprintf(retryAfter, sizeof(retryAfter), "Retry-After: %lu\r\n", config.faultRetryAfterS);
+      }
+      headerLen = snprintf(header, sizeof(header),
+          "HTTP/1.1 %d %s\r\n"
+          "Content-Type: text/plain\r\n"
+          "Content-Length: %zu\r\n"
+          "%s"
+          "Connection: %s\r\n\r\n",
+          status, reasonPhrase(status), body.size(), retryAfter, connection);
+    } else if (status == 304) {
+      // No body and, like Warp, no Content-Length
+      headerLen = snprintf(header, sizeof(header),
+          "HTTP/1.1 304 Not Modified\r\n"
+          "%s"
+          "Connection: %s\r\n\r\n",
+          cacheControl, connection);
+    } else {
+      headerLen = snprintf(header, sizeof(header),
+          "HTTP/1.1 200 OK\r\n"
+          "Content-Type: application/json;charset=utf-8\r\n"
+          "Content-Length: %zu\r\n"
+          "%s"
+          "Connection: %s\r\n\r\n",
+          body.size(), cacheControl, connection);
+    }
+    std::string response(header, headerLen);
+    response += cut ? body.substr(0, body.size() / 2) : body;
+    counters.bodyBytes += response.size() - headerLen;
+    counters.requests++;
+
+    // A cut response closes mid-body, as a dropped link would
+    bool close = cut || !keepAlive;
+    if (fault == STAND_IN_FAULT_LATENCY) {
+      conn->delayed = response;
+      conn->delayedAtMs = millis() + config.faultLatencyMs;
+      conn->closeAfterDelayed = close;
+      delayedCount++;
+      return;
+    }
+    if (!sendResponse(conn, response, close)) return;
+  }
+}
+
+// Send late responses that are due, then carry on with requests queued behind them
+void StandInServer::sendDelayed() {
+  unsigned long now = millis();
+  for (auto it = liveConnections.begin(); it != liveConnections.end();) {
+    Connection* conn = *it++;  // Sending may close (and erase) the current entry
+    if (conn->delayed.empty() || (long)(now - conn->delayedAtMs) < 0) continue;
+    std::string response;
+    response.swap(conn->delayed);
+    delayedCount--;
+    conn->lastActiveMs = now;
+    if (sendResponse(conn, response, conn->closeAfterDelayed)) answerRequests(conn);
+  }
+}
+
+void StandInServer::run(const std::atomic<bool>& stop) {
+  epoll_event events[256];
+  unsigned long nextSweep = millis() + 1000;
+  while (!stop.load(std::memory_order_relaxed)) {
+    int n = epoll_wait(epollFd, events, 256, delayedCount > 0 ? 5 : 50);
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.ptr == nullptr) {
+        acceptAll();
+      } else {
+        handleReadable(static_cast<Connection*>(events[i].data.ptr));
+      }
+    }
+    if (delayedCount > 0) sendDelayed();
+    if (millis() >= nextSweep) {
+      reapIdle();
+      nextSweep = millis() + 1000;
+    }
+    if (config.flipEveryS > 0 && millis() - lastFlipMs >= config.flipEveryS * 1000UL) {
+      flipZone();
+      lastFlipMs = millis();
+    }
+  }
+  while (!liveConnections.empty()) closeConnection(*liveConnections.begin());
+}
@@ -0,0 +1,136 @@
+#ifndef HOST_STAND_IN_SERVER_H
+#define HOST_STAND_IN_SERVER_H
+
+/*
+ * Local stand-in for the schedule endpoint
+ *
+ * A single-threaded epoll HTTP/1.1 server that answers schedule GETs the
+ * way the Servant server does. Supports keep-alive and "Connection: close",
+ * and reaps idle connections, like the real backend behind Warp. Host tools
+ * run it on a background thread when the real server isn't available.
+ *
+ * The schedule is versioned: `GET /?since=N` gets 304 Not Modified if N is
+ * current, a delta of the changed zones if N is among the last
+ * historyDepth versions, and a full snapshot otherwise. A fixed `body`
+ * replaces all of that with one unversioned response.
+ *
+ * `GET /firmware?offset=N&length=M` serves bytes of a firmware update image
+ * (FirmwareImage.h), 404 when there is none. Every firmwareCutEvery-th such
+ * response is cut off halfway and the connection closed, so resuming an
+ * interrupted download can be exercised.
+ *
+ * For chaos runs, schedule GETs can be answered wrongly on purpose: late,
+ * with a connection reset, with the body cut short, with a body that isn't
+ * a schedule, or with an error status. One fault kind per server, applied to
+ * every faultEvery-th schedule request while faulting is on (setFaulting()
+ * flips it from another thread). Firmware requests are never faulted.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+enum StandInFault {
+  STAND_IN_FAULT_NONE,
+  STAND_IN_FAULT_LATENCY,    // Answer faultLatencyMs late (other connections aren't held up)
+  STAND_IN_FAULT_RESET,      // Reset the connection (RST) instead of answering
+  STAND_IN_FAULT_TRUNCATE,   // Full snapshot headers, half the body, then close
+  STAND_IN_FAULT_MALFORMED,  // 200 with a cut-off object, a bad literal or an HTML page
+  STAND_IN_FAULT_STATUS      // faultStatus with a text body (and Retry-After if set)
+};
+
+struct StandInConfig {
+  uint16_t port;          // 0 = pick an ephemeral port
+  std::string body;       // Fixed body for every GET; empty = versioned schedule
+  uint8_t zones;          // Initial zones of the versioned schedule (bit 0 = zone 1)
+  unsigned long flipEveryS;    // Toggle one zone this often, 0 = never
+  unsigned historyDepth;       // Versions a delta can span before a snapshot is sent
+  unsigned long maxAgeS;  // Send Cache-Control: max-age=N when non-zero
+  unsigned long idleTimeoutS;  // Close connections idle this long, 0 = never
+  std::string firmware;   // Update image served on /firmware; empty = 404
+  unsigned long firmwareCutEvery;  // Cut every Nth firmware response short, 0 = never
+  StandInFault fault;     // How schedule GETs go wrong while faulting
+  unsigned long faultEvery;    // Fault every Nth schedule GET (1 = all of them)
+  unsigned long faultLatencyMs;  // Delay for STAND_IN_FAULT_LATENCY
+  int faultStatus;        // Status for STAND_IN_FAULT_STATUS
+  unsigned long faultRetryAfterS;  // Retry-After sent with it, 0 = none
+
+  StandInConfig()
+    : port(0), zones(0x05), flipEveryS(0), historyDepth(16), maxAgeS(0), idleTimeoutS(30),
+      firmwareCutEvery(0), fault(STAND_IN_FAULT_NONE), faultEvery(1), faultLatencyMs(2000),
+      faultStatus(503), faultRetryAfterS(0) {}
+};
+
+struct StandInStats {
+  std::atomic<unsigned long> connections{0};  // Accepted TCP connections
+  std::atomic<unsigned long> requests{0};     // Complete requests answered
+  std::atomic<unsigned long> idleCloses{0};   // Connections reaped by the idle timeout
+  std::atomic<unsigned long> snapshots{0};    // Full schedules sent
+  std::atomic<unsigned long> deltas{0};       // Changed zones only
+  std::atomic<unsigned long> notModified{0};  // 304s
+  std::atomic<unsigned long> bodyBytes{0};    // Response body bytes sent
+  std::atomic<unsigned long> firmwareRequests{0};  // /firmware requests answered
+  std::atomic<unsigned long> firmwareCuts{0};      // ...of those, cut off on purpose
+  std::atomic<unsigned long> faults{0};       // Schedule GETs answered wrongly on purpose
+};
+
+class StandInServer {
+public:
+  StandInServer();
+  ~StandInServer();
+
+  /**
+   * Bind and listen on 127.0.0.1
+   * @param config Port and response body
+   * @return true on success
+   */
+  bool start(const StandInConfig& config);
+
+  /**
+   * Serve until `stop` becomes true
+   */
+  void run(const std::atomic<bool>& stop);
+
+  /**
+   * Turn fault injection on or off (safe from any thread; on after start())
+   * @param on Whether schedule GETs get config.fault
+   */
+  void setFaulting(bool on) { faulting.store(on); }
+
+  uint16_t port() const { return boundPort; }
+  const StandInStats& stats() const { return counters; }
+
+private:
+  struct Connection;
+
+  void acceptAll();
+  void handleReadable(Connection* conn);
+  void answerRequests(Connection* conn);
+  bool sendResponse(Connection* conn, const std::string& response, bool close);
+  void sendDelayed();
+  StandInFault nextFault();
+  void closeConnection(Connection* conn);
+  void reapIdle();
+  void flipZone();
+  int scheduleResponse(const std::string& head, std::string* body);
+  int firmwareResponse(const std::string& head, std::string* body, bool* cut);
+
+  StandInConfig config;
+  int listenFd;
+  int epollFd;
+  uint16_t boundPort;
+  StandInStats counters;
+  std::set<Connection*> liveConnections;  // For the idle sweep
+  std::atomic<bool> faulting;
+  unsigned long scheduleRequests;  // Counts toward faultEvery
+  unsigned long delayedCount;      // Connections holding a late response
+
+  // Versioned schedule: history[i] holds the zones of version firstSeq + i
+  uint32_t firstSeq;
+  std::vector<uint8_t> history;
+  unsigned long lastFlipMs;
+};
+
+#endif // HOST_STAND_IN_SERVER_H
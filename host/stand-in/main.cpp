@@ -0,0 +1,118 @@
+/*
+ * Schedule Endpoint Stand-In
+ *
+ * Serves the schedule JSON on 127.0.0.1 so host tools (and a controller on
+ * the bench) can run without the Servant backend and its Postgres.
+ *
+ * Usage: schedule-stand-in [--port N] [--flip-every S] [--history N] [--body JSON]
+ *                          [--max-age S] [--idle-timeout S]
+ *                          [--firmware FILE] [--firmware-cut-every N]
+ *                          [--fault KIND] [--fault-every N] [--latency-ms N]
+ *                          [--fault-status N] [--retry-after S]
+ *   --port  Listen port (default 3000, the controller's server_port)
+ *   --flip-every  Toggle one zone every S seconds, as a new version (default 0 = never)
+ *   --history  Versions a delta can span before a snapshot is sent (default 16)
+ *   --body  Fixed, unversioned response body instead of the versioned
+ *           schedule (which starts as {"zone1":true,"zone2":false,"zone3":true})
+ *   --max-age  Send Cache-Control: max-age=N seconds (default 0 = none)
+ *   --idle-timeout  Close keep-alive connections idle S seconds (default 30, 0 = never)
+ *   --firmware  Signed update image to serve on /firmware (from `just host-firmware-sign`)
+ *   --firmware-cut-every  Cut every Nth firmware response off halfway (default 0 = never)
+ *   --fault  Answer schedule GETs wrongly: latency, reset, truncate, malformed or status
+ *   --fault-every  Only every Nth schedule GET (default 1 = all)
+ *   --latency-ms  Delay for --fault latency (default 2000)
+ *   --fault-status  Status for --fault status (default 503)
+ *   --retry-after  Send Retry-After: S with --fault status (default 0 = none)
+ */
+
+#include "StandInServer.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+static std::atomic<bool> g_stop(false);
+
+static void onSignal(int) {
+  g_stop.store(true);
+}
+
+static const char* const FAULT_NAMES[] = {"none", "latency", "reset", "truncate", "malformed", "status"};
+
+int main(int argc, char** argv) {
+  StandInConfig config;
+  config.port = 3000;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--port") == 0) {
+      config.port = (uint16_t)atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--flip-every") == 0) {
+      config.flipEveryS = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--history") == 0) {
+      config.historyDepth = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--body") == 0) {
+      config.body = argv[i + 1];
+    } else if (strcmp(argv[i], "--max-age") == 0) {
+      config.maxAgeS = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--idle-timeout") == 0) {
+      config.idleTimeoutS = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--firmware") == 0) {
+      std::ifstream file(argv[i + 1], std::ios::binary);
+      std::stringstream contents;
+      contents << file.rdbuf();
+      config.firmware = contents.str();
+      if (!file || config.firmware.empty()) {
+        fprintf(stderr, "Can't read firmware image %s\n", argv[i + 1]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--firmware-cut-every") == 0) {
+      config.firmwareCutEvery = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--fault") == 0) {
+      int kind = 0;
+      while (kind <= STAND_IN_FAULT_STATUS && strcmp(argv[i + 1], FAULT_NAMES[kind]) != 0) kind++;
+      if (kind > STAND_IN_FAULT_STATUS) {
+        fprintf(stderr, "Unknown fault: %s\n", argv[i + 1]);
+        return 2;
+      }
+      config.fault = (StandInFault)kind;
+    } else if (strcmp(argv[i], "--fault-every") == 0) {
+      config.faultEvery = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--latency-ms") == 0) {
+      config.faultLatencyMs = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--fault-status") == 0) {
+      config.faultStatus = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--retry-after") == 0) {
+      config.faultRetryAfterS = strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  StandInServer server;
+  if (!server.start(config)) return 1;
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  printf("schedule-stand-in: listening on 127.0.0.1:%u\n", server.port());
+  fflush(stdout);
+
+  server.run(g_stop);
+
+  const StandInStats& stats = server.stats();
+  printf("schedule-stand-in: %lu connections, %lu requests, %lu idle closes\n",
+         stats.connections.load(), stats.requests.load(), stats.idleCloses.load());
+  printf("schedule-stand-in: %lu snapshots, %lu deltas, %lu not modified, %lu body bytes\n",
+         stats.snapshots.load(), stats.deltas.load(), stats.notModified.load(),
+         stats.bodyBytes.load());
+  if (!config.firmware.empty()) {
+    printf("schedule-stand-in: %lu firmware requests, %lu cut short\n",
+           stats.firmwareRequests.load(), stats.firmwareCuts.load());
+  }
+  if (config.fault != STAND_IN_FAULT_NONE) {
+    printf("schedule-stand-in: %lu %s faults injected\n", stats.faults.load(), FAULT_NAMES[config.fault]);
+  }
+  return 0;
+}
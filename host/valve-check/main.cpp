@@ -0,0 +1,290 @@
+/*
+ * Shift Register Valve Chain Check and Benchmark
+ *
+ * Drives the valve chain (ShiftRegisterValves.h) over a recording bus that
+ * keeps every frame transferred and feeds it, bit by bit, through a model
+ * of daisy-chained 74HC595s: shift registers clocked MSB first, storage
+ * registers loaded by the latch, outputs held off until /OE is enabled,
+ * and power-up garbage in both. The check fails unless
+ *
+ *   - the first frame is all off, and the outputs are enabled only once it
+ *     is latched, so the power-up contents never reach a valve,
+ *   - after every latch the outputs are exactly a mask that was written,
+ *     and once transfers drain, the last one (nothing torn, nothing lost),
+ *   - a write that changes nothing sends nothing, and writes made while a
+ *     transfer is under way go out together in one further frame,
+ *   - a transfer the bus refuses is retried by the next write.
+ *
+ * Transfers complete either inside startTransfer() or later, at random, as
+ * they would from a DMA interrupt. Reports the CPU cost of an update and
+ * the bytes and wire time per update at the firmware's SPI clock.
+ *
+ * Usage: valve-check [options]
+ *   --registers N   74HC595s in the chain, 1-4 (default: every size)
+ *   --writes N      Random writes per chain size (default 200000)
+ *   --seed N        RNG seed (default 1)
+ */
+
+#include "ShiftRegisterValves.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// VALVE_SPI_HZ in OutputEngine.cpp
+static const double SPI_HZ = 1000000.0;
+
+static unsigned long g_failures = 0;
+
+static void fail(const char* what, int registers, unsigned long step) {
+  if (g_failures++ < 10) {
+    printf("FAIL: %s (%d registers, step %lu)\n", what, registers, step);
+  }
+}
+
+//----------------------------------------------------------------------------//
+// Recording Bus and 74HC595 Model
+//----------------------------------------------------------------------------//
+
+class RecordingBus : public ShiftChainBus {
+public:
+  RecordingBus(int registers, std::mt19937* rng)
+      : chain(nullptr), registers(registers), deferred(false), refuseNext(false), pending(false),
+        enabled(false), rng(rng) {
+    // Whatever the registers hold at power-up
+    for (int r = 0; r < registers; r++) {
+      shift[r] = (uint8_t)(*rng)();
+      storage[r] = (uint8_t)(*rng)();
+    }
+  }
+
+  bool startTransfer(const uint8_t* frame, size_t length) override {
+    if (refuseNext) {
+      refuseNext = false;
+      return false;
+    }
+    if (pending) {
+      fail("transfer started while one was under way", registers, 0);
+    }
+    frames.push_back(std::vector<uint8_t>(frame, frame + length));
+    pending = true;
+    if (!deferred) complete();
+    return true;
+  }
+
+  void latch() override {
+    if (pending) {
+      fail("latched before the frame was clocked out", registers, 0);
+    }
+    memcpy(storage, shift, sizeof(storage));
+    enabled = true;
+    latches++;
+  }
+
+  // The transfer's bytes reach the chain, then the driver hears it finished
+  void complete() {
+    const std::vector<uint8_t>& frame = frames.back();
+    for (uint8_t byte : frame) {
+      for (int bit = 7; bit >= 0; bit--) clock((byte >> bit) & 1);
+    }
+    pending = false;
+    shiftChainTransferDone(chain);
+  }
+
+  // What the valves see: nothing until /OE goes low
+  uint32_t outputs() const {
+    if (!enabled) return 0;
+    uint32_t value = 0;
+    for (int r = 0; r < registers; r++) value |= (uint32_t)storage[r] << (r * 8);
+    return value;
+  }
+
+  ShiftRegisterChain* chain;
+  int registers;
+  bool deferred;                // Complete transfers when told, not at once
+  bool refuseNext;
+  bool pending;
+  bool enabled;
+  unsigned long latches = 0;
+  std::vector<std::vector<uint8_t>> frames;
+
+private:
+  // One SRCLK edge: every register takes the previous one's Q7, register 0 takes MOSI
+  void clock(int mosi) {
+    for (int r = registers - 1; r >= 0; r--) {
+      int in = r == 0 ? mosi : (shift[r - 1] >> 7) & 1;
+      shift[r] = (uint8_t)((shift[r] << 1) | in);
+    }
+  }
+
+  uint8_t shift[SHIFT_CHAIN_MAX_REGISTERS];
+  uint8_t storage[SHIFT_CHAIN_MAX_REGISTERS];
+  std::mt19937* rng;
+};
+
+//----------------------------------------------------------------------------//
+// Checks
+//----------------------------------------------------------------------------//
+
+static uint32_t chainBits(int registers) {
+  return registers >= 4 ? 0xFFFFFFFFu : ((1u << (registers * 8)) - 1);
+}
+
+static void checkBegin(int registers, std::mt19937& rng) {
+  RecordingBus bus(registers, &rng);
+  bus.deferred = true;
+  ShiftRegisterChain chain;
+  bus.chain = &chain;
+  shiftChainBegin(&chain, &bus, registers);
+  if (bus.frames.size() != 1 || bus.frames[0] != std::vector<uint8_t>(registers, 0)) {
+    fail("first frame isn't all off", registers, 0);
+  }
+  if (bus.enabled) fail("outputs enabled before the first latch", registers, 0);
+  shiftChainWrite(&chain, 0x01);  // Requested before the all-off frame is latched
+  if (bus.frames.size() != 1) fail("second frame started mid-transfer", registers, 0);
+  bus.complete();
+  if (!bus.enabled) fail("outputs not enabled after the first latch", registers, 0);
+  if (bus.frames.size() != 2) fail("write during the first frame was dropped", registers, 0);
+  bus.complete();
+  if (bus.outputs() != 0x01) fail("outputs don't match the write", registers, 0);
+}
+
+static void checkLayout(int registers) {
+  // One output at a time, against the model rather than shiftChainFrame()
+  std::mt19937 rng(7);
+  RecordingBus bus(registers, &rng);
+  ShiftRegisterChain chain;
+  bus.chain = &chain;
+  shiftChainBegin(&chain, &bus, registers);
+  for (int k = 0; k < registers * 8; k++) {
+    shiftChainWrite(&chain, 1u << k);
+    if (bus.outputs() != (1u << k)) fail("output lands on the wrong pin", registers, (unsigned long)k);
+  }
+  unsigned long frames = bus.frames.size();
+  shiftChainWrite(&chain, 1u << (registers * 8 - 1));
+  if (bus.frames.size() != frames) fail("unchanged write sent a frame", registers, 0);
+  if (registers < 4) {
+    shiftChainWrite(&chain, (1u << (registers * 8 - 1)) | (1u << (registers * 8)));
+    if (bus.frames.size() != frames) fail("bit past the chain sent a frame", registers, 0);
+  }
+}
+
+static void checkRandom(int registers, unsigned long writes, std::mt19937& rng) {
+  RecordingBus bus(registers, &rng);
+  ShiftRegisterChain chain;
+  bus.chain = &chain;
+  bus.deferred = true;
+  shiftChainBegin(&chain, &bus, registers);
+
+  std::set<uint32_t> written = {0};
+  uint32_t last = 0;
+  unsigned long changes = 0;
+  std::uniform_int_distribution<int> op(0, 9);
+  for (unsigned long i = 0; i < writes; i++) {
+    int choice = op(rng);
+    if (choice < 4 && bus.pending) {
+      bus.complete();
+      if (written.count(bus.outputs()) == 0) fail("outputs show a mask never written", registers, i);
+      continue;
+    }
+    if (choice == 4) bus.refuseNext = !bus.pending;
+    // Mostly small changes, like zones opening and closing one at a time
+    uint32_t mask = (choice < 8) ? (last ^ (1u << (rng() % (registers * 8))))
+                                 : ((uint32_t)rng() & chainBits(registers));
+    if (mask != last) changes++;
+    shiftChainWrite(&chain, mask);
+    written.insert(mask);
+    last = mask;
+  }
+  // Drain: a refused transfer needs another write to go out
+  for (int n = 0; n < 4 && (bus.pending || bus.outputs() != last); n++) {
+    if (bus.pending) {
+      bus.complete();
+    } else {
+      shiftChainWrite(&chain, last);
+    }
+  }
+  if (bus.outputs() != last) fail("outputs don't settle on the last write", registers, writes);
+  if (chain.stats.frames > changes + 1) fail("more frames than changes", registers, writes);
+  if (chain.stats.frames != bus.frames.size()) fail("frame count doesn't match the bus", registers, writes);
+
+  printf("  %d registers: %lu writes, %lu changes -> %lu frames (%lu merged while busy, %lu refused)\n",
+         registers, chain.stats.writes, changes, chain.stats.frames, chain.stats.merged,
+         chain.stats.refused);
+}
+
+//----------------------------------------------------------------------------//
+// Benchmark
+//----------------------------------------------------------------------------//
+
+// Completes at once and keeps nothing: the driver's own cost
+class NullBus : public ShiftChainBus {
+public:
+  ShiftRegisterChain* chain = nullptr;
+  bool startTransfer(const uint8_t*, size_t) override {
+    shiftChainTransferDone(chain);
+    return true;
+  }
+  void latch() override {}
+};
+
+static void benchmark(int registers) {
+  NullBus bus;
+  ShiftRegisterChain chain;
+  bus.chain = &chain;
+  shiftChainBegin(&chain, &bus, registers);
+  const unsigned long updates = 2000000;
+  Clock::time_point start = Clock::now();
+  for (unsigned long i = 0; i < updates; i++) shiftChainWrite(&chain, (uint32_t)(i * 2654435761u));
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / updates;
+  printf("  %d registers: %5.1f ns per update, %d byte frame, %5.1f us on the wire at %.0f MHz\n",
+         registers, ns, registers, registers * 8 / SPI_HZ * 1e6, SPI_HZ / 1e6);
+}
+
+//----------------------------------------------------------------------------//
+// Entry Point
+//----------------------------------------------------------------------------//
+
+int main(int argc, char** argv) {
+  int onlyRegisters = 0;
+  unsigned long writes = 200000;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--registers") == 0) {
+      onlyRegisters = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "--writes") == 0) {
+      writes = strtoul(argv[i + 1], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = (unsigned)strtoul(argv[i + 1], nullptr, 10);
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (onlyRegisters < 0 || onlyRegisters > SHIFT_CHAIN_MAX_REGISTERS) {
+    fprintf(stderr, "--registers must be 1 to %d\n", SHIFT_CHAIN_MAX_REGISTERS);
+    return 2;
+  }
+
+  std::mt19937 rng(seed);
+  printf("valve-check: frames through a modeled 74HC595 chain\n");
+  for (int registers = 1; registers <= SHIFT_CHAIN_MAX_REGISTERS; registers++) {
+    if (onlyRegisters != 0 && registers != onlyRegisters) continue;
+    checkBegin(registers, rng);
+    checkLayout(registers);
+    checkRandom(registers, writes, rng);
+  }
+  printf("valve-check: driver cost (bus completes at once)\n");
+  for (int registers = 1; registers <= SHIFT_CHAIN_MAX_REGISTERS; registers++) {
+    if (onlyRegisters != 0 && registers != onlyRegisters) continue;
+    benchmark(registers);
+  }
+  printf("%s\n", g_failures == 0 ? "PASS" : "FAIL");
+  return g_failures == 0 ? 0 : 1;
+}
@@ -6,11 +6,21 @@ module WebServer where
 import App qualified
 import App.Auth qualified as Auth
 import App.Observability (WithSpan)
+import Codec.Compression.GZip qualified as GZip
+import Data.ByteString.Lazy qualified as LBS
+import Data.Int (Int64)
+import Data.List (find)
+import Data.List.NonEmpty (NonEmpty (..))
+import Data.Proxy (Proxy (..))
 import Data.Text (Text)
+import Data.Text qualified as Text
 import OpenTelemetry.Trace (Tracer)
 import Servant qualified
 import Servant ((:>))
 import qualified Data.Aeson as Aeson
+import Data.Aeson ((.=))
+import Data.Aeson.Key qualified as Key
+import Data.Word (Word32)
 import GHC.Generics (Generic)
 import Data.Text.Display.Core (Display)
 import Data.Text.Display.Generic (RecordInstance (..))
@@ -22,7 +32,7 @@ import qualified App.Config
 runApp :: () -> IO ()
 runApp = App.runApp @API server
 
-type API = WithSpan "GET SCHEDULE" (Servant.Header "Cookie" Text :> Servant.Get '[Servant.JSON] Schedule)
+type API = WithSpan "GET SCHEDULE" (Servant.Header "Cookie" Text :> Servant.Header "Accept-Encoding" Text :> Servant.QueryParam "since" Word32 :> Servant.Get '[EncodedJSON] EncodedResponse)
 
 server :: App.Config.Environment -> Servant.ServerT API (AppM ())
 server _ = handler
@@ -30,16 +40,118 @@ server _ = handler
 handler ::
   Tracer ->
   Maybe Text ->
-  AppM () Schedule
-handler _tracer cookie = do
+  Maybe Text ->
+  Maybe Word32 ->
+  AppM () EncodedResponse
+handler _tracer cookie acceptEncoding since = do
     _loginState <- Auth.userLoginState cookie
-    pure $ Schedule True False True
+    pure $ encodeResponse acceptEncoding (Aeson.encode (scheduleResponse since scheduleHistory))
+
+--------------------------------------------------------------------------------
+
+-- | @application/json@ already serialized, and perhaps gzipped, by
+-- 'encodeResponse'; Servant passes it through untouched.
+data EncodedJSON
+
+instance Servant.Accept EncodedJSON where
+  contentType _ = Servant.contentType (Proxy @Servant.JSON)
+
+newtype EncodedBody = EncodedBody LBS.ByteString
+
+instance Servant.MimeRender EncodedJSON EncodedBody where
+  mimeRender _ (EncodedBody body) = body
+
+type EncodedResponse = Servant.Headers '[Servant.Header "Content-Encoding" Text, Servant.Header "Vary" Text] EncodedBody
+
+-- | Bodies shorter than this go out as they are: under it the gzip header
+-- and trailer (18 bytes) cost about what compression saves.
+compressionThreshold :: Int64
+compressionThreshold = 256
+
+-- | Gzip the body when it's long enough and the client accepts gzip.
+-- Controllers decode with a 1 KB window (controller/Inflate.h), so the
+-- stream must never refer back further than that: zlib window bits 10,
+-- where the default of 15 would make every large body undecodable.
+encodeResponse :: Maybe Text -> LBS.ByteString -> EncodedResponse
+encodeResponse acceptEncoding body
+  | LBS.length body >= compressionThreshold && maybe False acceptsGzip acceptEncoding =
+      Servant.addHeader "gzip" $ Servant.addHeader "Accept-Encoding" $ EncodedBody (GZip.compressWith gzipParams body)
+  | otherwise =
+      Servant.noHeader $ Servant.addHeader "Accept-Encoding" $ EncodedBody body
+  where
+    gzipParams =
+      GZip.defaultCompressParams
+        { GZip.compressLevel = GZip.bestCompression,
+          GZip.compressWindowBits = GZip.windowBits 10
+        }
+
+-- | Whether an @Accept-Encoding@ value offers gzip (by name or @*@) without
+-- refusing it with @q=0@.
+acceptsGzip :: Text -> Bool
+acceptsGzip = any offered . Text.splitOn ","
+  where
+    offered entry = case Text.splitOn ";" entry of
+      coding : params -> Text.toLower (Text.strip coding) `elem` ["gzip", "x-gzip", "*"] && not (any refused params)
+      [] -> False
+    refused param = case Text.splitOn "=" (Text.filter (/= ' ') param) of
+      ["q", q] -> Text.all (`elem` ['0', '.']) q
+      _ -> False
+
+-- | The schedule and its version number. Every change to a schedule must
+-- get a new, larger number so controllers can ask for what changed.
+data Versioned = Versioned
+  { versionSeq :: Word32,
+    versionSchedule :: Schedule
+  }
+
+-- | The current version and the few before it, newest first. Only these
+-- can be answered with a delta, so keep it short: a controller further
+-- behind costs one snapshot. The schedule is fixed for now, so the history
+-- is the current version alone and a controller holding it gets an empty
+-- delta; earlier versions go behind it once schedules can change.
+scheduleHistory :: NonEmpty Versioned
+scheduleHistory = Versioned 1 (Schedule True False True) :| []
+
+-- | Controllers poll with @?since=N@, the version they hold. A version still
+-- in the history gets a @Delta@ of the zones changed since (empty for the
+-- current one); anything else, or no @since@, gets a full snapshot.
+scheduleResponse :: Maybe Word32 -> NonEmpty Versioned -> ScheduleResponse
+scheduleResponse since (current :| older) =
+  case since >>= \held -> find ((== held) . versionSeq) (current : older) of
+    Just base ->
+      Delta (versionSeq current) (versionSeq base) (diffSchedule (versionSchedule base) (versionSchedule current))
+    Nothing -> Snapshot (versionSeq current) (versionSchedule current)
+
+-- | Zones whose state differs between two versions, with their new state.
+diffSchedule :: Schedule -> Schedule -> [(Text, Bool)]
+diffSchedule old new =
+  [ (name, now)
+    | (name, before, now) <-
+        [ ("zone1", zone1 old, zone1 new),
+          ("zone2", zone2 old, zone2 new),
+          ("zone3", zone3 old, zone3 new)
+        ],
+      before /= now
+  ]
+
+-- | @{"seq":7,"zone1":true,"zone2":false,"zone3":true}@ for a snapshot,
+-- @{"seq":9,"base":7,"zone2":true}@ (changed zones only) for a delta.
+data ScheduleResponse
+  = Snapshot Word32 Schedule
+  | Delta Word32 Word32 [(Text, Bool)]
+  deriving stock (Eq, Show)
+
+instance Aeson.ToJSON ScheduleResponse where
+  toJSON (Snapshot seqNo Schedule {..}) =
+    Aeson.object ["seq" .= seqNo, "zone1" .= zone1, "zone2" .= zone2, "zone3" .= zone3]
+  toJSON (Delta seqNo base changes) =
+    Aeson.object $ ["seq" .= seqNo, "base" .= base] <> [Key.fromText name .= on | (name, on) <- changes]
 
 data Schedule = Schedule
   { zone1 :: Bool,
     zone2 :: Bool,
     zone3 :: Bool
   }
-  deriving stock (Show, Generic)
+  deriving stock (Eq, Show, Generic)
   deriving anyclass (Aeson.FromJSON, Aeson.ToJSON)
   deriving (Display) via (RecordInstance Schedule)
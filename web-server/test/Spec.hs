@@ -0,0 +1,44 @@
+module Main where
+
+--------------------------------------------------------------------------------
+
+import Data.List.NonEmpty (NonEmpty (..))
+import Test.Hspec
+import WebServer
+
+--------------------------------------------------------------------------------
+
+main :: IO ()
+main = hspec $ do
+  describe "scheduleResponse" $ do
+    it "answers a poll without ?since= with a snapshot" $
+      scheduleResponse Nothing history `shouldBe` Snapshot 3 current
+
+    it "answers the current version with an empty delta" $
+      scheduleResponse (Just 3) history `shouldBe` Delta 3 3 []
+
+    it "answers an earlier version with the zones changed since" $ do
+      scheduleResponse (Just 2) history `shouldBe` Delta 3 2 [("zone2", True)]
+      scheduleResponse (Just 1) history `shouldBe` Delta 3 1 [("zone1", True), ("zone2", True), ("zone3", False)]
+
+    it "answers a version no longer in the history with a snapshot" $ do
+      scheduleResponse (Just 7) history `shouldBe` Snapshot 3 current
+      scheduleResponse (Just 0) history `shouldBe` Snapshot 3 current
+
+    it "answers from the served history" $
+      scheduleResponse (Just 1) scheduleHistory `shouldBe` Delta 1 1 []
+
+  describe "diffSchedule" $ do
+    it "is empty for the same schedule" $
+      diffSchedule current current `shouldBe` []
+
+    it "lists only the zones that changed, with their new state" $
+      diffSchedule (Schedule False False True) (Schedule False True False)
+        `shouldBe` [("zone2", True), ("zone3", False)]
+  where
+    current = Schedule True True False
+    history =
+      Versioned 3 current
+        :| [ Versioned 2 (Schedule True False False),
+             Versioned 1 (Schedule False False True)
+           ]